@@ -0,0 +1,215 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file batch_kmedoids.h
+/// @brief PAM on many small, independent problems at once, spread across threads.
+///
+#ifndef MUSTER_BATCH_KMEDOIDS_H
+#define MUSTER_BATCH_KMEDOIDS_H
+
+#include "muster-config.h"
+#ifdef MUSTER_HAVE_OPENMP
+#include <omp.h>
+#endif // MUSTER_HAVE_OPENMP
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "kmedoids.h"
+#include "partition.h"
+#include "dissimilarity.h"
+
+namespace cluster {
+
+  ///
+  /// One problem for batch_kmedoids::pam(): a group of objects and the number of clusters
+  /// to find in it.  A problem can give a precomputed dissimilarity matrix instead of objects.
+  /// The objects or matrix are referenced, not copied, and must outlive the call.
+  ///
+  /// @tparam Objects  Container of objects (std::vector<T> or dense_dataset).  Problems 
+  ///                  that all have matrices can use the default.
+  ///
+  template <class Objects = std::vector<object_id> >
+  struct pam_problem {
+    const Objects *objects;                ///< Objects to cluster, or NULL if matrix is set.
+    const dissimilarity_matrix *matrix;    ///< Dissimilarities between the objects, or NULL.
+    size_t k;                              ///< Number of clusters to find.
+
+    pam_problem(const Objects& o, size_t _k) 
+      : objects(&o), matrix(NULL), k(_k) { }
+
+    pam_problem(const dissimilarity_matrix& m, size_t _k) 
+      : objects(NULL), matrix(&m), k(_k) { }
+
+    /// Number of objects in this problem.
+    size_t size() const { return matrix ? matrix->size1() : objects->size(); }
+
+    /// Rough cost of PAM on this problem, for scheduling the largest problems first.
+    double work() const { return (double)size() * size() * std::max<size_t>(k, 1); }
+  };
+
+
+  ///
+  /// Runs PAM on a batch of independent problems, e.g. thousands of per-region groups of a 
+  /// few hundred objects each timestep.  Problems are handed to OpenMP threads one at a time
+  /// (dynamic scheduling), largest first, so threads that finish early take more work and 
+  /// no thread is left with a big problem at the end.
+  ///
+  /// Each thread has its own kmedoids and dissimilarity matrix, kept between calls, so 
+  /// repeated batches reuse their storage.  Matrices of objects are built in the thread 
+  /// that clusters them.  Results don't depend on the number of threads.
+  ///
+  class batch_kmedoids {
+  public:
+    ///
+    /// Constructor.  num_threads is the number of threads to use, or 0 for as many as OpenMP
+    /// would use by default.
+    ///
+    batch_kmedoids(int threads = 0) : num_threads(threads), epsilon(1e-15) { }
+
+    /// Set tolerance for convergence.  See kmedoids::set_epsilon().
+    void set_epsilon(double e) { epsilon = e; }
+
+    /// Set the number of threads to use, or 0 for as many as OpenMP would use by default.
+    void set_num_threads(int threads) { num_threads = threads; }
+
+    ///
+    /// Cluster every problem with PAM.  On return, results[i] is the partition of the objects
+    /// of problems[i], with medoid ids and cluster ids local to that problem, and
+    /// average_dissimilarity(i) is its average dissimilarity.
+    ///
+    /// @param problems  Problems to cluster.
+    /// @param dmetric   Distance metric for problems given as objects.
+    /// @param results   One partition per problem.
+    ///
+    template <class Objects, class D>
+    void pam(const std::vector< pam_problem<Objects> >& problems, D dmetric, 
+             std::vector<partition>& results) {
+      for (size_t i=0; i < problems.size(); i++) {
+        const pam_problem<Objects>& problem = problems[i];
+        if (problem.matrix && problem.matrix->size1() != problem.matrix->size2()) {
+          throw std::logic_error("Error: distance matrix is not square!");
+        }
+        if (problem.k > problem.size()) {
+          throw std::logic_error("Attempt to run PAM with more clusters than data.");
+        }
+      }
+
+      // largest problems first.
+      order.resize(problems.size());
+      for (size_t i=0; i < order.size(); i++) order[i] = i;
+      std::stable_sort(order.begin(), order.end(), more_work<Objects>(problems));
+
+      results.resize(problems.size());
+      dissimilarities.resize(problems.size());
+
+      int threads = 1;
+#ifdef MUSTER_HAVE_OPENMP
+      threads = num_threads > 0 ? num_threads : omp_get_max_threads();
+#endif // MUSTER_HAVE_OPENMP
+      threads = std::max(1, std::min<int>(threads, problems.size()));
+      if (workers.size() < (size_t)threads) {
+        workers.resize(threads);
+        matrices.resize(threads);
+      }
+      for (size_t t=0; t < workers.size(); t++) {
+        workers[t].set_epsilon(epsilon);
+      }
+
+#pragma omp parallel num_threads(threads)
+      {
+        int t = 0;
+#ifdef MUSTER_HAVE_OPENMP
+        t = omp_get_thread_num();
+#endif // MUSTER_HAVE_OPENMP
+        kmedoids& worker = workers[t];
+        dissimilarity_matrix& scratch = matrices[t];
+        D thread_dmetric(dmetric);
+
+#pragma omp for schedule(dynamic, 1)
+        for (long o=0; o < (long)order.size(); o++) {
+          const size_t i = order[o];
+          const pam_problem<Objects>& problem = problems[i];
+
+          const dissimilarity_matrix *mat = problem.matrix;
+          if (!mat) {
+            build_dissimilarity_matrix(*problem.objects, thread_dmetric, scratch);
+            mat = &scratch;
+          }
+          worker.pam(*mat, problem.k);
+
+          results[i].medoid_ids  = worker.medoid_ids;
+          results[i].cluster_ids = worker.cluster_ids;
+          dissimilarities[i] = worker.average_dissimilarity();
+        }
+      }
+    }
+
+    ///
+    /// Cluster problems that all come with dissimilarity matrices.
+    ///
+    void pam(const std::vector< pam_problem<> >& problems, std::vector<partition>& results) {
+      pam(problems, no_distance(), results);
+    }
+
+    /// Average dissimilarity of objects from their medoids in problem i of the last batch.
+    double average_dissimilarity(size_t i) const { return dissimilarities[i]; }
+
+  private:
+    int num_threads;                              ///< Threads to use, or 0 for the OpenMP default.
+    double epsilon;                               ///< Convergence tolerance for PAM.
+    std::vector<kmedoids> workers;                ///< Per-thread kmedoids, kept between batches.
+    std::vector<dissimilarity_matrix> matrices;   ///< Per-thread scratch matrices.
+    std::vector<size_t> order;                    ///< Problem indices, largest first.
+    std::vector<double> dissimilarities;          ///< Average dissimilarity for each problem.
+
+    /// Orders problem indices by decreasing work.
+    template <class Objects>
+    struct more_work {
+      const std::vector< pam_problem<Objects> >& problems;
+      more_work(const std::vector< pam_problem<Objects> >& p) : problems(p) { }
+      bool operator()(size_t a, size_t b) const { 
+        return problems[a].work() > problems[b].work(); 
+      }
+    };
+
+    /// Metric for batches of matrices, where no distances are computed.
+    struct no_distance {
+      template <class T>
+      double operator()(const T&, const T&) const { return 0; }
+    };
+  };
+
+} // namespace cluster
+
+#endif // MUSTER_BATCH_KMEDOIDS_H
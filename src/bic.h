@@ -106,6 +106,50 @@ namespace cluster {
   }
 
 
+  ///
+  /// Weighted version of bic() for partitions of weighted objects, such as the unique objects 
+  /// from dedup().  Object i counts as weights[i] objects, so with integer counts this gives
+  /// the same score as bic() on the full, duplicated data set.
+  /// 
+  /// @param[in] p         A partition object describing the clustering to be evaluated.
+  /// @param[in] distance  A distance function callable on two \em indices from the partition p.
+  /// @param[in] M         Dimensionality parameter -- degrees of freedom in the input dataset.
+  /// @param[in] weights   Weight of each object in p.
+  ///
+  template <typename D>
+  double bic(const partition& p, D distance, size_t M, const std::vector<double>& weights) {
+    size_t k = p.num_clusters();
+
+    // weighted sizes and squared dissimilarity
+    std::vector<double> sizes(k, 0.0);
+    double R = 0, dissim2 = 0;
+    for (size_t i=0; i < p.size(); i++) {
+      double d = distance(i, p.medoid_ids[p.cluster_ids[i]]);
+      sizes[p.cluster_ids[i]] += weights[i];
+      R       += weights[i];
+      dissim2 += weights[i] * d * d;
+    }
+
+    double s2 = dissim2 / (R - k);
+    double s  = sqrt(s2);
+    double sM = pow(s, (double)M);
+
+    double root2pi = sqrt(2 * M_PI);
+    double lD = 0;
+    for (size_t i=0; i < p.size(); i++) {
+      double d  = distance(i, p.medoid_ids[p.cluster_ids[i]]);
+      double Ri = sizes[p.cluster_ids[i]];
+      lD += weights[i] * (
+        + log(1.0 / (root2pi * sM))
+        - (1 / (2 * s2)) * d * d
+        + log(Ri / R));
+    }
+
+    const size_t pj = (k-1) + M*k + 1;   // free parameter count
+    return lD - pj/2 * log((double)R);
+  }
+
+
   ///
   /// This version of the BIC assumes some precomputed information.  This is useful for
   /// parallel implementations, where it is more efficient to compute some global sums as a 
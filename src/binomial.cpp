@@ -1,5 +1,7 @@
 #include <cstdlib>
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <iostream>
 #include "binomial.h"
 using namespace std;
@@ -9,12 +11,54 @@ namespace cluster {
   binomial_embedding::binomial_embedding(int size, int root) 
     : _size(size), _root(root) { }
 
+  binomial_embedding::binomial_embedding(const vector<int>& nodes, int size, int root) 
+    : _size(size), _root(root)
+  {
+    // members of each node, with nodes in order of their lowest rank.
+    map<int, size_t> index;                    // node id -> index in members
+    vector< vector<int> > members;
+    for (int r=0; r < size; r++) {
+      map<int, size_t>::iterator i = index.find(nodes[r]);
+      if (i == index.end()) {
+        i = index.insert(make_pair(nodes[r], members.size())).first;
+        members.push_back(vector<int>());
+      }
+      members[i->second].push_back(r);
+    }
+
+    // the root leads its node, and its node goes first.
+    size_t root_node = index[nodes[root]];
+    vector<int>& root_members = members[root_node];
+    root_members.erase(find(root_members.begin(), root_members.end(), root));
+    root_members.insert(root_members.begin(), root);
+    swap(members[0], members[root_node]);
+    if (root_node > 1) {
+      // keep the rest in order of lowest rank.
+      rotate(members.begin() + 1, members.begin() + root_node, members.begin() + root_node + 1);
+    }
+
+    node_layout *layout = new node_layout();
+    layout->position.resize(size);
+    for (size_t n=0; n < members.size(); n++) {
+      layout->starts.push_back(layout->order.size());
+      for (size_t m=0; m < members[n].size(); m++) {
+        layout->position[members[n][m]] = layout->order.size();
+        layout->order.push_back(members[n][m]);
+        layout->node.push_back(n);
+      }
+    }
+    layout->starts.push_back(size);
+    _layout.reset(layout);
+  }
+
   /// This permutes ranks in case the root is not zero
   int binomial_embedding::relative_rank(int rank) const {
+    if (_layout) return _layout->position[rank];
     return (rank - _root + _size) % _size;
   }
 
   int binomial_embedding::reverse_relative_rank(int rank) const {
+    if (_layout) return _layout->order[rank];
     return (rank + _root) % _size;
   }
 
@@ -24,14 +68,32 @@ namespace cluster {
     return childvec;
   }
 
-  int binomial_embedding::parent(int rank) const {
-    int relrank = relative_rank(rank);
-    for (int mask = 0x1; mask < _size; mask <<= 1) {
-      if ((mask & relrank) != 0) {
-        return ((relrank & (~ mask)) + _root) % _size;
+  /// Parent of i in a binomial tree over [0, size) rooted at 0, or -1 for the root.
+  static int binomial_parent(int i, int size) {
+    for (int mask = 0x1; mask < size; mask <<= 1) {
+      if ((mask & i) != 0) {
+        return i & (~ mask);
       }    
     }
     return -1;
   }
 
+  int binomial_embedding::parent(int rank) const {
+    if (!_layout) {
+      int parent = binomial_parent(relative_rank(rank), _size);
+      return (parent < 0) ? -1 : (parent + _root) % _size;
+    }
+
+    // parent on this node, or the leader of the parent node for leaders.
+    const node_layout& layout = *_layout;
+    int pos   = layout.position[rank];
+    int node  = layout.node[pos];
+    int start = layout.starts[node];
+    if (pos != start) {
+      return layout.order[start + binomial_parent(pos - start, layout.starts[node + 1] - start)];
+    }
+    int parent_node = binomial_parent(node, num_nodes());
+    return (parent_node < 0) ? -1 : layout.order[layout.starts[parent_node]];
+  }
+
 } // namespace cluster
@@ -3,17 +3,46 @@
 
 #include <cstdlib>
 #include <vector>
+#include <boost/shared_ptr.hpp>
 
 namespace cluster {
   
+  ///
+  /// Embedding of a binomial tree in a set of ranks, for gathers.  Ranks are numbered by their
+  /// position in a depth-first traversal of the tree, so the subtree below any rank covers a
+  /// contiguous range of positions.  gather_packed() relies on this to pack data from the 
+  /// whole tree in position order.
+  ///
+  /// The plain embedding is a binomial tree over ranks in order, starting at the root.  The
+  /// node-aware embedding first combines the ranks on each node, with a binomial tree per
+  /// node, then combines node leaders with a binomial tree over nodes.  Only one tree edge 
+  /// per node other than the root's crosses a node boundary, however ranks are placed.
+  ///
   class binomial_embedding {
   private:
-    const int _size;
-    const int _root;
+    /// Ranks grouped by node, for the node-aware embedding.
+    struct node_layout {
+      std::vector<int> order;      ///< Rank at each position.
+      std::vector<int> position;   ///< Position of each rank.
+      std::vector<int> node;       ///< Node index at each position.
+      std::vector<int> starts;     ///< First position of each node, then size.
+    };
+
+    int _size;
+    int _root;
+    boost::shared_ptr<const node_layout> _layout;   ///< NULL for the plain embedding.
     
   public:
     /// Construct a binomial rank embedding with size nodes, rooted at root.
     binomial_embedding(int size, int root = 0);
+
+    ///
+    /// Construct a node-aware embedding of ranks [0, size), rooted at root.  nodes[r] 
+    /// identifies the node of rank r, e.g. from get_node_ids() in gather.h.  Ranks on the
+    /// root's node come first, starting with the root, then the other nodes in order of their
+    /// lowest rank, which is their leader.
+    ///
+    binomial_embedding(const std::vector<int>& nodes, int size, int root = 0);
     
     int relative_rank(int rank) const;          ///< This permutes ranks in case the root is not zero
     int reverse_relative_rank(int rank) const;  ///< Reverse rank permutation
@@ -22,19 +51,64 @@ namespace cluster {
     
     int size() const { return _size; }
     int root() const { return _root; }
+
+    /// Number of nodes in the embedding; each rank is its own node in the plain embedding.
+    int num_nodes() const { return _layout ? _layout->starts.size() - 1 : _size; }
     
     /// This allows you to putting children into any structure that supports output iterators
     template <class OutputIterator>
     void get_children(int rank, OutputIterator o) const {
-      int relrank = relative_rank(rank);
-      for (int mask = 0x1; mask < _size; mask <<= 1) {
-        if ((mask & relrank) != 0) {
+      if (!_layout) {
+        binomial_children(relative_rank(rank), _size, o, rotation(_root, _size));
+        return;
+      }
+
+      // children on this node, then leaders of child nodes if rank leads its node.
+      const node_layout& layout = *_layout;
+      int pos   = layout.position[rank];
+      int node  = layout.node[pos];
+      int start = layout.starts[node];
+      binomial_children(pos - start, layout.starts[node + 1] - start, o, 
+                        positions(layout, start));
+      if (pos == start) {
+        binomial_children(node, num_nodes(), o, leaders(layout));
+      }
+    }
+
+  private:
+    /// Maps relative ranks to ranks in the plain embedding.
+    struct rotation {
+      int root, size;
+      rotation(int r, int s) : root(r), size(s) { }
+      int operator()(int i) const { return (i + root) % size; }
+    };
+
+    /// Maps local indices on a node to ranks.
+    struct positions {
+      const node_layout& layout;
+      int start;
+      positions(const node_layout& l, int s) : layout(l), start(s) { }
+      int operator()(int i) const { return layout.order[start + i]; }
+    };
+
+    /// Maps node indices to the ranks of their leaders.
+    struct leaders {
+      const node_layout& layout;
+      leaders(const node_layout& l) : layout(l) { }
+      int operator()(int n) const { return layout.order[layout.starts[n]]; }
+    };
+
+    /// Children of index i in a binomial tree over [0, size) rooted at 0, mapped to ranks.
+    template <class OutputIterator, class Map>
+    static void binomial_children(int i, int size, OutputIterator& o, Map map) {
+      for (int mask = 0x1; mask < size; mask <<= 1) {
+        if ((mask & i) != 0) {
           break;
         }
         
-        int child = (relrank | mask);
-        if (child < _size) {
-          *o++ = (child + _root) % _size;
+        int child = (i | mask);
+        if (child < size) {
+          *o++ = map(child);
         }
       }
     }
@@ -43,4 +117,3 @@ namespace cluster {
 } // namespace cluster
 
 #endif // MUSTER_BINOMIAL_H
-
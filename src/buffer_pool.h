@@ -0,0 +1,128 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file buffer_pool.h
+/// @brief Pool of reusable char buffers for packing and unpacking MPI messages.
+///
+#ifndef MUSTER_BUFFER_POOL_H
+#define MUSTER_BUFFER_POOL_H
+
+#include <vector>
+#include <cstddef>
+
+namespace cluster {
+
+  ///
+  /// Pool of reusable char buffers.  Gathers acquire buffers here instead of allocating
+  /// them, and release them when they're done, so once the pool has grown to fit a 
+  /// program's messages, later gathers do no heap allocation for their buffers.  The pool
+  /// also keeps the integer scratch a gather needs for its place in the tree.
+  ///
+  /// Copying a pool gives an empty pool; buffers are never shared between pools.
+  ///
+  class buffer_pool {
+  public:
+    typedef std::vector<char> buffer_type;
+
+    /// Child ranks, message sizes, and receive offsets of one gather.
+    struct gather_scratch {
+      std::vector<int> children;
+      std::vector<int> sizes;
+      std::vector<int> offsets;
+    };
+
+    buffer_pool() : growths(0) { }
+    buffer_pool(const buffer_pool&) : growths(0) { }
+    buffer_pool& operator=(const buffer_pool&) { return *this; }
+
+    ~buffer_pool() {
+      for (size_t i=0; i < free_buffers.size(); i++) {
+        delete free_buffers[i];
+      }
+    }
+
+    ///
+    /// Get a buffer of size chars.  This is the free buffer with the smallest capacity that
+    /// fits size, if there is one.  Otherwise the largest free buffer is grown, or a new one
+    /// is made.  The buffer must go back to this pool with release().
+    ///
+    buffer_type *acquire(size_t size) {
+      size_t best = free_buffers.size();      // smallest that fits
+      size_t largest = free_buffers.size();   // largest overall
+      for (size_t i=0; i < free_buffers.size(); i++) {
+        size_t capacity = free_buffers[i]->capacity();
+        if (capacity >= size && (best == free_buffers.size() || capacity < free_buffers[best]->capacity())) {
+          best = i;
+        }
+        if (largest == free_buffers.size() || capacity > free_buffers[largest]->capacity()) {
+          largest = i;
+        }
+      }
+
+      size_t pick = (best < free_buffers.size()) ? best : largest;
+      buffer_type *buf;
+      if (pick < free_buffers.size()) {
+        buf = free_buffers[pick];
+        free_buffers[pick] = free_buffers.back();
+        free_buffers.pop_back();
+      } else {
+        buf = new buffer_type();
+      }
+
+      if (buf->capacity() < size) growths++;
+      buf->resize(size);
+      return buf;
+    }
+
+    /// Return a buffer from acquire() to the pool.
+    void release(buffer_type *buf) {
+      if (buf) free_buffers.push_back(buf);
+    }
+
+    /// Number of times acquire() has had to allocate memory.
+    size_t num_growths() const { return growths; }
+
+    /// Number of buffers waiting in the pool.
+    size_t num_free() const { return free_buffers.size(); }
+
+    /// Integer scratch for gathers that use this pool.  Only one gather may use it at a time.
+    gather_scratch& scratch() { return gather_ints; }
+
+  private:
+    std::vector<buffer_type*> free_buffers;   ///< Buffers not in use.
+    size_t growths;                           ///< Times acquire() allocated.
+    gather_scratch gather_ints;               ///< Scratch returned by scratch().
+  };
+
+} // namespace cluster
+
+#endif // MUSTER_BUFFER_POOL_H
@@ -0,0 +1,334 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file capek_request.h
+/// @brief Handles for non-blocking runs of capek() and xcapek().
+///
+#ifndef MUSTER_CAPEK_REQUEST_H
+#define MUSTER_CAPEK_REQUEST_H
+
+#include <mpi.h>
+#include <vector>
+#include <stdexcept>
+#include <boost/scoped_ptr.hpp>
+
+#include "par_kmedoids.h"
+
+namespace cluster {
+
+  ///
+  /// A clustering in progress, started with par_kmedoids::icapek() or par_kmedoids::ixcapek().
+  /// Works like an MPI_Request: the clustering moves forward only inside calls to test()
+  /// and wait(), which every process in the par_kmedoids' communicator must keep making
+  /// until the request completes.  Sample gathers, medoid broadcasts and reductions are all
+  /// non-blocking, so a process that calls test() between steps of its own work only blocks
+  /// if it is a worker: to run PAM on its sample, then to combine medoids with the other 
+  /// workers on the node-aware binomial tree that capek() uses.  There is no helper thread, 
+  /// so nothing happens between calls.
+  ///
+  /// Each phase is the same code that capek() and xcapek() run, in the par_kmedoids, with the
+  /// same workspace.  The request works on its own duplicate of the communicator, so the 
+  /// application can communicate on the original meanwhile.  The par_kmedoids object, the 
+  /// objects and the medoids vector must not be used or destroyed until the request 
+  /// completes.  When it does, the par_kmedoids holds the same partition that capek() or 
+  /// xcapek() would have found with the same seed.
+  ///
+  template <class Objects, class D>
+  class capek_request {
+  public:
+    typedef typename Objects::value_type T;
+
+    capek_request() 
+      : km(NULL), objects(NULL), medoids(NULL), phase(done_phase), comm(MPI_COMM_NULL),
+        packed(NULL) { }
+
+    /// Completes the request if it's still active, so all processes must destroy it together.
+    ~capek_request() {
+      if (active()) wait();
+    }
+
+    ///
+    /// Makes whatever progress is possible without blocking on communication.  Returns true
+    /// once the clustering is complete and the par_kmedoids holds its result.
+    ///
+    bool test() { return advance(false); }
+
+    /// Blocks until the clustering is complete and the par_kmedoids holds its result.
+    void wait() { advance(true); }
+
+    /// Whether a clustering has been started and hasn't completed yet.
+    bool active() const { return phase != done_phase; }
+
+  private:
+    friend class par_kmedoids;
+
+    /// Steps of the clustering.  Each waits on some communication before it can be done.
+    enum phase_t {
+      setup_phase,         ///< Waiting for object counts (and the seed).
+      gather_phase,        ///< Waiting for samples to arrive at workers.
+      medoid_size_phase,   ///< Waiting for the size of the packed medoids from process 0.
+      medoid_phase,        ///< Waiting for the packed medoids from process 0.
+      reduce_phase,        ///< Waiting for sums to reach process 0.
+      bcast_phase,         ///< Waiting for sums from process 0.
+      done_phase           ///< Nothing in progress.
+    };
+
+    par_kmedoids *km;                     ///< Object that started this request and gets the result.
+    const Objects *objects;               ///< Local objects to cluster.
+    boost::scoped_ptr<D> dmetric;         ///< Distance metric.
+    size_t k;                             ///< k for capek, max k for xcapek.
+    bool xmode;                           ///< Whether this is an xcapek().
+    size_t dimensionality;                ///< Dimensionality of objects, for the BIC.
+    std::vector<T> *medoids;              ///< Optional output for copies of the medoids.
+
+    phase_t phase;                        ///< What we're waiting for.
+    MPI_Comm comm;                        ///< Duplicate of km's communicator.
+    int size, rank;
+    std::vector<MPI_Request> reqs;        ///< Outstanding collectives for this phase.
+    uint32_t seed;                        ///< Seed broadcast from process 0, if km had none.
+    size_t local_count;                   ///< Number of local objects, sent to all processes.
+
+    boost::scoped_ptr<trial_generator> trials;      ///< Trials to run.
+    size_t round;                                   ///< Current round of trials.
+    int my_k;                                       ///< k for the local trial, if any.
+    int my_trial;                                   ///< Id of the local trial, or -1.
+    std::vector<char> *packed;                      ///< Packed medoids of the current round.
+    size_t packed_size;                             ///< Size of packed, sent from process 0.
+    par_kmedoids::k_search_state<T> state;          ///< Scores and best trial, for xcapek.
+
+    // requests hold pointers to their own members.
+    capek_request(const capek_request&);
+    capek_request& operator=(const capek_request&);
+
+    /// Workspace of the par_kmedoids, which holds all scratch storage.
+    capek_workspace& workspace() { return km->workspace(); }
+
+    /// Medoids of every trial, in the workspace.
+    std::vector<typename id_pair<T>::vector>& all_medoids() {
+      return workspace().template storage<T>(comm).medoids;
+    }
+
+    /// Starts the clustering; called by par_kmedoids::icapek() and par_kmedoids::ixcapek().
+    void start(par_kmedoids& _km, const Objects& _objects, D _dmetric, size_t _k, bool _xmode,
+               size_t _dimensionality, std::vector<T> *_medoids) {
+      if (active()) {
+        throw std::logic_error("Error: capek_request started while still active.");
+      }
+
+      km = &_km;
+      objects = &_objects;
+      dmetric.reset(new D(_dmetric));
+      k = _k;
+      xmode = _xmode;
+      dimensionality = _dimensionality;
+      medoids = _medoids;
+      state = par_kmedoids::k_search_state<T>();
+
+      // node ids are found with blocking collectives the first time, so find them now, on 
+      // km's communicator, where capek() caches them and the embeddings built from them too.
+      workspace().node_ids(km->comm);
+
+      CMPI_Comm_dup(km->comm, &comm);
+      CMPI_Comm_size(comm, &size);
+      CMPI_Comm_rank(comm, &rank);
+
+      // global ids of local objects start at offsets[rank].
+      local_count = objects->size();
+      km->start_object_offsets(local_count, workspace().offsets, comm, push_request());
+      if (!km->seed_set) {
+        km->start_uniform_seed(seed, comm, push_request());
+      }
+      phase = setup_phase;
+    }
+
+    ///
+    /// Does each step whose communication has completed, waiting for communication if block
+    /// is true.  Returns whether the clustering is complete.
+    ///
+    bool advance(bool block) {
+      while (phase != done_phase) {
+        if (phase == gather_phase) {
+          multi_gather<T>& gather = workspace().template storage<T>(comm).gather;
+          if (block) {
+            gather.finish();
+          } else if (!gather.test()) {
+            return false;
+          }
+
+        } else if (!reqs.empty()) {
+          if (block) {
+            CMPI_Waitall(reqs.size(), &reqs[0], MPI_STATUSES_IGNORE);
+          } else {
+            int flag;
+            CMPI_Testall(reqs.size(), &reqs[0], &flag, MPI_STATUSES_IGNORE);
+            if (!flag) return false;
+          }
+        }
+        reqs.clear();
+        step();
+      }
+      return true;
+    }
+
+    /// Does the work for the current phase, now that its communication is complete.
+    void step() {
+      switch (phase) {
+      case setup_phase:        setup();           break;
+      case gather_phase:       run_trial();       break;
+      case medoid_size_phase:  share_medoids();   break;
+      case medoid_phase:       unpack_medoids();  break;
+      case reduce_phase:
+        CMPI_Ibcast(&workspace().sums[0], workspace().sums.size(), MPI_DOUBLE, 0, comm, push_request());
+        phase = bcast_phase;
+        break;
+      case bcast_phase:        finish();          break;
+      case done_phase:                            break;
+      }
+    }
+
+    /// Adds a request to wait on in the current phase.
+    MPI_Request *push_request() {
+      reqs.push_back(MPI_REQUEST_NULL);
+      return &reqs.back();
+    }
+
+    /// Sets up trials once the object counts (and the seed) have arrived.
+    void setup() {
+      if (!km->seed_set) {
+        km->set_seed(seed);
+      }
+      std::vector<size_t>& offsets = workspace().offsets;
+      km->finish_object_offsets(offsets);
+
+      // fix things if k is greater than the number of elements, since we can't 
+      // ever find that many clusters.
+      size_t num_objects = offsets.back();
+      k = std::min(num_objects, k);
+      if (xmode) {
+        trials.reset(new trial_generator(par_kmedoids::k_range(1, k), km->max_reps, km->init_size, num_objects));
+      } else {
+        trials.reset(new trial_generator(k, k, km->max_reps, km->init_size, num_objects));
+      }
+      par_kmedoids::reset_vectors(all_medoids(), trials->num_trials());
+      round = 0;
+      start_round();
+    }
+
+    /// Starts gathers for the next round of trials, or starts evaluating trials if they're all done.
+    void start_round() {
+      if (!trials->has_next()) {
+        evaluate();
+        return;
+      }
+      my_trial = km->start_trial_round(*trials, *objects, workspace().offsets, comm, my_k);
+      phase = gather_phase;
+    }
+
+    ///
+    /// Runs PAM on the local sample, if there is one, and gathers the round's medoids to 
+    /// process 0, which starts broadcasting their size.
+    ///
+    void run_trial() {
+      capek_workspace& ws = workspace();
+      packed = ws.buffers.acquire(0);
+      if (my_trial >= 0) {
+        km->run_local_trial<T>(*dmetric, my_k, all_medoids()[my_trial], comm);
+
+        // the workers are ranks [0, num_workers), as in run_pam_trials().
+        gather_packed(make_packable_vector(&all_medoids()[my_trial], false), *packed, 
+                      ws.node_embedding(km->comm, num_workers()), comm, &ws.buffers);
+      }
+
+      packed_size = packed->size();
+      CMPI_Ibcast(&packed_size, 1, MPI_SIZE_T, 0, comm, push_request());
+      phase = medoid_size_phase;
+    }
+
+    /// Number of trials in the current round.
+    int num_workers() const { return trials->count() - round * size; }
+
+    /// Starts broadcasting the packed medoids from process 0.
+    void share_medoids() {
+      packed->resize(packed_size);
+      CMPI_Ibcast(&(*packed)[0], packed_size, MPI_PACKED, 0, comm, push_request());
+      phase = medoid_phase;
+    }
+
+    /// Unpacks the round's medoids into their trials, and moves on to the next round.
+    void unpack_medoids() {
+      const binomial_embedding& binomial = workspace().node_embedding(km->comm, num_workers());
+      km->finish_trial_round(*packed, binomial, round * size, all_medoids(), comm);
+      workspace().buffers.release(packed);
+      packed = NULL;
+
+      round++;
+      start_round();
+    }
+
+    ///
+    /// Finds the closest medoid in each trial to each local object, and starts summing 
+    /// dissimilarities (and cluster sizes, for xcapek) over all processes.
+    ///
+    void evaluate() {
+      capek_workspace& ws = workspace();
+      km->sum_trials(*objects, *dmetric, all_medoids(), trials->count(), ws.offsets[rank], xmode);
+
+      // Reduce then bcast, as capek() does, so sums are the same on all processes.
+      ws.sums.resize(ws.dissimilarities.size());
+      CMPI_Ireduce(&ws.dissimilarities[0], &ws.sums[0], ws.sums.size(), MPI_DOUBLE, MPI_SUM, 0, comm, 
+                   push_request());
+      if (xmode) {
+        ws.sizes.resize(ws.cluster_sizes.size());
+        CMPI_Iallreduce(&ws.cluster_sizes[0], &ws.sizes[0], ws.sizes.size(), MPI_SIZE_T, MPI_SUM, comm, 
+                        push_request());
+      }
+      phase = reduce_phase;
+    }
+
+    /// Picks the best trial and sets up km's partition with it, as capek() and xcapek() do.
+    void finish() {
+      const size_t num_objects = workspace().offsets.back();
+      if (xmode) {
+        km->score_trials(all_medoids(), trials->count(), dimensionality, num_objects, state);
+        km->finish_xcapek(state, num_objects, medoids);
+      } else {
+        km->finish_capek(all_medoids(), trials->count(), num_objects, medoids);
+      }
+
+      CMPI_Comm_free(&comm);
+      phase = done_phase;
+    }
+  };
+
+} // namespace cluster
+
+#endif // MUSTER_CAPEK_REQUEST_H
@@ -0,0 +1,247 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file capek_workspace.h
+/// @brief Storage that par_kmedoids keeps between calls to capek() and xcapek().
+///
+#ifndef MUSTER_CAPEK_WORKSPACE_H
+#define MUSTER_CAPEK_WORKSPACE_H
+
+#include <mpi.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+
+#include "mpi_bindings.h"
+#include "kmedoids.h"
+#include "dissimilarity.h"
+#include "multi_gather.h"
+#include "packable_vector.h"
+#include "id_pair.h"
+#include "buffer_pool.h"
+#include "gather.h"
+
+namespace cluster {
+
+  ///
+  /// Buffers, worker state, and communicators for par_kmedoids, kept between calls so that 
+  /// clustering once per timestep of a simulation stops allocating after the first few calls.
+  /// Every buffer stays at its high-water mark.  Each par_kmedoids has its own workspace;
+  /// par_kmedoids::set_workspace() lets several share one.
+  ///
+  /// The communicators made for each round of trials are cached here too, and freed when the
+  /// workspace is destroyed (unless MPI has been finalized by then).  They are looked up by the
+  /// parent communicator's handle, so a workspace shouldn't outlive communicators it was used with.
+  ///
+  /// Copying a workspace gives an empty one.
+  ///
+  class capek_workspace {
+  public:
+    /// Base for typed_storage, so the workspace itself needn't know the object type.
+    struct storage_base {
+      virtual ~storage_base() { }
+    };
+
+    /// Storage for objects of type T: samples, the medoids of each trial, and the gather for samples.
+    template <class T>
+    struct typed_storage : public storage_base {
+      MPI_Comm comm;                                          ///< Communicator for gather
+      multi_gather<T> gather;                                 ///< Gathers samples to workers
+      std::vector<T> samples;                                 ///< This process's trial sample
+      std::vector<typename id_pair<T>::vector> medoids;       ///< Medoids of every trial
+      std::vector< packable_vector< id_pair<T> > > unpacked;  ///< Medoids unpacked from a broadcast
+
+      typed_storage(MPI_Comm c, buffer_pool *pool) : comm(c), gather(c, 0, pool) { }
+    };
+
+    buffer_pool buffers;                        ///< Packing buffers for gathers
+    kmedoids worker;                            ///< Runs PAM on this process's trial
+    dissimilarity_matrix distance;              ///< Matrix for this process's trial sample
+    std::vector<size_t> offsets;                ///< Global id of the first object on each process
+    std::vector<size_t> sample_ids;             ///< Global ids of a trial's sample
+    std::vector<size_t> sample_indices;         ///< Local indices of sampled objects
+    std::vector<size_t> my_ids;                 ///< Global ids of this process's trial sample
+    std::vector<int> sources;                   ///< Processes that hold members of a sample
+    std::vector<double> dissimilarities;        ///< Local sums for judging trials, from sum_trials()
+    std::vector<double> sums;                   ///< Global versions of dissimilarities
+    std::vector<size_t> cluster_sizes;          ///< Local size of each trial's clusters
+    std::vector<size_t> sizes;                  ///< Global versions of cluster_sizes
+    std::vector< std::vector<medoid_id> > cluster_ids;   ///< Local cluster ids for each trial
+    std::vector<nearest_two> nearest;           ///< Nearest medoids of each local object
+
+    capek_workspace() : nodes_comm(MPI_COMM_NULL) { }
+    capek_workspace(const capek_workspace&) : nodes_comm(MPI_COMM_NULL) { }
+    capek_workspace& operator=(const capek_workspace&) { return *this; }
+
+    ~capek_workspace() {
+      int finalized;
+      CMPI_Finalized(&finalized);
+      if (finalized) return;
+
+      for (size_t i=0; i < comms.size(); i++) {
+        if (comms[i].comm != MPI_COMM_NULL) CMPI_Comm_free(&comms[i].comm);
+      }
+      for (size_t i=0; i < participants.size(); i++) {
+        if (participants[i].comm != MPI_COMM_NULL) CMPI_Comm_free(&participants[i].comm);
+      }
+    }
+
+    /// Storage for objects of type T gathered on comm, made on first use.  Switching to 
+    /// another type or communicator discards the old storage.
+    template <class T>
+    typed_storage<T>& storage(MPI_Comm comm) {
+      typed_storage<T> *s = dynamic_cast<typed_storage<T>*>(typed.get());
+      if (!s || s->comm != comm) {
+        s = new typed_storage<T>(comm, &buffers);
+        typed.reset(s);
+      }
+      return *s;
+    }
+
+    ///
+    /// Communicator for ranks [0, num_ranks) of comm, in the same order, made the first time it
+    /// is asked for.  Collective on comm.  Processes outside the group get MPI_COMM_NULL.
+    ///
+    MPI_Comm group_comm(MPI_Comm comm, int num_ranks) {
+      for (size_t i=0; i < comms.size(); i++) {
+        if (comms[i].parent == comm && comms[i].size == num_ranks) return comms[i].comm;
+      }
+
+      std::vector<int> ranks(num_ranks);
+      for (int r=0; r < num_ranks; r++) ranks[r] = r;
+
+      MPI_Group comm_group, group;
+      CMPI_Comm_group(comm, &comm_group);
+      CMPI_Group_incl(comm_group, num_ranks, &ranks[0], &group);
+
+      cached_comm cached;
+      cached.parent = comm;
+      cached.size = num_ranks;
+      CMPI_Comm_create(comm, group, &cached.comm);
+      CMPI_Group_free(&group);
+      CMPI_Group_free(&comm_group);
+
+      comms.push_back(cached);
+      return cached.comm;
+    }
+
+    ///
+    /// Communicator for the given ranks of comm, in the order given, kept until it is asked for
+    /// again with other ranks.  Call on every process in comm with the same ranks, but only the
+    /// processes in ranks communicate, with MPI_Comm_create_group().  The rest get MPI_COMM_NULL.
+    ///
+    MPI_Comm participant_comm(MPI_Comm comm, const std::vector<int>& ranks) {
+      for (size_t i=0; i < participants.size(); i++) {
+        if (participants[i].parent != comm) continue;
+        if (participants[i].ranks == ranks) return participants[i].comm;
+
+        // the old participants free their communicator together.
+        if (participants[i].comm != MPI_COMM_NULL) CMPI_Comm_free(&participants[i].comm);
+        participants.erase(participants.begin() + i);
+        break;
+      }
+
+      cached_participants cached;
+      cached.parent = comm;
+      cached.ranks = ranks;
+      cached.comm = MPI_COMM_NULL;
+
+      int rank;
+      CMPI_Comm_rank(comm, &rank);
+      if (std::find(ranks.begin(), ranks.end(), rank) != ranks.end()) {
+        MPI_Group comm_group, group;
+        CMPI_Comm_group(comm, &comm_group);
+        CMPI_Group_incl(comm_group, ranks.size(), const_cast<int*>(&ranks[0]), &group);
+        CMPI_Comm_create_group(comm, group, 0, &cached.comm);
+        CMPI_Group_free(&group);
+        CMPI_Group_free(&comm_group);
+      }
+
+      participants.push_back(cached);
+      return cached.comm;
+    }
+
+    ///
+    /// Node of each rank of comm, from get_node_ids(), for node-aware gathers.  Found the first
+    /// time it is asked for, which is collective on comm.
+    ///
+    const std::vector<int>& node_ids(MPI_Comm comm) {
+      if (nodes.empty() || nodes_comm != comm) {
+        get_node_ids(comm, nodes);
+        nodes_comm = comm;
+        embeddings.clear();
+      }
+      return nodes;
+    }
+
+    ///
+    /// Node-aware binomial_embedding of ranks [0, num_ranks) of comm, rooted at 0, for gathering
+    /// a round's trials.  Built from node_ids() the first time it's asked for with num_ranks,
+    /// so it's collective on comm if node_ids() is.  The reference is good until node_ids() 
+    /// is asked for another communicator.
+    ///
+    const binomial_embedding& node_embedding(MPI_Comm comm, int num_ranks) {
+      const std::vector<int>& node_of = node_ids(comm);
+      for (size_t i=0; i < embeddings.size(); i++) {
+        if (embeddings[i].size() == num_ranks) return embeddings[i];
+      }
+      embeddings.push_back(binomial_embedding(node_of, num_ranks, 0));
+      return embeddings.back();
+    }
+
+  private:
+    /// A communicator made by group_comm().
+    struct cached_comm {
+      MPI_Comm parent;   ///< Communicator the group was taken from
+      int size;          ///< The group is ranks [0, size) of parent
+      MPI_Comm comm;     ///< Communicator for the group
+    };
+
+    /// A communicator made by participant_comm().
+    struct cached_participants {
+      MPI_Comm parent;          ///< Communicator the participants were taken from
+      std::vector<int> ranks;   ///< Ranks of the participants in parent
+      MPI_Comm comm;            ///< Communicator for the participants, or null if not one
+    };
+
+    boost::shared_ptr<storage_base> typed;   ///< Storage for the last type clustered
+    std::vector<cached_comm> comms;          ///< Communicators from group_comm()
+    std::vector<cached_participants> participants;   ///< Communicators from participant_comm()
+    MPI_Comm nodes_comm;                     ///< Communicator that nodes describes
+    std::vector<int> nodes;                  ///< Node of each rank of nodes_comm
+    std::deque<binomial_embedding> embeddings;    ///< From node_embedding(), one per size
+  };
+
+} // namespace cluster
+
+#endif // MUSTER_CAPEK_WORKSPACE_H
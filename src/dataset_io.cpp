@@ -0,0 +1,418 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file dataset_io.cpp
+///
+#include "dataset_io.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "muster-config.h"
+#ifdef MUSTER_HAVE_OPENMP
+#include <omp.h>
+#endif // MUSTER_HAVE_OPENMP
+
+using namespace std;
+
+namespace cluster {
+
+  static const char dataset_magic[8] = { 'M', 'U', 'S', 'T', 'E', 'R', 'D', 'S' };
+
+  dataset_header::dataset_header(uint64_t r, uint64_t d) : rows(r), dimension(d) {
+    memcpy(magic, dataset_magic, sizeof(magic));
+  }
+
+  bool dataset_header::valid() const {
+    return !memcmp(magic, dataset_magic, sizeof(magic));
+  }
+
+
+  dataset_bounds::dataset_bounds(size_t dimension) 
+    : min(dimension,  numeric_limits<double>::infinity()),
+      max(dimension, -numeric_limits<double>::infinity()) { }
+
+  void dataset_bounds::add(const double *values) {
+    for (size_t d=0; d < min.size(); d++) {
+      if (values[d] < min[d]) min[d] = values[d];
+      if (values[d] > max[d]) max[d] = values[d];
+    }
+  }
+
+  void dataset_bounds::merge(const dataset_bounds& other) {
+    if (min.empty()) {
+      *this = other;
+      return;
+    }
+    for (size_t d=0; d < min.size(); d++) {
+      min[d] = std::min(min[d], other.min[d]);
+      max[d] = std::max(max[d], other.max[d]);
+    }
+  }
+
+
+  ///
+  /// RAII wrapper for a read-only mapping of a whole file.
+  ///
+  struct file_mapping {
+    void *addr;
+    size_t length;
+
+    file_mapping(const string& filename) : addr(NULL), length(0) {
+      int fd = open(filename.c_str(), O_RDONLY);
+      if (fd < 0) {
+        throw runtime_error("Couldn't open " + filename);
+      }
+
+      struct stat st;
+      if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw runtime_error("Couldn't stat " + filename);
+      }
+
+      length = st.st_size;
+      if (length) {
+        addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+          close(fd);
+          throw runtime_error("Couldn't map " + filename);
+        }
+        madvise(addr, length, MADV_SEQUENTIAL);
+      }
+      close(fd);   // mapping stays valid after close.
+    }
+
+    ~file_mapping() {
+      if (addr) munmap(addr, length);
+    }
+
+    const char *begin() const { return static_cast<const char*>(addr); }
+    const char *end()   const { return begin() + length; }
+
+    /// Give up ownership of the mapping.
+    void release() { addr = NULL; }
+  };
+
+
+  mapped_dataset::mapped_dataset(const string& filename) {
+    file_mapping mapping(filename);
+    if (mapping.length < sizeof(dataset_header)) {
+      throw runtime_error(filename + " is too small to be a data set.");
+    }
+
+    const dataset_header *header = reinterpret_cast<const dataset_header*>(mapping.begin());
+    if (!header->valid() || header->offset(header->rows) != mapping.length) {
+      throw runtime_error(filename + " is not a valid binary data set.");
+    }
+
+    map_     = mapping.addr;
+    length_  = mapping.length;
+    header_  = header;
+    values_  = reinterpret_cast<const double*>(mapping.begin() + sizeof(dataset_header));
+    mapping.release();
+  }
+
+
+  mapped_dataset::~mapped_dataset() {
+    munmap(map_, length_);
+  }
+
+
+  void mapped_dataset::copy(size_t first, size_t last, dense_dataset& dest, dataset_bounds *bounds) const {
+    dense_dataset data(dimension(), last - first);
+    if (bounds) *bounds = dataset_bounds(dimension());
+
+    for (size_t i=first; i < last; i++) {
+      std::copy(row(i), row(i) + dimension(), data.row_data(i - first));
+      if (bounds) bounds->add(row(i));
+    }
+    dest.swap(data);
+  }
+
+
+  void write_binary_dataset(const string& filename, const dense_dataset& data) {
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file) {
+      throw runtime_error("Couldn't open " + filename + " for writing.");
+    }
+
+    dataset_header header(data.size(), data.dimension());
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    for (size_t i=0; ok && i < data.size(); i++) {
+      ok = (fwrite(data.row_data(i), sizeof(double), data.dimension(), file) == data.dimension());
+    }
+
+    if (fclose(file) != 0 || !ok) {
+      throw runtime_error("Error writing " + filename);
+    }
+  }
+
+
+  void load_binary_dataset(const string& filename, dense_dataset& data, dataset_bounds *bounds) {
+    mapped_dataset mapped(filename);
+    mapped.copy(0, mapped.size(), data, bounds);
+  }
+
+
+  /// Exact powers of ten representable as doubles.
+  static const double powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  static const int max_exact_power = 22;
+
+  static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+  static inline bool is_blank(char c) { return c == ' ' || c == '\t'; }
+
+  const char *parse_double(const char *begin, const char *end, double *value) {
+    const char *p = begin;
+    while (p < end && is_blank(*p)) p++;
+    const char *start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative = (*p == '-');
+      p++;
+    }
+
+    uint64_t mantissa = 0;   // first 19 significant digits
+    int significant = 0;     // number of significant digits in mantissa
+    int exponent = 0;        // decimal exponent to apply to mantissa
+    bool any_digits = false;
+
+    for (; p < end && is_digit(*p); p++) {
+      any_digits = true;
+      if (significant < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa) significant++;
+      } else {
+        exponent++;
+      }
+    }
+
+    if (p < end && *p == '.') {
+      for (p++; p < end && is_digit(*p); p++) {
+        any_digits = true;
+        if (significant < 19) {
+          mantissa = mantissa * 10 + (*p - '0');
+          if (mantissa) significant++;
+          exponent--;
+        }
+      }
+    }
+
+    if (!any_digits) return begin;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      const char *e = p + 1;
+      bool negative_exp = false;
+      if (e < end && (*e == '-' || *e == '+')) {
+        negative_exp = (*e == '-');
+        e++;
+      }
+      if (e < end && is_digit(*e)) {
+        int exp = 0;
+        for (; e < end && is_digit(*e); e++) {
+          if (exp < 100000) exp = exp * 10 + (*e - '0');
+        }
+        exponent += negative_exp ? -exp : exp;
+        p = e;
+      }
+    }
+
+    double result = (double)mantissa;
+    if (mantissa && exponent) {
+      if (exponent < 0 && exponent >= -max_exact_power) {
+        result /= powers_of_ten[-exponent];
+      } else if (exponent > 0 && exponent <= max_exact_power) {
+        result *= powers_of_ten[exponent];
+      } else {
+        // Rare: huge or tiny magnitudes, where scaling would over/underflow.  Let strtod do it.
+        string token(start, p);
+        *value = strtod(token.c_str(), NULL);
+        return p;
+      }
+    }
+
+    *value = negative ? -result : result;
+    return p;
+  }
+
+
+  ///
+  /// Parses one CSV line in [begin, end) into values.  Returns the number of columns parsed,
+  /// or 0 if the line is not entirely numbers separated by commas.  Parses at most max_columns
+  /// values; a line with more columns than that returns max_columns + 1.
+  ///
+  static size_t parse_csv_line(const char *begin, const char *end, double *values, size_t max_columns) {
+    size_t columns = 0;
+    const char *p = begin;
+    while (true) {
+      double value;
+      const char *next = parse_double(p, end, &value);
+      if (next == p) return 0;
+      if (columns == max_columns) return max_columns + 1;
+      values[columns++] = value;
+
+      p = next;
+      while (p < end && (is_blank(*p) || *p == '\r')) p++;
+      if (p == end) return columns;
+      if (*p != ',') return 0;
+      p++;
+    }
+  }
+
+
+  /// Find the end of the line starting at p (the newline, or end).
+  static inline const char *line_end(const char *p, const char *end) {
+    const char *nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    return nl ? nl : end;
+  }
+
+
+  /// Start of the first line at or after p, assuming p may be mid-line.
+  static const char *next_line(const char *begin, const char *p, const char *end) {
+    if (p == begin || p == end) return p;
+    if (p[-1] == '\n') return p;
+    const char *e = line_end(p, end);
+    return (e == end) ? end : e + 1;
+  }
+
+
+  void load_csv_dataset(const string& filename, dense_dataset& data, 
+                        dataset_bounds *bounds, int num_threads) {
+    file_mapping file(filename);
+    const char *begin = file.begin();
+    const char *end   = file.end();
+
+    // Take the dimension from the first line that parses.
+    const size_t max_columns = 4096;
+    vector<double> scratch(max_columns + 1);
+    size_t dimension = 0;
+    for (const char *line = begin; line < end && !dimension; ) {
+      const char *eol = line_end(line, end);
+      dimension = parse_csv_line(line, eol, &scratch[0], max_columns);
+      if (dimension > max_columns) {
+        throw runtime_error(filename + " has too many columns.");
+      }
+      line = eol + 1;
+    }
+
+#ifdef MUSTER_HAVE_OPENMP
+    if (num_threads <= 0) num_threads = omp_get_max_threads();
+#else
+    num_threads = 1;
+#endif // MUSTER_HAVE_OPENMP
+
+    // Don't bother splitting small files finely.
+    const size_t min_chunk = 1 << 16;
+    num_threads = std::max(1, std::min<int>(num_threads, (end - begin) / min_chunk + 1));
+
+    // Each chunk gets its own values and bounds, merged in order afterwards.
+    vector< vector<double> > chunk_values(num_threads);
+    vector<dataset_bounds> chunk_bounds(num_threads, dataset_bounds(dimension));
+
+    if (dimension) {
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+      for (int t = 0; t < num_threads; t++) {
+        const char *chunk_begin = next_line(begin, begin + (end - begin) * t / num_threads, end);
+        const char *chunk_end   = next_line(begin, begin + (end - begin) * (t + 1) / num_threads, end);
+
+        vector<double>& values = chunk_values[t];
+        values.reserve((chunk_end - chunk_begin) / (8 * dimension) + dimension);
+        vector<double> row(dimension + 1);
+
+        for (const char *line = chunk_begin; line < chunk_end; ) {
+          const char *eol = line_end(line, chunk_end);
+          if (parse_csv_line(line, eol, &row[0], dimension) == dimension) {
+            values.insert(values.end(), row.begin(), row.begin() + dimension);
+            chunk_bounds[t].add(&row[0]);
+          }
+          line = eol + 1;
+        }
+      }
+    }
+
+    // Offsets of each chunk's rows in the final data set.
+    vector<size_t> offsets(num_threads + 1, 0);
+    for (int t=0; t < num_threads; t++) {
+      offsets[t+1] = offsets[t] + (dimension ? chunk_values[t].size() / dimension : 0);
+    }
+
+    dense_dataset result(dimension, offsets[num_threads]);
+
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+    for (int t = 0; t < num_threads; t++) {
+      const double *values = chunk_values[t].empty() ? NULL : &chunk_values[t][0];
+      for (size_t i = offsets[t]; i < offsets[t+1]; i++) {
+        std::copy(values, values + dimension, result.row_data(i));
+        values += dimension;
+      }
+      vector<double>().swap(chunk_values[t]);
+    }
+
+    if (bounds) {
+      *bounds = dataset_bounds();
+      for (int t=0; t < num_threads; t++) {
+        bounds->merge(chunk_bounds[t]);
+      }
+    }
+    data.swap(result);
+  }
+
+
+  void normalize(dense_dataset& data, const dataset_bounds& bounds) {
+    vector<double> scale(data.dimension());
+    for (size_t d=0; d < data.dimension(); d++) {
+      double range = bounds.max[d] - bounds.min[d];
+      scale[d] = (range > 0) ? 1.0 / range : 0.0;
+    }
+
+    for (size_t i=0; i < data.size(); i++) {
+      double *row = data.row_data(i);
+      for (size_t d=0; d < data.dimension(); d++) {
+        row[d] = (row[d] - bounds.min[d]) * scale[d];
+      }
+    }
+  }
+
+} // namespace cluster
@@ -0,0 +1,170 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file dataset_io.h
+/// @brief Fast loaders for numeric data sets: memory-mapped binary files and a
+///        multi-threaded CSV parser.
+///
+/// The binary format is deliberately trivial so that it can be read without any parsing,
+/// either by mapping it into memory or, in parallel, with MPI-IO:
+///
+/// <table>
+/// <tr><th>Offset</th><th>Type</th><th>Contents</th></tr>
+/// <tr><td>0</td> <td>char[8]</td>  <td>magic string "MUSTERDS"</td></tr>
+/// <tr><td>8</td> <td>uint64_t</td> <td>number of rows, <i>n</i></td></tr>
+/// <tr><td>16</td><td>uint64_t</td> <td>dimension of each row, <i>d</i></td></tr>
+/// <tr><td>24</td><td>double[n*d]</td><td>row-major values</td></tr>
+/// </table>
+///
+/// All values are in native byte order.
+///
+#ifndef DATASET_IO_H
+#define DATASET_IO_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "dense_dataset.h"
+
+namespace cluster {
+
+  /// Header at the start of every binary data set file.
+  struct dataset_header {
+    char     magic[8];    ///< Always "MUSTERDS" (not NUL-terminated).
+    uint64_t rows;        ///< Number of rows in the file.
+    uint64_t dimension;   ///< Number of doubles per row.
+
+    dataset_header(uint64_t rows = 0, uint64_t dimension = 0);
+
+    /// True if the magic string is correct.
+    bool valid() const;
+
+    /// Byte offset of row i in a file with this header.
+    uint64_t offset(uint64_t i) const { return sizeof(dataset_header) + i * dimension * sizeof(double); }
+  };
+
+
+  ///
+  /// Per-dimension minimum and maximum values of a data set.  These are what range
+  /// normalization needs, and the loaders compute them for free while reading.
+  ///
+  struct dataset_bounds {
+    std::vector<double> min;
+    std::vector<double> max;
+
+    /// Bounds for d dimensions that contain nothing yet.
+    explicit dataset_bounds(size_t dimension = 0);
+
+    /// Grow bounds to include the row of dimension() values at values.
+    void add(const double *values);
+
+    /// Grow bounds to include all of other.
+    void merge(const dataset_bounds& other);
+
+    size_t dimension() const { return min.size(); }
+  };
+
+
+  ///
+  /// Read-only view of a binary data set file mapped into memory.  Rows are accessed
+  /// in place, straight from the page cache, with no parsing or copying.
+  ///
+  class mapped_dataset {
+  public:
+    /// Map the file.  Throws std::runtime_error if it can't be opened or isn't valid.
+    explicit mapped_dataset(const std::string& filename);
+    ~mapped_dataset();
+
+    size_t size() const      { return header_->rows; }
+    size_t dimension() const { return header_->dimension; }
+
+    /// Pointer to the dimension() values of row i.  Rows are not padded.
+    const double *row(size_t i) const { return values_ + i * header_->dimension; }
+
+    /// Copy rows [first, last) into dest, replacing its contents, and optionally compute bounds.
+    void copy(size_t first, size_t last, dense_dataset& dest, dataset_bounds *bounds = NULL) const;
+
+  private:
+    void *map_;
+    size_t length_;
+    const dataset_header *header_;
+    const double *values_;
+
+    mapped_dataset(const mapped_dataset&);              // not copyable
+    mapped_dataset& operator=(const mapped_dataset&);
+  };
+
+
+  ///
+  /// Write data as a binary data set file.
+  ///
+  void write_binary_dataset(const std::string& filename, const dense_dataset& data);
+
+  ///
+  /// Load a whole binary data set file into data using mmap, optionally computing bounds.
+  ///
+  void load_binary_dataset(const std::string& filename, dense_dataset& data, 
+                           dataset_bounds *bounds = NULL);
+
+  ///
+  /// Load a CSV file with one object per line and one number per column.  The file is split
+  /// at line boundaries into one chunk per thread, and chunks are parsed in parallel with a 
+  /// non-locale-aware float parser.  Bounds, if requested, are computed in the same pass.
+  ///
+  /// The dimension is the number of columns on the first line that parses.  Lines that don't 
+  /// parse, or that have a different number of columns, are skipped.
+  ///
+  /// @param filename     File to read.
+  /// @param data         Destination; its contents are replaced.
+  /// @param bounds       Optional output for per-column minima and maxima.
+  /// @param num_threads  Threads to parse with.  Zero means use all available threads.
+  ///
+  void load_csv_dataset(const std::string& filename, dense_dataset& data, 
+                        dataset_bounds *bounds = NULL, int num_threads = 0);
+
+  ///
+  /// Parse a floating point number from [begin, end), skipping leading blanks.  This is much 
+  /// faster than strtod() but is not correctly rounded for numbers with more than 15 
+  /// significant digits, where it may be off by an ulp.  Returns a pointer just past the number, 
+  /// or begin if no number was found.
+  ///
+  const char *parse_double(const char *begin, const char *end, double *value);
+
+  ///
+  /// Rescale each dimension of data to [0,1] using the supplied bounds.
+  ///
+  void normalize(dense_dataset& data, const dataset_bounds& bounds);
+
+} // namespace cluster
+
+#endif // DATASET_IO_H
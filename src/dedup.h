@@ -0,0 +1,199 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file dedup.h
+/// @brief Collapse identical objects into unique objects with multiplicities.
+///
+/// When many objects are identical (e.g. thousands of ranks with the same performance 
+/// signature), clustering every copy wastes time and makes the dissimilarity matrix
+/// O(n^2) in the number of copies.  dedup() reduces a data set to its unique objects plus 
+/// a count for each, which the weighted kmedoids::pam(), kmedoids::clara() and bic() 
+/// overloads take as weights.  The resulting partition of unique objects can be expanded
+/// back to the original objects with dedup_map::expand().
+///
+/// <b>Example:</b>
+/// @code
+/// vector<point> unique;
+/// dedup_map map;
+/// dedup(points, unique, map, point_hash());
+///
+/// dissimilarity_matrix mat;
+/// build_dissimilarity_matrix(unique, point_distance(), mat);
+/// kmedoids km;
+/// km.pam(mat, map.weights, k);
+///
+/// partition full;
+/// map.expand(km, full);     // cluster ids for all of the original points
+/// @endcode
+///
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <vector>
+#include <functional>
+#include <tr1/unordered_map>
+
+#include <boost/functional/hash.hpp>
+
+#include "partition.h"
+#include "dense_dataset.h"
+#include "sparse_vector.h"
+
+namespace cluster {
+
+  ///
+  /// Correspondence between original objects and the unique objects found by dedup().
+  ///
+  struct dedup_map {
+    /// Number of original objects equal to each unique object.  Use these as weights.
+    std::vector<double> weights;
+
+    /// Index of the unique object equal to each original object.
+    std::vector<size_t> mapping;
+
+    /// Index of the first original object equal to each unique object.
+    std::vector<object_id> representatives;
+
+    /// Number of original objects.
+    size_t size() const { return mapping.size(); }
+
+    /// Number of unique objects.
+    size_t num_unique() const { return weights.size(); }
+
+    ///
+    /// Expand a partition of the unique objects into a partition of the original objects.
+    /// Each medoid becomes the first original object equal to it.
+    ///
+    void expand(const partition& unique, partition& full) const {
+      full.medoid_ids.resize(unique.medoid_ids.size());
+      for (size_t m=0; m < unique.medoid_ids.size(); m++) {
+        full.medoid_ids[m] = representatives[unique.medoid_ids[m]];
+      }
+      full.cluster_ids.resize(mapping.size());
+      for (size_t i=0; i < mapping.size(); i++) {
+        full.cluster_ids[i] = unique.cluster_ids[mapping[i]];
+      }
+    }
+  };
+
+
+  ///
+  /// Find the unique objects in objects, using hash to find candidates and exact equality
+  /// to confirm them.  This is a single O(n) pass, expected.
+  ///
+  /// @param[in]  objects  Objects to deduplicate: a std::vector<T>, dense_dataset, or 
+  ///                      anything with size() and operator[].
+  /// @param[out] unique   Unique objects are appended here, in order of first appearance.
+  ///                      Must support push_back() of an element of objects.
+  /// @param[out] map      Counts and mappings between objects and unique.
+  /// @param[in]  hash     Hash function callable on an element of objects.  Equal objects
+  ///                      must have equal hashes.
+  /// @param[in]  equal    Equality predicate callable on two elements of objects.
+  ///
+  template <class Objects, class Unique, class Hash, class Equal>
+  void dedup(const Objects& objects, Unique& unique, dedup_map& map, Hash hash, Equal equal) {
+    // hash value -> index of a unique object with that hash.
+    typedef std::tr1::unordered_multimap<size_t, size_t> index_map;
+    index_map index;
+
+    map.weights.clear();
+    map.representatives.clear();
+    map.mapping.resize(objects.size());
+
+    for (size_t i=0; i < objects.size(); i++) {
+      const size_t h = hash(objects[i]);
+
+      size_t u = map.num_unique();
+      std::pair<index_map::iterator, index_map::iterator> range = index.equal_range(h);
+      for (index_map::iterator it = range.first; it != range.second; it++) {
+        if (equal(objects[map.representatives[it->second]], objects[i])) {
+          u = it->second;
+          break;
+        }
+      }
+
+      if (u == map.num_unique()) {
+        index.insert(std::make_pair(h, u));
+        map.representatives.push_back(i);
+        map.weights.push_back(0);
+        unique.push_back(objects[i]);
+      }
+      map.weights[u] += 1;
+      map.mapping[i] = u;
+    }
+  }
+
+
+  ///
+  /// dedup() using operator== for equality.
+  ///
+  template <class Objects, class Unique, class Hash>
+  void dedup(const Objects& objects, Unique& unique, dedup_map& map, Hash hash) {
+    dedup(objects, unique, map, hash, std::equal_to<typename Objects::value_type>());
+  }
+
+
+  /// Hash of the coordinates of a dense row.
+  struct dense_row_hash {
+    size_t operator()(const dense_row& row) const {
+      return boost::hash_range(row.data(), row.data() + row.dimension());
+    }
+  };
+
+  /// Exact equality of dense rows.
+  struct dense_row_equal {
+    bool operator()(const dense_row& a, const dense_row& b) const {
+      return a.dimension() == b.dimension() && std::equal(a.data(), a.data() + a.dimension(), b.data());
+    }
+  };
+
+  /// Hash of the nonzeros of a sparse vector.
+  struct sparse_vector_hash {
+    size_t operator()(const sparse_vector& v) const {
+      size_t seed = boost::hash_range(v.indices(), v.indices() + v.nnz());
+      boost::hash_range(seed, v.values(), v.values() + v.nnz());
+      return seed;
+    }
+  };
+
+  /// Exact equality of sparse vectors.
+  struct sparse_vector_equal {
+    bool operator()(const sparse_vector& a, const sparse_vector& b) const {
+      return a.nnz() == b.nnz() 
+        && std::equal(a.indices(), a.indices() + a.nnz(), b.indices())
+        && std::equal(a.values(), a.values() + a.nnz(), b.values());
+    }
+  };
+
+} // namespace cluster
+
+#endif // DEDUP_H
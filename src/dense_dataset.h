@@ -0,0 +1,569 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file dense_dataset.h
+/// @brief Contiguous storage and fast distance kernels for dense numeric feature vectors.
+///
+/// Most clustering inputs are plain numeric vectors with a fixed number of dimensions.
+/// Storing these as a std::vector of individually allocated objects wastes memory and
+/// makes every distance computation chase pointers.  dense_dataset instead stores all 
+/// objects as rows of one aligned, contiguous block of doubles, and the kernels here work 
+/// directly on those rows.
+///
+/// Rows are padded with zeros to a multiple of dense_lanes doubles.  Zero padding does not
+/// change Euclidean, Manhattan or cosine distances, so the kernels can always process whole
+/// groups of lanes with independent accumulators, which compilers turn into SIMD code.
+///
+/// dense_dataset works as the objects argument to kmedoids::clara(), kmedoids::xclara(),
+/// par_kmedoids::capek() and par_kmedoids::xcapek().  Medoids and samples that need to be
+/// copied out of the dataset are stored as dense_point objects.
+///
+#ifndef DENSE_DATASET_H
+#define DENSE_DATASET_H
+
+#include "muster-config.h"
+
+#ifdef MUSTER_HAVE_MPI
+#include <mpi.h>
+#include "mpi_bindings.h"
+#endif // MUSTER_HAVE_MPI
+
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+#include <new>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+namespace cluster {
+
+  /// Rows of dense data are padded to a multiple of this many doubles.
+  const size_t dense_lanes = 4;
+
+  /// Alignment in bytes of dense row storage (one cache line).
+  const size_t dense_alignment = 64;
+
+  /// Number of doubles actually stored for a row of the given dimension.
+  inline size_t padded_dimension(size_t dimension) {
+    return (dimension + dense_lanes - 1) / dense_lanes * dense_lanes;
+  }
+
+  ///
+  /// Minimal STL allocator that returns memory aligned to Alignment bytes.
+  ///
+  template <class T, size_t Alignment = dense_alignment>
+  struct aligned_allocator {
+    typedef T         value_type;
+    typedef T*        pointer;
+    typedef const T*  const_pointer;
+    typedef T&        reference;
+    typedef const T&  const_reference;
+    typedef size_t    size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <class U> struct rebind { typedef aligned_allocator<U, Alignment> other; };
+
+    aligned_allocator() { }
+    template <class U> aligned_allocator(const aligned_allocator<U, Alignment>&) { }
+
+    pointer       address(reference x)       const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+    size_type     max_size()                 const { return size_type(-1) / sizeof(T); }
+
+    pointer allocate(size_type n, const void * = 0) {
+      void *p = NULL;
+      if (posix_memalign(&p, Alignment, std::max<size_t>(n * sizeof(T), 1))) {
+        throw std::bad_alloc();
+      }
+      return static_cast<pointer>(p);
+    }
+
+    void deallocate(pointer p, size_type) { free(p); }
+    void construct(pointer p, const T& val) { new (p) T(val); }
+    void destroy(pointer p) { p->~T(); }
+
+    template <class U> bool operator==(const aligned_allocator<U, Alignment>&) const { return true; }
+    template <class U> bool operator!=(const aligned_allocator<U, Alignment>&) const { return false; }
+  };
+
+
+  ///
+  /// Squared Euclidean distance between two padded rows of n doubles (n % dense_lanes == 0).
+  ///
+  inline double dense_squared_euclidean(const double *a, const double *b, size_t n) {
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (size_t i=0; i < n; i += dense_lanes) {
+      const double d0 = a[i]   - b[i];
+      const double d1 = a[i+1] - b[i+1];
+      const double d2 = a[i+2] - b[i+2];
+      const double d3 = a[i+3] - b[i+3];
+      s0 += d0 * d0;  s1 += d1 * d1;
+      s2 += d2 * d2;  s3 += d3 * d3;
+    }
+    return (s0 + s1) + (s2 + s3);
+  }
+
+  ///
+  /// Manhattan (L1) distance between two padded rows of n doubles (n % dense_lanes == 0).
+  ///
+  inline double dense_manhattan(const double *a, const double *b, size_t n) {
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (size_t i=0; i < n; i += dense_lanes) {
+      s0 += std::fabs(a[i]   - b[i]);
+      s1 += std::fabs(a[i+1] - b[i+1]);
+      s2 += std::fabs(a[i+2] - b[i+2]);
+      s3 += std::fabs(a[i+3] - b[i+3]);
+    }
+    return (s0 + s1) + (s2 + s3);
+  }
+
+  ///
+  /// Versions of dense_squared_euclidean() and dense_manhattan() for rows of exactly N doubles.
+  /// With N known at compile time, the loop over lanes unrolls completely for small rows.
+  ///
+  template <size_t N>
+  inline double dense_squared_euclidean(const double *a, const double *b) {
+    return dense_squared_euclidean(a, b, N);
+  }
+
+  template <size_t N>
+  inline double dense_manhattan(const double *a, const double *b) {
+    return dense_manhattan(a, b, N);
+  }
+
+  ///
+  /// Cosine distance (1 - cosine similarity) between two padded rows of n doubles.
+  /// The dot product and both norms are computed in a single pass.  Returns 0 if both 
+  /// rows are zero and 1 if only one is.
+  ///
+  inline double dense_cosine(const double *a, const double *b, size_t n) {
+    double ab0 = 0, ab1 = 0, aa0 = 0, aa1 = 0, bb0 = 0, bb1 = 0;
+    for (size_t i=0; i < n; i += dense_lanes) {
+      ab0 += a[i]   * b[i]   + a[i+2] * b[i+2];
+      ab1 += a[i+1] * b[i+1] + a[i+3] * b[i+3];
+      aa0 += a[i]   * a[i]   + a[i+2] * a[i+2];
+      aa1 += a[i+1] * a[i+1] + a[i+3] * a[i+3];
+      bb0 += b[i]   * b[i]   + b[i+2] * b[i+2];
+      bb1 += b[i+1] * b[i+1] + b[i+3] * b[i+3];
+    }
+    const double aa = aa0 + aa1;
+    const double bb = bb0 + bb1;
+    if (aa == 0 || bb == 0) {
+      return (aa == bb) ? 0.0 : 1.0;
+    }
+    return 1.0 - (ab0 + ab1) / std::sqrt(aa * bb);
+  }
+
+
+  ///
+  /// Lightweight, non-owning view of one dense row.  This is what dense_dataset::operator[]
+  /// returns, so it is what distance functors see.  Copying a dense_row copies a pointer,
+  /// not the data.
+  ///
+  class dense_row {
+  public:
+    dense_row(const double *data, size_t dimension)
+      : data_(data), dimension_(dimension) { }
+
+    const double *data() const      { return data_; }
+    size_t dimension() const        { return dimension_; }
+    size_t padded_size() const      { return padded_dimension(dimension_); }
+    double operator[](size_t i) const { return data_[i]; }
+
+#ifdef MUSTER_HAVE_MPI
+    /// Packed size of this row: its dimension followed by its values.
+    int packed_size(MPI_Comm comm) const {
+      return cmpi_packed_size(1, MPI_SIZE_T, comm) + cmpi_packed_size(dimension_, MPI_DOUBLE, comm);
+    }
+
+    /// Pack this row in the same format as dense_point::pack(), so that rows packed 
+    /// straight out of a dense_dataset can be unpacked as dense_points.
+    void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const {
+      CMPI_Pack(const_cast<size_t*>(&dimension_), 1, MPI_SIZE_T, buf, bufsize, position, comm);
+      CMPI_Pack(const_cast<double*>(data_), dimension_, MPI_DOUBLE, buf, bufsize, position, comm);
+    }
+#endif // MUSTER_HAVE_MPI
+
+  private:
+    const double *data_;
+    size_t dimension_;
+  };
+
+
+  ///
+  /// A single dense feature vector that owns its (aligned, padded) storage.  Used for
+  /// medoids and for samples copied out of a dense_dataset.  Converts implicitly to 
+  /// dense_row, so the same distance functors work on both.
+  ///
+  class dense_point {
+  public:
+    typedef std::vector<double, aligned_allocator<double> > storage_type;
+
+    /// New point of the given dimension with all coordinates zero.
+    explicit dense_point(size_t dimension = 0)
+      : values_(padded_dimension(dimension), 0.0), dimension_(dimension) { }
+
+    /// New point from dimension coordinates starting at data.
+    dense_point(const double *data, size_t dimension)
+      : values_(padded_dimension(dimension), 0.0), dimension_(dimension) {
+      std::copy(data, data + dimension, values_.begin());
+    }
+
+    /// Copy a row out of a dense_dataset.
+    dense_point(const dense_row& row)
+      : values_(row.data(), row.data() + row.padded_size()), dimension_(row.dimension()) { }
+
+    operator dense_row() const { return dense_row(data(), dimension_); }
+
+    const double *data() const          { return values_.empty() ? NULL : &values_[0]; }
+    double       *data()                { return values_.empty() ? NULL : &values_[0]; }
+    size_t dimension() const            { return dimension_; }
+    double  operator[](size_t i) const  { return values_[i]; }
+    double& operator[](size_t i)        { return values_[i]; }
+
+    dense_point& operator+=(const dense_row& other) {
+      for (size_t i=0; i < dimension_; i++) values_[i] += other[i];
+      return *this;
+    }
+
+    dense_point operator+(const dense_row& other) const {
+      dense_point result = *this;
+      result += other;
+      return result;
+    }
+
+    dense_point& operator/=(double divisor) {
+      for (size_t i=0; i < dimension_; i++) values_[i] /= divisor;
+      return *this;
+    }
+
+    dense_point operator/(double divisor) const {
+      dense_point result = *this;
+      result /= divisor;
+      return result;
+    }
+
+#ifdef MUSTER_HAVE_MPI
+    int packed_size(MPI_Comm comm) const {
+      return dense_row(*this).packed_size(comm);
+    }
+
+    void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const {
+      dense_row(*this).pack(buf, bufsize, position, comm);
+    }
+
+    static dense_point unpack(void *buf, int bufsize, int *position, MPI_Comm comm) {
+      dense_point p;
+      p.unpack_from(buf, bufsize, position, comm);
+      return p;
+    }
+
+    /// Unpack into this point, reusing its storage if it is already large enough.
+    void unpack_from(void *buf, int bufsize, int *position, MPI_Comm comm) {
+      CMPI_Unpack(buf, bufsize, position, &dimension_, 1, MPI_SIZE_T, comm);
+      values_.assign(padded_dimension(dimension_), 0.0);
+      CMPI_Unpack(buf, bufsize, position, data(), dimension_, MPI_DOUBLE, comm);
+    }
+#endif // MUSTER_HAVE_MPI
+
+  private:
+    storage_type values_;
+    size_t dimension_;
+  };
+
+
+  ///
+  /// Random-access iterator over the rows of a dense_dataset.  Dereferences to dense_row 
+  /// by value, so it is suitable for STL and boost iterator adaptors.
+  ///
+  class dense_row_iterator 
+    : public boost::iterator_facade<dense_row_iterator, dense_point, 
+                                    std::random_access_iterator_tag, dense_row> {
+  public:
+    dense_row_iterator() : data_(NULL), dimension_(0), stride_(0) { }
+    dense_row_iterator(const double *data, size_t dimension, size_t stride) 
+      : data_(data), dimension_(dimension), stride_(stride) { }
+
+  private:
+    friend class boost::iterator_core_access;
+
+    dense_row dereference() const                          { return dense_row(data_, dimension_); }
+    bool equal(const dense_row_iterator& other) const      { return data_ == other.data_; }
+    void increment()                                       { data_ += stride_; }
+    void decrement()                                       { data_ -= stride_; }
+    void advance(ptrdiff_t n)                              { data_ += n * (ptrdiff_t)stride_; }
+    ptrdiff_t distance_to(const dense_row_iterator& other) const {
+      return stride_ ? (other.data_ - data_) / (ptrdiff_t)stride_ : 0;
+    }
+
+    const double *data_;
+    size_t dimension_;
+    size_t stride_;
+  };
+
+
+  ///
+  /// Set of dense feature vectors with a fixed dimensionality, stored as padded rows in one
+  /// contiguous, cache-line-aligned block.
+  ///
+  /// This models the parts of std::vector<T> that the clustering algorithms use:
+  /// size(), operator[], begin() and end().  Its value_type is dense_point, which is
+  /// the type the algorithms use for medoids and samples.
+  ///
+  class dense_dataset {
+  public:
+    typedef dense_point        value_type;
+    typedef dense_row          const_reference;
+    typedef dense_row_iterator const_iterator;
+
+    /// New dataset with n rows of the given dimension, all zero.
+    explicit dense_dataset(size_t dimension = 0, size_t n = 0)
+      : dimension_(dimension), stride_(padded_dimension(dimension)), size_(n),
+        values_(n * padded_dimension(dimension), 0.0) { }
+
+    size_t size() const       { return size_; }
+    bool   empty() const      { return size_ == 0; }
+    size_t dimension() const  { return dimension_; }
+
+    /// Distance in doubles between the starts of consecutive rows.
+    size_t stride() const     { return stride_; }
+
+    /// Pointer to the first element of row i.  Only the first dimension() elements of a
+    /// row may be written; the padding after them must stay zero.
+    const double *row_data(size_t i) const { return &values_[i * stride_]; }
+    double       *row_data(size_t i)       { return &values_[i * stride_]; }
+
+    dense_row operator[](size_t i) const { return dense_row(row_data(i), dimension_); }
+
+    const_iterator begin() const { return const_iterator(base(), dimension_, stride_); }
+    const_iterator end()   const { return const_iterator(base() + size_ * stride_, dimension_, stride_); }
+
+    /// Change the number of rows.  New rows are zero.
+    void resize(size_t n) {
+      values_.resize(n * stride_, 0.0);
+      size_ = n;
+    }
+
+    /// Reserve space for n rows.
+    void reserve(size_t n) { values_.reserve(n * stride_); }
+
+    /// Remove all rows.  Storage is retained.
+    void clear() { resize(0); }
+
+    /// Append dimension() values starting at data as a new row.
+    void push_back(const double *data) {
+      resize(size_ + 1);
+      std::copy(data, data + dimension_, row_data(size_ - 1));
+    }
+
+    /// Append a row from another dataset or a dense_point of the same dimension.
+    void push_back(const dense_row& row) {
+      if (row.dimension() != dimension_) {
+        throw std::logic_error("dense_dataset::push_back: dimension mismatch.");
+      }
+      push_back(row.data());
+    }
+
+    void swap(dense_dataset& other) {
+      std::swap(dimension_, other.dimension_);
+      std::swap(stride_, other.stride_);
+      std::swap(size_, other.size_);
+      values_.swap(other.values_);
+    }
+
+#ifdef MUSTER_HAVE_MPI
+    ///
+    /// Packed size of rows [first, last), as packed by pack().
+    ///
+    int packed_size(size_t first, size_t last, MPI_Comm comm) const {
+      return 2 * cmpi_packed_size(1, MPI_SIZE_T, comm)
+        + cmpi_packed_size((last - first) * dimension_, MPI_DOUBLE, comm);
+    }
+
+    ///
+    /// Pack rows [first, last) in bulk.  Padding is skipped using a strided datatype, so
+    /// the whole range is packed with a single MPI_Pack call.
+    ///
+    void pack(size_t first, size_t last, void *buf, int bufsize, int *position, MPI_Comm comm) const {
+      size_t count = last - first;
+      CMPI_Pack(&count, 1, MPI_SIZE_T, buf, bufsize, position, comm);
+      CMPI_Pack(const_cast<size_t*>(&dimension_), 1, MPI_SIZE_T, buf, bufsize, position, comm);
+      if (!count) return;
+
+      MPI_Datatype rows = row_type(count);
+      CMPI_Pack(const_cast<double*>(row_data(first)), 1, rows, buf, bufsize, position, comm);
+      CMPI_Type_free(&rows);
+    }
+
+    ///
+    /// Unpack a range of rows packed by pack() and append them to this dataset.  An empty
+    /// dataset takes on the dimension of the packed rows.
+    ///
+    void unpack(void *buf, int bufsize, int *position, MPI_Comm comm) {
+      size_t count, dimension;
+      CMPI_Unpack(buf, bufsize, position, &count, 1, MPI_SIZE_T, comm);
+      CMPI_Unpack(buf, bufsize, position, &dimension, 1, MPI_SIZE_T, comm);
+      if (empty()) {
+        dimension_ = dimension;
+        stride_    = padded_dimension(dimension);
+      } else if (dimension != dimension_) {
+        throw std::logic_error("dense_dataset::unpack: dimension mismatch.");
+      }
+      if (!count) return;
+
+      size_t first = size_;
+      resize(size_ + count);
+      MPI_Datatype rows = row_type(count);
+      CMPI_Unpack(buf, bufsize, position, row_data(first), 1, rows, comm);
+      CMPI_Type_free(&rows);
+    }
+#endif // MUSTER_HAVE_MPI
+
+  private:
+    size_t dimension_;
+    size_t stride_;
+    size_t size_;
+    dense_point::storage_type values_;
+
+    const double *base() const { return values_.empty() ? NULL : &values_[0]; }
+
+#ifdef MUSTER_HAVE_MPI
+    /// Committed datatype describing count rows, skipping padding.  Caller frees.
+    MPI_Datatype row_type(size_t count) const {
+      MPI_Datatype rows;
+      CMPI_Type_vector(count, dimension_, stride_, MPI_DOUBLE, &rows);
+      CMPI_Type_commit(&rows);
+      return rows;
+    }
+#endif // MUSTER_HAVE_MPI
+  };
+
+
+  /// Euclidean distance between dense rows.
+  struct dense_euclidean_distance {
+    double operator()(const dense_row& a, const dense_row& b) const {
+      return std::sqrt(dense_squared_euclidean(a.data(), b.data(), a.padded_size()));
+    }
+  };
+
+  /// Manhattan (L1) distance between dense rows.
+  struct dense_manhattan_distance {
+    double operator()(const dense_row& a, const dense_row& b) const {
+      return dense_manhattan(a.data(), b.data(), a.padded_size());
+    }
+  };
+
+  /// Cosine distance (1 - cosine similarity) between dense rows.
+  struct dense_cosine_distance {
+    double operator()(const dense_row& a, const dense_row& b) const {
+      return dense_cosine(a.data(), b.data(), a.padded_size());
+    }
+  };
+
+
+  ///
+  /// Euclidean distance between dense rows of a dimension Dim fixed at compile time.  Rows
+  /// must have dimension Dim, or at least the same padded size.  Use with_dense_euclidean()
+  /// to pick one for a dimension known only at runtime.
+  ///
+  template <size_t Dim>
+  struct dense_fixed_euclidean_distance {
+    static const size_t padded = (Dim + dense_lanes - 1) / dense_lanes * dense_lanes;
+
+    double operator()(const dense_row& a, const dense_row& b) const {
+      return std::sqrt(dense_squared_euclidean<padded>(a.data(), b.data()));
+    }
+  };
+
+  /// Manhattan (L1) distance between dense rows of a dimension Dim fixed at compile time.
+  template <size_t Dim>
+  struct dense_fixed_manhattan_distance {
+    static const size_t padded = (Dim + dense_lanes - 1) / dense_lanes * dense_lanes;
+
+    double operator()(const dense_row& a, const dense_row& b) const {
+      return dense_manhattan<padded>(a.data(), b.data());
+    }
+  };
+
+  ///
+  /// Calls kernel(distance) once, with a dense_fixed_euclidean_distance for rows of up to 
+  /// 16 dimensions and dense_euclidean_distance for larger ones.  Kernel should have a templated
+  /// operator() that does all of its clustering with the distance it is given, e.g.
+  /// 
+  ///     struct run_clara {
+  ///       template <class D> void operator()(D distance) { km.clara(data, distance, k); }
+  ///     };
+  ///
+  template <class Kernel>
+  void with_dense_euclidean(size_t dimension, Kernel& kernel) {
+    switch (padded_dimension(dimension)) {
+    case 4:  kernel(dense_fixed_euclidean_distance<4>());  break;
+    case 8:  kernel(dense_fixed_euclidean_distance<8>());  break;
+    case 12: kernel(dense_fixed_euclidean_distance<12>()); break;
+    case 16: kernel(dense_fixed_euclidean_distance<16>()); break;
+    default: kernel(dense_euclidean_distance());           break;
+    }
+  }
+
+  /// Manhattan version of with_dense_euclidean().
+  template <class Kernel>
+  void with_dense_manhattan(size_t dimension, Kernel& kernel) {
+    switch (padded_dimension(dimension)) {
+    case 4:  kernel(dense_fixed_manhattan_distance<4>());  break;
+    case 8:  kernel(dense_fixed_manhattan_distance<8>());  break;
+    case 12: kernel(dense_fixed_manhattan_distance<12>()); break;
+    case 16: kernel(dense_fixed_manhattan_distance<16>()); break;
+    default: kernel(dense_manhattan_distance());           break;
+    }
+  }
+
+
+  inline std::ostream& operator<<(std::ostream& out, const dense_row& row) {
+    out << "(";
+    for (size_t i=0; i < row.dimension(); i++) {
+      if (i) out << ",";
+      out << row[i];
+    }
+    return out << ")";
+  }
+
+  inline std::ostream& operator<<(std::ostream& out, const dense_point& p) {
+    return out << dense_row(p);
+  }
+
+} // namespace cluster
+
+#endif // DENSE_DATASET_H
@@ -50,13 +50,14 @@ namespace cluster {
   ///
   /// Computes a dissimilarity matrix from a vector of objects.
   ///
-  /// @param[in]  objects         Vector of any type T.
+  /// @param[in]  objects         Vector of any type T, or any container with size() and
+  ///                             operator[], such as dense_dataset.
   /// @param[in]  dissimilarity   A dissimilarity measure that gives the distance between two T's.
   ///                             Needs to be callable on (T, T).
   /// @param[out] mat             Output parameter.  Dissimiliarity matrix is stored here.
   /// 
-  template <class T, class D>
-  void build_dissimilarity_matrix(const std::vector<T>& objects, D dissimilarity, 
+  template <class Objects, class D>
+  void build_dissimilarity_matrix(const Objects& objects, D dissimilarity, 
                                   dissimilarity_matrix& mat) {
     if (mat.size1() != objects.size() || mat.size2() != objects.size()) {
       mat.resize(objects.size(), objects.size());
@@ -73,14 +74,14 @@ namespace cluster {
   ///
   /// Computes a dissimilarity matrix from a subset of a vector of objects.
   ///
-  /// @param objects         Vector of any type T.
+  /// @param objects         Vector of any type T, or any container with size() and operator[].
   /// @param subset          Indirection vector.  Contains indices into objects for 
   ///                        elements to be compared.
   /// @param dissimilarity   A dissimilarity measure that gives the distance between two T's.
   ///                        Needs to be callable(T, T).
   /// @param mat             Output parameter.  Dissimiliarity matrix is stored here.
-  template <class T, class D>
-  void build_dissimilarity_matrix(const std::vector<T>& objects, const std::vector<size_t>& subset,
+  template <class Objects, class D>
+  void build_dissimilarity_matrix(const Objects& objects, const std::vector<size_t>& subset,
                                   D dissimilarity, dissimilarity_matrix& mat) {
     if (mat.size1() != subset.size() || mat.size2() != subset.size()) {
       mat.resize(subset.size(), subset.size());
@@ -95,23 +96,35 @@ namespace cluster {
 
   
   /// Adaptor for passing a matrix by reference to template functions that take
-  /// a callable distance function.  Avoids copying distance matrix.
-  struct matrix_distance {
-    const dissimilarity_matrix& mat;
-    matrix_distance(const dissimilarity_matrix& m) : mat(m) { }
+  /// a callable distance function.  Avoids copying distance matrix.  Matrix can be
+  /// any type with an operator()(i,j) that returns a distance, e.g. a quantized_matrix.
+  template <class Matrix>
+  struct basic_matrix_distance {
+    const Matrix& mat;
+    basic_matrix_distance(const Matrix& m) : mat(m) { }
     double operator()(size_t i, size_t j) { return mat(i,j); }
   };
 
+  /// Adaptor for the common case of a dissimilarity_matrix.
+  typedef basic_matrix_distance<dissimilarity_matrix> matrix_distance;
+
+  /// Type-inferred syntactic sugar for constructing basic_matrix_distance.
+  template <class Matrix>
+  basic_matrix_distance<Matrix> make_matrix_distance(const Matrix& mat) {
+    return basic_matrix_distance<Matrix>(mat);
+  }
+
 
   /// Functor for computing distance lazily from an object array and
   /// a distance metric.  Use this for CLARA, where we don't want to
-  /// precompute the entire distance matrix.
-  template <class T, class D>
+  /// precompute the entire distance matrix.  Objects can be a std::vector or 
+  /// any other container with operator[], such as dense_dataset.
+  template <class Objects, class D>
   struct lazy_distance_functor {
-    const std::vector<T>& objects;
+    const Objects& objects;
     D dissimilarity;
 
-    lazy_distance_functor(const std::vector<T>& objs, D d)
+    lazy_distance_functor(const Objects& objs, D d)
       : objects(objs), dissimilarity(d) { }
 
     double operator()(size_t i, size_t j) {
@@ -120,9 +133,9 @@ namespace cluster {
   };
 
   /// Type-inferred syntactic sugar for constructing lazy_distance_functor.
-  template <class T, class D>
-  lazy_distance_functor<T,D> lazy_distance(const std::vector<T>& objs, D dist) {
-    return lazy_distance_functor<T,D>(objs, dist);
+  template <class Objects, class D>
+  lazy_distance_functor<Objects,D> lazy_distance(const Objects& objs, D dist) {
+    return lazy_distance_functor<Objects,D>(objs, dist);
   }
 
 }; // namespace cluster
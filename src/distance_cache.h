@@ -0,0 +1,194 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file distance_cache.h
+/// @brief Cache of pairwise distances shared by repeated sample matrix builds.
+///
+/// CLARA builds a dissimilarity matrix for a fresh random sample on every repetition, and
+/// XCLARA does this again for every k.  Samples overlap, so with an expensive metric much
+/// of that work recomputes distances that were already known.  A pair_distance_cache
+/// remembers distances by global object id pair, within a fixed memory budget, and
+/// build_dissimilarity_matrix() copies cached distances instead of recomputing them.
+///
+/// <b>Example:</b>
+/// @code
+/// pair_distance_cache cache(64 << 20);     // 64MB budget
+/// kmedoids km;
+/// km.set_distance_cache(&cache);
+/// km.xclara(objects, expensive_metric(), max_k, dimensionality);
+/// cout << "hit rate: " << cache.hit_rate() << endl;
+/// @endcode
+///
+#ifndef DISTANCE_CACHE_H
+#define DISTANCE_CACHE_H
+
+#include <vector>
+#include <utility>
+#include <tr1/unordered_map>
+
+#include <boost/functional/hash.hpp>
+
+#include "dissimilarity.h"
+
+namespace cluster {
+
+  ///
+  /// Sparse, bounded cache of distances between pairs of objects, keyed by object index.
+  /// Distances are assumed symmetric, so (i,j) and (j,i) share an entry.  Once the memory
+  /// budget is used up, new distances are no longer stored; entries already in the cache 
+  /// stay there, since those are the ones earlier samples had in common.
+  ///
+  class pair_distance_cache {
+  public:
+    ///
+    /// Create a cache that uses about max_bytes of memory.
+    ///
+    explicit pair_distance_cache(size_t max_bytes) 
+      : max_entries_(max_bytes / entry_size()), hits_(0), misses_(0) { }
+
+    /// Approximate memory used by one cached distance, including hash table overhead.
+    static size_t entry_size() {
+      return sizeof(std::pair<const key_type, double>) + 2 * sizeof(void*);
+    }
+
+    ///
+    /// Look up the distance between objects i and j.  Returns true and sets distance if
+    /// it's in the cache.  Counts a hit or a miss either way.
+    ///
+    bool lookup(size_t i, size_t j, double& distance) {
+      map_type::const_iterator it = distances_.find(key(i, j));
+      if (it == distances_.end()) {
+        misses_++;
+        return false;
+      }
+      hits_++;
+      distance = it->second;
+      return true;
+    }
+
+    ///
+    /// Remember the distance between objects i and j, if there's room.
+    ///
+    void insert(size_t i, size_t j, double distance) {
+      if (distances_.size() < max_entries_) {
+        distances_.insert(std::make_pair(key(i, j), distance));
+      }
+    }
+
+    ///
+    /// Return the distance between objects[i] and objects[j], computing it with dissimilarity
+    /// only if it isn't cached.
+    ///
+    template <class Objects, class D>
+    double operator()(const Objects& objects, size_t i, size_t j, D& dissimilarity) {
+      double d;
+      if (!lookup(i, j, d)) {
+        d = dissimilarity(objects[i], objects[j]);
+        insert(i, j, d);
+      }
+      return d;
+    }
+
+    /// Number of cached distances.
+    size_t size() const { return distances_.size(); }
+
+    /// Max number of distances this cache will hold.
+    size_t capacity() const { return max_entries_; }
+
+    /// Number of lookups that found a cached distance.
+    size_t hits() const { return hits_; }
+
+    /// Number of lookups that had to compute a distance.
+    size_t misses() const { return misses_; }
+
+    /// Fraction of lookups that found a cached distance, or 0 if there were none.
+    double hit_rate() const {
+      size_t lookups = hits_ + misses_;
+      return lookups ? hits_ / (double)lookups : 0.0;
+    }
+
+    /// Reset hit and miss counts, but keep cached distances.
+    void reset_stats() { hits_ = misses_ = 0; }
+
+    /// Discard all cached distances and statistics.
+    void clear() {
+      distances_.clear();
+      reset_stats();
+    }
+
+  private:
+    typedef std::pair<size_t, size_t> key_type;
+    typedef std::tr1::unordered_map<key_type, double, boost::hash<key_type> > map_type;
+
+    map_type distances_;    ///< Cached distances by key(i,j)
+    size_t max_entries_;    ///< Max size of distances_, from the memory budget.
+    size_t hits_;           ///< Lookups found in the cache
+    size_t misses_;         ///< Lookups not found in the cache
+
+    /// Order-independent key for a pair of object ids.
+    static key_type key(size_t i, size_t j) {
+      return (i < j) ? key_type(j, i) : key_type(i, j);
+    }
+  };
+
+
+  ///
+  /// Computes a dissimilarity matrix from a subset of objects, taking distances from cache 
+  /// where possible and adding new ones to it.  Indices in subset are the cache keys, so the
+  /// same cache should only be used with the same objects.  Diagonal entries are computed 
+  /// directly, so they take no room in the cache and don't count as hits.
+  ///
+  /// @param objects         Vector of any type T, or any container with size() and operator[].
+  /// @param subset          Indices into objects for elements to be compared.
+  /// @param dissimilarity   A dissimilarity measure callable on (T, T).
+  /// @param mat             Output parameter.  Dissimiliarity matrix is stored here.
+  /// @param cache           Cache of distances between objects.
+  ///
+  template <class Objects, class D>
+  void build_dissimilarity_matrix(const Objects& objects, const std::vector<size_t>& subset,
+                                  D dissimilarity, dissimilarity_matrix& mat,
+                                  pair_distance_cache& cache) {
+    if (mat.size1() != subset.size() || mat.size2() != subset.size()) {
+      mat.resize(subset.size(), subset.size());
+    }
+
+    for (size_t i=0; i < subset.size(); i++) {
+      for (size_t j=0; j < i; j++) {
+        mat(i,j) = cache(objects, subset[i], subset[j], dissimilarity);
+      }
+      mat(i,i) = dissimilarity(objects[subset[i]], objects[subset[i]]);
+    }
+  }
+
+} // namespace cluster
+
+#endif // DISTANCE_CACHE_H
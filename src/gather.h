@@ -7,6 +7,8 @@
 #include "mpi_bindings.h"
 #include "mpi_utils.h"
 #include "binomial.h"
+#include "buffer_pool.h"
+#include "unpack.h"
 
 namespace cluster {
   
@@ -18,19 +20,32 @@ namespace cluster {
   /// This allows you to use native MPI operations like bcast on the packed buffer 
   /// once it's gathered.
   ///
+  /// If pool is supplied, the buffer for packed data at each level of the tree comes from
+  /// it, and buffers left over at the end go back to it, so repeated gathers with the same
+  /// pool do no allocation once the pool has grown to fit them.
+  ///
   /// @see gather() for a version of this that will unpack the gathered data for you.
   ///
   template <class T>
-  void gather_packed(const T& src, std::vector<char>& dest, const binomial_embedding binomial, MPI_Comm comm) {
+  void gather_packed(const T& src, std::vector<char>& dest, const binomial_embedding& binomial, MPI_Comm comm,
+                     buffer_pool *pool = NULL) {
     int rank, size;
     CMPI_Comm_rank(comm, &rank);
     CMPI_Comm_size(comm, &size);
 
+    // buffers and scratch come from the pool, so steady-state gathers don't allocate.
+    buffer_pool local_pool;
+    buffer_pool& buffers = pool ? *pool : local_pool;
+    buffer_pool::gather_scratch& scratch = buffers.scratch();
+
     int parent = binomial.parent(rank);
-    std::vector<int> children = binomial.children(rank);
+    std::vector<int>& children = scratch.children;
+    children.clear();
+    binomial.get_children(rank, back_inserter(children));
 
-    std::vector<int> sizes;                  // sizes of buffers to receive.
-    sizes.push_back(src.packed_size(comm));  // size of local packed data
+    std::vector<int>& sizes = scratch.sizes;  // sizes of buffers to receive.
+    sizes.clear();
+    sizes.push_back(src.packed_size(comm));   // size of local packed data
 
     for (size_t i=0; i < children.size(); i++) {
       // Receive sizes from all children
@@ -40,12 +55,13 @@ namespace cluster {
     }
 
     // construct offsets to receive buffers into.
-    std::vector<int> offsets;
+    std::vector<int>& offsets = scratch.offsets;
+    offsets.clear();
     offsets.push_back(0);
     std::partial_sum(sizes.begin(), sizes.end(), back_inserter(offsets));
 
     // create a buffer to receive into, then to send to parent
-    std::vector<char> sendbuf(accumulate(sizes.begin(), sizes.end(), 0));
+    std::vector<char>& sendbuf = *buffers.acquire(accumulate(sizes.begin(), sizes.end(), 0));
     
     // pack local object before its children
     int pos = 0;
@@ -63,9 +79,10 @@ namespace cluster {
       CMPI_Send(&sendbuf[0], sendbuf.size(), MPI_PACKED, parent, 0, comm);
 
     } else {
-      // put packed data in the destination.
+      // put packed data in the destination.  dest's old storage goes back to the pool.
       dest.swap(sendbuf);
     }
+    buffers.release(&sendbuf);
   }
 
 
@@ -73,48 +90,77 @@ namespace cluster {
   /// Unpacks a packed vector in binomial order into objects in rank order in the destination vector.
   ///
   template <class T>
-  void unpack_binomial(const std::vector<char>& src, std::vector<T>& dest, const binomial_embedding binomial, 
+  void unpack_binomial(const std::vector<char>& src, std::vector<T>& dest, const binomial_embedding& binomial, 
                        MPI_Comm comm) {
     int pos = 0;
     dest.resize(binomial.size());
     for (size_t i=0; i < binomial.size(); i++) {
-      dest[binomial.reverse_relative_rank(i)] = T::unpack(const_cast<char*>(&src[0]), src.size(), &pos, comm);
+      unpack_into(dest[binomial.reverse_relative_rank(i)], const_cast<char*>(&src[0]), src.size(), &pos, comm);
     }
   }
   
 
   ///
-  /// Binomial gather of char buffers into a single agglomerated clump of buffers
+  /// Finds which ranks of comm share a node, with MPI_Comm_split_type().  On return, nodes[r]
+  /// is the lowest rank of comm on the same node as rank r, on every rank.  Collective.
+  /// Pass nodes to binomial_embedding to make gathers combine data within nodes first.
   ///
-  template <class T>
-  void gather(const T& src, std::vector<T>& dest, MPI_Comm comm, int root = 0) {
+  inline void get_node_ids(MPI_Comm comm, std::vector<int>& nodes) {
     int rank, size;
     CMPI_Comm_rank(comm, &rank);
     CMPI_Comm_size(comm, &size);
 
+    MPI_Comm node_comm;
+    CMPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    int leader;
+    CMPI_Allreduce(&rank, &leader, 1, MPI_INT, MPI_MIN, node_comm);
+    CMPI_Comm_free(&node_comm);
+
+    nodes.resize(size);
+    CMPI_Allgather(&leader, 1, MPI_INT, &nodes[0], 1, MPI_INT, comm);
+  }
+
+
+  ///
+  /// Gather along the tree of the supplied embedding, which must cover all of comm.  
+  /// dest is filled on the embedding's root.
+  ///
+  template <class T>
+  void gather(const T& src, std::vector<T>& dest, const binomial_embedding& binomial, MPI_Comm comm) {
+    int rank;
+    CMPI_Comm_rank(comm, &rank);
+
     // gather everything to a packed buffer at the root.
-    binomial_embedding binomial(size, root);
     std::vector<char> packed;
     gather_packed(src, packed, binomial, comm);
 
     // now unpack everything.
-    if (rank == root) {
+    if (rank == binomial.root()) {
       unpack_binomial(packed, dest, binomial, comm);
     }
   }
 
 
   ///
-  /// Allgather for variable-length data.
+  /// Binomial gather of char buffers into a single agglomerated clump of buffers
   ///
   template <class T>
-  void allgather(const T& src, std::vector<T>& dest, MPI_Comm comm, int root = 0) {
-    int rank, size;
-    CMPI_Comm_rank(comm, &rank);
+  void gather(const T& src, std::vector<T>& dest, MPI_Comm comm, int root = 0) {
+    int size;
     CMPI_Comm_size(comm, &size);
+    gather(src, dest, binomial_embedding(size, root), comm);
+  }
+
+
+  ///
+  /// Allgather for variable-length data, gathering along the tree of the supplied embedding,
+  /// which must cover all of comm.
+  ///
+  template <class T>
+  void allgather(const T& src, std::vector<T>& dest, const binomial_embedding& binomial, MPI_Comm comm) {
+    const int root = binomial.root();
 
     // gather everything to a packed buffer at the root.
-    binomial_embedding binomial(size, root);
     std::vector<char> packed;
     gather_packed(src, packed, binomial, comm);
 
@@ -127,6 +173,17 @@ namespace cluster {
     unpack_binomial(packed, dest, binomial, comm);
   }
 
+
+  ///
+  /// Allgather for variable-length data.
+  ///
+  template <class T>
+  void allgather(const T& src, std::vector<T>& dest, MPI_Comm comm, int root = 0) {
+    int size;
+    CMPI_Comm_size(comm, &size);
+    allgather(src, dest, binomial_embedding(size, root), comm);
+  }
+
 } // namespace cluster
 
 #endif // MUSTER_GATHER_H
@@ -0,0 +1,220 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file hierarchical.cpp
+///
+#include "hierarchical.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace cluster {
+
+  ostream& operator<<(ostream& out, const merge& m) {
+    out << "(" << m.a << ", " << m.b << ", " << m.distance << ", " << m.size << ")";
+    return out;
+  }
+
+
+  /// Orders merges by distance, for stable_sort.
+  static bool closer(const merge& m1, const merge& m2) {
+    return m1.distance < m2.distance;
+  }
+
+
+  void dendrogram::assign(size_t num_objects, const vector<merge>& merges) {
+    num_objects_ = num_objects;
+    merges_ = merges;
+    // NN-chain finds merges out of order.  Reducible linkages never merge below a child,
+    // and children are always found before their parents, so a stable sort keeps the 
+    // list valid.
+    stable_sort(merges_.begin(), merges_.end(), closer);
+  }
+
+
+  void dendrogram::swap(dendrogram& other) {
+    std::swap(num_objects_, other.num_objects_);
+    merges_.swap(other.merges_);
+  }
+
+
+  /// Union-find root of i, with path halving.
+  static object_id find_root(vector<object_id>& parent, object_id i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  }
+
+
+  void dendrogram::apply(size_t num_merges, partition& p) const {
+    // roots are always the smallest object id in their set.
+    vector<object_id> parent(num_objects_);
+    for (object_id i=0; i < num_objects_; i++) parent[i] = i;
+
+    for (size_t m=0; m < num_merges; m++) {
+      object_id ra = find_root(parent, merges_[m].a);
+      object_id rb = find_root(parent, merges_[m].b);
+      if (ra > rb) std::swap(ra, rb);
+      parent[rb] = ra;
+    }
+
+    p.medoid_ids.clear();
+    p.cluster_ids.resize(num_objects_);
+    for (object_id i=0; i < num_objects_; i++) {
+      object_id root = find_root(parent, i);
+      if (root == i) {
+        p.cluster_ids[i] = p.medoid_ids.size();
+        p.medoid_ids.push_back(i);
+      } else {
+        p.cluster_ids[i] = p.cluster_ids[root];
+      }
+    }
+  }
+
+
+  void dendrogram::cut(size_t k, partition& p) const {
+    if (k < 1 || k > num_objects_) {
+      throw logic_error("Can't cut dendrogram into more clusters than objects.");
+    }
+    apply(num_objects_ - k, p);
+  }
+
+
+  void dendrogram::cut_height(double height, partition& p) const {
+    merge limit(0, 0, height, 0);
+    apply(upper_bound(merges_.begin(), merges_.end(), limit, closer) - merges_.begin(), p);
+  }
+
+
+  ///
+  /// Lance-Williams update: distance from cluster k to the union of clusters i and j.
+  /// For Ward linkage, distances are squared.
+  ///
+  static inline double lance_williams(linkage method, double dik, double djk, double dij,
+                                      size_t ni, size_t nj, size_t nk) {
+    switch (method) {
+    case single_linkage:
+      return min(dik, djk);
+    case complete_linkage:
+      return max(dik, djk);
+    case average_linkage:
+      return (ni * dik + nj * djk) / (ni + nj);
+    case ward_linkage:
+      return ((ni + nk) * dik + (nj + nk) * djk - nk * dij) / (ni + nj + nk);
+    }
+    throw logic_error("Unknown linkage.");
+  }
+
+
+  void hierarchical_cluster(dissimilarity_matrix& distance, linkage method, dendrogram& tree) {
+    const size_t n = distance.size1();
+    if (n != distance.size2()) {
+      throw logic_error("Error: distance matrix is not square!");
+    }
+
+    // Ward's Lance-Williams formula works on squared Euclidean distances.
+    if (method == ward_linkage) {
+      for (size_t i=0; i < n; i++) {
+        for (size_t j=0; j < i; j++) {
+          distance(i,j) *= distance(i,j);
+        }
+      }
+    }
+
+    // Each cluster lives in the row of its smallest object id.
+    vector<size_t> size(n, 1);
+    vector<char> active(n, 1);
+    vector<object_id> chain;
+    vector<merge> merges;
+    chain.reserve(n);
+    merges.reserve(n ? n-1 : 0);
+    object_id first_active = 0;
+
+    for (size_t remaining = n; remaining > 1; remaining--) {
+      if (chain.empty()) {
+        while (!active[first_active]) first_active++;
+        chain.push_back(first_active);
+      }
+
+      // Follow nearest neighbors until two clusters are each other's nearest neighbor.
+      // Ties go to the previous link in the chain, so the chain can't cycle.
+      object_id a, b;
+      while (true) {
+        a = chain.back();
+        object_id prev = (chain.size() > 1) ? chain[chain.size() - 2] : n;
+        object_id start = 0;
+        if (prev < n) {
+          b = prev;
+        } else {
+          // No previous link: start from the first other active cluster, so a neighbor is 
+          // chosen even when every distance is infinite or NaN.
+          b = 0;
+          while (!active[b] || b == a) b++;
+          start = b + 1;
+        }
+        double best = distance(a, b);
+        for (object_id c=start; c < n; c++) {
+          if (!active[c] || c == a) continue;
+          double d = distance(a, c);
+          if (d < best) {
+            best = d;
+            b = c;
+          }
+        }
+        if (b == prev) break;
+        chain.push_back(b);
+      }
+      chain.pop_back();
+      chain.pop_back();
+
+      if (a > b) swap(a, b);
+      const double dab = distance(a, b);
+      for (object_id k=0; k < n; k++) {
+        if (!active[k] || k == a || k == b) continue;
+        distance(a, k) = lance_williams(method, distance(a, k), distance(b, k), dab, 
+                                        size[a], size[b], size[k]);
+      }
+      active[b] = 0;
+      size[a] += size[b];
+      merges.push_back(merge(a, b, (method == ward_linkage) ? sqrt(dab) : dab, size[a]));
+    }
+
+    tree.assign(n, merges);
+  }
+
+} // namespace cluster
@@ -0,0 +1,147 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file hierarchical.h
+/// @brief Agglomerative hierarchical clustering on a dissimilarity_matrix.
+///
+/// hierarchical_cluster() builds a full dendrogram with the nearest-neighbor-chain algorithm.
+/// It takes O(n^2) time, and it updates distances in place in the packed dissimilarity
+/// matrix with the Lance-Williams formulas, so it needs only O(n) extra memory.  The result
+/// is a list of n-1 merges, which can be cut into a partition with k clusters or at a
+/// given height.
+///
+/// <b>Example:</b>
+/// @code
+/// dissimilarity_matrix mat;
+/// build_dissimilarity_matrix(objects, dmetric, mat);
+///
+/// dendrogram tree;
+/// hierarchical_cluster(mat, average_linkage, tree);   // mat is overwritten
+///
+/// partition p;
+/// tree.cut(5, p);
+/// @endcode
+///
+#ifndef HIERARCHICAL_H
+#define HIERARCHICAL_H
+
+#include <vector>
+#include <ostream>
+
+#include "dissimilarity.h"
+#include "partition.h"
+
+namespace cluster {
+
+  ///
+  /// Rule for the distance between two clusters.  All of these are reducible, which the 
+  /// nearest-neighbor-chain algorithm needs.
+  ///
+  enum linkage {
+    single_linkage,     ///< Distance between the closest pair of objects.
+    complete_linkage,   ///< Distance between the farthest pair of objects.
+    average_linkage,    ///< Mean distance over all pairs of objects (UPGMA).
+    ward_linkage        ///< Ward's minimum variance.  Assumes Euclidean input distances.
+  };
+
+  ///
+  /// One step of agglomeration.  Clusters are named by their smallest object id, so a 
+  /// merge joins the cluster containing object a with the cluster containing object b.
+  ///
+  struct merge {
+    object_id a;         ///< Smallest object id in one cluster.  Always less than b.
+    object_id b;         ///< Smallest object id in the other cluster.
+    double distance;     ///< Linkage distance between the two clusters.
+    size_t size;         ///< Number of objects in the merged cluster.
+
+    merge(object_id a_ = 0, object_id b_ = 0, double d = 0, size_t s = 0)
+      : a(a_), b(b_), distance(d), size(s) { }
+  };
+
+  std::ostream& operator<<(std::ostream& out, const merge& m);
+
+
+  ///
+  /// Merge list produced by hierarchical_cluster(), in non-decreasing order of distance.
+  ///
+  class dendrogram {
+  public:
+    dendrogram(size_t num_objects = 0) : num_objects_(num_objects) { }
+
+    /// Number of objects clustered.
+    size_t num_objects() const { return num_objects_; }
+
+    /// The n-1 merges, from first (closest) to last.
+    const std::vector<merge>& merges() const { return merges_; }
+
+    ///
+    /// Partition into k clusters by undoing the last k-1 merges.  Cluster ids are assigned
+    /// in order of each cluster's smallest object id.  There are no real medoids in a 
+    /// hierarchical clustering, so medoid_ids hold each cluster's smallest object id.
+    ///
+    void cut(size_t k, partition& p) const;
+
+    ///
+    /// Partition with all merges at distance <= height applied.
+    ///
+    void cut_height(double height, partition& p) const;
+
+    /// Replace contents with the merges for num_objects objects.  Sorts merges by distance.
+    void assign(size_t num_objects, const std::vector<merge>& merges);
+
+    void swap(dendrogram& other);
+
+  private:
+    size_t num_objects_;
+    std::vector<merge> merges_;
+
+    /// Partition with the first num_merges merges applied.
+    void apply(size_t num_merges, partition& p) const;
+  };
+
+
+  ///
+  /// Agglomerative clustering with the nearest-neighbor-chain algorithm.  Each step follows
+  /// a chain of nearest neighbors until it finds two clusters that are each other's nearest 
+  /// neighbor, then merges them and updates distances to the merged cluster with the 
+  /// Lance-Williams formula for the linkage.
+  ///
+  /// @param[in,out] distance  Distances between objects.  Overwritten with intermediate
+  ///                          cluster distances, so pass a copy if you need it afterwards.
+  /// @param[in]     method    Linkage to use.
+  /// @param[out]    tree      The n-1 merges, sorted by distance.
+  ///
+  void hierarchical_cluster(dissimilarity_matrix& distance, linkage method, dendrogram& tree);
+
+} // namespace cluster
+
+#endif // HIERARCHICAL_H
@@ -39,6 +39,7 @@
 
 #include <mpi.h>
 #include "mpi_bindings.h"
+#include "unpack.h"
 
 #include <cstdlib>
 #include <ostream>
@@ -76,10 +77,15 @@ namespace cluster {
     }
 
     static id_pair unpack(void *buf, int bufsize, int *position, MPI_Comm comm) {
-      T t = T::unpack(buf, bufsize, position, comm);
-      size_t id;
+      id_pair p;
+      p.unpack_from(buf, bufsize, position, comm);
+      return p;
+    }
+
+    /// Unpack into this pair.  The element is unpacked in place if T supports it.
+    void unpack_from(void *buf, int bufsize, int *position, MPI_Comm comm) {
+      unpack_into(element, buf, bufsize, position, comm);
       CMPI_Unpack(buf, bufsize, position, &id, 1, MPI_SIZE_T, comm);
-      return id_pair(t, id);
     }
   };
   
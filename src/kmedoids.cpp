@@ -61,6 +61,13 @@ namespace cluster {
       epsilon(1e-15),
       init_size(40),
       max_reps(5),
+      total_weight(0),
+      distance_cache(NULL),
+      bandit_batch_size(100),
+      bandit_precision(1e-2),
+      num_distance_calls(0),
+      criterion(bic_criterion),
+      shared_workspace(NULL),
       xcallback(NULL)
   { }
 
@@ -68,7 +75,7 @@ namespace cluster {
   kmedoids::~kmedoids() {  }
 
   double kmedoids::average_dissimilarity() const {
-    return total_dissimilarity / cluster_ids.size();
+    return total_dissimilarity / (total_weight ? total_weight : cluster_ids.size());
   }
 
   void kmedoids::set_seed(unsigned long s) {
@@ -82,12 +89,26 @@ namespace cluster {
   void kmedoids::set_epsilon(double e) {
     epsilon = e;
   }
+
+  void kmedoids::set_distance_cache(pair_distance_cache *cache) {
+    distance_cache = cache;
+  }
   
+  void kmedoids::set_workspace(kmedoids_workspace *ws) {
+    shared_workspace = ws;
+  }
+
   void kmedoids::set_xcallback(void (*xpc)(const partition& part, double bic)) {
     xcallback = xpc;
   }
 
-  void kmedoids::init_medoids(size_t k, const dissimilarity_matrix& distance) {
+  /// Weight of object i, where no weights means every object counts once.
+  static inline double weight_of(const double *weights, size_t i) {
+    return weights ? weights[i] : 1.0;
+  }
+
+  template <class Matrix>
+  void kmedoids::init_medoids(size_t k, const Matrix& distance, const double *weights) {
     medoid_ids.clear();
     // find first oject: object minimum dissimilarity to others
     object_id first_medoid = 0;
@@ -95,7 +116,7 @@ namespace cluster {
     for (size_t i=0; i < distance.size1(); i++) {
       double total = 0.0;
       for (size_t j=0; j < distance.size2(); j++) {
-        total += distance(i,j);
+        total += weight_of(weights, j) * distance(i,j);
       }
       if (total < min_dissim) {
         min_dissim   = total;
@@ -105,7 +126,7 @@ namespace cluster {
     
     // add first object to medoids and compute medoid ids.
     medoid_ids.push_back(first_medoid);
-    assign_objects_to_clusters(matrix_distance(distance));
+    assign_objects_to_clusters(make_matrix_distance(distance));
 
     // now select next k-1 objects according to KR's BUILD algorithm
     for (size_t cur_k = 1; cur_k < k; cur_k++) {
@@ -117,7 +138,7 @@ namespace cluster {
         double gain = 0.0;
         for (size_t j=0; j < distance.size1(); j++) {
           double Dj = distance(j, medoid_ids[cluster_ids[j]]);  // distance from j to its medoid
-          gain += max(Dj - distance(i,j), 0.0);                 // gain from selecting i  
+          gain += weight_of(weights, j) * max(Dj - distance(i,j), 0.0);  // gain from selecting i
         }
 
         if (gain >= max_gain) {   // set the next medoid to the object that 
@@ -127,15 +148,17 @@ namespace cluster {
       }
       
       medoid_ids.push_back(best_obj);
-      assign_objects_to_clusters(matrix_distance(distance));
+      assign_objects_to_clusters(make_matrix_distance(distance));
     }
   }
 
 
-  double kmedoids::cost(medoid_id i, object_id h, const dissimilarity_matrix& distance) const {
+  template <class Matrix>
+  double kmedoids::cost(medoid_id i, object_id h, const Matrix& distance, const double *weights) const {
     double total = 0;
+    const object_id mi = medoid_ids[i];                // object id of medoid i
+    const bool has_second = (medoid_ids.size() > 1);   // look at 2nd nearest if there's more than one medoid.
     for (object_id j = 0; j < cluster_ids.size(); j++) {
-      object_id mi  = medoid_ids[i];                // object id of medoid i
       double    dhj = distance(h, j);               // distance between object h and object j
       
       object_id mj1 = medoid_ids[cluster_ids[j]];   // object id of j's nearest medoid
@@ -144,21 +167,39 @@ namespace cluster {
       // check if distance bt/w medoid i and j is same as j's current nearest medoid.
       if (distance(mi, j) == dj1) {
         double dj2 = DBL_MAX;
-        if (medoid_ids.size() > 1) {   // look at 2nd nearest if there's more than one medoid.
+        if (has_second) {
           object_id mj2 = medoid_ids[sec_nearest[j]];  // object id of j's 2nd-nearest medoid
           dj2 = distance(mj2, j);                      // distance to j's 2nd-nearest medoid
         }
-        total += min(dj2, dhj) - dj1;
+        total += weight_of(weights, j) * (min(dj2, dhj) - dj1);
 
       } else if (dhj < dj1) {
-        total += dhj - dj1;
+        total += weight_of(weights, j) * (dhj - dj1);
       }
     }
     return total;
   }
 
 
-  void kmedoids::pam(const dissimilarity_matrix& distance, size_t k, const object_id *initial_medoids) {
+  template <class Matrix>
+  void kmedoids::pam(const Matrix& distance, size_t k, const object_id *initial_medoids) {
+    run_pam(distance, k, initial_medoids, NULL);
+  }
+
+
+  template <class Matrix>
+  void kmedoids::pam(const Matrix& distance, const vector<double>& weights, size_t k, 
+                     const object_id *initial_medoids) {
+    if (weights.size() != distance.size1()) {
+      throw std::logic_error("Number of weights doesn't match size of distance matrix.");
+    }
+    run_pam(distance, k, initial_medoids, weights.empty() ? NULL : &weights[0]);
+  }
+
+
+  template <class Matrix>
+  void kmedoids::run_pam(const Matrix& distance, size_t k, const object_id *initial_medoids,
+                         const double *weights) {
     if (k > distance.size1()) {
       throw std::logic_error("Attempt to run PAM with more clusters than data.");
     }
@@ -175,7 +216,13 @@ namespace cluster {
       medoid_ids.clear();
       copy(initial_medoids, initial_medoids + k, back_inserter(medoid_ids));
     } else {
-      init_medoids(k, distance);
+      init_medoids(k, distance, weights);
+    }
+
+    // Weighted costs are totals over all copies of each object.
+    total_weight = 0;
+    if (weights) {
+      total_weight = accumulate(weights, weights + distance.size1(), 0.0);
     }
 
     // set tolerance equal to epsilon times mean magnitude of distances.
@@ -184,7 +231,7 @@ namespace cluster {
 
     while (true) {
       // initial cluster setup
-      total_dissimilarity = assign_objects_to_clusters(matrix_distance(distance));
+      total_dissimilarity = assign_objects_to_clusters(make_matrix_distance(distance), weights);
 
       //vars to keep track of minimum
       double minTotalCost = DBL_MAX;
@@ -198,7 +245,7 @@ namespace cluster {
           if (is_medoid(h)) continue;
 
           //see if the total cost of swapping i & h was less than min
-          double curCost = cost(i, h, distance);
+          double curCost = cost(i, h, distance, weights);
           if (curCost < minTotalCost) {
             minTotalCost = curCost;
             minMedoid = i;
@@ -219,23 +266,205 @@ namespace cluster {
   }
 
 
-  double kmedoids::xpam(const dissimilarity_matrix& distance, size_t max_k, size_t dimensionality) {
+  template <class Matrix>
+  double kmedoids::xpam(const Matrix& distance, size_t max_k, size_t dimensionality) {
     double best_bic = -DBL_MAX;   // note that DBL_MIN isn't what you think it is.
 
     for (size_t k = 1; k <= max_k; k++) {
-      kmedoids subcall;
-      subcall.pam(distance, k);
-      double cur_bic = bic(subcall, matrix_distance(distance), dimensionality);
+      kmedoids& sub = subcall();
+      sub.pam(distance, k);
+      double cur_bic = k_score(sub, make_matrix_distance(distance), dimensionality);
 
-      if (xcallback) xcallback(subcall, cur_bic);
+      if (xcallback) xcallback(sub, cur_bic);
 
       if (cur_bic > best_bic) {
         best_bic = cur_bic;
-        swap(subcall);
+        swap(sub);
       }
     }
     return best_bic;
   }
 
 
+  double kmedoids::assign_from_medoid_rows(const vector<double>& medoid_rows, 
+                                           vector<double>& d1, vector<double>& d2) {
+    const size_t n = cluster_ids.size();
+    const size_t k = medoid_ids.size();
+    sec_nearest.resize(n);
+
+    double total = 0;
+    for (object_id j=0; j < n; j++) {
+      double    dj1 = DBL_MAX, dj2 = DBL_MAX;
+      medoid_id m1 = k, m2 = k;
+      for (medoid_id m=0; m < k; m++) {
+        double d = medoid_rows[m * n + j];
+        if (d < dj1 || medoid_ids[m] == j) {   // prefer the medoid in case of ties.
+          dj2 = dj1;  m2 = m1;
+          dj1 = d;    m1 = m;
+        } else if (d < dj2) {
+          dj2 = d;    m2 = m;
+        }
+      }
+      cluster_ids[j] = m1;
+      sec_nearest[j] = m2;
+      d1[j] = dj1;
+      d2[j] = dj2;
+      total += dj1;
+    }
+    return total;
+  }
+
+
+  void kmedoids::init_medoids(size_t k, const tiled_dissimilarity_matrix& distance, 
+                              vector<double>& medoid_rows) {
+    const size_t n = distance.size1();
+    medoid_ids.clear();
+    medoid_rows.resize(k * n);
+    vector<double>& d1 = workspace().d1;
+    vector<double>& d2 = workspace().d2;
+    d1.resize(n);
+    d2.resize(n);
+
+    // first medoid: object with minimum total dissimilarity to others.
+    object_id first_medoid = 0;
+    double min_dissim = DBL_MAX;
+    {
+      tile_reader reader(distance);
+      for (size_t t=0; t < reader.num_tiles(); t++) {
+        const double *row = reader.next();
+        for (size_t i=reader.first_row(); i < reader.last_row(); i++, row += n) {
+          double total = 0.0;
+          for (size_t j=0; j < n; j++) {
+            total += row[j];
+          }
+          if (total < min_dissim) {
+            min_dissim   = total;
+            first_medoid = i;
+          }
+        }
+      }
+    }
+    medoid_ids.push_back(first_medoid);
+    distance.read_row(first_medoid, &medoid_rows[0]);
+    assign_from_medoid_rows(medoid_rows, d1, d2);
+
+    // each further medoid takes one pass to find the object with the greatest gain.
+    for (size_t cur_k = 1; cur_k < k; cur_k++) {
+      object_id best_obj = 0;
+      double max_gain = 0.0;
+
+      tile_reader reader(distance);
+      for (size_t t=0; t < reader.num_tiles(); t++) {
+        const double *row = reader.next();
+        for (size_t i=reader.first_row(); i < reader.last_row(); i++, row += n) {
+          if (is_medoid(i)) continue;
+
+          double gain = 0.0;
+          for (size_t j=0; j < n; j++) {
+            gain += max(d1[j] - row[j], 0.0);
+          }
+          if (gain >= max_gain) {
+            max_gain = gain;
+            best_obj = i;
+          }
+        }
+      }
+
+      medoid_ids.push_back(best_obj);
+      distance.read_row(best_obj, &medoid_rows[cur_k * n]);
+      assign_from_medoid_rows(medoid_rows, d1, d2);
+    }
+  }
+
+
+  void kmedoids::pam(const tiled_dissimilarity_matrix& distance, size_t k, 
+                     const object_id *initial_medoids) {
+    const size_t n = distance.size1();
+    if (k > n) {
+      throw std::logic_error("Attempt to run PAM with more clusters than data.");
+    }
+
+    total_weight = 0;
+    cluster_ids.resize(n);
+    vector<double>& medoid_rows = workspace().medoid_rows;   // rows of the current medoids
+    medoid_rows.resize(k * n);
+    if (initial_medoids) {
+      medoid_ids.clear();
+      copy(initial_medoids, initial_medoids + k, back_inserter(medoid_ids));
+      for (medoid_id m=0; m < k; m++) {
+        distance.read_row(medoid_ids[m], &medoid_rows[m * n]);
+      }
+    } else {
+      init_medoids(k, distance, medoid_rows);
+    }
+
+    double tolerance = epsilon * distance.sum() / ((double)n * n);
+
+    vector<double>& d1 = workspace().d1;         // distances to nearest and second-nearest medoids
+    vector<double>& d2 = workspace().d2;
+    vector<double>& delta = workspace().delta;   // per-medoid corrections to the shared swap cost
+    d1.resize(n);
+    d2.resize(n);
+    delta.resize(k);
+
+    while (true) {
+      total_dissimilarity = assign_from_medoid_rows(medoid_rows, d1, d2);
+
+      double minTotalCost = DBL_MAX;
+      medoid_id minMedoid = 0;
+      object_id minObject = 0;
+
+      // The cost of swapping h with medoid i has a part that doesn't depend on i (objects 
+      // that move to h because it's closer than their medoid) plus a correction for objects 
+      // whose own medoid is i.  So one pass over row h gives the costs for all k medoids.
+      tile_reader reader(distance);
+      for (size_t t=0; t < reader.num_tiles(); t++) {
+        const double *row = reader.next();
+        for (object_id h=reader.first_row(); h < reader.last_row(); h++, row += n) {
+          if (is_medoid(h)) continue;
+
+          fill(delta.begin(), delta.end(), 0.0);
+          double shared = 0.0;
+          for (object_id j=0; j < n; j++) {
+            double dhj = row[j];
+            double gain = (dhj < d1[j]) ? dhj - d1[j] : 0.0;   // j moves to h if it's closer
+            shared += gain;
+            delta[cluster_ids[j]] += (min(dhj, d2[j]) - d1[j]) - gain;  // if j loses its medoid
+          }
+
+          for (medoid_id i=0; i < k; i++) {
+            double curCost = shared + delta[i];
+            if (curCost < minTotalCost) {
+              minTotalCost = curCost;
+              minMedoid = i;
+              minObject = h;
+            }
+          }
+        }
+      }
+
+      if (minTotalCost >= -tolerance) break;
+
+      medoid_ids[minMedoid] = minObject;
+      distance.read_row(minObject, &medoid_rows[minMedoid * n]);
+    }
+
+    if (sort_medoids) sort();
+  }
+
+
+  // PAM and XPAM are templates so they can read compressed matrices through the same
+  // accessor as dissimilarity_matrix.  Instantiate them for the matrix types we support.
+  template void   kmedoids::pam(const dissimilarity_matrix&, size_t, const object_id*);
+  template void   kmedoids::pam(const quantized_matrix&,     size_t, const object_id*);
+  template void   kmedoids::pam(const quantized8_matrix&,    size_t, const object_id*);
+
+  template void   kmedoids::pam(const dissimilarity_matrix&, const vector<double>&, size_t, const object_id*);
+  template void   kmedoids::pam(const quantized_matrix&,     const vector<double>&, size_t, const object_id*);
+  template void   kmedoids::pam(const quantized8_matrix&,    const vector<double>&, size_t, const object_id*);
+
+  template double kmedoids::xpam(const dissimilarity_matrix&, size_t, size_t);
+  template double kmedoids::xpam(const quantized_matrix&,     size_t, size_t);
+  template double kmedoids::xpam(const quantized8_matrix&,    size_t, size_t);
+
 } // namespace cluster  
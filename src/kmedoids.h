@@ -38,21 +38,65 @@
 #ifndef K_MEDOIDS_H
 #define K_MEDOIDS_H
 
+#include "muster-config.h"
+#ifdef MUSTER_HAVE_OPENMP
+#include <omp.h>
+#endif // MUSTER_HAVE_OPENMP
+
 #include <vector>
 #include <set>
+#include <numeric>
+#include <functional>
 #include <iostream>
 #include <stdexcept>
 #include <cfloat>
+#include <cmath>
 
 #include <boost/random.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "random.h"
 #include "dissimilarity.h"
 #include "partition.h"
 #include "bic.h"
+#include "silhouette.h"
+#include "dense_dataset.h"
+#include "quantized_matrix.h"
+#include "tiled_matrix.h"
+#include "distance_cache.h"
+#include "nearest_medoids.h"
 
 namespace cluster {
 
+  class kmedoids;
+
+  ///
+  /// Scratch storage for kmedoids, kept between calls so that clustering over and over
+  /// (e.g. once per timestep of a simulation) stops allocating once every buffer has 
+  /// reached its high-water mark.  Each kmedoids object has its own workspace; several
+  /// that run one after another can share one with kmedoids::set_workspace().
+  ///
+  /// Copying a workspace gives an empty one, since the storage is only scratch.
+  ///
+  struct kmedoids_workspace {
+    dissimilarity_matrix distance;          ///< Sample matrix for CLARA
+    std::vector<size_t> sample;             ///< Indices of sampled objects
+    std::vector<size_t> draws;              ///< Weighted draws for weighted CLARA, with repeats
+    std::vector<double> sample_weights;     ///< Draw count of each sampled object
+    partition best;                         ///< Best partition found so far by CLARA
+    std::vector<double> d1, d2;             ///< Distances to nearest and second-nearest medoids
+    std::vector<double> delta;              ///< Per-medoid swap cost corrections in tiled PAM
+    std::vector<double> medoid_rows;        ///< Matrix rows of the medoids in tiled PAM
+    std::vector<object_id> candidates;      ///< Candidate objects in bandit_pam()
+    boost::shared_ptr<kmedoids> subcall;    ///< Clusters samples and values of k, made on first use
+    std::vector< boost::shared_ptr<kmedoids> > workers;  ///< Per-thread splitters for xbisect()
+
+    kmedoids_workspace() { }
+    kmedoids_workspace(const kmedoids_workspace&) { }
+    kmedoids_workspace& operator=(const kmedoids_workspace&) { return *this; }
+  };
+
+
   /// 
   /// Implementations of the classic clustering algorithms PAM and CLARA, from 
   /// <i>Finding Groups in Data</i>, by Kaufman and Rousseeuw.
@@ -84,10 +128,24 @@ namespace cluster {
     /// Defaults to 1e-15; may need to be higher if there exist clusterings with very similar quality.
     void set_epsilon(double epsilon);
 
+    /// Set a cache for distances computed by clara() and xclara().  Sample matrices take
+    /// distances from the cache when they can and add new ones to it, so later repetitions
+    /// and later values of k reuse earlier work.  The cache must only be used with one set
+    /// of objects, and must outlive its use here.  Defaults to NULL (no caching).
+    void set_distance_cache(pair_distance_cache *cache);
+
+    /// Use an external workspace for scratch storage instead of this object's own, e.g. to 
+    /// share one between kmedoids objects used in turn.  The workspace must outlive its use
+    /// here.  NULL goes back to this object's own workspace.
+    void set_workspace(kmedoids_workspace *ws);
+
     /// 
     /// Classic K-Medoids clustering, using the Partitioning-Around-Medoids (PAM)
     /// algorithm as described in Kaufman and Rousseeuw. 
     ///
+    /// @tparam Matrix           dissimilarity_matrix, or one of the compressed quantized_matrix 
+    ///                         and quantized8_matrix types from quantized_matrix.h.
+    ///
     /// @param distance         dissimilarity matrix for all objects to cluster
     /// @param k                number of clusters to produce
     /// @param initial_medoids  Optionally supply k initial object ids to be used as initial medoids.
@@ -95,93 +153,245 @@ namespace cluster {
     /// @see \link build_dissimilarity_matrix()\endlink, a function to automatically
     ///      construct a dissimilarity matrix given a vector of objects and a distance function.
     /// 
-    void pam(const dissimilarity_matrix& distance, size_t k, const object_id *initial_medoids = NULL);
+    template <class Matrix>
+    void pam(const Matrix& distance, size_t k, const object_id *initial_medoids = NULL);
+
+    ///
+    /// Weighted PAM.  Object i stands for weights[i] identical objects, so costs, BUILD gains 
+    /// and average_dissimilarity() count it that many times.  Running this on the unique
+    /// objects and counts from dedup() finds the same medoids as pam() on the full data set,
+    /// with a matrix that is smaller by the square of the duplication factor.
+    ///
+    /// @param distance         dissimilarity matrix for the (unique) objects to cluster
+    /// @param weights          multiplicity of each object; non-negative, need not be integral
+    /// @param k                number of clusters to produce
+    /// @param initial_medoids  Optionally supply k initial object ids to be used as initial medoids.
+    ///
+    template <class Matrix>
+    void pam(const Matrix& distance, const std::vector<double>& weights, size_t k, 
+             const object_id *initial_medoids = NULL);
+
+    ///
+    /// Out-of-core PAM for matrices too large for memory.  The matrix stays on disk and is
+    /// streamed a tile at a time.  All k*(n-k) candidate swaps are evaluated with one pass 
+    /// over each row while its tile is resident, so each swap iteration reads the matrix
+    /// exactly once, and the next tile is prefetched while the current one is processed.
+    /// Only the k medoid rows and a few vectors of length n are kept in memory.
+    ///
+    /// BUILD initialization reads the matrix k times; supply initial_medoids to skip it.
+    ///
+    /// @see \link build_dissimilarity_matrix()\endlink in tiled_matrix.h to create the file.
+    ///
+    void pam(const tiled_dissimilarity_matrix& distance, size_t k, 
+             const object_id *initial_medoids = NULL);
+
+    ///
+    /// Alternating k-medoids (Voronoi iteration, as in Park and Jun).  Repeatedly assigns 
+    /// each object to its closest medoid, then makes the object with the smallest total 
+    /// distance to the rest of its cluster the new medoid, until no medoid changes.
+    ///
+    /// Each iteration costs O(sum of squared cluster sizes) instead of PAM's O(k*n^2), and
+    /// clusters are updated in parallel when OpenMP is available.  Results are usually a bit 
+    /// worse than PAM's, so this is best for quick exploration, or to get initial medoids
+    /// for pam().
+    ///
+    /// @param distance         dissimilarity matrix for all objects to cluster.  Same types as pam().
+    /// @param k                number of clusters to produce
+    /// @param initial_medoids  Optionally supply k initial object ids.  Default is k random objects.
+    ///
+    template <class Matrix>
+    void alternate(const Matrix& distance, size_t k, const object_id *initial_medoids = NULL) {
+      if (distance.size1() != distance.size2()) {
+        throw std::logic_error("Error: distance matrix is not square!");
+      }
+      run_alternate(make_matrix_distance(distance), distance.size1(), k, initial_medoids);
+    }
+
+    ///
+    /// Alternating k-medoids with distances computed as needed, for data sets whose full
+    /// dissimilarity matrix is too big to build.  Computes O(sum of squared cluster sizes)
+    /// distances per iteration.  If OpenMP is available, dmetric is called from several 
+    /// threads at once.
+    ///
+    /// @param objects          Objects to cluster (std::vector<T> or dense_dataset)
+    /// @param dmetric          Distance metric callable on two elements of objects
+    /// @param k                number of clusters to produce
+    /// @param initial_medoids  Optionally supply k initial object ids.  Default is k random objects.
+    ///
+    template <class Objects, class D>
+    void alternate(const Objects& objects, D dmetric, size_t k, 
+                   const object_id *initial_medoids = NULL) {
+      run_alternate(lazy_distance(objects, dmetric), objects.size(), k, initial_medoids);
+    }
 
     ///
     /// Classic K-Medoids clustering, using the Partitioning-Around-Medoids (PAM)
     /// algorithm as described in Kaufman and Rousseeuw. Runs PAM from 1 to max_k and selects
-    /// the best k using the bayesian information criterion.  Sets this partition to the best
-    /// partition found using PAM from 1 to k.
+    /// the best k using the bayesian information criterion, or the medoid silhouette if set
+    /// with set_k_criterion().  Sets this partition to the best partition found using PAM 
+    /// from 1 to k.
     /// 
     /// Based on X-Means, see Pelleg & Moore, 2000.
     /// 
-    /// @param distance         dissimilarity matrix for all objects to cluster
+    /// @param distance         dissimilarity matrix for all objects to cluster.  Same types as pam().
     /// @param max_k            Upper limit on number of clusters to find.
     /// @param dimensionality   Number of dimensions in clustered data, for BIC.
     ///
-    /// @return the best BIC value found (the bic value of the final partitioning).
+    /// @return the best BIC value found (the bic value of the final partitioning), or the 
+    ///         best silhouette.
     ///
     /// @see \link build_dissimilarity_matrix()\endlink, a function to automatically
     ///      construct a dissimilarity matrix given a vector of objects and a distance function.
     ///
-    double xpam(const dissimilarity_matrix& distance, size_t max_k, size_t dimensionality);
+    template <class Matrix>
+    double xpam(const Matrix& distance, size_t max_k, size_t dimensionality);
+
+    ///
+    /// Recomputes the total dissimilarity of the current clustering with exact distances.
+    /// Use this after running pam() on a quantized_matrix, whose distances are approximate,
+    /// to get the true cost of the result.  average_dissimilarity() reflects the exact cost 
+    /// afterwards.
+    ///
+    /// @param distance  Exact distance callable on two object indices, e.g. 
+    ///                  <code>lazy_distance(objects, dmetric)</code>.
+    /// @param reassign  If true, also reassign each object to its closest medoid under the
+    ///                  exact distance.  This can only lower the cost.
+    ///
+    /// @return the exact total dissimilarity.
+    ///
+    template <class DM>
+    double recheck_cost(DM distance, bool reassign = false) {
+      total_weight = 0;    // rechecked cost counts each object once.
+      if (reassign) {
+        total_dissimilarity = assign_objects_to_clusters(distance);
+      } else {
+        total_dissimilarity = 0;
+        for (object_id i=0; i < cluster_ids.size(); i++) {
+          total_dissimilarity += distance(i, medoid_ids[cluster_ids[i]]);
+        }
+      }
+      return total_dissimilarity;
+    }
 
     ///
     /// CLARA clustering algorithm, as per Kaufman and Rousseuw and
     /// R. Ng and J. Han, "Efficient and Effective Clustering Methods 
     /// for Spatial Data Mining."
     /// 
-    /// @tparam T    Type of objects to be clustered.
-    /// @tparam D    Dissimilarity metric type.  D should be callable 
-    ///              on (T, T) and should return a double.
+    /// @tparam Objects  Container of objects to be clustered: a std::vector<T>, or 
+    ///                  a dense_dataset for numeric feature vectors.
+    /// @tparam D        Dissimilarity metric type.  D should be callable 
+    ///                  on two elements of objects and should return a double.
     /// 
     /// @param objects        Objects to cluster
     /// @param dmetric        Distance metric to build dissimilarity matrices with
     /// @param k              Number of clusters to partition
     /// 
-    template <class T, class D>
-    void clara(const std::vector<T>& objects, D dmetric, size_t k) {
-      size_t sample_size = init_size + 2*k;
-    
-      // Just run plain KMedoids once if sampling won't gain us anything
-      if (objects.size() <= sample_size) {
-        dissimilarity_matrix mat;
-        build_dissimilarity_matrix(objects, dmetric, mat);
-        pam(mat, k);
-        return;
-      }
+    template <class Objects, class D>
+    void clara(const Objects& objects, D dmetric, size_t k) {
+      run_clara(objects, NULL, dmetric, k);
+    }
 
-      // get everything the right size before starting.
-      medoid_ids.resize(k);
-      cluster_ids.resize(objects.size());
 
-      // medoids and clusters for best partition so far.
-      partition best_partition;
+    ///
+    /// Weighted CLARA.  Object i stands for weights[i] identical objects.  Samples are drawn 
+    /// with probability proportional to weight, as CLARA would sample the expanded objects, and
+    /// PAM weights each sampled object by the number of times it was drawn.  The quality of each
+    /// sample's medoids is judged by total weighted dissimilarity over all objects.
+    ///
+    /// @param objects        Objects to cluster, e.g. the unique objects from dedup()
+    /// @param weights        Multiplicity of each object
+    /// @param dmetric        Distance metric to build dissimilarity matrices with
+    /// @param k              Number of clusters to partition
+    ///
+    template <class Objects, class D>
+    void clara(const Objects& objects, const std::vector<double>& weights, D dmetric, size_t k) {
+      if (weights.size() != objects.size()) {
+        throw std::logic_error("Number of weights doesn't match number of objects.");
+      }
+      run_clara(objects, &weights, dmetric, k);
+    }    
 
-      //run KMedoids on a sampled subset max_reps times
-      total_dissimilarity = DBL_MAX;
-      for (size_t i = 0; i < max_reps; i++) {
-        // Take a random sample of objects, store sample in a vector
-        std::vector<size_t> sample_to_full;
-        algorithm_r(objects.size(), sample_size, back_inserter(sample_to_full), rng);
 
-        // Build a distance matrix for PAM
-        dissimilarity_matrix distance;
-        build_dissimilarity_matrix(objects, sample_to_full, dmetric, distance);
+    ///
+    /// PAM with sampled BUILD and SWAP steps, after Tiwari et al., "BanditPAM: Almost Linear 
+    /// Time k-Medoids Clustering via Multi-Armed Bandits."  Distances are computed lazily, 
+    /// so no matrix is built.
+    ///
+    /// Each BUILD and SWAP step treats every candidate (a new medoid, or a medoid/object swap)
+    /// as an arm whose loss is its mean change in cost over all objects.  Losses are estimated 
+    /// from batches of randomly chosen reference objects, and candidates whose confidence 
+    /// interval lies entirely above the best upper bound are dropped.  The leading candidate
+    /// is then evaluated exactly, so a swap is only made if it really lowers the cost.  The 
+    /// number of samples each step needs depends on how far apart the candidates' losses are,
+    /// not on n, so a step takes O(n log n) distance calls instead of PAM's O(k*n^2) once n
+    /// is large.  See set_bandit_precision() for the accuracy/cost tradeoff.
+    ///
+    /// @param objects        Objects to cluster (std::vector<T> or dense_dataset)
+    /// @param dmetric        Distance metric callable on two elements of objects
+    /// @param k              Number of clusters to partition
+    ///
+    /// @see distance_calls() for the number of distance computations this took.
+    ///
+    template <class Objects, class D>
+    void bandit_pam(const Objects& objects, D dmetric, size_t k) {
+      const size_t n = objects.size();
+      if (k > n) {
+        throw std::logic_error("Attempt to run bandit_pam with more clusters than data.");
+      }
 
-        // Actually run PAM on the subset
-        kmedoids subcall;
-        subcall.set_sort_medoids(false); // skip sort for subcall since it's not needed
-        subcall.pam(distance, k);  
+      num_distance_calls = 0;
+      counted_distance<Objects, D> distance(objects, dmetric, &num_distance_calls);
 
-        // copy medoids from the subcall to local data, being sure to translate indices
-        for (size_t i=0; i < medoid_ids.size(); i++) {
-          medoid_ids[i] = sample_to_full[subcall.medoid_ids[i]];
+      medoid_ids.clear();
+      cluster_ids.resize(n);
+      sec_nearest.resize(n);
+      kmedoids_workspace& ws = workspace();
+      std::vector<double>& d1 = ws.d1;
+      std::vector<double>& d2 = ws.d2;
+      std::vector<object_id>& candidates = ws.candidates;
+      d1.assign(n, DBL_MAX);
+      d2.assign(n, DBL_MAX);
+      object_id x;
+      size_t arm;
+
+      // BUILD: add the medoid that most lowers the cost, k times.
+      bandit_build_terms<counted_distance<Objects, D> > build(distance, d1);
+      for (size_t l=0; l < k; l++) {
+        // precision is relative to the mean distance to the closest medoid.  There's no 
+        // medoid yet for the first one, so use the mean distance between random pairs.
+        double mean_d1 = 0;
+        if (l == 0) {
+          const size_t pairs = std::min(n, std::max<size_t>(bandit_batch_size, 1));
+          for (size_t p=0; p < pairs; p++) mean_d1 += distance(rng(n), rng(n));
+          mean_d1 /= pairs;
+        } else {
+          mean_d1 = std::accumulate(d1.begin(), d1.end(), 0.0) / n;
         }
 
-        // sync up the cluster_ids matrix with the new medoids by assigning
-        // each object to its closest medoid.  Remember the quality of the clustering.
-        double dissimilarity = assign_objects_to_clusters(lazy_distance(objects, dmetric));
-        
-        // keep the best clustering found so far around
-        if (dissimilarity < total_dissimilarity) {
-          swap(best_partition);
-          total_dissimilarity = dissimilarity;
-        } 
+        non_medoids(n, candidates);
+        build.first = (l == 0);
+        bandit_search(build, n, 1, candidates, bandit_precision * mean_d1, x, arm);
+        medoid_ids.push_back(x);
+        bandit_assign(distance, d1, d2);
       }
-      
-      if (sort_medoids) sort();   // just do one final ordering of ids.
-    }    
+
+      // SWAP: make the best swap of a medoid for a non-medoid until none lowers the cost.
+      bandit_swap_terms<counted_distance<Objects, D> > swaps(distance, d1, d2, cluster_ids, k);
+      while (k < n) {
+        double mean_d1 = std::accumulate(d1.begin(), d1.end(), 0.0) / n;
+        non_medoids(n, candidates);
+        double delta = bandit_search(swaps, n, k, candidates, bandit_precision * mean_d1, x, arm);
+        if (delta >= -epsilon * mean_d1) break;
+
+        medoid_ids[arm] = x;
+        bandit_assign(distance, d1, d2);
+      }
+
+      total_dissimilarity = std::accumulate(d1.begin(), d1.end(), 0.0);
+      total_weight = 0;
+      if (sort_medoids) sort();
+    }
 
 
     ///
@@ -225,38 +435,222 @@ namespace cluster {
 
 
     ///
-    /// K-Agnostic version of CLARA.  This uses the BIC criterion as described in bic.h to
-    /// run clara() a number of times and to select a best run of clara() from the trials.
+    /// Version of center_medoids() for dense_dataset.  Means are accumulated in a single
+    /// contiguous buffer instead of being built up from temporary objects.
+    ///
+    template <class D>
+    void center_medoids(const dense_dataset& objects, D distance) {
+      const size_t k = medoid_ids.size();
+      dense_dataset means(objects.dimension(), k);
+      std::vector<size_t> counts(k);
+      for (size_t i=0; i < cluster_ids.size(); i++) {
+        medoid_id m = cluster_ids[i];
+        const double *row = objects.row_data(i);
+        double *mean = means.row_data(m);
+        for (size_t d=0; d < objects.dimension(); d++) {
+          mean[d] += row[d];
+        }
+        counts[m]++;
+      }
+
+      std::vector<double> shortest(k);
+      for (size_t m=0; m < k; m++) {
+        double *mean = means.row_data(m);
+        for (size_t d=0; d < objects.dimension(); d++) {
+          mean[d] /= counts[m];
+        }
+        shortest[m] = distance(means[m], objects[medoid_ids[m]]);
+      }
+
+      for (size_t i=0; i < cluster_ids.size(); i++) {
+        medoid_id m = cluster_ids[i];
+        double d = distance(objects[i], means[m]);
+        if (d < shortest[m]) {
+          medoid_ids[m] = i;
+          shortest[m]   = d;
+        }
+      }
+    }
+
+
+    ///
+    /// K-Agnostic version of CLARA.  This uses the BIC criterion as described in bic.h (or the
+    /// criterion set with set_k_criterion()) to run clara() a number of times and to select 
+    /// a best run of clara() from the trials.
     /// This will be slower than regular clara().  In particular, it's O(n*max_k).
     /// 
-    /// @param[in]  objects         Objects to cluster
+    /// @param[in]  objects         Objects to cluster (std::vector<T> or dense_dataset)
     /// @param[in]  dmetric         Distance metric to build dissimilarity matrices with
     /// @param[in]  max_k           Max number of clusters to find.
     /// @param[in]  dimensionality  Dimensionality of objects, used by BIC.
     ///
-    template <class T, class D>
-    double xclara(const std::vector<T>& objects, D dmetric, size_t max_k, size_t dimensionality) {
+    template <class Objects, class D>
+    double xclara(const Objects& objects, D dmetric, size_t max_k, size_t dimensionality) {
       double best_bic = -DBL_MAX;   // note that DBL_MIN isn't what you think it is.
 
       for (size_t k = 1; k <= max_k; k++) {
-        kmedoids subcall;
-        subcall.clara(objects, dmetric, k);
+        kmedoids& sub = subcall();
+        sub.set_distance_cache(distance_cache);
+        sub.clara(objects, dmetric, k);
         center_medoids(objects, dmetric);
-        double cur_bic = bic(subcall, lazy_distance(objects, dmetric), dimensionality);
+        double cur_bic = k_score(sub, lazy_distance(objects, dmetric), dimensionality);
 
-        if (xcallback) xcallback(subcall, cur_bic);
+        if (xcallback) xcallback(sub, cur_bic);
         if (cur_bic > best_bic) {
           best_bic = cur_bic;
-          swap(subcall);
+          swap(sub);
         }
       }
       return best_bic;
     }
 
 
+    ///
+    /// K-agnostic clustering by recursive bisection, in the style of X-means.  Starts with all
+    /// objects in one cluster, then repeatedly tries a 2-medoid split of each cluster and keeps 
+    /// the split if it improves the BIC of that cluster's objects.  Clusters that refuse to split
+    /// are not tried again.  This stops when no cluster splits or there are max_k clusters, so
+    /// the cost tracks the final k rather than max_k.  Finally, every object is assigned to its
+    /// nearest medoid.
+    /// 
+    /// Splits run with pam() on clusters of up to init_size + 4 objects, and with CLARA-style
+    /// sampling on larger ones.  Independent splits run in parallel with OpenMP.
+    /// 
+    /// @param[in]  objects         Objects to cluster (std::vector<T> or dense_dataset)
+    /// @param[in]  dmetric         Distance metric to build dissimilarity matrices with
+    /// @param[in]  max_k           Max number of clusters to find.
+    /// @param[in]  dimensionality  Dimensionality of objects, used by BIC.
+    ///
+    /// @return The BIC of the final clustering.
+    ///
+    template <class Objects, class D>
+    double xbisect(const Objects& objects, D dmetric, size_t max_k, size_t dimensionality) {
+      const size_t n = objects.size();
+      max_k = std::min(max_k, n);
+      if (!max_k) {
+        medoid_ids.clear();
+        cluster_ids.clear();
+        total_dissimilarity = 0;
+        return 0;
+      }
+
+      // start with everything in one cluster around its best medoid.
+      std::vector< std::vector<object_id> > members(1);
+      for (object_id i=0; i < n; i++) members[0].push_back(i);
+
+      std::vector<object_id> medoids(1);
+      {
+        kmedoids& sub = subcall();
+        sub.set_seed(random());
+        sub.set_epsilon(epsilon);
+        sub.set_init_size(init_size);
+        sub.set_max_reps(max_reps);
+        sub.set_distance_cache(distance_cache);
+        sub.clara(objects, dmetric, 1);
+        medoids[0] = sub.medoid_ids[0];
+      }
+      std::vector<bool> done(1, false);
+
+      while (medoids.size() < max_k) {
+        std::vector<size_t> active;
+        for (size_t c=0; c < medoids.size(); c++) {
+          if (!done[c] && members[c].size() > 2) active.push_back(c);
+        }
+        if (active.empty()) break;
+
+        // seed each split here so results don't depend on thread scheduling.
+        std::vector<unsigned long> seeds(active.size());
+        for (size_t a=0; a < active.size(); a++) seeds[a] = random();
+
+        // The distance cache isn't thread-safe, so splits that share it run one at a time.
+        int threads = 1;
+#ifdef MUSTER_HAVE_OPENMP
+        if (!distance_cache) threads = omp_get_max_threads();
+#endif // MUSTER_HAVE_OPENMP
+        threads = std::max(1, std::min<int>(threads, active.size()));
+        std::vector< boost::shared_ptr<kmedoids> >& workers = workspace().workers;
+        while (workers.size() < (size_t)threads) {
+          workers.push_back(boost::shared_ptr<kmedoids>(new kmedoids()));
+        }
+        for (int t=0; t < threads; t++) {
+          workers[t]->set_epsilon(epsilon);
+          workers[t]->set_init_size(init_size);
+          workers[t]->set_max_reps(max_reps);
+          workers[t]->set_distance_cache(distance_cache);
+        }
+
+        std::vector<cluster_split> splits(active.size());
+#pragma omp parallel num_threads(threads)
+        {
+          int t = 0;
+#ifdef MUSTER_HAVE_OPENMP
+          t = omp_get_thread_num();
+#endif // MUSTER_HAVE_OPENMP
+          kmedoids& worker = *workers[t];
+
+#pragma omp for schedule(dynamic, 1)
+          for (long a=0; a < (long)active.size(); a++) {
+            worker.set_seed(seeds[a]);
+            worker.bisect_members(objects, dmetric, members[active[a]], medoids[active[a]], 
+                                  dimensionality, splits[a]);
+          }
+        }
+
+        // take the splits that help most first, in case we hit max_k.
+        std::vector< std::pair<double, size_t> > gains;
+        for (size_t a=0; a < active.size(); a++) {
+          gains.push_back(std::make_pair(splits[a].split_bic - splits[a].parent_bic, a));
+        }
+        std::sort(gains.begin(), gains.end(), std::greater< std::pair<double, size_t> >());
+
+        for (size_t i=0; i < gains.size(); i++) {
+          cluster_split& split = splits[gains[i].second];
+          size_t c = active[gains[i].second];
+          if (gains[i].first > 0 && medoids.size() < max_k) {
+            medoids[c] = split.medoids[0];
+            members[c].swap(split.halves[0]);
+            medoids.push_back(split.medoids[1]);
+            members.push_back(std::vector<object_id>());
+            members.back().swap(split.halves[1]);
+            done.push_back(false);
+          } else {
+            done[c] = true;
+          }
+        }
+      }
+
+      medoid_ids.swap(medoids);
+      cluster_ids.resize(n);
+      total_dissimilarity = assign_objects_to_clusters(lazy_distance(objects, dmetric));
+      total_weight = 0;
+      if (sort_medoids) sort();
+
+      double score = bic(*this, lazy_distance(objects, dmetric), dimensionality);
+      if (xcallback) xcallback(*this, score);
+      return score;
+    }
+
+
     void set_init_size(size_t sz) { init_size = sz; }
     void set_max_reps(size_t r) { max_reps = r; }
 
+    /// Number of reference objects bandit_pam() samples per round.  Defaults to 100.
+    void set_bandit_batch_size(size_t b) { bandit_batch_size = b; }
+
+    /// Precision of bandit_pam() relative to the mean distance of objects to their medoids.
+    /// Sampling stops once no candidate can beat the leader by more than this, so swaps that
+    /// would lower the average dissimilarity by less than this fraction may be missed.
+    /// Defaults to 1e-2.
+    void set_bandit_precision(double p) { bandit_precision = p; }
+
+    /// Number of distance computations in the last run of bandit_pam().
+    size_t distance_calls() const { return num_distance_calls; }
+
+
+    /// Set the criterion xpam() and xclara() use to pick k.  Defaults to bic_criterion.
+    /// With silhouette_criterion, the mean medoid_silhouette() is maximized instead, and 
+    /// the scores returned and passed to the xcallback are silhouettes.
+    void set_k_criterion(k_criterion c) { criterion = c; }
 
     /// Set callback function for XPAM and XCLARA.  default is none.
     void set_xcallback(void (*)(const partition& part, double bic));
@@ -275,17 +669,508 @@ namespace cluster {
     double epsilon;                          /// Normalized sensitivity for convergence
     size_t init_size;                        /// initial sample size (before 2*k)
     size_t max_reps;                         /// initial sample size (before 2*k)
+    double total_weight;                     /// Sum of object weights for weighted runs, 0 if unweighted
+    pair_distance_cache *distance_cache;     /// Distances shared by CLARA samples, or NULL
+    size_t bandit_batch_size;                /// Reference objects per round in bandit_pam()
+    double bandit_precision;                 /// Relative precision of bandit_pam() estimates
+    size_t num_distance_calls;               /// Distance computations in last bandit_pam()
+    k_criterion criterion;                   /// How xpam() and xclara() choose k
+    kmedoids_workspace own_workspace;        /// Scratch storage kept between calls
+    kmedoids_workspace *shared_workspace;    /// Workspace supplied with set_workspace(), or NULL
+
+    /// Scratch storage for this call: the shared workspace if there is one, else our own.
+    kmedoids_workspace& workspace() {
+      return shared_workspace ? *shared_workspace : own_workspace;
+    }
+
+    /// The workspace's kmedoids for sub-clusterings, with default settings as if it were new.
+    kmedoids& subcall() {
+      kmedoids_workspace& ws = workspace();
+      if (!ws.subcall) ws.subcall.reset(new kmedoids());
+
+      kmedoids& sub = *ws.subcall;
+      sub.sort_medoids   = true;
+      sub.epsilon        = 1e-15;
+      sub.init_size      = 40;
+      sub.max_reps       = 5;
+      sub.distance_cache = NULL;
+      sub.criterion      = bic_criterion;
+      sub.xcallback      = NULL;
+      return sub;
+    }
 
 
     /// Callback for each iteration of xpam.  is called with the current clustering and its BIC score.
     void (*xcallback)(const partition& part, double bic);
 
+    /// Score a clustering with the k criterion.  Higher is better.
+    template <class DM>
+    double k_score(const partition& p, DM distance, size_t dimensionality) const {
+      if (criterion == silhouette_criterion) {
+        return medoid_silhouette(p, distance);
+      }
+      return bic(p, distance, dimensionality);
+    }
+
+    /// PAM, optionally weighted.  weights is NULL or has one entry per object.
+    template <class Matrix>
+    void run_pam(const Matrix& distance, size_t k, const object_id *initial_medoids, 
+                 const double *weights);
+
+    /// CLARA, optionally weighted.  weights is NULL or has one entry per object.
+    template <class Objects, class D>
+    void run_clara(const Objects& objects, const std::vector<double> *weights, D dmetric, size_t k) {
+      size_t sample_size = init_size + 2*k;
+    
+      // Just run plain KMedoids once if sampling won't gain us anything
+      kmedoids_workspace& ws = workspace();
+      if (objects.size() <= sample_size) {
+        dissimilarity_matrix& mat = ws.distance;
+        build_dissimilarity_matrix(objects, dmetric, mat);
+        if (weights) {
+          pam(mat, *weights, k);
+        } else {
+          pam(mat, k);
+        }
+        return;
+      }
+
+      // get everything the right size before starting.
+      medoid_ids.resize(k);
+      cluster_ids.resize(objects.size());
+
+      const double *object_weights = weights ? &(*weights)[0] : NULL;
+
+      // medoids and clusters for best partition so far.
+      partition& best_partition = ws.best;
+
+      //run KMedoids on a sampled subset max_reps times
+      double best_dissimilarity = DBL_MAX;
+      for (size_t i = 0; i < max_reps; i++) {
+        // Take a random sample of objects, store sample in a vector.  Weighted objects 
+        // are drawn in proportion to how many objects they stand for, as if drawing from the 
+        // expanded objects, and each sampled object counts once per time it was drawn.
+        std::vector<size_t>& sample_to_full = ws.sample;
+        sample_to_full.clear();
+        if (weights) {
+          std::vector<size_t>& draws = ws.draws;
+          draws.clear();
+          weighted_draws(*weights, sample_size, back_inserter(draws), rng);
+
+          std::vector<double>& counts = ws.sample_weights;
+          counts.clear();
+          for (size_t d=0; d < draws.size(); d++) {
+            if (d == 0 || draws[d] != draws[d-1]) {
+              sample_to_full.push_back(draws[d]);
+              counts.push_back(0);
+            }
+            counts.back() += 1;
+          }
+        } else {
+          algorithm_r(objects.size(), sample_size, back_inserter(sample_to_full), rng);
+        }
+
+        // Build a distance matrix for PAM
+        dissimilarity_matrix& distance = ws.distance;
+        if (distance_cache) {
+          build_dissimilarity_matrix(objects, sample_to_full, dmetric, distance, *distance_cache);
+        } else {
+          build_dissimilarity_matrix(objects, sample_to_full, dmetric, distance);
+        }
+
+        // Actually run PAM on the subset.  Weighted samples are weighted only by their draw 
+        // counts: the draws already favor heavy objects, so their full weights would count twice.
+        kmedoids& sub = subcall();
+        sub.set_sort_medoids(false); // skip sort for subcall since it's not needed
+        if (weights) {
+          sub.pam(distance, ws.sample_weights, k);
+        } else {
+          sub.pam(distance, k);  
+        }
+
+        // copy medoids from the subcall to local data, being sure to translate indices
+        for (size_t i=0; i < medoid_ids.size(); i++) {
+          medoid_ids[i] = sample_to_full[sub.medoid_ids[i]];
+        }
+
+        // sync up the cluster_ids matrix with the new medoids by assigning
+        // each object to its closest medoid.  Remember the quality of the clustering.
+        double dissimilarity = assign_objects_to_clusters(lazy_distance(objects, dmetric), object_weights);
+        
+        // keep the best clustering found so far around
+        if (dissimilarity < best_dissimilarity) {
+          best_partition.medoid_ids  = medoid_ids;
+          best_partition.cluster_ids = cluster_ids;
+          best_dissimilarity = dissimilarity;
+        } 
+      }
+
+      swap(best_partition);
+      total_dissimilarity = best_dissimilarity;
+      total_weight = weights ? std::accumulate(weights->begin(), weights->end(), 0.0) : 0;
+      
+      if (sort_medoids) sort();   // just do one final ordering of ids.
+    }
+
+    /// A trial 2-medoid split of one cluster, made by xbisect().
+    struct cluster_split {
+      object_id medoids[2];                 ///< Medoids of the two halves
+      std::vector<object_id> halves[2];     ///< Members nearest each of the two medoids
+      double parent_bic;                    ///< BIC of the cluster's members around its medoid
+      double split_bic;                     ///< BIC of the members split around the two medoids
+    };
+
+    ///
+    /// Split members, the ids of more than 2 objects with current medoid parent, in two.  Uses 
+    /// PAM if members fit in one sample, otherwise the best of max_reps samples by total
+    /// dissimilarity, as in clara().
+    ///
+    template <class Objects, class D>
+    void bisect_members(const Objects& objects, D dmetric, const std::vector<object_id>& members,
+                        object_id parent, size_t dimensionality, cluster_split& split) {
+      lazy_distance_functor<Objects, D> distance(objects, dmetric);
+      const size_t sample_size = init_size + 4;
+      const size_t reps = (members.size() <= sample_size) ? 1 : max_reps;
+
+      kmedoids_workspace& ws = workspace();
+      double best_dissimilarity = DBL_MAX;
+      double sizes[2], dissim2[2];
+      for (size_t r=0; r < reps; r++) {
+        std::vector<object_id>& sample = ws.sample;
+        if (members.size() <= sample_size) {
+          sample.assign(members.begin(), members.end());
+        } else {
+          // pick positions in members, then translate them to object ids.
+          sample.clear();
+          algorithm_r(members.size(), sample_size, back_inserter(sample), rng);
+          for (size_t i=0; i < sample.size(); i++) sample[i] = members[sample[i]];
+        }
+
+        dissimilarity_matrix& mat = ws.distance;
+        if (distance_cache) {
+          build_dissimilarity_matrix(objects, sample, dmetric, mat, *distance_cache);
+        } else {
+          build_dissimilarity_matrix(objects, sample, dmetric, mat);
+        }
+        kmedoids& sub = subcall();
+        sub.set_sort_medoids(false);
+        sub.set_epsilon(epsilon);
+        sub.pam(mat, 2);
+        object_id m[2] = { sample[sub.medoid_ids[0]], sample[sub.medoid_ids[1]] };
+
+        // assign all members to the nearer of the two medoids.
+        std::vector<object_id> halves[2];
+        double cur_sizes[2] = { 0, 0 }, cur_dissim2[2] = { 0, 0 };
+        double dissimilarity = 0;
+        for (size_t i=0; i < members.size(); i++) {
+          double d0 = distance(members[i], m[0]);
+          double d1 = distance(members[i], m[1]);
+          int side = (members[i] != m[0] && (d1 < d0 || members[i] == m[1])) ? 1 : 0;
+          double d = side ? d1 : d0;
+
+          halves[side].push_back(members[i]);
+          cur_sizes[side]   += 1;
+          cur_dissim2[side] += d * d;
+          dissimilarity     += d;
+        }
+
+        if (dissimilarity < best_dissimilarity) {
+          best_dissimilarity = dissimilarity;
+          for (int h=0; h < 2; h++) {
+            split.medoids[h] = m[h];
+            split.halves[h].swap(halves[h]);
+            sizes[h]   = cur_sizes[h];
+            dissim2[h] = cur_dissim2[h];
+          }
+        }
+      }
+
+      double parent_size = members.size(), parent_dissim2 = 0;
+      for (size_t i=0; i < members.size(); i++) {
+        double d = distance(members[i], parent);
+        parent_dissim2 += d * d;
+      }
+      split.parent_bic = bic(1, &parent_size, &parent_dissim2, dimensionality);
+      split.split_bic  = bic(2, sizes, dissim2, dimensionality);
+    }
+
+    /// Voronoi iteration on n objects with distance callable on pairs of object ids.
+    template <class DM>
+    void run_alternate(DM distance, size_t n, size_t k, const object_id *initial_medoids) {
+      if (k > n) {
+        throw std::logic_error("Attempt to run alternate with more clusters than data.");
+      }
+
+      medoid_ids.clear();
+      if (initial_medoids) {
+        copy(initial_medoids, initial_medoids + k, back_inserter(medoid_ids));
+      } else {
+        algorithm_r(n, k, back_inserter(medoid_ids), rng);
+      }
+      cluster_ids.resize(n);
+
+      std::vector< std::vector<object_id> > members(k);
+      bool changed = true;
+      while (changed) {
+        total_dissimilarity = assign_objects_to_clusters(distance);
+
+        for (medoid_id m=0; m < k; m++) members[m].clear();
+        for (object_id i=0; i < n; i++) {
+          members[cluster_ids[i]].push_back(i);
+        }
+
+        // Find the best medoid of each cluster.  Candidates stop summing as soon as they
+        // can't beat the best so far, and the current medoid wins ties, so the total cost
+        // strictly decreases whenever a medoid changes.
+        changed = false;
+#pragma omp parallel for schedule(dynamic, 1) reduction(||:changed)
+        for (long m=0; m < (long)k; m++) {
+          DM dist = distance;   // per-thread copy, in case the functor has state.
+          const std::vector<object_id>& cluster = members[m];
+
+          object_id best = medoid_ids[m];
+          double best_sum = 0;
+          for (size_t j=0; j < cluster.size(); j++) {
+            best_sum += dist(best, cluster[j]);
+          }
+
+          for (size_t c=0; c < cluster.size(); c++) {
+            if (cluster[c] == medoid_ids[m]) continue;
+            double sum = 0;
+            for (size_t j=0; j < cluster.size() && sum < best_sum; j++) {
+              sum += dist(cluster[c], cluster[j]);
+            }
+            if (sum < best_sum) {
+              best_sum = sum;
+              best = cluster[c];
+            }
+          }
+
+          if (best != medoid_ids[m]) {
+            medoid_ids[m] = best;
+            changed = true;
+          }
+        }
+      }
+
+      total_weight = 0;
+      if (sort_medoids) sort();
+    }
+
+    /// Lazy distance between object indices that counts its calls.
+    template <class Objects, class D>
+    struct counted_distance {
+      const Objects& objects;
+      D dmetric;
+      size_t *calls;
+
+      counted_distance(const Objects& objs, D d, size_t *c) : objects(objs), dmetric(d), calls(c) { }
+
+      double operator()(size_t i, size_t j) {
+        (*calls)++;
+        return dmetric(objects[i], objects[j]);
+      }
+    };
+
+    /// Per-reference loss for adding medoid x in bandit BUILD: change in j's distance to its
+    /// nearest medoid, or just d(x,j) for the first medoid.
+    template <class DM>
+    struct bandit_build_terms {
+      DM& distance;
+      const std::vector<double>& d1;
+      bool first;
+
+      bandit_build_terms(DM& dist, const std::vector<double>& nearest)
+        : distance(dist), d1(nearest), first(true) { }
+
+      void operator()(object_id x, object_id j, double *loss) {
+        double dxj = distance(x, j);
+        loss[0] = first ? dxj : std::min(dxj, d1[j]) - d1[j];
+      }
+    };
+
+    /// Per-reference losses for swapping each medoid m for x in bandit SWAP.  One distance
+    /// gives the losses for all k medoids.
+    template <class DM>
+    struct bandit_swap_terms {
+      DM& distance;
+      const std::vector<double>& d1;
+      const std::vector<double>& d2;
+      const std::vector<medoid_id>& nearest;
+      size_t k;
+
+      bandit_swap_terms(DM& dist, const std::vector<double>& first, const std::vector<double>& second,
+                        const std::vector<medoid_id>& near, size_t num_medoids)
+        : distance(dist), d1(first), d2(second), nearest(near), k(num_medoids) { }
+
+      void operator()(object_id x, object_id j, double *loss) {
+        double dxj = distance(x, j);
+        double keep = std::min(d1[j], dxj) - d1[j];          // j's medoid stays
+        for (medoid_id m=0; m < k; m++) loss[m] = keep;
+        loss[nearest[j]] = std::min(d2[j], dxj) - d1[j];     // j's medoid is swapped out
+      }
+    };
+
+    /// Put ids of all objects that aren't medoids in candidates.
+    void non_medoids(size_t n, std::vector<object_id>& candidates) const {
+      std::vector<char> medoid(n, 0);
+      for (size_t m=0; m < medoid_ids.size(); m++) medoid[medoid_ids[m]] = 1;
+      candidates.clear();
+      for (object_id i=0; i < n; i++) {
+        if (!medoid[i]) candidates.push_back(i);
+      }
+    }
+
+    /// Assign objects to nearest medoids for bandit_pam(), keeping nearest and second-nearest
+    /// distances in d1 and d2.
+    template <class DM>
+    void bandit_assign(DM& distance, std::vector<double>& d1, std::vector<double>& d2) {
+      for (object_id i=0; i < cluster_ids.size(); i++) {
+        d1[i] = d2[i] = DBL_MAX;
+        cluster_ids[i] = sec_nearest[i] = 0;
+        for (medoid_id m=0; m < medoid_ids.size(); m++) {
+          double d = (medoid_ids[m] == i) ? 0.0 : distance(i, medoid_ids[m]);
+          if (d < d1[i] || medoid_ids[m] == i) {
+            d2[i] = d1[i];  sec_nearest[i] = cluster_ids[i];
+            d1[i] = d;      cluster_ids[i] = m;
+          } else if (d < d2[i]) {
+            d2[i] = d;      sec_nearest[i] = m;
+          }
+        }
+      }
+    }
+
+    ///
+    /// Successive elimination over width arms for each candidate object.  terms(x, j, loss)
+    /// writes the loss of each of x's arms for reference object j.  Arms are sampled in 
+    /// batches until the arm with the lowest upper bound is within precision of every other
+    /// arm's lower bound, and then only that leading arm is evaluated exactly.  If the arms
+    /// can't be told apart before sampling would cost more than an exact pass, all surviving
+    /// arms are evaluated exactly instead.
+    ///
+    /// @return exact mean loss of the chosen arm, which is arm best_arm of candidate best_x.
+    ///
+    template <class Terms>
+    double bandit_search(Terms& terms, size_t n, size_t width, 
+                         const std::vector<object_id>& candidates, double precision,
+                         object_id& best_x, size_t& best_arm) {
+      const size_t c = candidates.size();
+      std::vector<double> sum(c * width, 0.0), sum2(c * width, 0.0), sigma(c * width, 0.0);
+      std::vector<char> alive(c * width, 1), candidate_alive(c, 1);
+      std::vector<double> loss(width);
+
+      // confidence 1 - delta for each arm, with delta = 1/(1000 n) as in the paper.
+      const double log_inv_delta = log(1000.0 * n);
+      const size_t batch = std::max<size_t>(bandit_batch_size, 1);
+      size_t num_alive = c * width;
+      size_t samples = 0;
+      size_t leader = 0;           // alive arm with the lowest upper bound
+      bool   found = false;        // whether leader is within precision of the best
+
+      while (num_alive > 1 && samples + batch <= n) {
+        for (size_t b=0; b < batch; b++) {
+          object_id j = rng(n);
+          for (size_t ci=0; ci < c; ci++) {
+            if (!candidate_alive[ci]) continue;
+            terms(candidates[ci], j, &loss[0]);
+            for (size_t a=0; a < width; a++) {
+              sum[ci*width + a]  += loss[a];
+              sum2[ci*width + a] += loss[a] * loss[a];
+            }
+          }
+        }
+        samples += batch;
+
+        // standard deviations come from the first batch, as in BanditPAM.
+        if (samples == batch) {
+          for (size_t a=0; a < sigma.size(); a++) {
+            double mean = sum[a] / samples;
+            sigma[a] = sqrt(std::max(sum2[a] / samples - mean * mean, 0.0));
+          }
+        }
+
+        const double scale = sqrt(log_inv_delta / samples);
+        double min_ucb = DBL_MAX;
+        for (size_t a=0; a < alive.size(); a++) {
+          double ucb = sum[a] / samples + sigma[a] * scale;
+          if (alive[a] && ucb < min_ucb) {
+            min_ucb = ucb;
+            leader = a;
+          }
+        }
+
+        double min_other_lcb = DBL_MAX;
+        for (size_t ci=0; ci < c; ci++) {
+          if (!candidate_alive[ci]) continue;
+          bool any = false;
+          for (size_t a = ci*width; a < (ci+1)*width; a++) {
+            if (!alive[a]) continue;
+            double lcb = sum[a] / samples - sigma[a] * scale;
+            if (lcb > min_ucb) {
+              alive[a] = 0;
+              num_alive--;
+            } else if (a != leader) {
+              min_other_lcb = std::min(min_other_lcb, lcb);
+            }
+            any = any || alive[a];
+          }
+          candidate_alive[ci] = any;
+        }
+
+        // stop once no other arm can be more than precision better than the leader.
+        if (min_ucb - min_other_lcb <= precision || num_alive == 1) {
+          found = true;
+          break;
+        }
+      }
+
+      if (found) {
+        std::fill(candidate_alive.begin(), candidate_alive.end(), 0);
+        std::fill(alive.begin(), alive.end(), 0);
+        candidate_alive[leader / width] = 1;
+        alive[leader] = 1;
+      }
+
+      // exact evaluation of the leader, or of all survivors.
+      double best = DBL_MAX;
+      best_x = candidates.empty() ? 0 : candidates[0];
+      best_arm = 0;
+      std::vector<double> exact(width);
+      for (size_t ci=0; ci < c; ci++) {
+        if (!candidate_alive[ci]) continue;
+        std::fill(exact.begin(), exact.end(), 0.0);
+        for (object_id j=0; j < n; j++) {
+          terms(candidates[ci], j, &loss[0]);
+          for (size_t a=0; a < width; a++) exact[a] += loss[a];
+        }
+        for (size_t a=0; a < width; a++) {
+          if (alive[ci*width + a] && exact[a] / n < best) {
+            best = exact[a] / n;
+            best_x = candidates[ci];
+            best_arm = a;
+          }
+        }
+      }
+      return best;
+    }
+
     /// KR BUILD algorithm for assigning initial medoids to a partition.
-    void init_medoids(size_t k, const dissimilarity_matrix& distance);
+    template <class Matrix>
+    void init_medoids(size_t k, const Matrix& distance, const double *weights = NULL);
 
     /// Total cost of swapping object h with medoid i.
-    /// Sums costs of this exchagne for all objects j.
-    double cost(medoid_id i, object_id h, const dissimilarity_matrix& distance) const;
+    /// Sums costs of this exchagne for all objects j, each times its weight if weights isn't NULL.
+    template <class Matrix>
+    double cost(medoid_id i, object_id h, const Matrix& distance, const double *weights = NULL) const;
+
+    /// BUILD for out-of-core PAM.  Leaves the rows of the chosen medoids in medoid_rows.
+    void init_medoids(size_t k, const tiled_dissimilarity_matrix& distance, 
+                      std::vector<double>& medoid_rows);
+
+    /// Assign objects to clusters using resident medoid rows, recording the distances to
+    /// each object's nearest and second-nearest medoids in d1 and d2.
+    double assign_from_medoid_rows(const std::vector<double>& medoid_rows, 
+                                   std::vector<double>& d1, std::vector<double>& d2);
 
 
     /// Assign each object to the cluster with the closest medoid.
@@ -295,37 +1180,58 @@ namespace cluster {
     /// @param distance a callable object that computes distances between indices, as a distance 
     ///                 matrix would.  Algorithms are free to use real distance matrices (as in PAM) 
     ///                 or to compute lazily (as in CLARA medoid assignment).
+    /// @param weights  If not NULL, weight of each object in the total.
     template <class DM>
-    double assign_objects_to_clusters(DM distance) {
+    double assign_objects_to_clusters(DM distance, const double *weights = NULL) {
       if (sec_nearest.size() != cluster_ids.size()) {
         sec_nearest.resize(cluster_ids.size());
       }
       
       // go through and assign each object to nearest medoid, keeping track of total dissimilarity.
-      double total_dissimilarity = 0;
-      for (object_id i=0; i < cluster_ids.size(); i++) {
-        double    d1, d2;  // smallest, second smallest distance to medoid, respectively
-        medoid_id m1, m2;  // index of medoids with distances d1, d2 from object i, respectively
+      assign_kernel<DM> kernel(*this, distance, weights);
+      with_nearest_search(medoid_ids.size(), kernel);
+      return kernel.total;
+    }
 
-        d1 = d2 = DBL_MAX;
-        m1 = m2 = medoid_ids.size();
-        for (medoid_id m=0; m < medoid_ids.size(); m++) {
-          double d = distance(i, medoid_ids[m]);
-          if (d < d1 || medoid_ids[m] == i) {  // prefer the medoid in case of ties.
-            d2 = d1;  m2 = m1;
-            d1 = d;   m1 = m;
-          } else if (d < d2) {
-            d2 = d;   m2 = m;
-          }
-        }
+    /// Medoids of this partition as candidates for object i's nearest medoids.
+    template <class DM>
+    struct medoid_candidates {
+      DM& distance;
+      const object_id *medoids;
+      object_id i;
 
-        cluster_ids[i] = m1;
-        sec_nearest[i] = m2;
-        total_dissimilarity += d1;
+      medoid_candidates(DM& d, const object_id *m, object_id obj) 
+        : distance(d), medoids(m), i(obj) { }
+
+      void operator()(size_t m, nearest_two& nearest) {
+        nearest.consider(m, distance(i, medoids[m]), medoids[m] == i);  // prefer the medoid in case of ties.
       }
+    };
 
-      return total_dissimilarity;
-    }
+    /// Loop of assign_objects_to_clusters(), run with a nearest-medoid search for this k.
+    template <class DM>
+    struct assign_kernel {
+      kmedoids& km;
+      DM& distance;
+      const double *weights;
+      double total;
+
+      assign_kernel(kmedoids& k, DM& d, const double *w) : km(k), distance(d), weights(w), total(0) { }
+
+      template <class Search>
+      void operator()(const Search& search) {
+        const object_id *medoids = km.medoid_ids.empty() ? NULL : &km.medoid_ids[0];
+        for (object_id i=0; i < km.cluster_ids.size(); i++) {
+          nearest_two nearest(search.size());
+          medoid_candidates<DM> candidates(distance, medoids, i);
+          search.find(candidates, nearest);
+
+          km.cluster_ids[i] = nearest.m1;
+          km.sec_nearest[i] = nearest.m2;
+          total += weights ? weights[i] * nearest.d1 : nearest.d1;
+        }
+      }
+    };
   };
 
 
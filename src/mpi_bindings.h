@@ -67,10 +67,42 @@
 #define CMPI_Unpack      PMPI_Unpack
 #define CMPI_Waitsome    PMPI_Waitsome
 #define CMPI_Comm_free   PMPI_Comm_free
+#define CMPI_Finalized   PMPI_Finalized
 #define CMPI_Comm_group  PMPI_Comm_group
 #define CMPI_Comm_create PMPI_Comm_create
 #define CMPI_Group_incl  PMPI_Group_incl
 #define CMPI_Group_free  PMPI_Group_free
+#define CMPI_Type_vector PMPI_Type_vector
+#define CMPI_Type_commit PMPI_Type_commit
+#define CMPI_Type_free   PMPI_Type_free
+#define CMPI_Allgather        PMPI_Allgather
+#define CMPI_Alltoall         PMPI_Alltoall
+#define CMPI_Alltoallv        PMPI_Alltoallv
+#define CMPI_Comm_split       PMPI_Comm_split
+#define CMPI_Gatherv          PMPI_Gatherv
+#define CMPI_Exscan           PMPI_Exscan
+#define CMPI_File_open        PMPI_File_open
+#define CMPI_File_read_at     PMPI_File_read_at
+#define CMPI_File_read_at_all PMPI_File_read_at_all
+#define CMPI_File_get_size    PMPI_File_get_size
+#define CMPI_Type_contiguous  PMPI_Type_contiguous
+#define CMPI_Type_create_resized PMPI_Type_create_resized
+#define CMPI_Info_create      PMPI_Info_create
+#define CMPI_Info_set         PMPI_Info_set
+#define CMPI_Info_get         PMPI_Info_get
+#define CMPI_Info_dup         PMPI_Info_dup
+#define CMPI_Info_free        PMPI_Info_free
+#define CMPI_File_close       PMPI_File_close
+#define CMPI_Testsome         PMPI_Testsome
+#define CMPI_Testall          PMPI_Testall
+#define CMPI_Waitall          PMPI_Waitall
+#define CMPI_Iallgather       PMPI_Iallgather
+#define CMPI_Iallreduce       PMPI_Iallreduce
+#define CMPI_Ireduce          PMPI_Ireduce
+#define CMPI_Ibcast           PMPI_Ibcast
+#define CMPI_Comm_dup         PMPI_Comm_dup
+#define CMPI_Comm_create_group PMPI_Comm_create_group
+#define CMPI_Comm_split_type  PMPI_Comm_split_type
 
 #define cmpi_packed_size pmpi_packed_size
 
@@ -92,10 +124,42 @@
 #define CMPI_Unpack      MPI_Unpack
 #define CMPI_Waitsome    MPI_Waitsome
 #define CMPI_Comm_free   MPI_Comm_free
+#define CMPI_Finalized   MPI_Finalized
 #define CMPI_Comm_group  MPI_Comm_group
 #define CMPI_Comm_create MPI_Comm_create
 #define CMPI_Group_incl  MPI_Group_incl
 #define CMPI_Group_free  MPI_Group_free
+#define CMPI_Type_vector MPI_Type_vector
+#define CMPI_Type_commit MPI_Type_commit
+#define CMPI_Type_free   MPI_Type_free
+#define CMPI_Allgather        MPI_Allgather
+#define CMPI_Alltoall         MPI_Alltoall
+#define CMPI_Alltoallv        MPI_Alltoallv
+#define CMPI_Comm_split       MPI_Comm_split
+#define CMPI_Gatherv          MPI_Gatherv
+#define CMPI_Exscan           MPI_Exscan
+#define CMPI_File_open        MPI_File_open
+#define CMPI_File_read_at     MPI_File_read_at
+#define CMPI_File_read_at_all MPI_File_read_at_all
+#define CMPI_File_get_size    MPI_File_get_size
+#define CMPI_Type_contiguous  MPI_Type_contiguous
+#define CMPI_Type_create_resized MPI_Type_create_resized
+#define CMPI_Info_create      MPI_Info_create
+#define CMPI_Info_set         MPI_Info_set
+#define CMPI_Info_get         MPI_Info_get
+#define CMPI_Info_dup         MPI_Info_dup
+#define CMPI_Info_free        MPI_Info_free
+#define CMPI_File_close       MPI_File_close
+#define CMPI_Testsome         MPI_Testsome
+#define CMPI_Testall          MPI_Testall
+#define CMPI_Waitall          MPI_Waitall
+#define CMPI_Iallgather       MPI_Iallgather
+#define CMPI_Iallreduce       MPI_Iallreduce
+#define CMPI_Ireduce          MPI_Ireduce
+#define CMPI_Ibcast           MPI_Ibcast
+#define CMPI_Comm_dup         MPI_Comm_dup
+#define CMPI_Comm_create_group MPI_Comm_create_group
+#define CMPI_Comm_split_type  MPI_Comm_split_type
 
 #define cmpi_packed_size mpi_packed_size
 
@@ -42,6 +42,8 @@
 #include <vector>
 #include <iostream>
 #include "mpi_bindings.h"
+#include "buffer_pool.h"
+#include "unpack.h"
 #include <algorithm>
 
 namespace cluster {
@@ -55,6 +57,8 @@ namespace cluster {
   ///   - <code>int packed_size(MPI_Comm comm) const</code>
   ///   - <code>void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const</code>
   ///   - <code>static T unpack(void *buf, int bufsize, int *position, MPI_Comm comm)</code>
+  ///   and may also support <code>void unpack_from(void *buf, int bufsize, int *position, MPI_Comm comm)</code>,
+  ///   in which case received objects are unpacked in place.
   ///
   /// @see par_kmedoids::run_pam_trials(), which uses this class.
   /// 
@@ -62,31 +66,43 @@ namespace cluster {
   class multi_gather {
     /// internal struct for buffering sends and recvs.
     struct buffer {
-      int size;             ///< buffer for size of Isend or Irecv
-      char *buf;            ///< buffer for data to be sent/recv'd
-      std::vector<T> *dest; ///< vector to push unpacked data onto
+      int size;                             ///< buffer for size of Isend or Irecv
+      buffer_pool::buffer_type *data;       ///< pooled buffer for data to be sent/recv'd
+      std::vector<T> *dest;                 ///< vector to push unpacked data onto
 
-      /// constructor for receive buffers
-      buffer(std::vector<T>& _dest) 
-        : size(0), buf(NULL), dest(&_dest) { }
+      buffer() : size(0), data(NULL), dest(NULL) { }
 
-      /// constructor for send buffers
-      buffer(int _size) 
-        : size(_size), buf(new char[_size]), dest(NULL) { }
+      /// set up a receive buffer
+      void init_recv(std::vector<T>& _dest) { 
+        size = 0;
+        data = NULL;
+        dest = &_dest;
+      }
 
-      /// Destructor
-      ~buffer() { 
-        if (buf) delete [] buf; 
+      /// set up a send buffer
+      void init_send(int _size, buffer_pool& pool) { 
+        size = _size;
+        data = pool.acquire(_size);
+        dest = NULL;
       }
 
       /// Turn a send buffer into a receive buffer (for local "sends")
       void set_destination(std::vector<T>& _dest) { dest = &_dest; }
 
       /// Whether buffer has been allocated.
-      bool is_allocated() { return buf; }
+      bool is_allocated() { return data; }
+
+      /// Acquires a buffer of <size> chars, to be called after size is received.
+      void allocate(buffer_pool& pool) { data = pool.acquire(size); }
+
+      /// Start of the packed data.
+      char *buf() { return &(*data)[0]; }
 
-      /// Allocates a buffer of <size> chars, to be called after size is received.
-      void allocate() { buf = new char[size]; }
+      /// Give the packed data back to the pool.
+      void release(buffer_pool& pool) {
+        pool.release(data);
+        data = NULL;
+      }
 
       /// This is a buffer for a send if true.  It's a buffer for a recv if false.
       bool is_send()   { return !dest; }
@@ -98,14 +114,52 @@ namespace cluster {
     std::vector<MPI_Request> reqs;   ///< Oustanding requests to be completed.    
     std::vector<buffer*> buffers;    ///< Send and receive buffers for packed data in gathers.
     size_t unfinished_reqs;          ///< Number of still outstanding requests
-    
+
+    buffer_pool own_pool;            ///< Pool for packed data if none was supplied.
+    buffer_pool *pool;               ///< Pool that packed data comes from.
+    std::vector<buffer*> spare;      ///< buffer structs kept for reuse by later gathers.
+    std::vector<int> indices;        ///< Completed request indices, for Waitsome.
+    std::vector<MPI_Status> status;  ///< Completed request statuses, for Waitsome.
+    std::vector<int> positions;      ///< Unpack position in each buffer, for finish().
+    std::vector<size_t> counts;      ///< Number of objects in each received buffer.
+
+    /// True if buffers[i] receives data.
+    bool is_recv(size_t i) const {
+      return buffers[i] && !buffers[i]->is_send();
+    }
+
+    /// Get a buffer struct, reusing one from an earlier gather if possible.
+    buffer *new_buffer() {
+      if (spare.empty()) return new buffer();
+      buffer *b = spare.back();
+      spare.pop_back();
+      return b;
+    }
+
+    // multi_gathers hold pointers to their own members.
+    multi_gather(const multi_gather&);
+    multi_gather& operator=(const multi_gather&);
+
   public:
     /// 
     /// Construct a mult_gather on a communicator.  MPI communication will use 
     /// the specified tag.
+    /// Packed data is buffered in _pool if it is supplied, so that buffers can be reused 
+    /// across multi_gathers.  Otherwise it is buffered in a pool owned by this multi_gather,
+    /// and reused across calls to start() and finish().
     /// 
-    multi_gather(MPI_Comm _comm, int _tag=0) 
-      : comm(_comm), tag(_tag), unfinished_reqs(0) { }
+    multi_gather(MPI_Comm _comm, int _tag=0, buffer_pool *_pool=NULL) 
+      : comm(_comm), tag(_tag), unfinished_reqs(0), pool(_pool ? _pool : &own_pool) { }
+
+    ~multi_gather() {
+      for (size_t i=0; i < buffers.size(); i++) {
+        if (buffers[i]) buffers[i]->release(*pool);
+        delete buffers[i];
+      }
+      for (size_t i=0; i < spare.size(); i++) {
+        delete spare[i];
+      }
+    }
 
     /// 
     /// Starts initial send and receive requests for this gather.  Must be followed up with a call to finish().
@@ -128,7 +182,8 @@ namespace cluster {
         packed_size += o->packed_size(comm);
       }
 
-      buffer *send_buffer = new buffer(packed_size);
+      buffer *send_buffer = new_buffer();
+      send_buffer->init_send(packed_size, *pool);
       if (rank != root) {
         buffers.push_back(NULL);          // no separate buffer for the size.
         reqs.push_back(MPI_REQUEST_NULL);
@@ -139,16 +194,16 @@ namespace cluster {
       // pack up local data into the buffer
       int pos = 0;
       size_t num_objects = distance(begin_obj, end_obj);
-      CMPI_Pack(&num_objects, 1, MPI_SIZE_T, send_buffer->buf, send_buffer->size, &pos, comm);
+      CMPI_Pack(&num_objects, 1, MPI_SIZE_T, send_buffer->buf(), send_buffer->size, &pos, comm);
       for (ObjIterator o=begin_obj; o != end_obj; o++) {
-        o->pack(send_buffer->buf, packed_size, &pos, comm);
+        o->pack(send_buffer->buf(), packed_size, &pos, comm);
       }
 
       if (rank != root) {
         // send packed data along to destination.
         buffers.push_back(send_buffer);     // buffer data during send
         reqs.push_back(MPI_REQUEST_NULL);
-        CMPI_Isend(send_buffer->buf, packed_size, MPI_PACKED, root, tag, comm, &reqs.back());
+        CMPI_Isend(send_buffer->buf(), packed_size, MPI_PACKED, root, tag, comm, &reqs.back());
         unfinished_reqs++;
 
       } else {        // rank is root; do receives instead
@@ -163,12 +218,19 @@ namespace cluster {
 
           } else {
             // make some buffer space for the receive, record its eventual destination
-            buffers.push_back(new buffer(dest));
+            buffers.push_back(new_buffer());
+            buffers.back()->init_recv(dest);
             reqs.push_back(MPI_REQUEST_NULL);
             CMPI_Irecv(&buffers.back()->size, 1, MPI_INT, *src, tag, comm, &reqs.back());
             unfinished_reqs++;
           }
         }
+
+        // if the root isn't one of the sources, its local data isn't needed.
+        if (send_buffer->is_send()) {
+          send_buffer->release(*pool);
+          spare.push_back(send_buffer);
+        }
       }
     }
 
@@ -180,49 +242,100 @@ namespace cluster {
       start(&obj, (&obj) + 1, begin_src, end_src, dest, root);
     }    
 
+    ///
+    /// Completes all gathers started since the last call to finish() or a successful test(),
+    /// and unpacks received objects onto their destination vectors.
+    ///
     void finish() {
-      int rank;
-      CMPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
       while (unfinished_reqs) {
-        int outcount;
-        std::vector<int> indices(reqs.size());
-        std::vector<MPI_Status> status(reqs.size());
+        progress(true);
+      }
+      unpack_all();
+    }
+
+    ///
+    /// Makes whatever progress is possible without blocking.  Returns true, having unpacked
+    /// everything as finish() would, once all started gathers are complete.  Otherwise returns
+    /// false, and test() or finish() must be called again later.
+    ///
+    bool test() {
+      while (unfinished_reqs && progress(false)) { }
+      if (unfinished_reqs) return false;
+
+      unpack_all();
+      return true;
+    }
 
+  private:
+    ///
+    /// Handles requests that have completed, waiting for at least one if block is true.
+    /// Returns the number of requests handled.
+    ///
+    int progress(bool block) {
+      int outcount;
+      indices.resize(reqs.size());
+      status.resize(reqs.size());
+
+      if (block) {
         CMPI_Waitsome(reqs.size(), &reqs[0], &outcount, &indices[0], &status[0]);
-        for (int o=0; o < outcount; o++) {
-          const int r = indices[o];   // index of received object.
+      } else {
+        CMPI_Testsome(reqs.size(), &reqs[0], &outcount, &indices[0], &status[0]);
+      }
+      if (outcount == MPI_UNDEFINED) outcount = 0;
 
-          if (buffers[r] && !buffers[r]->is_send() && !buffers[r]->is_allocated()) {
-            // buffers[r] is a recv and we just received packed size.  Allocate space and recv data.
-            int src = status[o].MPI_SOURCE;
-            buffers[r]->allocate();
-            CMPI_Irecv(buffers[r]->buf, buffers[r]->size, MPI_PACKED, src, tag, comm, &reqs[r]);
+      for (int o=0; o < outcount; o++) {
+        const int r = indices[o];   // index of received object.
 
-          } else {
-            // buffers[r] is a send, or it's a receive and we just received full packed data.
-            // in either case, the buffer is done, so decrement the number of unfinished reqs.
-            unfinished_reqs--;
-          }
+        if (buffers[r] && !buffers[r]->is_send() && !buffers[r]->is_allocated()) {
+          // buffers[r] is a recv and we just received packed size.  Allocate space and recv data.
+          int src = status[o].MPI_SOURCE;
+          buffers[r]->allocate(*pool);
+          CMPI_Irecv(buffers[r]->buf(), buffers[r]->size, MPI_PACKED, src, tag, comm, &reqs[r]);
+
+        } else {
+          // buffers[r] is a send, or it's a receive and we just received full packed data.
+          // in either case, the buffer is done, so decrement the number of unfinished reqs.
+          unfinished_reqs--;
+        }
+      }
+      return outcount;
+    }
+
+    /// Unpacks all received buffers once every request is complete, and resets for the next start().
+    void unpack_all() {
+      // Read the object count at the head of each received buffer, and reserve space in each
+      // destination for everything headed to it, so destinations grow at most once.
+      positions.assign(buffers.size(), 0);
+      counts.assign(buffers.size(), 0);
+      for (size_t i=0; i < buffers.size(); i++) {
+        if (!is_recv(i)) continue;
+        CMPI_Unpack(buffers[i]->buf(), buffers[i]->size, &positions[i], &counts[i], 1, MPI_SIZE_T, comm);
+      }
+      for (size_t i=0; i < buffers.size(); i++) {
+        if (!is_recv(i)) continue;
+        std::vector<T> *dest = buffers[i]->dest;
+
+        size_t incoming = counts[i];
+        for (size_t j=0; j < buffers.size(); j++) {
+          if (j == i || !is_recv(j) || buffers[j]->dest != dest) continue;
+          if (j < i) { incoming = 0; break; }   // reserved already for buffer j
+          incoming += counts[j];
         }
+        if (incoming) dest->reserve(dest->size() + incoming);
       }
 
       // Unpack all the received buffers into their destination vectors.  This preserves order
-      // as unpacked data are only pushed onto the backs of destination vectors *after* everything
-      // is received.  Buffers are still received in any order above, though.
+      // as unpacked data are only appended to destination vectors *after* everything is 
+      // received.  Buffers are still received in any order above, though.  Objects are
+      // unpacked in place where T supports it (see unpack.h).
       for (size_t i=0; i < buffers.size(); i++) {
         if (!buffers[i]) continue;
 
         if (!buffers[i]->is_send()) {
-          int pos = 0;
-          size_t num_objects;
-
-          CMPI_Unpack(buffers[i]->buf, buffers[i]->size, &pos, &num_objects, 1, MPI_SIZE_T, comm);
-          for (size_t o=0; o < num_objects; o++) {
-            buffers[i]->dest->push_back(T::unpack(buffers[i]->buf, buffers[i]->size, &pos, comm));
-          }
+          unpack_back(*buffers[i]->dest, counts[i], buffers[i]->buf(), buffers[i]->size, &positions[i], comm);
         }
-        delete buffers[i];
+        buffers[i]->release(*pool);
+        spare.push_back(buffers[i]);
       }
             
       // clear these out before the next call to start()
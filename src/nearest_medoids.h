@@ -0,0 +1,151 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file nearest_medoids.h
+/// @brief Search for an object's nearest and second-nearest medoids, unrolled for small k.
+///
+/// Assigning objects to medoids is an O(n*k) loop whose inner trip count is k.  With k a 
+/// runtime value, the compiler can't unroll it or keep the running minima in registers 
+/// across medoids.  with_nearest_search() dispatches once on k and hands a kernel a search 
+/// that is fully unrolled at compile time for k <= max_unrolled_k, or a plain loop otherwise.
+///
+#ifndef NEAREST_MEDOIDS_H
+#define NEAREST_MEDOIDS_H
+
+#include <cstddef>
+#include <cfloat>
+
+namespace cluster {
+
+  /// Largest k for which with_nearest_search() uses an unrolled search.
+  const size_t max_unrolled_k = 16;
+
+  ///
+  /// Running nearest and second-nearest candidates for one object.  Candidates are indices;
+  /// m1 and m2 are the number of candidates (none) until something is found.
+  ///
+  struct nearest_two {
+    double d1, d2;    ///< Distances to the nearest and second-nearest candidates.
+    size_t m1, m2;    ///< Indices of the nearest and second-nearest candidates.
+
+    explicit nearest_two(size_t none) : d1(DBL_MAX), d2(DBL_MAX), m1(none), m2(none) { }
+
+    /// Consider candidate m at distance d.  A candidate that is the object itself wins ties.
+    void consider(size_t m, double d, bool self) {
+      if (d < d1 || self) {
+        d2 = d1;  m2 = m1;
+        d1 = d;   m1 = m;
+      } else if (d < d2) {
+        d2 = d;   m2 = m;
+      }
+    }
+  };
+
+
+  ///
+  /// Considers candidates 0 .. K-1, in order, by compile-time recursion.  Candidates is called 
+  /// as candidates(m, nearest) and should call nearest.consider() for candidate m.
+  ///
+  template <size_t K>
+  struct unrolled_nearest {
+    template <class Candidates>
+    static void find(Candidates& candidates, nearest_two& nearest) {
+      unrolled_nearest<K-1>::find(candidates, nearest);
+      candidates(K-1, nearest);
+    }
+  };
+
+  template <>
+  struct unrolled_nearest<0> {
+    template <class Candidates>
+    static void find(Candidates&, nearest_two&) { }
+  };
+
+
+  /// Search of exactly K candidates, unrolled.
+  template <size_t K>
+  struct fixed_nearest_search {
+    size_t size() const { return K; }
+
+    template <class Candidates>
+    void find(Candidates& candidates, nearest_two& nearest) const {
+      unrolled_nearest<K>::find(candidates, nearest);
+    }
+  };
+
+  /// Search of any number of candidates, as a loop.
+  struct looped_nearest_search {
+    size_t k;
+    explicit looped_nearest_search(size_t _k) : k(_k) { }
+
+    size_t size() const { return k; }
+
+    template <class Candidates>
+    void find(Candidates& candidates, nearest_two& nearest) const {
+      for (size_t m=0; m < k; m++) {
+        candidates(m, nearest);
+      }
+    }
+  };
+
+
+  ///
+  /// Calls kernel(search) once, where search is a fixed_nearest_search<k> if 
+  /// 1 <= k <= max_unrolled_k, and a looped_nearest_search otherwise.  Kernel should have a 
+  /// templated operator() that runs its whole loop over objects with the search it's given.
+  ///
+  template <class Kernel>
+  void with_nearest_search(size_t k, Kernel& kernel) {
+    switch (k) {
+    case 1:  kernel(fixed_nearest_search<1>());  break;
+    case 2:  kernel(fixed_nearest_search<2>());  break;
+    case 3:  kernel(fixed_nearest_search<3>());  break;
+    case 4:  kernel(fixed_nearest_search<4>());  break;
+    case 5:  kernel(fixed_nearest_search<5>());  break;
+    case 6:  kernel(fixed_nearest_search<6>());  break;
+    case 7:  kernel(fixed_nearest_search<7>());  break;
+    case 8:  kernel(fixed_nearest_search<8>());  break;
+    case 9:  kernel(fixed_nearest_search<9>());  break;
+    case 10: kernel(fixed_nearest_search<10>()); break;
+    case 11: kernel(fixed_nearest_search<11>()); break;
+    case 12: kernel(fixed_nearest_search<12>()); break;
+    case 13: kernel(fixed_nearest_search<13>()); break;
+    case 14: kernel(fixed_nearest_search<14>()); break;
+    case 15: kernel(fixed_nearest_search<15>()); break;
+    case 16: kernel(fixed_nearest_search<16>()); break;
+    default: kernel(looped_nearest_search(k));   break;
+    }
+  }
+
+} // namespace cluster
+
+#endif // NEAREST_MEDOIDS_H
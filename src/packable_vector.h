@@ -6,6 +6,7 @@
 #include <boost/shared_ptr.hpp>
 #include "mpi_utils.h"
 #include "mpi_bindings.h"
+#include "unpack.h"
 
 namespace cluster {
 
@@ -75,15 +76,29 @@ namespace cluster {
     /// Unpack from an input buffer.  Note that this creates a new vector.
     ///
     static packable_vector unpack(void *buf, int bufsize, int *pos, MPI_Comm comm) {
+      packable_vector vec;
+      vec.unpack_from(buf, bufsize, pos, comm);
+      return vec;
+    }
+
+    ///
+    /// Unpack into the vector this refers to.  Elements are unpacked in their slots, 
+    /// in place if T supports it, so no element is copied.  Copies of a packable_vector
+    /// share its vector (e.g. after std::vector::resize()), so if the vector is shared,
+    /// this unpacks into a new one instead.
+    ///
+    void unpack_from(void *buf, int bufsize, int *pos, MPI_Comm comm) {
       size_t num_packables;
       CMPI_Unpack(buf, bufsize, pos, &num_packables, 1, MPI_SIZE_T, comm);
 
-      packable_vector vec;
-      vec._packables->resize(num_packables);
-      for (size_t i=0; i < vec._packables->size(); i++) {
-        (*vec._packables)[i] = T::unpack(buf, bufsize, pos, comm);
+      if (!_packables.unique()) {
+        _packables.reset(new std::vector<T>());
+      }
+
+      _packables->resize(num_packables);
+      for (size_t i=0; i < num_packables; i++) {
+        unpack_into((*_packables)[i], buf, bufsize, pos, comm);
       }
-      return vec;
     }
   };
   
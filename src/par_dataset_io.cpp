@@ -0,0 +1,228 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_dataset_io.cpp
+///
+#include "par_dataset_io.h"
+
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "mpi_bindings.h"
+
+using namespace std;
+
+namespace cluster {
+
+  /// Largest number of bytes to read in one MPI-IO call.  Many MPI-IO implementations 
+  /// can't handle requests over 2GB, so larger slices are read in several calls.
+  static const size_t max_read_bytes = (size_t)1 << 30;
+
+  void balanced_slice(size_t n, int rank, int size, size_t *first, size_t *last) {
+    size_t base  = n / size;
+    size_t extra = n % size;
+    *first = rank * base + min<size_t>(rank, extra);
+    *last  = *first + base + ((size_t)rank < extra ? 1 : 0);
+  }
+
+
+  /// Throw on all processes if error is set on any of them.
+  static void check_all(bool error, const string& message, MPI_Comm comm) {
+    int local = error, global = 0;
+    CMPI_Allreduce(&local, &global, 1, MPI_INT, MPI_LOR, comm);
+    if (global) {
+      throw runtime_error(message);
+    }
+  }
+
+
+  /// Set key to value in info unless the caller already set it.
+  static void set_default_hint(MPI_Info info, const char *key, const char *value) {
+    char buf[MPI_MAX_INFO_VAL + 1];
+    int flag = 0;
+    CMPI_Info_get(info, const_cast<char*>(key), MPI_MAX_INFO_VAL, buf, &flag);
+    if (!flag) {
+      CMPI_Info_set(info, const_cast<char*>(key), const_cast<char*>(value));
+    }
+  }
+
+
+  ///
+  /// Open a data set collectively and read its header.  Rank 0 reads the header
+  /// and broadcasts it, so the metadata server sees one request instead of one per process.
+  ///
+  static MPI_File open_dataset(const string& filename, MPI_Comm comm, MPI_Info user_info, 
+                               dataset_header *header) {
+    int rank;
+    CMPI_Comm_rank(comm, &rank);
+
+    MPI_Info info;
+    if (user_info == MPI_INFO_NULL) {
+      CMPI_Info_create(&info);
+    } else {
+      CMPI_Info_dup(user_info, &info);
+    }
+    set_default_hint(info, "romio_cb_read", "enable");
+    set_default_hint(info, "romio_ds_read", "disable");   // slices are contiguous; no sieving.
+    set_default_hint(info, "access_style",  "read_once,sequential");
+
+    MPI_File file;
+    int err = CMPI_File_open(comm, const_cast<char*>(filename.c_str()), MPI_MODE_RDONLY, info, &file);
+    CMPI_Info_free(&info);
+    check_all(err != MPI_SUCCESS, "Couldn't open " + filename, comm);
+
+    bool valid = true;
+    if (rank == 0) {
+      MPI_Offset file_size = 0;
+      CMPI_File_get_size(file, &file_size);
+      MPI_Status status;
+      valid = ((size_t)file_size >= sizeof(dataset_header))
+        && CMPI_File_read_at(file, 0, header, sizeof(dataset_header), MPI_BYTE, &status) == MPI_SUCCESS
+        && header->valid() 
+        && header->offset(header->rows) == (uint64_t)file_size;
+    }
+    CMPI_Bcast(header, sizeof(dataset_header), MPI_BYTE, 0, comm);
+    CMPI_Bcast(&valid, sizeof(valid), MPI_BYTE, 0, comm);
+    if (!valid) {
+      CMPI_File_close(&file);
+      throw runtime_error(filename + " is not a valid binary data set.");
+    }
+
+    return file;
+  }
+
+
+  ///
+  /// Read rows [offset, offset+count) into local.  Rows land directly in the padded 
+  /// rows of local via a strided memory datatype, so there is no intermediate buffer.
+  ///
+  static void read_rows(MPI_File file, const dataset_header& header, 
+                        size_t offset, size_t count, dense_dataset& local, 
+                        MPI_Comm comm, dataset_bounds *bounds) {
+    const size_t dim = header.dimension;
+    check_all(offset + count > header.rows, "Requested rows are past the end of the data set.", comm);
+
+    dense_dataset data(dim, count);
+
+    if (dim) {
+      // one unpadded row in the file, stored into one padded row in memory.
+      MPI_Datatype row, padded_row;
+      CMPI_Type_contiguous(dim, MPI_DOUBLE, &row);
+      CMPI_Type_create_resized(row, 0, data.stride() * sizeof(double), &padded_row);
+      CMPI_Type_commit(&padded_row);
+
+      // everyone must make the same number of collective calls.
+      size_t rows_per_read = max<size_t>(1, max_read_bytes / (dim * sizeof(double)));
+      size_t my_reads = (count + rows_per_read - 1) / rows_per_read;
+      size_t num_reads = 0;
+      CMPI_Allreduce(&my_reads, &num_reads, 1, MPI_SIZE_T, MPI_MAX, comm);
+
+      bool error = false;
+      for (size_t r=0; r < num_reads; r++) {
+        size_t first = min(count, r * rows_per_read);
+        size_t last  = min(count, first + rows_per_read);
+        void *buf = (last > first) ? data.row_data(first) : NULL;
+
+        MPI_Status status;
+        int err = CMPI_File_read_at_all(file, header.offset(offset + first), buf, 
+                                        last - first, padded_row, &status);
+        error = error || (err != MPI_SUCCESS);
+      }
+
+      CMPI_Type_free(&row);
+      CMPI_Type_free(&padded_row);
+      check_all(error, "Error reading data set.", comm);
+    }
+
+    if (bounds) {
+      dataset_bounds local_bounds(dim);
+      for (size_t i=0; i < data.size(); i++) {
+        local_bounds.add(data.row_data(i));
+      }
+
+      *bounds = dataset_bounds(dim);
+      if (dim) {
+        CMPI_Allreduce(&local_bounds.min[0], &bounds->min[0], dim, MPI_DOUBLE, MPI_MIN, comm);
+        CMPI_Allreduce(&local_bounds.max[0], &bounds->max[0], dim, MPI_DOUBLE, MPI_MAX, comm);
+      }
+    }
+
+    local.swap(data);
+  }
+
+
+  void read_dataset_slice(const string& filename, size_t offset, size_t count,
+                          dense_dataset& local, MPI_Comm comm, 
+                          dataset_bounds *bounds, MPI_Info info) {
+    dataset_header header;
+    MPI_File file = open_dataset(filename, comm, info, &header);
+    try {
+      read_rows(file, header, offset, count, local, comm, bounds);
+    } catch (...) {
+      CMPI_File_close(&file);
+      throw;
+    }
+    CMPI_File_close(&file);
+  }
+
+
+  void load_binary_dataset(const string& filename, dense_dataset& local, MPI_Comm comm,
+                           size_t local_count, dataset_bounds *bounds, MPI_Info info) {
+    int rank, size;
+    CMPI_Comm_rank(comm, &rank);
+    CMPI_Comm_size(comm, &size);
+
+    dataset_header header;
+    MPI_File file = open_dataset(filename, comm, info, &header);
+
+    size_t first, last;
+    if (local_count == (size_t)-1) {
+      balanced_slice(header.rows, rank, size, &first, &last);
+    } else {
+      first = 0;
+      CMPI_Exscan(&local_count, &first, 1, MPI_SIZE_T, MPI_SUM, comm);
+      if (rank == 0) first = 0;   // Exscan leaves rank 0's result undefined.
+      last = first + local_count;
+    }
+
+    try {
+      read_rows(file, header, first, last - first, local, comm, bounds);
+    } catch (...) {
+      CMPI_File_close(&file);
+      throw;
+    }
+    CMPI_File_close(&file);
+  }
+
+} // namespace cluster
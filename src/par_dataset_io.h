@@ -0,0 +1,97 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_dataset_io.h
+/// @brief Collective MPI-IO loader for binary data set files.
+///
+/// Each process reads only its own contiguous slice of rows, straight from the file into
+/// its local dense_dataset, so no single process ever holds (or forwards) the whole
+/// data set.  The file format is the one described in dataset_io.h.
+///
+#ifndef PAR_DATASET_IO_H
+#define PAR_DATASET_IO_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#include "dataset_io.h"
+
+namespace cluster {
+
+  ///
+  /// Collectively read rows [offset, offset+count) of a binary data set into local.
+  /// Every process in comm must call this, but offsets and counts may differ between 
+  /// processes (and count may be zero).
+  ///
+  /// Reads use MPI_File_read_at_all, so the MPI library can aggregate requests with
+  /// collective buffering.  Collective buffering is enabled by default; hints in info
+  /// (e.g. <code>cb_nodes</code>, <code>cb_buffer_size</code>, <code>striping_unit</code>) 
+  /// are passed on to MPI_File_open and override the defaults.
+  ///
+  /// Throws std::runtime_error on all processes if the file can't be opened, isn't
+  /// a valid data set, or doesn't contain the requested rows.
+  ///
+  /// @param filename  File to read.
+  /// @param offset    Index of the first row to read on this process.
+  /// @param count     Number of rows to read on this process.
+  /// @param local     Destination for this process's rows; its contents are replaced.
+  /// @param comm      Communicator of processes reading the file.
+  /// @param bounds    Optional output for bounds of the rows read on <i>all</i> processes.
+  /// @param info      Optional MPI-IO hints.
+  ///
+  void read_dataset_slice(const std::string& filename, size_t offset, size_t count,
+                          dense_dataset& local, MPI_Comm comm, 
+                          dataset_bounds *bounds = NULL, MPI_Info info = MPI_INFO_NULL);
+
+  ///
+  /// Collectively read a binary data set, divided among processes in comm in rank order.
+  /// If local_count is (size_t)-1 (the default) rows are divided as evenly as possible;
+  /// otherwise each process reads local_count rows, starting after the rows of all 
+  /// lower-ranked processes.  Other parameters are as for read_dataset_slice().
+  ///
+  /// The result is laid out the way par_kmedoids::capek() expects: local objects on 
+  /// each process, with global object ids assigned in rank order.
+  ///
+  void load_binary_dataset(const std::string& filename, dense_dataset& local, MPI_Comm comm,
+                           size_t local_count = (size_t)-1, dataset_bounds *bounds = NULL, 
+                           MPI_Info info = MPI_INFO_NULL);
+
+  ///
+  /// Rows [first, last) of an n-row data set that rank should read when rows are 
+  /// divided as evenly as possible among size processes.
+  ///
+  void balanced_slice(size_t n, int rank, int size, size_t *first, size_t *last);
+
+} // namespace cluster
+
+#endif // PAR_DATASET_IO_H
@@ -35,6 +35,7 @@
 ///
 #include "par_kmedoids.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <stdint.h>
 #include <sys/time.h>
@@ -48,10 +49,15 @@ namespace cluster {
     : par_partition(comm),
       seed_set(false),
       total_dissimilarity(numeric_limits<double>::infinity()),
+      reference_dissimilarity(-1),
       best_bic_score(0),
+      criterion(bic_criterion),
+      search(exhaustive_k_search),
+      patience(0),
       init_size(40),
       max_reps(5),
-      epsilon(1e-15)
+      epsilon(1e-15),
+      shared_workspace(NULL)
   { }
 
   void par_kmedoids::set_seed(uint32_t s) {
@@ -75,14 +81,52 @@ namespace cluster {
   }
 
   void par_kmedoids::seed_random_uniform(MPI_Comm comm) {
-    int rank;
-    CMPI_Comm_rank(comm, &rank);
+    uint32_t seed;
+    MPI_Request req;
+    start_uniform_seed(seed, comm, &req);
+    CMPI_Waitall(1, &req, MPI_STATUSES_IGNORE);
+    set_seed(seed);
+  }
 
+  void par_kmedoids::start_uniform_seed(uint32_t& seed, MPI_Comm comm, MPI_Request *req) {
     // same seed on all processes.
-    uint32_t seed = get_time_seed();
-    CMPI_Bcast(&seed, 1, MPI_INT, 0, comm);
-    random.seed(seed);
-    seed_set = true;
+    seed = get_time_seed();
+    CMPI_Ibcast(&seed, 1, MPI_INT, 0, comm, req);
+  }
+
+  void par_kmedoids::object_offsets(size_t local_count, vector<size_t>& offsets, MPI_Comm comm) {
+    MPI_Request req;
+    start_object_offsets(local_count, offsets, comm, &req);
+    CMPI_Waitall(1, &req, MPI_STATUSES_IGNORE);
+    finish_object_offsets(offsets);
+  }
+
+  void par_kmedoids::start_object_offsets(const size_t& local_count, vector<size_t>& offsets, 
+                                          MPI_Comm comm, MPI_Request *req) {
+    int size;
+    CMPI_Comm_size(comm, &size);
+
+    offsets.resize(size + 1);
+    offsets[0] = 0;
+    CMPI_Iallgather(&local_count, 1, MPI_SIZE_T, &offsets[1], 1, MPI_SIZE_T, comm, req);
+  }
+
+  void par_kmedoids::finish_object_offsets(vector<size_t>& offsets) {
+    for (size_t p=1; p + 1 < offsets.size(); p++) {
+      offsets[p+1] += offsets[p];
+    }
+  }
+
+
+  void par_kmedoids::local_indices(const vector<size_t>& sample_ids, const vector<size_t>& offsets,
+                                   int rank, vector<size_t>& indices) {
+    vector<size_t>::const_iterator first = lower_bound(sample_ids.begin(), sample_ids.end(), offsets[rank]);
+    vector<size_t>::const_iterator last  = lower_bound(first, sample_ids.end(), offsets[rank + 1]);
+
+    indices.clear();
+    for (vector<size_t>::const_iterator id = first; id != last; id++) {
+      indices.push_back(*id - offsets[rank]);
+    }
   }
 
 } // namespace cluster
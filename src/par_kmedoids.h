@@ -40,7 +40,10 @@
 #include <mpi.h>
 #include <ostream>
 #include <vector>
+#include <map>
+#include <set>
 #include <functional>
+#include <stdexcept>
 
 #include <boost/iterator/permutation_iterator.hpp>
 
@@ -52,10 +55,14 @@
 #include "par_partition.h"
 #include "stl_utils.h"
 #include "bic.h"
+#include "silhouette.h"
 #include "mpi_bindings.h"
 #include "gather.h"
 #include "packable_vector.h"
 #include "binomial.h"
+#include "buffer_pool.h"
+#include "capek_workspace.h"
+#include "nearest_medoids.h"
 
 namespace cluster {
 
@@ -112,6 +119,17 @@ namespace cluster {
   /// 
   /// @endcode
   ///
+  ///
+  /// Ways for xcapek() to choose which values of k to run trials for.
+  ///
+  enum k_search_strategy {
+    exhaustive_k_search,       ///< Every k from 1 to max_k, optionally stopping early.
+    coarse_to_fine_k_search,   ///< An evenly spaced grid of k, then halving steps around the best.
+    golden_section_k_search    ///< Golden-section search, assuming the score is unimodal in k.
+  };
+
+  template <class Objects, class D> class capek_request;
+
   class par_kmedoids : public par_partition {
   public:
     ///
@@ -132,9 +150,13 @@ namespace cluster {
     /// Get the average dissimilarity of objects w/their medoids for the last run.
     double average_dissimilarity();
 
-    /// BIC score for selected clustering
+    /// BIC score for selected clustering, or its mean medoid silhouette if xcapek() used
+    /// silhouette_criterion.
     double bic_score();
 
+    /// Set the criterion xcapek() uses to pick k.  Defaults to bic_criterion.
+    void set_k_criterion(k_criterion c) { criterion = c; }
+
     ///
     /// Sets max_reps, Max number of times to run PAM with each sampled dataset.
     /// Default is 5, per Kaufman and Rousseeuw.
@@ -162,112 +184,78 @@ namespace cluster {
     /// Defaults to 1e-15; may need to be higher if there exist clusterings with very similar quality.
     void set_epsilon(double epsilon);
 
+    ///
+    /// Use an external workspace for buffers, worker state and communicators instead of this
+    /// object's own, e.g. to share one between par_kmedoids objects used in turn.  Calls after
+    /// the first few on the same workspace allocate little or nothing.  The workspace must 
+    /// outlive its use here.  NULL goes back to this object's own workspace.
+    ///
+    void set_workspace(capek_workspace *ws) { shared_workspace = ws; }
+
 
     ///
     /// Farms out trials of PAM to worker processes then collects medoids from all trials to all processors.
     /// Puts resulting medoids in all_medoids when done.
     ///
-    template <class T, class D>
-    void run_pam_trials(trial_generator& trials, const std::vector<T>& objects, D dmetric, 
-                        std::vector<typename id_pair<T>::vector>& all_medoids, MPI_Comm comm)
+    template <class Objects, class D>
+    void run_pam_trials(trial_generator& trials, const Objects& objects, D dmetric, 
+                        std::vector<typename id_pair<typename Objects::value_type>::vector>& all_medoids,
+                        MPI_Comm comm)
     {
-      int size, rank;
+      std::vector<size_t>& offsets = workspace().offsets;
+      object_offsets(objects.size(), offsets, comm);
+      run_pam_trials(trials, objects, dmetric, all_medoids, offsets, comm);
+    }
+
+    ///
+    /// Version of run_pam_trials() for callers that already have the object offsets
+    /// computed by object_offsets().  If seeds is supplied, trials with k equal to its size 
+    /// add the seeds to their samples and start PAM from them.
+    ///
+    template <class Objects, class D>
+    void run_pam_trials(trial_generator& trials, const Objects& objects, D dmetric, 
+                        std::vector<typename id_pair<typename Objects::value_type>::vector>& all_medoids,
+                        const std::vector<size_t>& offsets, MPI_Comm comm,
+                        const typename id_pair<typename Objects::value_type>::vector *seeds = NULL)
+    {
+      typedef typename Objects::value_type T;   // type for samples copied out of objects
+
+      int size;
       CMPI_Comm_size(comm, &size);
-      CMPI_Comm_rank(comm, &rank);
-      
-      MPI_Group comm_group;
-      CMPI_Comm_group(comm, &comm_group);
+
+      // Everything below comes from the workspace, so repeated calls reuse its storage.
+      capek_workspace& ws = workspace();
       
       for (size_t i=0; trials.has_next(); i++) {
-        int my_k = -1;                        // trial id for local run of kmedoids
-        int my_trial = -1;                    // trial id for local run of kmedoids
-        std::vector<size_t>  my_ids;          // object ids for each of my_objects
-        std::vector<T>       my_objects;      // vector to hold local sample of objects for clustering.
-        multi_gather<T>      gather(comm);    // simultaneous, asynchronous local gathers for collecting samples.
-        
         // start gathers for each trial to aggregate samples to single worker processes.
-        for (int root=0; trials.has_next() && root < size; root++) {
-          trial cur_trial = trials.next();    // generate a trial descriptor
-          
-          // Generate a set of indices for members of this k-medoids trial
-          std::vector<size_t> sample_ids;
-          boost::random_number_generator<random_t> rng(random);  // Boost adaptor for STL RNG's
-          algorithm_r(trials.num_objects, cur_trial.sample_size, std::back_inserter(sample_ids), rng);
-
-          // figure out where the sample objects live, ASSUME objects.size() objs per process.
-          std::vector<int> sources;
-          std::transform(sample_ids.begin(), sample_ids.end(), std::back_inserter(sources),
-                         std::bind2nd(std::divides<size_t>(), objects.size()));
-          sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
-
-          // make a permutation vector for the indices of the sampled *local* objects
-          std::vector<size_t> sample_indices;
-          transform(std::lower_bound(sample_ids.begin(), sample_ids.end(), objects.size() * rank),
-                    std::lower_bound(sample_ids.begin(), sample_ids.end(), objects.size() * (rank + 1)),
-                    std::back_inserter(sample_indices),
-                    std::bind2nd(std::minus<int>(), objects.size() * rank));
-
-          // gather trial members to the current worker (root)
-          gather.start(boost::make_permutation_iterator(objects.begin(), sample_indices.begin()), 
-                       boost::make_permutation_iterator(objects.begin(), sample_indices.end()),
-                       sources.begin(), sources.end(), my_objects, root);
-          
-          // record which trial to use locally and save the medoids there.
-          if (rank == root) {
-            my_k     = cur_trial.k;
-            my_trial = trials.count() - 1;
-            my_ids.swap(sample_ids);
-          }
-        }
+        int my_k;
+        int my_trial = start_trial_round(trials, objects, offsets, comm, my_k);
         timer.record("StartGather");
         
         // finish all sample gathers.
-        gather.finish();
+        ws.storage<T>(comm).gather.finish();
         timer.record("FinishGather");
 
-        // we're a worker process if we were assigned a trial number.
-        int is_worker_process = (my_trial >= 0);
-
         // then run PAM on the samples that we aggregated to workers.
-        if (is_worker_process) {
-          kmedoids cluster;
-          cluster.set_epsilon(epsilon);
-
-          dissimilarity_matrix mat;
-          build_dissimilarity_matrix(my_objects, dmetric, mat);
-          cluster.pam(mat, my_k);
+        if (my_trial >= 0) {
+          run_local_trial<T>(dmetric, my_k, all_medoids[my_trial], comm, seeds);
           timer.record("LocalCluster");
-
-          // put this trial's medoids into their spot in the global medoids array.
-          // and pack them up so that we can bcast them to other processes.
-          for (size_t m=0; m < cluster.medoid_ids.size(); m++) {
-            all_medoids[my_trial].push_back(
-              make_id_pair(my_objects[cluster.medoid_ids[m]], my_ids[cluster.medoid_ids[m]]));
-          }
-        }
-
-        // create a new communicator for the trials
-        // note that the way we construct this, members of trials have the same rank in trials_comm
-        // and in comm.  So it's safe to gather to zero on trials_comm then bcast from 0 on comm.
-        std::vector<int> trial_ranks;
-        for (int trial_id = i * size; trial_id < trials.count(); trial_id++) {
-          trial_ranks.push_back(trial_id % size);
         }
 
-        MPI_Group trials_group;
-        CMPI_Group_incl(comm_group, trial_ranks.size(), &trial_ranks[0], &trials_group);
-        
-        MPI_Comm trials_comm;
-        CMPI_Comm_create(comm, trials_group, &trials_comm);
+        // get a communicator for the trials: trial i*size + r ran on rank r, so the workers
+        // are ranks [0, num_workers).  Members of trials have the same rank in trials_comm
+        // and in comm, so it's safe to gather to zero on trials_comm then bcast from 0 on comm.
+        // The communicator is cached in the workspace, as rounds mostly have the same size.
+        int num_workers = trials.count() - i * size;
+        MPI_Comm trials_comm = ws.group_comm(comm, num_workers);
         timer.record("CreateMedoidComm");
         
-        // Gather the trials to a single process
-        std::vector<char> packed_medoids;
-        binomial_embedding binomial(trial_ranks.size(), 0);
-        if (is_worker_process) {
+        // Gather the trials to a single process, combining medoids within each node first.
+        std::vector<char>& packed_medoids = *ws.buffers.acquire(0);
+        const binomial_embedding& binomial = ws.node_embedding(comm, num_workers);
+        if (my_trial >= 0) {
           gather_packed(make_packable_vector(&all_medoids[my_trial], false), packed_medoids,
-                        binomial, trials_comm);
-          CMPI_Comm_free(&trials_comm);
+                        binomial, trials_comm, &ws.buffers);
         }
         timer.record("GatherTrials");
 
@@ -276,38 +264,34 @@ namespace cluster {
         size_t packed_medoids_size = packed_medoids.size();
         CMPI_Bcast(&packed_medoids_size, 1, MPI_SIZE_T, 0, comm);
 
-        if (rank != 0) packed_medoids.resize(packed_medoids_size);
+        packed_medoids.resize(packed_medoids_size);
         CMPI_Bcast(&packed_medoids[0], packed_medoids_size, MPI_PACKED, 0, comm);
         timer.record("BroadcastTrials");
         
         // unpack the medoids and swap them into their place in the all_medoids array.
-        std::vector< packable_vector< id_pair<T> > > unpacked_medoids;
-        unpack_binomial(packed_medoids, unpacked_medoids, binomial, comm);
-        for (int trial_id = i * size; trial_id < trials.count(); trial_id++) {
-          unpacked_medoids[trial_id % size]._packables->swap(all_medoids[trial_id]);
-        }
+        finish_trial_round(packed_medoids, binomial, i * size, all_medoids, comm);
+        ws.buffers.release(&packed_medoids);
         timer.record("UnpackFromBroadcast");
       }
-
-      CMPI_Group_free(&comm_group);
     }
 
     ///
     /// This is the Clustering Algorithm with Parallel Extensions to K-Medoids (CAPEK).
     /// 
-    /// Assumes that objects to be clustered are fully distributed across parallel process, 
-    /// with the same number of objects per process.  
-    ///
-    /// @tparam T     Type of objects to be clustered.
-    ///               T must support the following operations:
-    ///               - <code>int packed_size(MPI_Comm comm) const</code>
-    ///               - <code>void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const</code>
-    ///               - <code>static T unpack(void *buf, int bufsize, int *position, MPI_Comm comm)</code>
-    /// @tparam D     Dissimilarity metric type.  
-    ///               D should be callable on (T, T) and should return a double representing 
-    ///               the distance between the two T's.
+    /// Assumes that objects to be clustered are fully distributed across parallel processes.
+    /// Processes may have different numbers of objects; global object ids are assigned in
+    /// rank order, so the ith local object on process p has id i + (objects on ranks < p).
+    ///
+    /// @tparam Objects  Container of objects to be clustered, either std::vector<T> or dense_dataset.
+    ///                  Its value_type T must support the following operations:
+    ///                  - <code>int packed_size(MPI_Comm comm) const</code>
+    ///                  - <code>void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const</code>
+    ///                  - <code>static T unpack(void *buf, int bufsize, int *position, MPI_Comm comm)</code>
+    /// @tparam D        Dissimilarity metric type.  
+    ///                  D should be callable on (T, T) and should return a double representing 
+    ///                  the distance between the two T's.
     /// 
-    /// @param[in]  objects   Local objects to cluster (ASSUME: currently must be same number per process!)
+    /// @param[in]  objects   Local objects to cluster (counts may differ between processes)
     /// @param[in]  dmetric   Distance metric to build dissimilarity matrices with
     /// @param[in]  k         Number of clusters to find.
     /// @param[out] medoids   Optional output vector where global medoids will 
@@ -319,111 +303,329 @@ namespace cluster {
     ///
     /// @see xcapek() for a K-agnostic version of this algorithm.
     ///
-    template <class T, class D>
-    void capek(const std::vector<T>& objects, D dmetric, size_t k, std::vector<T> *medoids = NULL) 
+    template <class Objects, class D>
+    void capek(const Objects& objects, D dmetric, size_t k, 
+               std::vector<typename Objects::value_type> *medoids = NULL) 
     {
-      int size, rank;
-      CMPI_Comm_size(comm, &size);
+      seeded_capek(objects, dmetric, k, medoids, NULL);
+    }
+
+    ///
+    /// Incremental version of capek(), for re-clustering data that changes a little at a time, 
+    /// e.g. once per timestep.  This object should hold the previous partition, from capek() 
+    /// or recapek(), and prev_medoids the medoids that came with it.
+    ///
+    /// Local objects are first assigned to the previous medoids.  If the average dissimilarity
+    /// of objects to their medoids is within a factor of (1 + max_drift) of what it was when
+    /// trials last ran, the previous medoids are kept, and this costs just that assignment 
+    /// pass and one reduction.  Otherwise, capek() runs again with the same k, but trials also 
+    /// consider the previous medoids and start PAM from them.
+    ///
+    /// Object ids refer to the current objects, so medoid_ids only makes sense if each 
+    /// object keeps its id from one call to the next.  medoids may be &prev_medoids.
+    ///
+    /// @param[in]  objects       Local objects to cluster (counts may differ between processes)
+    /// @param[in]  dmetric       Distance metric to build dissimilarity matrices with
+    /// @param[in]  prev_medoids  Medoids of the previous partition, in medoid_ids order.
+    /// @param[in]  max_drift     Relative growth in average dissimilarity that triggers new trials.
+    /// @param[out] medoids       Optional output vector for the medoids.
+    ///
+    /// @return true if new trials were run, false if the previous medoids were kept.
+    ///
+    template <class Objects, class D>
+    bool recapek(const Objects& objects, D dmetric, 
+                 const std::vector<typename Objects::value_type>& prev_medoids, double max_drift,
+                 std::vector<typename Objects::value_type> *medoids = NULL) 
+    {
+      typedef typename Objects::value_type T;
+
+      if (prev_medoids.empty() || prev_medoids.size() != medoid_ids.size()) {
+        throw std::logic_error("Error: recapek() needs the medoids of the previous partition.");
+      }
+
+      int rank;
       CMPI_Comm_rank(comm, &rank);
 
-      if (!seed_set)
-        seed_random_uniform(comm); // seed RN generator uniformly across ranks.
+      std::vector<size_t>& offsets = workspace().offsets;
+      object_offsets(objects.size(), offsets, comm);
+      const size_t num_objects = offsets.back();
 
-      // fix things if k is greater than the number of elements, since we can't 
-      // ever find that many clusters.
-      size_t num_objects = size * objects.size();
-      k = std::min(num_objects, k);
-      timer.record("Init");
+      typename id_pair<T>::vector previous;
+      for (size_t m=0; m < prev_medoids.size(); m++) {
+        previous.push_back(make_id_pair(prev_medoids[m], medoid_ids[m]));
+      }
 
-      // do parallel work: farms out trials and broadcasts medoids from each trial to
-      // all processes.  On completion, medoids from all trials are in all_medoids vector.
-      std::vector<typename id_pair<T>::vector> all_medoids(max_reps);
-      trial_generator trials(k, k, max_reps, init_size, num_objects);
-      run_pam_trials(trials, objects, dmetric, all_medoids, comm);
+      // assign local objects to the previous medoids.
+      std::vector<nearest_two>& nearest = workspace().nearest;
+      closest_medoids(objects, offsets[rank], previous, dmetric, nearest);
+      double local_dissimilarity = 0;
+      cluster_ids.clear();
+      for (size_t o=0; o < objects.size(); o++) {
+        cluster_ids.push_back(nearest[o].m1);
+        local_dissimilarity += nearest[o].d1;
+      }
 
-      // Make two arrays to hold our closest medoids and their distance from our object
-      std::vector<double> all_dissimilarities(trials.count(), 0.0);           // dissimilarity sums
-      std::vector< std::vector<medoid_id> > all_cluster_ids(trials.count());  // local nearest medoid ids
+      double dissimilarity;
+      CMPI_Reduce(&local_dissimilarity, &dissimilarity, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+      CMPI_Bcast(&dissimilarity, 1, MPI_DOUBLE, 0, comm);
+      timer.record("Assign");
 
-      // Go through all the trials again, and for each of them, find the closest 
-      // medoid to this process's objects and sum the dissimilarities
-      for (size_t i=0; i < trials.count(); i++) {
-        for (size_t o=0; o < objects.size(); o++) {
-          object_id global_oid = rank + o;
-          std::pair<double, size_t> closest = closest_medoid(objects[o], global_oid, all_medoids[i], dmetric);
+      double average = num_objects ? dissimilarity / num_objects : 0;
+      if (reference_dissimilarity < 0) {
+        reference_dissimilarity = average;
+      }
 
-          all_dissimilarities[i]  += closest.first;
-          all_cluster_ids[i].push_back(closest.second);
+      if (average <= (1 + max_drift) * reference_dissimilarity) {
+        total_dissimilarity = dissimilarity;
+        if (medoids && medoids != &prev_medoids) {
+          *medoids = prev_medoids;
         }
+        return false;
       }
-      timer.record("FindMinima");
 
-      // Sum up all the min dissimilarities.  We do a Reduce/Bcast instead of an Allreduce
-      // to avoid FP error and guarantee that sums is the same across all processors.
-      std::vector<double> sums(trials.count());         // destination vectors for reduction.
+      seeded_capek(objects, dmetric, previous.size(), medoids, &previous);
+      return true;
+    }
 
-      CMPI_Reduce(&all_dissimilarities[0],  &sums[0], trials.count(), MPI_DOUBLE, MPI_SUM, 0, comm);
-      CMPI_Bcast(&sums[0],  trials.count(), MPI_DOUBLE, 0, comm);
-      timer.record("GlobalSums");
+    ///
+    /// Version of capek() for data sets with few objects per process, where most processes
+    /// hold no part of any trial's sample.  Only the participants, processes holding sampled
+    /// objects, take part in sampling, trials, and the exchange of medoids.  The rest of comm
+    /// joins in only for the final broadcast of the best medoids.
+    ///
+    /// All processes draw the same samples, so every process knows the participants without
+    /// communicating.  Each trial runs on a process in its own sample, with at most one trial
+    /// per process in each round of gathers.  Participants share medoids on a communicator 
+    /// made with MPI_Comm_create_group(), which only they call, and which the workspace keeps
+    /// until a call with different participants.  The first participant then broadcasts the
+    /// medoids of every trial, k times max_reps ids and objects, to all of comm.  Every process
+    /// sums the dissimilarity of its objects to each trial's medoids, and one reduction picks 
+    /// the trial with the least total dissimilarity over all objects, as in capek().
+    ///
+    /// Besides the object counts exchanged by object_offsets(), which are O(P) per process, 
+    /// and the final broadcast and reduction, communication per process depends on the trials
+    /// it takes part in, not on the size of comm.  Parameters are the same as for capek().
+    ///
+    template <class Objects, class D>
+    void subset_capek(const Objects& objects, D dmetric, size_t k, 
+                      std::vector<typename Objects::value_type> *medoids = NULL) 
+    {
+      typedef typename Objects::value_type T;
 
-      // find minmum global dissimilarity among all trials.
-      std::vector<double>::iterator min_sum = std::min_element(sums.begin(), sums.end());
-      total_dissimilarity = *min_sum;
-      size_t best = (min_sum - sums.begin());  // index of best trial.
+      int rank;
+      CMPI_Comm_rank(comm, &rank);
 
+      if (!seed_set)
+        seed_random_uniform(comm); // seed RN generator uniformly across ranks.
 
-      // Finally set up the partition to correspond to trial with best dissimilarity found
-      medoid_ids.resize(all_medoids[best].size());
-      for (size_t i = 0; i < medoid_ids.size(); i++) {
-        medoid_ids[i] = all_medoids[best][i].id;
+      capek_workspace& ws = workspace();
+      std::vector<size_t>& offsets = ws.offsets;
+      object_offsets(objects.size(), offsets, comm);
+      const size_t num_objects = offsets.back();
+      k = std::min(num_objects, k);
+      if (!k) {
+        medoid_ids.clear();
+        cluster_ids.clear();
+        total_dissimilarity = 0;
+        if (medoids) medoids->clear();
+        return;
       }
+      timer.record("Init");
 
-      // Make an indirection vector from the unsorted to sorted medoids
-      std::vector<size_t> mapping(medoid_ids.size());
-      std::generate(mapping.begin(), mapping.end(), sequence());
-      std::sort(mapping.begin(), mapping.end(), indexed_lt(medoid_ids));
-      invert(mapping);
+      // Plan every trial on every process: its sample, the processes that hold the sample,
+      // and the process that runs it.  This uses the same random numbers everywhere.
+      trial_generator trials(k, k, max_reps, init_size, num_objects);
+      std::vector< std::vector<size_t> > samples;
+      std::vector< std::vector<int> > sources;
+      std::vector<int> roots;
+      std::vector<size_t> round_starts;     // first trial of each round of gathers
+      std::set<int> busy;                   // roots in the current round
+      std::set<int> participant_set;
+      while (trials.has_next()) {
+        trial cur_trial = trials.next();
+        samples.push_back(std::vector<size_t>());
+        std::vector<size_t>& sample_ids = samples.back();
+        boost::random_number_generator<random_t> rng(random);  // Boost adaptor for STL RNG's
+        algorithm_r(trials.num_objects, cur_trial.sample_size, std::back_inserter(sample_ids), rng);
+
+        sources.push_back(std::vector<int>());
+        for (size_t s=0; s < sample_ids.size(); s++) {
+          int source = std::upper_bound(offsets.begin(), offsets.end(), sample_ids[s]) - offsets.begin() - 1;
+          if (sources.back().empty() || sources.back().back() != source) {
+            sources.back().push_back(source);
+            participant_set.insert(source);
+          }
+        }
 
-      // set up local cluster ids, medoids, and medoid_ids with the sorted mapping.
-      for (size_t i=0; i < medoid_ids.size(); i++) {
-        medoid_ids[i] = all_medoids[best][mapping[i]].id;
+        // run the trial on the first source that isn't busy, or start a new round.
+        int root = -1;
+        for (size_t s=0; s < sources.back().size() && root < 0; s++) {
+          if (!busy.count(sources.back()[s])) root = sources.back()[s];
+        }
+        if (round_starts.empty() || root < 0) {
+          round_starts.push_back(roots.size());
+          busy.clear();
+          if (root < 0) root = sources.back()[0];
+        }
+        busy.insert(root);
+        roots.push_back(root);
       }
+      round_starts.push_back(roots.size());
+      std::vector<int> participants(participant_set.begin(), participant_set.end());
+      const bool participant = participant_set.count(rank);
+      MPI_Comm participant_comm = ws.participant_comm(comm, participants);  // null if not one
+
+      typename id_pair<T>::vector trial_medoids;   // k medoids per trial, in trial order
+      std::vector<char>& packed = *ws.buffers.acquire(0);
+      if (participant) {
+        // gather samples and run PAM, a round at a time.  my_medoids holds the medoids of 
+        // the trials run here, k per trial, in trial order.
+        capek_workspace::typed_storage<T>& typed = ws.storage<T>(comm);
+        typename id_pair<T>::vector my_medoids;
+        for (size_t r=0; r + 1 < round_starts.size(); r++) {
+          std::vector<T>& my_objects = typed.samples;
+          my_objects.clear();
+          int my_trial = -1;
+
+          for (size_t t=round_starts[r]; t < round_starts[r+1]; t++) {
+            const std::vector<size_t>& sample_ids = samples[t];
+            std::vector<size_t>& sample_indices = ws.sample_indices;
+            local_indices(sample_ids, offsets, rank, sample_indices);
+
+            typed.gather.start(boost::make_permutation_iterator(objects.begin(), sample_indices.begin()), 
+                               boost::make_permutation_iterator(objects.begin(), sample_indices.end()),
+                               sources[t].begin(), sources[t].end(), my_objects, roots[t]);
+            if (roots[t] == rank) my_trial = t;
+          }
+          typed.gather.finish();
+          timer.record("Gather");
+
+          if (my_trial >= 0) {
+            kmedoids& cluster = ws.worker;
+            cluster.set_epsilon(epsilon);
+            build_dissimilarity_matrix(my_objects, dmetric, ws.distance);
+            cluster.pam(ws.distance, k);
+            for (size_t m=0; m < cluster.medoid_ids.size(); m++) {
+              my_medoids.push_back(
+                make_id_pair(my_objects[cluster.medoid_ids[m]], samples[my_trial][cluster.medoid_ids[m]]));
+            }
+          }
+          timer.record("LocalCluster");
+        }
 
-      // swap in the cluster ids with the best BIC score.
-      cluster_ids.swap(all_cluster_ids[best]);
+        // share medoids of all trials among the participants only.
+        std::vector< packable_vector< id_pair<T> > > all_mine;
+        allgather(make_packable_vector(&my_medoids, false), all_mine, participant_comm);
+        timer.record("ShareMedoids");
+
+        // the first participant lines them up k per trial, in trial order, for everyone.
+        if (rank == participants[0]) {
+          std::vector<size_t> next(participants.size(), 0);   // next unread medoid from each participant
+          for (size_t t=0; t < roots.size(); t++) {
+            size_t p = std::lower_bound(participants.begin(), participants.end(), roots[t]) - participants.begin();
+            const typename id_pair<T>::vector& theirs = *all_mine[p]._packables;
+            trial_medoids.insert(trial_medoids.end(), theirs.begin() + next[p], theirs.begin() + next[p] + k);
+            next[p] += k;
+          }
+          packable_vector< id_pair<T> > packable = make_packable_vector(&trial_medoids, false);
+          packed.resize(packable.packed_size(comm));
+          int pos = 0;
+          packable.pack(&packed[0], packed.size(), &pos, comm);
+        }
+      }
 
-      // if the caller wanted a copy of the medoids, copy them into the dstination array.
-      if (medoids) {
-        medoids->resize(medoid_ids.size());
-        for (size_t i=0; i < medoid_ids.size(); i++) {
-          (*medoids)[i] = all_medoids[best][mapping[i]].element;
+      // the first participant sends the medoids of every trial to everyone.
+      int packed_size = packed.size();
+      CMPI_Bcast(&packed_size, 1, MPI_INT, participants[0], comm);
+      packed.resize(packed_size);
+      CMPI_Bcast(&packed[0], packed_size, MPI_PACKED, participants[0], comm);
+      if (rank != participants[0]) {
+        int pos = 0;
+        packable_vector< id_pair<T> > packable = make_packable_vector(&trial_medoids, false);
+        packable.unpack_from(&packed[0], packed_size, &pos, comm);
+      }
+      ws.buffers.release(&packed);
+      timer.record("BroadcastMedoids");
+
+      // judge each trial by the dissimilarity of all objects to its medoids, as capek() does.
+      std::vector<typename id_pair<T>::vector>& all_medoids = ws.storage<T>(comm).medoids;
+      reset_vectors(all_medoids, roots.size());
+      std::vector<double>& dissimilarities = ws.dissimilarities;
+      dissimilarities.assign(roots.size(), 0.0);
+      for (size_t t=0; t < roots.size(); t++) {
+        all_medoids[t].assign(trial_medoids.begin() + t * k, trial_medoids.begin() + (t + 1) * k);
+        closest_medoids(objects, offsets[rank], all_medoids[t], dmetric, ws.nearest);
+        for (size_t o=0; o < objects.size(); o++) {
+          dissimilarities[t] += ws.nearest[o].d1;
         }
       }
+      std::vector<double>& sums = ws.sums;
+      sums.resize(roots.size());
+      CMPI_Allreduce(&dissimilarities[0], &sums[0], roots.size(), MPI_DOUBLE, MPI_SUM, comm);
+      timer.record("TrialSums");
+
+      size_t best = std::min_element(sums.begin(), sums.end()) - sums.begin();
+      typename id_pair<T>::vector& best_medoids = all_medoids[best];
+      total_dissimilarity = sums[best];
+
+      // order medoids by object id, and assign local objects to them.
+      std::vector< std::pair<object_id, size_t> > order;
+      for (size_t m=0; m < best_medoids.size(); m++) {
+        order.push_back(std::make_pair(best_medoids[m].id, m));
+      }
+      std::sort(order.begin(), order.end());
+      typename id_pair<T>::vector sorted;
+      medoid_ids.clear();
+      for (size_t m=0; m < order.size(); m++) {
+        sorted.push_back(best_medoids[order[m].second]);
+        medoid_ids.push_back(order[m].first);
+      }
 
-      timer.record("BicScore");
-    }    
+      std::vector<nearest_two>& nearest = ws.nearest;
+      closest_medoids(objects, offsets[rank], sorted, dmetric, nearest);
+      cluster_ids.clear();
+      for (size_t o=0; o < objects.size(); o++) {
+        cluster_ids.push_back(nearest[o].m1);
+      }
+      reference_dissimilarity = total_dissimilarity / num_objects;
+
+      if (medoids) {
+        medoids->clear();
+        for (size_t m=0; m < sorted.size(); m++) {
+          medoids->push_back(sorted[m].element);
+        }
+      }
+      timer.record("Assign");
+    }
 
     
     ///
     /// K-agnostic version of capek().
     /// This version attempts to guess the best K for the data using the 
     /// Bayesian Information Criterion (BIC) described in bic.h.  Evaluation of the 
-    /// BIC is parallelized using global reduction operations.
+    /// BIC is parallelized using global reduction operations.  With set_k_criterion(), the
+    /// mean medoid silhouette from silhouette.h can be used instead, at the cost of one
+    /// more reduction.
     /// 
     /// Like capek(), this uses run_pam_trials() to farm out trials of the PAM clustering algorithm,
     /// but it requires more trials than capek().  In particular, it will run 
     /// (sum(1..max_k) * trials) total trials in parallel on MPI worker processes.
     ///
-    /// @tparam T     Type of objects to be clustered.
-    ///               T must support the following operations:
-    ///                - <code>int packed_size(MPI_Comm comm) const</code>
-    ///                - <code>void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const</code>
-    ///                - <code>static T unpack(void *buf, int bufsize, int *position, MPI_Comm comm)</code>
-    /// @tparam D     Dissimilarity metric type.  
-    ///               D should be callable on (T, T) and should return a double representing 
-    ///               the distance between the two T's.
+    /// set_k_search() and set_k_patience() reduce this by evaluating only some values of k.  
+    /// Each round of k values runs its trials together, so fewer k values means fewer rounds 
+    /// of trials, but also less parallelism per round.  Scores for the k values visited are 
+    /// available from get_k_scores() afterwards.
+    ///
+    /// @tparam Objects  Container of objects to be clustered, either std::vector<T> or dense_dataset.
+    ///                  Its value_type T must support the following operations:
+    ///                   - <code>int packed_size(MPI_Comm comm) const</code>
+    ///                   - <code>void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const</code>
+    ///                   - <code>static T unpack(void *buf, int bufsize, int *position, MPI_Comm comm)</code>
+    /// @tparam D        Dissimilarity metric type.  
+    ///                  D should be callable on (T, T) and should return a double representing 
+    ///                  the distance between the two T's.
     /// 
-    /// @param[in]  objects         Local objects to cluster (ASSUME: currently must be same number per process!)
+    /// @param[in]  objects         Local objects to cluster (counts may differ between processes)
     /// @param[in]  dmetric         Distance metric to build dissimilarity matrices with
     /// @param[in]  max_k           Max number of clusters to find.
     /// @param[in]  dimensionality  Dimensionality of objects, used by BIC.
@@ -431,102 +633,762 @@ namespace cluster {
     ///                             along with their source ranks.
     ///
     /// @return
-    /// The best BIC value found, that is, the BIC value of the final clustering.
+    /// The best BIC value found, that is, the BIC value of the final clustering, or the best 
+    /// silhouette.
     ///
-    template <class T, class D>
-    double xcapek(const std::vector<T>& objects, D dmetric, size_t max_k, size_t dimensionality,
-                  std::vector<T> *medoids = NULL) 
+    template <class Objects, class D>
+    double xcapek(const Objects& objects, D dmetric, size_t max_k, size_t dimensionality,
+                  std::vector<typename Objects::value_type> *medoids = NULL) 
     {
-      int size, rank;
+      typedef typename Objects::value_type T;
+
+      int size;
       CMPI_Comm_size(comm, &size);
-      CMPI_Comm_rank(comm, &rank);
 
       if (!seed_set)
         seed_random_uniform(comm); // seed RN generator uniformly across ranks.
 
+      // global ids of local objects start at offsets[rank].
+      std::vector<size_t> offsets;
+      object_offsets(objects.size(), offsets, comm);
+
       // fix things if k is greater than the number of elements, since we can't 
       // ever find that many clusters.
-      size_t num_objects = size * objects.size();
+      size_t num_objects = offsets.back();
       max_k = std::min(num_objects, max_k);
+      if (!max_k) {
+        medoid_ids.clear();
+        cluster_ids.clear();
+        k_scores.clear();
+        total_dissimilarity = best_bic_score = 0;
+        if (medoids) medoids->clear();
+        return 0;
+      }
       timer.record("Init");
 
-      std::vector<typename id_pair<T>::vector> all_medoids(max_k * max_reps);
-      trial_generator trials(max_k, max_reps, init_size, num_objects);
-      run_pam_trials(trials, objects, dmetric, all_medoids, comm);
+      k_search_state<T> state;
+      std::vector<size_t> ks;
+
+      switch (search) {
+      case exhaustive_k_search:
+        if (!patience) {
+          // everything at once, for the best load balance.
+          evaluate_k_values(k_range(1, max_k), objects, dmetric, dimensionality, offsets, state);
+        } else {
+          // enough k's per round to keep all processes busy, stopping after patience 
+          // k values without improvement.
+          size_t per_round = std::max<size_t>(1, size / std::max<size_t>(max_reps, 1));
+          for (size_t k = 1; k <= max_k; k += per_round) {
+            size_t last = std::min(max_k, k + per_round - 1);
+            evaluate_k_values(k_range(k, last), objects, dmetric, dimensionality, offsets, state);
+            if (last - state.best_k() >= patience) break;
+          }
+        }
+        break;
+
+      case coarse_to_fine_k_search: {
+        // evaluate an evenly spaced grid, then halve the spacing around the best k.
+        size_t step = std::max<size_t>(1, max_k / 8);
+        for (size_t k = 1; k <= max_k; k += step) ks.push_back(k);
+        ks.push_back(max_k);
+        evaluate_k_values(ks, objects, dmetric, dimensionality, offsets, state);
+
+        while (step > 1) {
+          step = (step + 1) / 2;
+          size_t best = state.best_k();
+          ks.clear();
+          if (best > step) ks.push_back(best - step);
+          if (best + step <= max_k) ks.push_back(best + step);
+          evaluate_k_values(ks, objects, dmetric, dimensionality, offsets, state);
+        }
+        break;
+      }
+
+      case golden_section_k_search: {
+        // assumes the score is unimodal in k.  Each round shrinks [lo, hi] by 1/phi.
+        const double inv_phi = 0.6180339887498949;
+        size_t lo = 1, hi = max_k;
+        while (hi > lo + 2) {
+          size_t c = hi - (size_t)((hi - lo) * inv_phi + 0.5);
+          size_t d = lo + (size_t)((hi - lo) * inv_phi + 0.5);
+          if (c >= d) { c = lo + (hi - lo) / 2; d = c + 1; }
+
+          ks.clear();
+          ks.push_back(c);
+          ks.push_back(d);
+          evaluate_k_values(ks, objects, dmetric, dimensionality, offsets, state);
+
+          if (state.score(c) >= state.score(d)) {
+            hi = d - 1;
+          } else {
+            lo = c + 1;
+          }
+        }
+        evaluate_k_values(k_range(lo, hi), objects, dmetric, dimensionality, offsets, state);
+        break;
+      }
+      }
 
-      // Make two arrays to hold our closest medoids and their distance from our object
-      std::vector<double> all_dissimilarities(trials.count(), 0.0);           // dissimilarity sums
-      std::vector< std::vector<medoid_id> > all_cluster_ids(trials.count());  // local nearest medoid ids
+      // Finally set up the partition to correspond to best trial found.
+      finish_xcapek(state, num_objects, medoids);
+      timer.record("BicScore");
+      return best_bic_score;
+    }    
 
-      std::vector<double> all_dissim2;      // dissimilarity sums squared
-      std::vector<size_t> cluster_sizes;    // sizes of clusters in each trial
 
-      // Go through all the trials again, and for each of them, find the closest 
-      // medoid to this process's objects and sum the squared dissimilarities
-      for (size_t i=0; i < trials.count(); i++) {
-        const size_t num_medoids = all_medoids[i].size();
-        for (size_t m=0; m < num_medoids; m++) {
-          all_dissim2.push_back(0.0);
-          cluster_sizes.push_back(0);
-        }
-        double *dissim2 = &all_dissim2[all_dissim2.size() - num_medoids];
-        size_t *sizes   = &cluster_sizes[cluster_sizes.size() - num_medoids];
-        
+    ///
+    /// Non-blocking version of capek().  Starts the clustering and returns right away; it 
+    /// then progresses in calls to req.test() or req.wait(), which leave this object with 
+    /// the same partition capek() would have found.  Include capek_request.h to use this.
+    /// Collective, like capek().  This object and the arguments must stay valid, and this 
+    /// object must not be used for anything else, until req completes.
+    ///
+    template <class Objects, class D>
+    void icapek(capek_request<Objects, D>& req, const Objects& objects, D dmetric, size_t k,
+                std::vector<typename Objects::value_type> *medoids = NULL) 
+    {
+      req.start(*this, objects, dmetric, k, false, 0, medoids);
+    }
+
+    ///
+    /// Non-blocking version of xcapek(), with the same requirements as icapek().  This always
+    /// runs an exhaustive search over k from 1 to max_k in one round, whatever set_k_search() 
+    /// and set_k_patience() say.  The best score is available from bic_score() on completion.
+    ///
+    template <class Objects, class D>
+    void ixcapek(capek_request<Objects, D>& req, const Objects& objects, D dmetric, size_t max_k,
+                 size_t dimensionality, std::vector<typename Objects::value_type> *medoids = NULL) 
+    {
+      req.start(*this, objects, dmetric, max_k, true, dimensionality, medoids);
+    }
+
+    /// Set how xcapek() searches for k.  Defaults to exhaustive_k_search.
+    void set_k_search(k_search_strategy strategy) { search = strategy; }
+
+    ///
+    /// With exhaustive_k_search, stop once the best score hasn't improved for this many 
+    /// values of k.  k values are then evaluated in rounds of about (processes / max_reps)
+    /// values each.  Defaults to 0, which evaluates all k from 1 to max_k in one round.
+    ///
+    void set_k_patience(size_t p) { patience = p; }
+
+    /// Best score found for each k that the last xcapek() evaluated.
+    const std::map<size_t, double>& get_k_scores() const { return k_scores; }
+
+
+    ///
+    /// Parallel version of kmedoids::xbisect(), in the style of X-means.  Starts with capek() 
+    /// for k=1, then repeatedly tries a 2-medoid split of each cluster that hasn't refused one,
+    /// keeping splits that improve the BIC of the cluster's objects, until no cluster splits or 
+    /// there are max_k clusters.  The cost tracks the final k rather than max_k.
+    /// 
+    /// Each round splits the processes into one subcommunicator per cluster to be split (or
+    /// fewer, taking turns, if there are more clusters than processes).  Members of each 
+    /// cluster are moved to its subcommunicator, which splits them with capek().  BIC scores 
+    /// for the splits come from global reductions over the original objects.
+    ///
+    /// @param[in]  objects         Local objects to cluster (counts may differ between processes)
+    /// @param[in]  dmetric         Distance metric to build dissimilarity matrices with
+    /// @param[in]  max_k           Max number of clusters to find.
+    /// @param[in]  dimensionality  Dimensionality of objects, used by BIC.
+    /// @param[out] medoids         Optional output vector where global medoids will be stored.
+    ///
+    /// @return The BIC of the final clustering.
+    ///
+    template <class Objects, class D>
+    double xbisect(const Objects& objects, D dmetric, size_t max_k, size_t dimensionality,
+                   std::vector<typename Objects::value_type> *medoids = NULL) 
+    {
+      typedef typename Objects::value_type T;
+
+      int rank;
+      CMPI_Comm_rank(comm, &rank);
+
+      if (!seed_set)
+        seed_random_uniform(comm); // seed RN generator uniformly across ranks.
+
+      std::vector<size_t> offsets;
+      object_offsets(objects.size(), offsets, comm);
+      const size_t num_objects = offsets.back();
+      max_k = std::min(num_objects, max_k);
+      if (!max_k) {
+        medoid_ids.clear();
+        cluster_ids.clear();
+        total_dissimilarity = best_bic_score = 0;
+        if (medoids) medoids->clear();
+        return 0;
+      }
+
+      // start with everything in one cluster.
+      typename id_pair<T>::vector cur_medoids;
+      {
+        std::vector<T> first;
+        capek(objects, dmetric, 1, &first);
+        cur_medoids.push_back(make_id_pair(first[0], medoid_ids[0]));
+      }
+      timer.record("Init");
+
+      // cluster of each local object, and distance to its medoid.
+      std::vector<size_t> local_cluster(objects.size(), 0);
+      std::vector<double> local_distance(objects.size());
+      for (size_t o=0; o < objects.size(); o++) {
+        local_distance[o] = dmetric(cur_medoids[0].element, objects[o]);
+      }
+
+      std::vector<bool> done(1, false);
+      while (cur_medoids.size() < max_k) {
+        // global sizes and squared dissimilarities of the current clusters.
+        const size_t k = cur_medoids.size();
+        std::vector<size_t> local_sizes(k, 0), sizes(k);
+        std::vector<double> local_dissim2(k, 0.0), dissim2(k);
         for (size_t o=0; o < objects.size(); o++) {
-          object_id global_oid = rank + o;
-          std::pair<double, size_t> closest = closest_medoid(objects[o], global_oid, all_medoids[i], dmetric);
+          local_sizes[local_cluster[o]]   += 1;
+          local_dissim2[local_cluster[o]] += local_distance[o] * local_distance[o];
+        }
+        CMPI_Allreduce(&local_sizes[0], &sizes[0], k, MPI_SIZE_T, MPI_SUM, comm);
+        CMPI_Reduce(&local_dissim2[0], &dissim2[0], k, MPI_DOUBLE, MPI_SUM, 0, comm);
+        CMPI_Bcast(&dissim2[0], k, MPI_DOUBLE, 0, comm);
+
+        std::vector<size_t> active;            // clusters to try splitting
+        std::vector<long> position(k, -1);     // position of each cluster in active
+        for (size_t c=0; c < k; c++) {
+          if (!done[c] && sizes[c] > 2) {
+            position[c] = active.size();
+            active.push_back(c);
+          }
+        }
+        if (active.empty()) break;
+
+        // candidate medoids for active[a] end up in halves[2a] and halves[2a+1].
+        typename id_pair<T>::vector halves;
+        bisect_clusters(objects, dmetric, active, position, local_cluster, offsets, halves);
+        timer.record("Bisect");
+
+        // assign members of active clusters to the nearer candidate.
+        std::vector<char>   local_side(objects.size(), 0);
+        std::vector<double> side_distance(objects.size());
+        std::vector<size_t> local_half_sizes(halves.size(), 0), half_sizes(halves.size());
+        std::vector<double> local_half_dissim2(halves.size(), 0.0), half_dissim2(halves.size());
+        for (size_t o=0; o < objects.size(); o++) {
+          long a = position[local_cluster[o]];
+          if (a < 0) continue;
+
+          object_id oid = offsets[rank] + o;
+          const id_pair<T>& m0 = halves[2*a];
+          const id_pair<T>& m1 = halves[2*a + 1];
+          double d0 = dmetric(m0.element, objects[o]);
+          double d1 = dmetric(m1.element, objects[o]);
+          int side = (oid != m0.id && (d1 < d0 || oid == m1.id)) ? 1 : 0;
+
+          local_side[o]    = side;
+          side_distance[o] = side ? d1 : d0;
+          local_half_sizes[2*a + side]   += 1;
+          local_half_dissim2[2*a + side] += side_distance[o] * side_distance[o];
+        }
+        CMPI_Allreduce(&local_half_sizes[0], &half_sizes[0], halves.size(), MPI_SIZE_T, MPI_SUM, comm);
+        CMPI_Reduce(&local_half_dissim2[0], &half_dissim2[0], halves.size(), MPI_DOUBLE, MPI_SUM, 0, comm);
+        CMPI_Bcast(&half_dissim2[0], halves.size(), MPI_DOUBLE, 0, comm);
+        timer.record("SplitSums");
+
+        // take the splits that help most first, in case we hit max_k.
+        std::vector< std::pair<double, size_t> > gains;
+        for (size_t a=0; a < active.size(); a++) {
+          size_t c = active[a];
+          double gain = bic(2, &half_sizes[2*a], &half_dissim2[2*a], dimensionality)
+            - bic(1, &sizes[c], &dissim2[c], dimensionality);
+          gains.push_back(std::make_pair(gain, a));
+        }
+        std::sort(gains.begin(), gains.end(), std::greater< std::pair<double, size_t> >());
+
+        std::vector<size_t> new_cluster(active.size(), 0);   // cluster id for second halves, if split
+        for (size_t i=0; i < gains.size(); i++) {
+          size_t a = gains[i].second;
+          size_t c = active[a];
+          if (gains[i].first > 0 && cur_medoids.size() < max_k) {
+            cur_medoids[c] = halves[2*a];
+            new_cluster[a] = cur_medoids.size();
+            cur_medoids.push_back(halves[2*a + 1]);
+            done.push_back(false);
+          } else {
+            done[c] = true;
+          }
+        }
 
-          all_dissimilarities[i]  += closest.first;
-          dissim2[closest.second] += closest.first * closest.first;
-          sizes[closest.second]   += 1;
-          all_cluster_ids[i].push_back(closest.second);
+        for (size_t o=0; o < objects.size(); o++) {
+          long a = position[local_cluster[o]];
+          if (a < 0 || !new_cluster[a]) continue;
+          if (local_side[o]) local_cluster[o] = new_cluster[a];
+          local_distance[o] = side_distance[o];
         }
       }
+
+      // order medoids by object id, and assign everything to its nearest medoid.
+      std::vector< std::pair<object_id, size_t> > order;
+      for (size_t m=0; m < cur_medoids.size(); m++) {
+        order.push_back(std::make_pair(cur_medoids[m].id, m));
+      }
+      std::sort(order.begin(), order.end());
+      typename id_pair<T>::vector sorted;
+      for (size_t m=0; m < order.size(); m++) {
+        sorted.push_back(cur_medoids[order[m].second]);
+      }
+      cur_medoids.swap(sorted);
+
+      const size_t k = cur_medoids.size();
+      medoid_ids.resize(k);
+      for (size_t m=0; m < k; m++) {
+        medoid_ids[m] = cur_medoids[m].id;
+      }
+
+      cluster_ids.clear();
+      std::vector<size_t> local_sizes(k, 0), sizes(k);
+      std::vector<double> local_sums(k + 1, 0.0), sums(k + 1);  // squared dissimilarities, then total
+      std::vector<nearest_two>& nearest = workspace().nearest;
+      closest_medoids(objects, offsets[rank], cur_medoids, dmetric, nearest);
+      for (size_t o=0; o < objects.size(); o++) {
+        const nearest_two& closest = nearest[o];
+        cluster_ids.push_back(closest.m1);
+        local_sizes[closest.m1] += 1;
+        local_sums[closest.m1]  += closest.d1 * closest.d1;
+        local_sums[k]           += closest.d1;
+      }
+      CMPI_Allreduce(&local_sizes[0], &sizes[0], k, MPI_SIZE_T, MPI_SUM, comm);
+      CMPI_Reduce(&local_sums[0], &sums[0], k + 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+      CMPI_Bcast(&sums[0], k + 1, MPI_DOUBLE, 0, comm);
+
+      total_dissimilarity = sums[k];
+      best_bic_score = bic(k, &sizes[0], &sums[0], dimensionality);
+
+      if (medoids) {
+        medoids->clear();
+        for (size_t m=0; m < k; m++) {
+          medoids->push_back(cur_medoids[m].element);
+        }
+      }
+      timer.record("BicScore");
+      return best_bic_score;
+    }
+    
+    /// Get the Timer with info on the last run of either capek() or xcapek().
+    const Timer& get_timer() { return timer; }
+
+  protected:
+    template <class Objects, class D> friend class capek_request;
+
+    ///
+    /// capek(), with trials for k seeded with seeds if it's supplied.  See run_pam_trials().
+    ///
+    template <class Objects, class D>
+    void seeded_capek(const Objects& objects, D dmetric, size_t k, 
+                      std::vector<typename Objects::value_type> *medoids,
+                      const typename id_pair<typename Objects::value_type>::vector *seeds)
+    {
+      typedef typename Objects::value_type T;
+
+      int size, rank;
+      CMPI_Comm_size(comm, &size);
+      CMPI_Comm_rank(comm, &rank);
+
+      if (!seed_set)
+        seed_random_uniform(comm); // seed RN generator uniformly across ranks.
+
+      // global ids of local objects start at offsets[rank].
+      capek_workspace& ws = workspace();
+      std::vector<size_t>& offsets = ws.offsets;
+      object_offsets(objects.size(), offsets, comm);
+
+      // fix things if k is greater than the number of elements, since we can't 
+      // ever find that many clusters.
+      size_t num_objects = offsets.back();
+      k = std::min(num_objects, k);
+      timer.record("Init");
+
+      // do parallel work: farms out trials and broadcasts medoids from each trial to
+      // all processes.  On completion, medoids from all trials are in all_medoids vector.
+      std::vector<typename id_pair<T>::vector>& all_medoids = ws.storage<T>(comm).medoids;
+      reset_vectors(all_medoids, max_reps);
+      trial_generator trials(k, k, max_reps, init_size, num_objects);
+      run_pam_trials(trials, objects, dmetric, all_medoids, offsets, comm, seeds);
+
+      // Go through all the trials again, and for each of them, find the closest 
+      // medoid to this process's objects and sum the dissimilarities
+      sum_trials(objects, dmetric, all_medoids, trials.count(), offsets[rank], false);
       timer.record("FindMinima");
-      
 
       // Sum up all the min dissimilarities.  We do a Reduce/Bcast instead of an Allreduce
       // to avoid FP error and guarantee that sums is the same across all processors.
-      std::vector<double> sums(trials.count());         // destination vectors for reduction.
-      std::vector<double> sums2(all_dissim2.size());
-      std::vector<size_t> sizes(cluster_sizes.size());
+      std::vector<double>& sums = ws.sums;         // destination vectors for reduction.
+      sums.resize(trials.count());
 
-      CMPI_Reduce(&all_dissimilarities[0],  &sums[0], trials.count(), MPI_DOUBLE, MPI_SUM, 0, comm);
-      CMPI_Reduce(&all_dissim2[0], &sums2[0], sums2.size(), MPI_DOUBLE, MPI_SUM, 0, comm);
+      CMPI_Reduce(&ws.dissimilarities[0], &sums[0], trials.count(), MPI_DOUBLE, MPI_SUM, 0, comm);
       CMPI_Bcast(&sums[0],  trials.count(), MPI_DOUBLE, 0, comm);
-      CMPI_Bcast(&sums2[0], sums2.size(), MPI_DOUBLE, 0, comm);
-      CMPI_Allreduce(&cluster_sizes[0], &sizes[0], sizes.size(), MPI_SIZE_T, MPI_SUM, comm);
       timer.record("GlobalSums");
 
+      // Finally set up the partition to correspond to trial with best dissimilarity found
+      finish_capek(all_medoids, trials.count(), num_objects, medoids);
+      timer.record("BicScore");
+    }
+
+    ///
+    /// Start of a round of run_pam_trials().  Draws samples for the next trials, one per process,
+    /// and starts gathering each to the process that will run it, on the workspace's gather for
+    /// T on comm.  Finish the gathers, then call run_local_trial() if this process got a trial.
+    ///
+    /// @return Index of the trial to run here, or -1 if there is none.  Its k goes in my_k.
+    ///
+    template <class Objects>
+    int start_trial_round(trial_generator& trials, const Objects& objects, 
+                          const std::vector<size_t>& offsets, MPI_Comm comm, int& my_k) 
+    {
+      typedef typename Objects::value_type T;
+
+      int size, rank;
+      CMPI_Comm_size(comm, &size);
+      CMPI_Comm_rank(comm, &rank);
+
+      capek_workspace& ws = workspace();
+      capek_workspace::typed_storage<T>& typed = ws.storage<T>(comm);
+      std::vector<T>& my_objects = typed.samples;    // local sample of objects for clustering.
+      multi_gather<T>& gather = typed.gather;        // simultaneous, asynchronous local gathers for collecting samples.
+      my_objects.clear();
+
+      int my_trial = -1;
+      my_k = -1;
+      for (int root=0; trials.has_next() && root < size; root++) {
+        trial cur_trial = trials.next();    // generate a trial descriptor
+        
+        // Generate a set of indices for members of this k-medoids trial
+        std::vector<size_t>& sample_ids = ws.sample_ids;
+        sample_ids.clear();
+        boost::random_number_generator<random_t> rng(random);  // Boost adaptor for STL RNG's
+        algorithm_r(trials.num_objects, cur_trial.sample_size, std::back_inserter(sample_ids), rng);
+
+        // figure out where the sample objects live.  Process p owns [offsets[p], offsets[p+1]).
+        std::vector<int>& sources = ws.sources;
+        sources.clear();
+        for (size_t s=0; s < sample_ids.size(); s++) {
+          int source = std::upper_bound(offsets.begin(), offsets.end(), sample_ids[s]) - offsets.begin() - 1;
+          if (sources.empty() || sources.back() != source) {
+            sources.push_back(source);
+          }
+        }
+
+        // make a permutation vector for the indices of the sampled *local* objects
+        std::vector<size_t>& sample_indices = ws.sample_indices;
+        local_indices(sample_ids, offsets, rank, sample_indices);
+
+        // gather trial members to the current worker (root)
+        gather.start(boost::make_permutation_iterator(objects.begin(), sample_indices.begin()), 
+                     boost::make_permutation_iterator(objects.begin(), sample_indices.end()),
+                     sources.begin(), sources.end(), my_objects, root);
+        
+        // record which trial to use locally and save the medoids there.
+        if (rank == root) {
+          my_k     = cur_trial.k;
+          my_trial = trials.count() - 1;
+          ws.my_ids.swap(sample_ids);   // object ids for each of my_objects
+        }
+      }
+      return my_trial;
+    }
+
+    ///
+    /// Runs PAM with k = my_k on the sample gathered here by start_trial_round(), and puts the
+    /// medoids in trial_medoids.  Seeds are used as in run_pam_trials().
+    ///
+    template <class T, class D>
+    void run_local_trial(D dmetric, int my_k, typename id_pair<T>::vector& trial_medoids, MPI_Comm comm,
+                         const typename id_pair<T>::vector *seeds = NULL)
+    {
+      capek_workspace& ws = workspace();
+      std::vector<T>& my_objects = ws.storage<T>(comm).samples;
+      std::vector<size_t>& my_ids = ws.my_ids;
+
+      kmedoids& cluster = ws.worker;
+      cluster.set_epsilon(epsilon);
+
+      dissimilarity_matrix& mat = ws.distance;
+      if (seeds && seeds->size() == (size_t)my_k) {
+        // seeds are the first my_k objects of the sample.
+        add_seeds(*seeds, my_objects, my_ids);
+        build_dissimilarity_matrix(my_objects, dmetric, mat);
+        std::vector<object_id>& initial = ws.sample_ids;
+        initial.clear();
+        for (int m=0; m < my_k; m++) initial.push_back(m);
+        cluster.pam(mat, my_k, &initial[0]);
+      } else {
+        build_dissimilarity_matrix(my_objects, dmetric, mat);
+        cluster.pam(mat, my_k);
+      }
+
+      // put this trial's medoids into their spot in the global medoids array.
+      for (size_t m=0; m < cluster.medoid_ids.size(); m++) {
+        trial_medoids.push_back(
+          make_id_pair(my_objects[cluster.medoid_ids[m]], my_ids[cluster.medoid_ids[m]]));
+      }
+    }
+
+    ///
+    /// End of a round of run_pam_trials().  Unpacks the medoids that the round's workers gathered
+    /// along binomial, now broadcast to all processes in packed, into all_medoids.  The round's
+    /// trials start at first_trial, and trial first_trial + r ran on rank r.
+    ///
+    template <class T>
+    void finish_trial_round(const std::vector<char>& packed, const binomial_embedding& binomial, 
+                            size_t first_trial, std::vector< std::vector< id_pair<T> > >& all_medoids,
+                            MPI_Comm comm)
+    {
+      std::vector< packable_vector< id_pair<T> > >& unpacked = workspace().storage<T>(comm).unpacked;
+      unpack_binomial(packed, unpacked, binomial, comm);
+      for (size_t r=0; r < binomial.size(); r++) {
+        unpacked[r]._packables->swap(all_medoids[first_trial + r]);
+      }
+    }
+
+    ///
+    /// Put seeds at the front of a worker's sample, in place of any sampled copies of them.
+    ///
+    template <class T>
+    static void add_seeds(const typename id_pair<T>::vector& seeds, std::vector<T>& objects, 
+                          std::vector<size_t>& ids) {
+      size_t kept = 0;
+      for (size_t i=0; i < ids.size(); i++) {
+        bool is_seed = false;
+        for (size_t s=0; s < seeds.size(); s++) {
+          if (seeds[s].id == ids[i]) is_seed = true;
+        }
+        if (!is_seed) {
+          if (kept != i) {
+            objects[kept] = objects[i];
+            ids[kept] = ids[i];
+          }
+          kept++;
+        }
+      }
+      objects.resize(kept);
+      ids.resize(kept);
+
+      objects.insert(objects.begin(), seeds.size(), T());
+      ids.insert(ids.begin(), seeds.size(), 0);
+      for (size_t s=0; s < seeds.size(); s++) {
+        objects[s] = seeds[s].element;
+        ids[s] = seeds[s].id;
+      }
+    }
+
+    ///
+    /// Results of the k values xcapek() has evaluated so far, and the best trial among them.
+    ///
+    template <class T>
+    struct k_search_state {
+      std::map<size_t, double> scores;           ///< best score for each k evaluated
+      typename id_pair<T>::vector best_medoids;  ///< medoids of the best trial
+      std::vector<medoid_id> best_cluster_ids;   ///< local cluster ids for the best trial
+      double best_score;                         ///< score of the best trial
+      double min_dissimilarity;                  ///< lowest total dissimilarity of any trial
+
+      k_search_state() : best_score(-DBL_MAX), min_dissimilarity(DBL_MAX) { }
+
+      /// k of the best trial so far.
+      size_t best_k() const { return best_medoids.size(); }
+
+      /// Best score for k, or -DBL_MAX if k hasn't been evaluated.  Never adds to scores.
+      double score(size_t k) const {
+        std::map<size_t, double>::const_iterator s = scores.find(k);
+        return (s == scores.end()) ? -DBL_MAX : s->second;
+      }
+    };
+
+    /// Consecutive k values from lo to hi.
+    static std::vector<size_t> k_range(size_t lo, size_t hi) {
+      std::vector<size_t> ks;
+      for (size_t k = lo; k <= hi; k++) ks.push_back(k);
+      return ks;
+    }
+
+    ///
+    /// Run max_reps trials of PAM for each k in ks that hasn't been evaluated yet, score them
+    /// with the k criterion, and record the results in state.  This is one round of 
+    /// run_pam_trials() plus one set of global reductions, however many k values there are.
+    ///
+    template <class Objects, class D>
+    void evaluate_k_values(std::vector<size_t> ks, const Objects& objects, D dmetric, 
+                           size_t dimensionality, const std::vector<size_t>& offsets,
+                           k_search_state<typename Objects::value_type>& state) {
+      typedef typename Objects::value_type T;
+
+      int rank;
+      CMPI_Comm_rank(comm, &rank);
+      const size_t num_objects = offsets.back();
+
+      // skip k values already evaluated.
+      std::sort(ks.begin(), ks.end());
+      ks.erase(std::unique(ks.begin(), ks.end()), ks.end());
+      std::vector<size_t> new_ks;
+      for (size_t i=0; i < ks.size(); i++) {
+        if (ks[i] >= 1 && ks[i] <= num_objects && !state.scores.count(ks[i])) {
+          new_ks.push_back(ks[i]);
+        }
+      }
+      if (new_ks.empty()) return;
+
+      capek_workspace& ws = workspace();
+      trial_generator trials(new_ks, max_reps, init_size, num_objects);
+      std::vector<typename id_pair<T>::vector>& all_medoids = ws.storage<T>(comm).medoids;
+      reset_vectors(all_medoids, trials.num_trials());
+      run_pam_trials(trials, objects, dmetric, all_medoids, offsets, comm);
+
+      // Go through all the trials again, and for each of them, find the closest 
+      // medoid to this process's objects and sum the squared dissimilarities
+      sum_trials(objects, dmetric, all_medoids, trials.count(), offsets[rank], true);
+      timer.record("FindMinima");
+
+      // Sum up all the min dissimilarities.  We do a Reduce/Bcast instead of an Allreduce
+      // to avoid FP error and guarantee that sums is the same across all processors.
+      std::vector<double>& sums = ws.sums;         // destination vectors for reduction.
+      sums.resize(ws.dissimilarities.size());
+      ws.sizes.resize(ws.cluster_sizes.size());
+
+      CMPI_Reduce(&ws.dissimilarities[0], &sums[0], sums.size(), MPI_DOUBLE, MPI_SUM, 0, comm);
+      CMPI_Bcast(&sums[0], sums.size(), MPI_DOUBLE, 0, comm);
+      CMPI_Allreduce(&ws.cluster_sizes[0], &ws.sizes[0], ws.sizes.size(), MPI_SIZE_T, MPI_SUM, comm);
+      timer.record("GlobalSums");
+
+      score_trials(all_medoids, trials.count(), dimensionality, num_objects, state);
+    }
+
+    ///
+    /// Finds the closest medoid in each trial to each local object, and sums up locally what 
+    /// it takes to judge the trials.  In the workspace, dissimilarities gets the dissimilarity
+    /// sum for each trial.  If scored, it then gets the squared dissimilarity sum for each 
+    /// medoid of each trial, and with the silhouette criterion, the medoid silhouette sum for 
+    /// each trial after that; cluster_sizes gets the size of each medoid's cluster.  
+    /// cluster_ids gets local cluster ids for each trial.  Sum these over all processes into 
+    /// sums and sizes, then call finish_capek() or score_trials().
+    ///
+    template <class Objects, class D>
+    void sum_trials(const Objects& objects, D dmetric, 
+                    const std::vector<typename id_pair<typename Objects::value_type>::vector>& all_medoids,
+                    size_t num_trials, object_id first_oid, bool scored)
+    {
+      capek_workspace& ws = workspace();
+      const bool silhouette = scored && (criterion == silhouette_criterion);
+
+      size_t total_medoids = 0;
+      for (size_t i=0; i < num_trials; i++) {
+        total_medoids += all_medoids[i].size();
+      }
+
+      std::vector<double>& local_sums = ws.dissimilarities;
+      local_sums.assign(num_trials + (scored ? total_medoids : 0) + (silhouette ? num_trials : 0), 0.0);
+      ws.cluster_sizes.assign(scored ? total_medoids : 0, 0);
+      reset_vectors(ws.cluster_ids, num_trials);
+
+      size_t trial_offset = 0;   // offset of this trial's medoids in cluster_sizes
+      for (size_t i=0; i < num_trials; i++) {
+        closest_medoids(objects, first_oid, all_medoids[i], dmetric, ws.nearest);
+        for (size_t o=0; o < objects.size(); o++) {
+          const nearest_two& closest = ws.nearest[o];
+          local_sums[i] += closest.d1;
+          if (scored) {
+            local_sums[num_trials + trial_offset + closest.m1] += closest.d1 * closest.d1;
+            ws.cluster_sizes[trial_offset + closest.m1] += 1;
+          }
+          if (silhouette) {
+            local_sums[num_trials + total_medoids + i] += medoid_silhouette(closest.d1, closest.d2);
+          }
+          ws.cluster_ids[i].push_back(closest.m1);
+        }
+        trial_offset += all_medoids[i].size();
+      }
+    }
+
+    ///
+    /// Scores the trials that sum_trials() summed with scored set, once the workspace's sums 
+    /// and sizes hold the global sums, and records them in state.
+    ///
+    template <class T>
+    void score_trials(const std::vector< std::vector< id_pair<T> > >& all_medoids, size_t num_trials,
+                      size_t dimensionality, size_t num_objects, k_search_state<T>& state)
+    {
+      capek_workspace& ws = workspace();
+      const std::vector<double>& sums = ws.sums;
+      const size_t total_medoids = ws.sizes.size();
+      const bool silhouette = (criterion == silhouette_criterion);
+
       // find minmum global dissimilarity among all trials.
-      std::vector<double>::iterator min_sum = std::min_element(sums.begin(), sums.end());
-      total_dissimilarity = *min_sum;
-      size_t best = (min_sum - sums.begin());  // index of best trial.
+      state.min_dissimilarity = std::min(state.min_dissimilarity, 
+                                         *std::min_element(sums.begin(), sums.begin() + num_trials));
 
       // locally calculate the BIC for each trial
-      size_t best_trial = 0;
-      best_bic_score    = -DBL_MAX;
-
       size_t trial_offset = 0;  // offset into sizes array
-      for (size_t i=0; i < trials.count(); i++) {
+      for (size_t i=0; i < num_trials; i++) {
         size_t k = all_medoids[i].size();
-        double cur_bic = bic(k, &sizes[trial_offset], &sums2[trial_offset], dimensionality);
-        if (cur_bic > best_bic_score) {
-          best_trial     = i;
-          best_bic_score = cur_bic;
+        double cur_bic = silhouette 
+          ? sums[num_trials + total_medoids + i] / num_objects
+          : bic(k, &ws.sizes[trial_offset], &sums[num_trials + trial_offset], dimensionality);
+
+        std::map<size_t, double>::iterator score = state.scores.find(k);
+        if (score == state.scores.end()) {
+          state.scores[k] = cur_bic;
+        } else {
+          score->second = std::max(score->second, cur_bic);
+        }
+
+        // keep the first trial if no score beats -DBL_MAX, e.g. a BIC of -inf for k = 1.
+        if (cur_bic > state.best_score || state.best_medoids.empty()) {
+          state.best_score = cur_bic;
+          state.best_medoids = all_medoids[i];
+          state.best_cluster_ids.swap(ws.cluster_ids[i]);
         }
         trial_offset += k;
       }
-      
-      best = best_trial;
+    }
 
-      // Finally set up the partition to correspond to best trial found.
-      medoid_ids.resize(all_medoids[best].size());
+    ///
+    /// Sets up capek()'s partition from the trial with the least dissimilarity, once the 
+    /// workspace's sums hold the global sums from sum_trials().
+    ///
+    template <class T>
+    void finish_capek(const std::vector< std::vector< id_pair<T> > >& all_medoids, size_t num_trials,
+                      size_t num_objects, std::vector<T> *medoids) 
+    {
+      capek_workspace& ws = workspace();
+
+      // find minmum global dissimilarity among all trials.
+      std::vector<double>::iterator min_sum = std::min_element(ws.sums.begin(), ws.sums.begin() + num_trials);
+      total_dissimilarity = *min_sum;
+      reference_dissimilarity = num_objects ? total_dissimilarity / num_objects : 0;
+      size_t best = (min_sum - ws.sums.begin());  // index of best trial.
+
+      set_best_partition(all_medoids[best], ws.cluster_ids[best], medoids);
+    }
+
+    /// Sets up xcapek()'s partition and scores from the best trial in state.
+    template <class T>
+    void finish_xcapek(k_search_state<T>& state, size_t num_objects, std::vector<T> *medoids) {
+      k_scores.swap(state.scores);
+      total_dissimilarity = state.min_dissimilarity;
+      reference_dissimilarity = num_objects ? total_dissimilarity / num_objects : 0;
+      best_bic_score = state.best_score;
+
+      set_best_partition(state.best_medoids, state.best_cluster_ids, medoids);
+    }
+
+    ///
+    /// Sets up the partition from a trial's medoids, sorted by object id, and its local cluster 
+    /// ids, which are swapped in.  Copies the medoids to medoids, if it isn't NULL.
+    ///
+    template <class T>
+    void set_best_partition(const std::vector< id_pair<T> >& best_medoids, 
+                            std::vector<medoid_id>& best_cluster_ids, std::vector<T> *medoids)
+    {
+      medoid_ids.resize(best_medoids.size());
       for (size_t i = 0; i < medoid_ids.size(); i++) {
-        medoid_ids[i] = all_medoids[best][i].id;
+        medoid_ids[i] = best_medoids[i].id;
       }
 
-      // Make an indirection vector from the unsorted to sorted medoids.
+      // Make an indirection vector from the unsorted to sorted medoids
       std::vector<size_t> mapping(medoid_ids.size());
       std::generate(mapping.begin(), mapping.end(), sequence());
       std::sort(mapping.begin(), mapping.end(), indexed_lt(medoid_ids));
@@ -534,39 +1396,183 @@ namespace cluster {
 
       // set up local cluster ids, medoids, and medoid_ids with the sorted mapping.
       for (size_t i=0; i < medoid_ids.size(); i++) {
-        medoid_ids[i] = all_medoids[best][mapping[i]].id;
+        medoid_ids[i] = best_medoids[mapping[i]].id;
       }
 
-      // swap in the cluster ids with the best BIC score.
-      cluster_ids.swap(all_cluster_ids[best]);
+      // swap in the cluster ids of the best trial.
+      cluster_ids.swap(best_cluster_ids);
 
-      // if the user wanted a copy of the medoids, copy them into the dstination array.
+      // if the caller wanted a copy of the medoids, copy them into the dstination array.
       if (medoids) {
         medoids->resize(medoid_ids.size());
         for (size_t i=0; i < medoid_ids.size(); i++) {
-          (*medoids)[i] = all_medoids[best][mapping[i]].element;
+          (*medoids)[i] = best_medoids[mapping[i]].element;
         }
       }
+    }
 
-      timer.record("BicScore");
-      return best_bic_score;
-    }    
-    
-    /// Get the Timer with info on the last run of either capek() or xcapek().
-    const Timer& get_timer() { return timer; }
+    /// Distance between the elements of two id_pairs, for clustering id_pairs with capek().
+    template <class D>
+    struct element_distance {
+      D dmetric;
+      element_distance(D d) : dmetric(d) { }
+
+      template <class T>
+      double operator()(const id_pair<T>& a, const id_pair<T>& b) {
+        return dmetric(a.element, b.element);
+      }
+    };
+
+    ///
+    /// Splits each cluster in active in two for xbisect(), with capek() on a subcommunicator
+    /// of the processes.  position[c] is the position of cluster c in active, or -1.  On return,
+    /// every process has the two medoids for active[a] in halves[2a] and halves[2a+1].
+    ///
+    template <class Objects, class D>
+    void bisect_clusters(const Objects& objects, D dmetric, const std::vector<size_t>& active,
+                         const std::vector<long>& position, const std::vector<size_t>& local_cluster,
+                         const std::vector<size_t>& offsets,
+                         typename id_pair<typename Objects::value_type>::vector& halves)
+    {
+      typedef typename Objects::value_type T;
+
+      int size, rank;
+      CMPI_Comm_size(comm, &size);
+      CMPI_Comm_rank(comm, &rank);
+
+      // Group g is processes g, g + groups, g + 2*groups, ..., so process g is its root.
+      const size_t groups = std::min<size_t>(size, active.size());
+      const size_t group = rank % groups;
+
+      MPI_Comm group_comm;
+      CMPI_Comm_split(comm, group, rank, &group_comm);
+
+      std::vector<uint32_t> seeds(active.size());
+      for (size_t a=0; a < active.size(); a++) seeds[a] = random();
+
+      halves.resize(2 * active.size());
+      for (size_t first=0; first < active.size(); first += groups) {
+        // send members of active[first + g] round-robin to the processes in group g.
+        std::vector< std::pair<int, size_t> > sends;   // destination, local object
+        std::vector<size_t> sent(groups, 0);
+        for (size_t o=0; o < objects.size(); o++) {
+          long a = position[local_cluster[o]];
+          if (a < (long)first || a >= (long)(first + groups)) continue;
+
+          size_t g = a - first;
+          size_t group_size = (size - g + groups - 1) / groups;
+          int dest = g + ((sent[g]++ + rank) % group_size) * groups;
+          sends.push_back(std::make_pair(dest, o));
+        }
+        std::sort(sends.begin(), sends.end());
+
+        typename id_pair<T>::vector outgoing;
+        std::vector<int> send_counts(size, 0);
+        for (size_t i=0; i < sends.size(); i++) {
+          object_id oid = offsets[rank] + sends[i].second;
+          outgoing.push_back(make_id_pair(objects[sends[i].second], oid));
+          send_counts[sends[i].first] += outgoing.back().packed_size(comm);
+        }
+
+        std::vector<int> recv_counts(size);
+        CMPI_Alltoall(&send_counts[0], 1, MPI_INT, &recv_counts[0], 1, MPI_INT, comm);
+
+        std::vector<int> send_displs(size, 0), recv_displs(size, 0);
+        for (int p=1; p < size; p++) {
+          send_displs[p] = send_displs[p-1] + send_counts[p-1];
+          recv_displs[p] = recv_displs[p-1] + recv_counts[p-1];
+        }
+        int send_size = send_displs[size-1] + send_counts[size-1];
+        int recv_size = recv_displs[size-1] + recv_counts[size-1];
+
+        std::vector<char>& send_buf = *workspace().buffers.acquire(std::max(send_size, 1));
+        std::vector<char>& recv_buf = *workspace().buffers.acquire(std::max(recv_size, 1));
+        int pos = 0;
+        for (size_t i=0; i < outgoing.size(); i++) {
+          outgoing[i].pack(&send_buf[0], send_size, &pos, comm);
+        }
+        CMPI_Alltoallv(&send_buf[0], &send_counts[0], &send_displs[0], MPI_PACKED,
+                       &recv_buf[0], &recv_counts[0], &recv_displs[0], MPI_PACKED, comm);
+
+        typename id_pair<T>::vector members;
+        pos = 0;
+        while (pos < recv_size) {
+          members.push_back(id_pair<T>::unpack(&recv_buf[0], recv_size, &pos, comm));
+        }
+        workspace().buffers.release(&send_buf);
+        workspace().buffers.release(&recv_buf);
+        timer.record("MoveMembers");
+
+        // each group splits its cluster.
+        const size_t mine = first + group;
+        if (mine < active.size()) {
+          par_kmedoids splitter(group_comm);
+          splitter.set_seed(seeds[mine]);
+          splitter.set_init_size(init_size);
+          splitter.set_max_reps(max_reps);
+          splitter.set_epsilon(epsilon);
+
+          std::vector< id_pair<T> > split;
+          splitter.capek(members, element_distance<D>(dmetric), 2, &split);
+          halves[2*mine]     = split[0];
+          halves[2*mine + 1] = split[1];
+        }
+
+        // roots send their medoids to everyone.
+        for (size_t a=first; a < std::min(active.size(), first + groups); a++) {
+          int root = a - first;
+          int packed_size = 0;
+          std::vector<char> buf;
+          if (rank == root) {
+            packed_size = halves[2*a].packed_size(comm) + halves[2*a + 1].packed_size(comm);
+            buf.resize(packed_size);
+            int position = 0;
+            halves[2*a].pack(&buf[0], packed_size, &position, comm);
+            halves[2*a + 1].pack(&buf[0], packed_size, &position, comm);
+          }
+          CMPI_Bcast(&packed_size, 1, MPI_INT, root, comm);
+          buf.resize(packed_size);
+          CMPI_Bcast(&buf[0], packed_size, MPI_PACKED, root, comm);
+          if (rank != root) {
+            int position = 0;
+            halves[2*a]     = id_pair<T>::unpack(&buf[0], packed_size, &position, comm);
+            halves[2*a + 1] = id_pair<T>::unpack(&buf[0], packed_size, &position, comm);
+          }
+        }
+      }
+      CMPI_Comm_free(&group_comm);
+    }
 
-  protected:
     typedef boost::mt19937 random_t;   ///< Type for random number generator used here.
     random_t random;                   ///< Random number distribution to be used for samples
     bool seed_set;                     /// Track whether the random seed has been set
     
     double total_dissimilarity;   ///< Total dissimilarity bt/w objects and medoids for last clustering.
-    double best_bic_score;        ///< BIC score for the clustering found.
+    double reference_dissimilarity;   ///< Average dissimilarity when trials last ran, or -1, for recapek().
+    double best_bic_score;        ///< BIC score (or silhouette) for the clustering found.
+    k_criterion criterion;        ///< How xcapek() chooses k.
+    k_search_strategy search;     ///< Which k values xcapek() evaluates.
+    size_t patience;              ///< k values without improvement before exhaustive search stops.
+    std::map<size_t, double> k_scores;  ///< Best score for each k in the last xcapek().
     size_t init_size;             ///< baseline size for samples
     size_t max_reps;              ///< Max repetitions of trials for a particular k.
     double epsilon;               ///< Tolerance for convergence tests in kmedoids PAM runs.
 
     Timer timer;                  ///< Performance timer.
+    capek_workspace own_workspace;        ///< Buffers and worker state kept between calls.
+    capek_workspace *shared_workspace;    ///< Workspace supplied with set_workspace(), or NULL.
+
+    /// Storage for this call: the shared workspace if there is one, else our own.
+    capek_workspace& workspace() {
+      return shared_workspace ? *shared_workspace : own_workspace;
+    }
+
+    /// Resize a vector of vectors to size, emptying the inner vectors but keeping their storage.
+    template <class V>
+    static void reset_vectors(std::vector<V>& vectors, size_t size) {
+      vectors.resize(size);
+      for (size_t i=0; i < size; i++) vectors[i].clear();
+    }
 
     /// 
     /// Seeds random number generators across all processes with the same number,
@@ -575,29 +1581,98 @@ namespace cluster {
     void seed_random_uniform(MPI_Comm comm);
 
     ///
-    /// Find the closest object in the medoids vector to the object passed in.
-    /// Returns a pair of the closest medoid's id and its distance from the object.
+    /// Non-blocking start of seed_random_uniform().  Once req completes, every process has the
+    /// same seed, to pass to set_seed().  seed must stay valid until then.
+    ///
+    void start_uniform_seed(uint32_t& seed, MPI_Comm comm, MPI_Request *req);
+
+    ///
+    /// Collectively computes where each process's objects fall in the global numbering.
+    /// On return, offsets has size+1 entries and process p owns global object ids
+    /// [offsets[p], offsets[p+1]).  offsets.back() is the total number of objects.
+    ///
+    void object_offsets(size_t local_count, std::vector<size_t>& offsets, MPI_Comm comm);
+
+    ///
+    /// Non-blocking start of object_offsets().  Once req completes, finish_object_offsets() 
+    /// makes offsets what object_offsets() would.  local_count must stay valid until then.
+    ///
+    static void start_object_offsets(const size_t& local_count, std::vector<size_t>& offsets, 
+                                     MPI_Comm comm, MPI_Request *req);
+
+    /// Turns the object counts gathered by start_object_offsets() into offsets.
+    static void finish_object_offsets(std::vector<size_t>& offsets);
+
+    ///
+    /// Local indices of the sampled objects this process owns.  sample_ids holds sorted global
+    /// ids; on return, indices holds id - offsets[rank] for each id in [offsets[rank], 
+    /// offsets[rank+1]), in order.
+    ///
+    static void local_indices(const std::vector<size_t>& sample_ids, const std::vector<size_t>& offsets,
+                              int rank, std::vector<size_t>& indices);
+
+    ///
+    /// Find the closest and second-closest medoids to each of this process's objects.  Dispatches
+    /// the nearest-medoid search on k once, and loops over all the objects inside it.
     /// 
-    /// @param[in] object   Object to compare to medoids.
-    /// @param[in] oid      ID of the object (need this so medoids prefer themselves as their own medoids).
-    /// @param[in] medoids  Vector of medoids to find the closest from.
-    /// @param[in] dmetric  Distance metric to assess closeness with.
-    ///
-    template <typename T, typename D>
-    std::pair<double, size_t> closest_medoid(
-      const T& object, object_id oid, const std::vector< id_pair<T> >& medoids, D dmetric
+    /// @param[in]  objects    This process's objects.
+    /// @param[in]  first_oid  Global ID of objects[0] (need this so medoids prefer themselves as 
+    ///                        their own medoids).
+    /// @param[in]  medoids    Vector of medoids to find the closest from.
+    /// @param[in]  dmetric    Distance metric to assess closeness with.
+    /// @param[out] nearest    On return, nearest[o] holds the distances to and indices in medoids
+    ///                        of the two medoids closest to objects[o].
+    ///
+    template <class Objects, typename T, typename D>
+    void closest_medoids(
+      const Objects& objects, object_id first_oid, const std::vector< id_pair<T> >& medoids, D dmetric,
+      std::vector<nearest_two>& nearest
     ) {
-      double min_distance = DBL_MAX;
-      size_t min_id = medoids.size();
-      for (size_t m=0; m < medoids.size(); m++) {
-        double d = dmetric(medoids[m].element, object);
-        if (d < min_distance || medoids[m].id == oid) { // prefer actual medoid as closest
-          min_distance = d;
-          min_id = m;
+      nearest.assign(objects.size(), nearest_two(medoids.size()));
+      closest_kernel<Objects, T, D> kernel(objects, first_oid, medoids, dmetric, nearest);
+      with_nearest_search(medoids.size(), kernel);
+    }
+
+    /// Medoids as candidates for the nearest medoids of objects[o].
+    template <class Objects, typename T, typename D>
+    struct closest_candidates {
+      const Objects& objects;
+      size_t o;
+      object_id oid;
+      const std::vector< id_pair<T> >& medoids;
+      D& dmetric;
+
+      closest_candidates(const Objects& objs, size_t obj, object_id id, 
+                         const std::vector< id_pair<T> >& meds, D& d)
+        : objects(objs), o(obj), oid(id), medoids(meds), dmetric(d) { }
+
+      void operator()(size_t m, nearest_two& nearest) {
+        // prefer actual medoid as closest
+        nearest.consider(m, dmetric(medoids[m].element, objects[o]), medoids[m].id == oid);
+      }
+    };
+
+    /// Loop of closest_medoids(), run with the nearest-medoid search for this k.
+    template <class Objects, typename T, typename D>
+    struct closest_kernel {
+      const Objects& objects;
+      object_id first_oid;
+      const std::vector< id_pair<T> >& medoids;
+      D& dmetric;
+      std::vector<nearest_two>& nearest;
+
+      closest_kernel(const Objects& objs, object_id first, const std::vector< id_pair<T> >& meds, 
+                     D& d, std::vector<nearest_two>& n)
+        : objects(objs), first_oid(first), medoids(meds), dmetric(d), nearest(n) { }
+
+      template <class Search>
+      void operator()(const Search& search) {
+        for (size_t o=0; o < objects.size(); o++) {
+          closest_candidates<Objects, T, D> candidates(objects, o, first_oid + o, medoids, dmetric);
+          search.find(candidates, nearest[o]);
         }
       }
-      return std::make_pair(min_distance, min_id);
-    }
+    };
 
   };
 
@@ -65,14 +65,6 @@ namespace cluster {
            << ", expected " << count << endl;
       exit(1);
     }
-    
-    size_t object_count = cluster_ids.size();
-    CMPI_Bcast(&object_count, 1, MPI_SIZE_T, root, comm);    
-    if (object_count != cluster_ids.size()) {
-      cerr << "Error: incorrect number of objects on " << rank << ": " << cluster_ids.size() 
-           << ", expected " << object_count << endl;
-      exit(1);
-    }
 
     std::vector<object_id> bcast_medoid_ids = medoid_ids;
     CMPI_Bcast(&bcast_medoid_ids[0], bcast_medoid_ids.size(), MPI_SIZE_T, root, comm);
@@ -84,14 +76,22 @@ namespace cluster {
     }
 #endif // DEBUG
     
+    // processes may own different numbers of objects.
+    int local_count = cluster_ids.size();
+    vector<int> counts(size), displs(size);
+    CMPI_Gather(&local_count, 1, MPI_INT, &counts[0], 1, MPI_INT, root, comm);
+
     if (rank == root) {
+      for (int i=1; i < size; i++) {
+        displs[i] = displs[i-1] + counts[i-1];
+      }
       destination.medoid_ids = medoid_ids;
-      destination.cluster_ids.resize(cluster_ids.size() * size);
+      destination.cluster_ids.resize(displs[size-1] + counts[size-1]);
     }
 
-    CMPI_Gather(&cluster_ids[0],             cluster_ids.size(), MPI_SIZE_T,
-                &destination.cluster_ids[0], cluster_ids.size(), MPI_SIZE_T, 
-                root, comm);
+    CMPI_Gatherv(&cluster_ids[0], local_count, MPI_SIZE_T,
+                 &destination.cluster_ids[0], &counts[0], &displs[0], MPI_SIZE_T, 
+                 root, comm);
   }
 
 
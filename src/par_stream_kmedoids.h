@@ -0,0 +1,395 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_stream_kmedoids.h
+/// @brief Sliding-window clustering of objects that arrive continuously on each process.
+///
+#ifndef MUSTER_PAR_STREAM_KMEDOIDS_H
+#define MUSTER_PAR_STREAM_KMEDOIDS_H
+
+#include <mpi.h>
+#include <vector>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+
+#include "kmedoids.h"
+#include "dissimilarity.h"
+#include "mpi_bindings.h"
+#include "unpack.h"
+#include "packable_vector.h"
+#include "gather.h"
+
+namespace cluster {
+
+  ///
+  /// MPI-packable object plus the number of objects it stands for.
+  ///
+  /// @tparam T Type of contained element.  
+  ///           T Must support MPI pack(), packed_size(), and unpack() methods.
+  ///
+  template <class T>
+  struct weighted_object {
+    T element;       ///< The representative object.
+    double weight;   ///< Number of objects it represents; need not be integral.
+
+    weighted_object() : weight(0) { }
+    weighted_object(const T& elt, double w) : element(elt), weight(w) { }
+
+    int packed_size(MPI_Comm comm) const {
+      return element.packed_size(comm) + cmpi_packed_size(1, MPI_DOUBLE, comm);
+    }
+
+    void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const {
+      element.pack(buf, bufsize, position, comm);
+      CMPI_Pack(const_cast<double*>(&weight), 1, MPI_DOUBLE, buf, bufsize, position, comm);
+    }
+
+    static weighted_object unpack(void *buf, int bufsize, int *position, MPI_Comm comm) {
+      weighted_object w;
+      w.unpack_from(buf, bufsize, position, comm);
+      return w;
+    }
+
+    /// Unpack into this object.  The element is unpacked in place if T supports it.
+    void unpack_from(void *buf, int bufsize, int *position, MPI_Comm comm) {
+      unpack_into(element, buf, bufsize, position, comm);
+      CMPI_Unpack(buf, bufsize, position, &weight, 1, MPI_DOUBLE, comm);
+    }
+  };
+
+
+  ///
+  /// Clusters a sliding window of objects that arrive continuously on each process, 
+  /// without keeping the objects themselves.
+  ///
+  /// Each process keeps a summary of its window as weighted representative objects.  The
+  /// window is divided into panes of pane_size objects, and only the last window_panes panes
+  /// are kept, so old objects expire a pane at a time.  Within a pane, each new object starts
+  /// as its own representative; whenever a pane has 2*summary_size representatives, weighted
+  /// PAM collapses them to summary_size, each with the total weight of its cluster.  Memory 
+  /// per process is thus O(window_panes * summary_size) objects however long the stream is.
+  ///
+  /// update() recomputes the global medoids from the summaries.  Each process collapses its
+  /// panes into one summary of at most summary_size objects, the summaries are gathered to 
+  /// rank 0, which clusters them with weighted PAM (or weighted CLARA, if there are more than
+  /// max_pam_size of them), and the k medoids are broadcast.  Communication per update is 
+  /// O(summary_size) objects per process, and O(k) from the root.
+  ///
+  /// <b>Example:</b>
+  /// @code
+  /// par_stream_kmedoids<point, point_distance> stream(MPI_COMM_WORLD, point_distance(), k, 20, 1000, 10);
+  /// for (size_t step=0; ; step++) {
+  ///   for (...) stream.add(p);         // local, no communication
+  ///   if (step % 10 == 0) {
+  ///     stream.update();               // collective
+  ///     size_t c = stream.nearest(p);  // index into stream.medoids()
+  ///   }
+  /// }
+  /// @endcode
+  ///
+  /// @tparam T  Object type.  Must be default-constructible and support packed_size(), 
+  ///            pack() and unpack() like objects for par_kmedoids::capek().
+  /// @tparam D  Dissimilarity metric callable on (T, T).
+  ///
+  template <class T, class D>
+  class par_stream_kmedoids {
+  public:
+    ///
+    /// Constructor.  Not collective, but all processes should use the same parameters.
+    ///
+    /// @param comm           Processes that share the global medoids.
+    /// @param dmetric        Distance metric for objects.
+    /// @param k              Number of global medoids to find.
+    /// @param summary_size   Representatives per pane and per process summary.  At least k.
+    /// @param pane_size      Objects per pane, or 0 to start new panes only in next_pane().
+    /// @param window_panes   Number of most recent panes in the window.
+    ///
+    par_stream_kmedoids(MPI_Comm comm, D dmetric, size_t k, size_t summary_size,
+                        size_t pane_size, size_t window_panes)
+      : comm(comm), dmetric(dmetric), k(k), summary_size(std::max(summary_size, k)), 
+        pane_size(pane_size), window_panes(std::max<size_t>(window_panes, 1)),
+        max_pam_size(2000), pane_open(false), total_weight(0), dissimilarity(0)
+    {
+      if (!k) {
+        throw std::logic_error("Error: par_stream_kmedoids needs k > 0.");
+      }
+    }
+
+    /// Seed the random number generator for weighted CLARA on the root.
+    void set_seed(unsigned long seed) { global.set_seed(seed); }
+
+    /// Above this many gathered representatives, update() uses weighted CLARA instead of PAM.
+    void set_max_pam_size(size_t size) { max_pam_size = size; }
+
+    ///
+    /// Add a local object to the current pane.  Not collective.
+    ///
+    void add(const T& object) {
+      if (!pane_open || (pane_size && panes.back().count >= pane_size)) {
+        open_pane();
+      }
+      pane& cur = panes.back();
+      cur.reps.push_back(object);
+      cur.weights.push_back(1);
+      cur.count++;
+
+      if (cur.reps.size() >= 2 * summary_size) {
+        compress(cur.reps, cur.weights, summary_size);
+      }
+    }
+
+    ///
+    /// Close the current pane, e.g. at the end of each timestep.  The next add() starts a 
+    /// new pane, expiring the oldest if the window is full.  Not collective.
+    ///
+    void next_pane() { pane_open = false; }
+
+    ///
+    /// Recompute the global medoids from all processes' window summaries.  Collective.
+    ///
+    void update() {
+      int rank;
+      CMPI_Comm_rank(comm, &rank);
+
+      // collapse the window into one local summary.
+      summary_reps.clear();
+      summary_weights.clear();
+      for (size_t p=0; p < panes.size(); p++) {
+        summary_reps.insert(summary_reps.end(), panes[p].reps.begin(), panes[p].reps.end());
+        summary_weights.insert(summary_weights.end(), panes[p].weights.begin(), panes[p].weights.end());
+      }
+      compress(summary_reps, summary_weights, summary_size);
+
+      outgoing.clear();
+      for (size_t i=0; i < summary_reps.size(); i++) {
+        outgoing.push_back(weighted_object<T>(summary_reps[i], summary_weights[i]));
+      }
+
+      // gather summaries to the root.
+      std::vector< packable_vector< weighted_object<T> > > summaries;
+      gather(make_packable_vector(&outgoing, false), summaries, comm, 0);
+
+      std::vector<char> packed;
+      if (rank == 0) {
+        cluster_summaries(summaries);
+
+        int packed_size = 0;
+        packable_vector<T> packable = make_packable_vector(&global_medoids, false);
+        packed_size = packable.packed_size(comm) + cmpi_packed_size(2, MPI_DOUBLE, comm);
+        packed.resize(packed_size);
+
+        int pos = 0;
+        packable.pack(&packed[0], packed_size, &pos, comm);
+        CMPI_Pack(&total_weight, 1, MPI_DOUBLE, &packed[0], packed_size, &pos, comm);
+        CMPI_Pack(&dissimilarity, 1, MPI_DOUBLE, &packed[0], packed_size, &pos, comm);
+      }
+
+      // broadcast the medoids.
+      int packed_size = packed.size();
+      CMPI_Bcast(&packed_size, 1, MPI_INT, 0, comm);
+      packed.resize(packed_size);
+      CMPI_Bcast(&packed[0], packed_size, MPI_PACKED, 0, comm);
+
+      if (rank != 0) {
+        int pos = 0;
+        packable_vector<T> packable = make_packable_vector(&global_medoids, false);
+        packable.unpack_from(&packed[0], packed_size, &pos, comm);
+        CMPI_Unpack(&packed[0], packed_size, &pos, &total_weight, 1, MPI_DOUBLE, comm);
+        CMPI_Unpack(&packed[0], packed_size, &pos, &dissimilarity, 1, MPI_DOUBLE, comm);
+      }
+    }
+
+    /// Global medoids from the last update(), at most k of them.
+    const std::vector<T>& medoids() const { return global_medoids; }
+
+    ///
+    /// Index in medoids() of the medoid nearest to object, for assigning new objects 
+    /// to clusters between updates.  Not collective.
+    ///
+    size_t nearest(const T& object) {
+      if (global_medoids.empty()) {
+        throw std::logic_error("Error: par_stream_kmedoids has no medoids before update().");
+      }
+      size_t best = 0;
+      double best_d = std::numeric_limits<double>::infinity();
+      for (size_t m=0; m < global_medoids.size(); m++) {
+        double d = dmetric(global_medoids[m], object);
+        if (d < best_d) {
+          best_d = d;
+          best = m;
+        }
+      }
+      return best;
+    }
+
+    ///
+    /// Average dissimilarity of summary representatives from their medoids, weighted by 
+    /// what they represent, as of the last update().  An estimate of the average 
+    /// dissimilarity of the objects in the window.
+    ///
+    double average_dissimilarity() const { return dissimilarity; }
+
+    /// Number of objects in all processes' windows as of the last update().
+    double window_weight() const { return total_weight; }
+
+    /// Number of objects in this process's window.
+    size_t local_count() const {
+      size_t count = 0;
+      for (size_t p=0; p < panes.size(); p++) count += panes[p].count;
+      return count;
+    }
+
+    /// Number of representatives this process keeps for its window.
+    size_t local_summary_size() const {
+      size_t size = 0;
+      for (size_t p=0; p < panes.size(); p++) size += panes[p].reps.size();
+      return size;
+    }
+
+  private:
+    /// Weighted representatives of the objects added to one pane.
+    struct pane {
+      std::vector<T> reps;            ///< Representative objects.
+      std::vector<double> weights;    ///< Objects each representative stands for.
+      size_t count;                   ///< Objects added to this pane.
+
+      pane() : count(0) { }
+
+      void clear() {
+        reps.clear();
+        weights.clear();
+        count = 0;
+      }
+
+      void swap(pane& other) {
+        reps.swap(other.reps);
+        weights.swap(other.weights);
+        std::swap(count, other.count);
+      }
+    };
+
+    MPI_Comm comm;                 ///< Processes sharing the global medoids.
+    D dmetric;                     ///< Distance metric for objects.
+    size_t k;                      ///< Number of global medoids.
+    size_t summary_size;           ///< Representatives per pane and per summary.
+    size_t pane_size;              ///< Objects per pane, or 0.
+    size_t window_panes;           ///< Panes kept in the window.
+    size_t max_pam_size;           ///< Largest gathered summary clustered with PAM.
+
+    std::deque<pane> panes;        ///< Panes in the window, oldest first.
+    bool pane_open;                ///< Whether add() can add to the last pane.
+    std::vector<T> global_medoids; ///< Medoids from the last update().
+    double total_weight;           ///< Objects in the window at the last update().
+    double dissimilarity;          ///< Weighted average dissimilarity at the last update().
+
+    kmedoids compressor;                       ///< Collapses panes and summaries.
+    kmedoids global;                           ///< Clusters gathered summaries on the root.
+    dissimilarity_matrix scratch;              ///< Matrix for compress().
+    std::vector<T> summary_reps;               ///< Local summary for update().
+    std::vector<double> summary_weights;       ///< Weights of summary_reps.
+    std::vector< weighted_object<T> > outgoing; ///< Local summary, packable.
+
+    /// Start a new pane, recycling the oldest one's storage if the window is full.
+    void open_pane() {
+      if (panes.size() < window_panes) {
+        panes.push_back(pane());
+      } else {
+        // recycle the expired pane's storage.
+        panes.push_back(pane());
+        panes.back().swap(panes.front());
+        panes.pop_front();
+        panes.back().clear();
+      }
+      pane_open = true;
+    }
+
+    ///
+    /// Collapse reps to at most size weighted representatives with weighted PAM.  Each
+    /// medoid takes the total weight of its cluster.
+    ///
+    void compress(std::vector<T>& reps, std::vector<double>& weights, size_t size) {
+      if (reps.size() <= size) return;
+
+      build_dissimilarity_matrix(reps, dmetric, scratch);
+      compressor.pam(scratch, weights, size);
+
+      std::vector<double> merged(compressor.medoid_ids.size(), 0.0);
+      for (size_t i=0; i < reps.size(); i++) {
+        merged[compressor.cluster_ids[i]] += weights[i];
+      }
+      for (size_t m=0; m < compressor.medoid_ids.size(); m++) {
+        reps[m] = reps[compressor.medoid_ids[m]];   // medoid ids are sorted, so m <= medoid_ids[m].
+      }
+      reps.resize(merged.size());
+      weights.swap(merged);
+    }
+
+    ///
+    /// Cluster the gathered summaries into global_medoids, on the root.
+    ///
+    void cluster_summaries(const std::vector< packable_vector< weighted_object<T> > >& summaries) {
+      std::vector<T> reps;
+      std::vector<double> weights;
+      for (size_t p=0; p < summaries.size(); p++) {
+        const std::vector< weighted_object<T> >& summary = *summaries[p]._packables;
+        for (size_t i=0; i < summary.size(); i++) {
+          reps.push_back(summary[i].element);
+          weights.push_back(summary[i].weight);
+        }
+      }
+
+      total_weight = 0;
+      for (size_t i=0; i < weights.size(); i++) total_weight += weights[i];
+
+      global_medoids.clear();
+      dissimilarity = 0;
+      if (reps.empty()) return;
+
+      const size_t my_k = std::min(k, reps.size());
+      if (reps.size() > max_pam_size) {
+        global.clara(reps, weights, dmetric, my_k);
+      } else {
+        build_dissimilarity_matrix(reps, dmetric, scratch);
+        global.pam(scratch, weights, my_k);
+      }
+
+      for (size_t m=0; m < global.medoid_ids.size(); m++) {
+        global_medoids.push_back(reps[global.medoid_ids[m]]);
+      }
+      dissimilarity = global.average_dissimilarity();
+    }
+  };
+
+} // namespace cluster
+
+#endif // MUSTER_PAR_STREAM_KMEDOIDS_H
@@ -0,0 +1,306 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file quantized_matrix.h
+/// @brief Compressed dissimilarity matrices that store each entry in 16 or 8 bits.
+///
+/// A packed double matrix for n objects takes 4n^2 bytes.  PAM only needs distances
+/// accurate enough to rank candidate swaps, so storing each entry as a small integer
+/// with a per-block (or global) scale and offset gives 4x (or 8x) more objects per node
+/// for the same memory, with a bounded absolute error per entry.
+///
+/// Quantized matrices have the same accessor interface as dissimilarity_matrix 
+/// (<code>size1()</code>, <code>size2()</code>, <code>operator()(i,j)</code>), so 
+/// kmedoids::pam(), kmedoids::xpam(), and bic() can run on them directly.
+///
+#ifndef QUANTIZED_MATRIX_H
+#define QUANTIZED_MATRIX_H
+
+#include <stdint.h>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include "dissimilarity.h"
+
+namespace cluster {
+
+  ///
+  /// Symmetric matrix of doubles stored as unsigned integers of type Q.
+  ///
+  /// The lower triangle is stored packed by rows.  Rows are grouped into blocks, and 
+  /// each block has its own offset and scale, so entry (i,j) with i >= j decodes to
+  /// <code>offset[block(i)] + scale[block(i)] * q(i,j)</code>.  One block spanning all 
+  /// rows gives a single global scale; smaller blocks track local distance ranges more 
+  /// closely at the cost of two doubles per block.
+  ///
+  /// Entries are read-only once built: use build_dissimilarity_matrix() or quantize()
+  /// to fill one in.
+  ///
+  template <typename Q>
+  class basic_quantized_matrix {
+  public:
+    typedef double value_type;    ///< Type entries decode to.
+    typedef Q      storage_type;  ///< Type entries are stored as.
+
+    /// Largest quantized value.
+    static Q max_level() { return std::numeric_limits<Q>::max(); }
+
+    ///
+    /// Construct an empty matrix.  block_rows is the number of rows per scale block,
+    /// rounded up to a power of two; zero means use one global scale.
+    ///
+    explicit basic_quantized_matrix(size_t block_rows = 0) : size_(0) {
+      set_block_rows(block_rows);
+    }
+
+    size_t size1() const { return size_; }
+    size_t size2() const { return size_; }
+
+    /// Decoded value of entry (i,j).
+    double operator()(size_t i, size_t j) const {
+      if (i < j) std::swap(i, j);
+      const size_t b = i >> block_shift_;
+      return offset_[b] + scale_[b] * data_[index(i, j)];
+    }
+
+    /// Raw quantized value of entry (i,j).
+    Q level(size_t i, size_t j) const {
+      if (i < j) std::swap(i, j);
+      return data_[index(i, j)];
+    }
+
+    /// Rows per scale block (a power of two), or 0 for a single global scale.
+    size_t block_rows() const {
+      return global() ? 0 : ((size_t)1 << block_shift_);
+    }
+
+    /// Largest possible absolute difference between a decoded and an original entry.
+    double max_error() const {
+      double max_scale = 0;
+      for (size_t b=0; b < scale_.size(); b++) {
+        max_scale = std::max(max_scale, scale_[b]);
+      }
+      return max_scale / 2;
+    }
+
+    /// Bytes of storage used by entries and scale factors.
+    size_t bytes() const {
+      return data_.size() * sizeof(Q) + (offset_.size() + scale_.size()) * sizeof(double);
+    }
+
+    ///
+    /// Resize to n objects and fill in entries from a function that computes, for a 
+    /// range of rows, all distances in the lower triangle.
+    ///
+    /// @param n     Number of objects.
+    /// @param rows  Callable as rows(first, last, double *out), which writes the entries
+    ///              (i, 0..i) for each i in [first, last), in order, to out.
+    ///
+    template <class RowFunction>
+    void assign(size_t n, RowFunction rows) {
+      size_ = n;
+      std::vector<Q>(n * (n + 1) / 2).swap(data_);
+
+      const size_t num_blocks = global() ? 1 : (n + block_size() - 1) >> block_shift_;
+      std::vector<double>(num_blocks, 0.0).swap(offset_);
+      std::vector<double>(num_blocks, 0.0).swap(scale_);
+
+      if (global()) {
+        // One scale for everything: need the global range before quantizing anything.
+        // Compute it a row at a time so that we never hold more than one row of doubles.
+        std::vector<double> row(n);
+        double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+        for (size_t i=0; i < n; i++) {
+          rows(i, i+1, &row[0]);
+          range(&row[0], &row[0] + i + 1, &lo, &hi);
+        }
+        set_scale(0, lo, hi);
+        for (size_t i=0; i < n; i++) {
+          rows(i, i+1, &row[0]);
+          encode(0, &row[0], &row[0] + i + 1, &data_[index(i, 0)]);
+        }
+
+      } else {
+        // Per-block scales: compute each block's rows once, then quantize them.
+        std::vector<double> values;
+        for (size_t b=0; b < num_blocks; b++) {
+          const size_t first = b << block_shift_;
+          const size_t last  = std::min(n, first + block_size());
+          const size_t count = index(last, 0) - index(first, 0);
+          values.resize(count);
+          rows(first, last, &values[0]);
+
+          double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+          range(values.begin(), values.end(), &lo, &hi);
+          set_scale(b, lo, hi);
+          encode(b, values.begin(), values.end(), &data_[index(first, 0)]);
+        }
+      }
+    }
+
+    /// Exchange contents with another matrix.
+    void swap(basic_quantized_matrix& other) {
+      std::swap(size_, other.size_);
+      std::swap(block_shift_, other.block_shift_);
+      data_.swap(other.data_);
+      offset_.swap(other.offset_);
+      scale_.swap(other.scale_);
+    }
+
+  private:
+    size_t size_;                  ///< Number of rows and columns.
+    size_t block_shift_;           ///< log2 of rows per block.
+    std::vector<Q> data_;          ///< Packed lower triangle, by rows.
+    std::vector<double> offset_;   ///< Per-block offsets.
+    std::vector<double> scale_;    ///< Per-block scales.
+
+    static size_t index(size_t i, size_t j) { return i * (i + 1) / 2 + j; }
+
+    bool global() const { return block_shift_ == std::numeric_limits<size_t>::digits - 1; }
+    size_t block_size() const { return (size_t)1 << block_shift_; }
+
+    void set_block_rows(size_t block_rows) {
+      if (!block_rows) {
+        block_shift_ = std::numeric_limits<size_t>::digits - 1;   // i >> shift is always 0.
+      } else {
+        block_shift_ = 0;
+        while (((size_t)1 << block_shift_) < block_rows) block_shift_++;
+      }
+    }
+
+    template <class Iterator>
+    static void range(Iterator begin, Iterator end, double *lo, double *hi) {
+      for (Iterator v = begin; v != end; v++) {
+        if (*v < *lo) *lo = *v;
+        if (*v > *hi) *hi = *v;
+      }
+    }
+
+    void set_scale(size_t b, double lo, double hi) {
+      if (!(lo <= hi)) lo = hi = 0;    // empty block
+      offset_[b] = lo;
+      scale_[b]  = (hi - lo) / max_level();
+    }
+
+    template <class Iterator>
+    void encode(size_t b, Iterator begin, Iterator end, Q *out) const {
+      const double offset = offset_[b];
+      const double inverse = scale_[b] ? 1.0 / scale_[b] : 0.0;
+      for (Iterator v = begin; v != end; v++) {
+        double level = std::floor((*v - offset) * inverse + 0.5);
+        *out++ = (Q)std::min<double>(std::max(level, 0.0), max_level());
+      }
+    }
+  };
+
+  /// 16-bit quantized matrix: 4x smaller than dissimilarity_matrix.
+  typedef basic_quantized_matrix<uint16_t> quantized_matrix;
+
+  /// 8-bit quantized matrix: 8x smaller than dissimilarity_matrix, but coarse.
+  typedef basic_quantized_matrix<uint8_t>  quantized8_matrix;
+
+
+  /// Row function for basic_quantized_matrix::assign() that evaluates a distance metric.
+  template <class Objects, class D>
+  struct object_rows {
+    const Objects& objects;
+    const std::vector<size_t> *subset;
+    D dissimilarity;
+
+    object_rows(const Objects& o, const std::vector<size_t> *s, D d) 
+      : objects(o), subset(s), dissimilarity(d) { }
+
+    size_t id(size_t i) const { return subset ? (*subset)[i] : i; }
+
+    void operator()(size_t first, size_t last, double *out) {
+      for (size_t i=first; i < last; i++) {
+        for (size_t j=0; j <= i; j++) {
+          *out++ = dissimilarity(objects[id(i)], objects[id(j)]);
+        }
+      }
+    }
+  };
+
+
+  /// Row function for basic_quantized_matrix::assign() that copies from another matrix.
+  template <class Matrix>
+  struct matrix_rows {
+    const Matrix& mat;
+    matrix_rows(const Matrix& m) : mat(m) { }
+
+    void operator()(size_t first, size_t last, double *out) {
+      for (size_t i=first; i < last; i++) {
+        for (size_t j=0; j <= i; j++) {
+          *out++ = mat(i, j);
+        }
+      }
+    }
+  };
+
+
+  ///
+  /// Computes a quantized dissimilarity matrix from a vector of objects.  Each distance
+  /// is evaluated once for blocked matrices and twice for globally scaled ones, and no
+  /// full-precision copy of the matrix is ever held in memory.
+  ///
+  /// @see build_dissimilarity_matrix() in dissimilarity.h for the parameters.
+  ///
+  template <class Objects, class D, typename Q>
+  void build_dissimilarity_matrix(const Objects& objects, D dissimilarity, 
+                                  basic_quantized_matrix<Q>& mat) {
+    mat.assign(objects.size(), object_rows<Objects,D>(objects, NULL, dissimilarity));
+  }
+
+
+  ///
+  /// Computes a quantized dissimilarity matrix from a subset of a vector of objects.
+  ///
+  template <class Objects, class D, typename Q>
+  void build_dissimilarity_matrix(const Objects& objects, const std::vector<size_t>& subset,
+                                  D dissimilarity, basic_quantized_matrix<Q>& mat) {
+    mat.assign(subset.size(), object_rows<Objects,D>(objects, &subset, dissimilarity));
+  }
+
+
+  ///
+  /// Quantizes an existing matrix, e.g. a dissimilarity_matrix, into mat.
+  ///
+  template <class Matrix, typename Q>
+  void quantize(const Matrix& exact, basic_quantized_matrix<Q>& mat) {
+    mat.assign(exact.size1(), matrix_rows<Matrix>(exact));
+  }
+
+} // namespace cluster
+
+#endif // QUANTIZED_MATRIX_H
@@ -39,6 +39,11 @@
 #define MUSTER_RANDOM_H
 
 #include <sys/time.h>
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
 #include <tr1/unordered_map>
 
 namespace cluster {
@@ -112,6 +117,43 @@ namespace cluster {
   }
   
 
+  ///
+  /// Weighted random sampling with replacement.  Makes num_draws independent draws, each 
+  /// picking element i with probability weights[i] / sum(weights), as if sampling from a 
+  /// collection where element i appears in proportion to weights[i].  Elements with zero 
+  /// weight are never picked.  Drawn indices are written in increasing order, with an element
+  /// repeated once per time it was drawn.  This is O(n + d log n) for n weights and d draws.
+  ///
+  /// @param weights        non-negative weight for each element
+  /// @param num_draws      number of draws to make (none if all weights are zero)
+  /// @param out            destination for drawn elements, must model output iterator.
+  /// @param random         model of STL Random Number Generator.
+  ///
+  template <class OutputIterator, class Random>
+  void weighted_draws(const std::vector<double>& weights, size_t num_draws, 
+                      OutputIterator out, Random& random) {
+    const unsigned long resolution = 1ul << 30;
+
+    std::vector<double> cumulative(weights.size());
+    double total = 0;
+    for (size_t i=0; i < weights.size(); i++) {
+      total += weights[i];
+      cumulative[i] = total;
+    }
+    if (total <= 0) return;
+
+    // Elements with zero weight have the same cumulative weight as an earlier element, so
+    // upper_bound() never lands on them.
+    std::vector<size_t> drawn(num_draws);
+    for (size_t d=0; d < num_draws; d++) {
+      double u = (random(resolution) + 0.5) / resolution * total;
+      drawn[d] = std::upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin();
+    }
+    std::sort(drawn.begin(), drawn.end());
+    std::copy(drawn.begin(), drawn.end(), out);
+  }
+
+
   ///
   /// Returns a seed for random number generators based on the product
   /// of sec and usec from gettimeofday().
@@ -0,0 +1,103 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file silhouette.h
+/// @brief Medoid silhouette, a criterion for choosing k that doesn't assume gaussian clusters.
+///
+/// The usual silhouette compares each object's mean distance to its own cluster with its 
+/// mean distance to the nearest other cluster, which takes O(n^2) distances.  The medoid
+/// silhouette (Van der Laan et al., 2003; Lenssen and Schubert, 2022) uses the distances to 
+/// the nearest and second-nearest medoids instead:
+///
+///     s(i) = 1 - d1(i) / d2(i)
+///
+/// which takes O(n*k) distances, the same as assigning objects to medoids.  Scores range 
+/// from 0 to 1; higher is better.  Unlike bic(), it makes no assumption about the shape 
+/// or distribution of clusters.
+///
+#ifndef SILHOUETTE_H
+#define SILHOUETTE_H
+
+#include <cfloat>
+#include <algorithm>
+#include "partition.h"
+
+namespace cluster {
+
+  ///
+  /// Criteria that xpam(), xclara() and xcapek() can use to pick the best k.
+  ///
+  enum k_criterion {
+    bic_criterion,          ///< Bayesian information criterion from bic.h.  The default.
+    silhouette_criterion    ///< Mean medoid silhouette from silhouette.h.
+  };
+
+
+  ///
+  /// Medoid silhouette of one object, given distances to its nearest and second-nearest 
+  /// medoids.  This is 0 if there is no second medoid, or if both distances are 0.
+  ///
+  inline double medoid_silhouette(double d1, double d2) {
+    if (d2 == DBL_MAX || d2 <= 0) return 0.0;
+    return 1.0 - d1 / d2;
+  }
+
+
+  ///
+  /// Mean medoid silhouette of a partition.  Each object's first distance is to its own 
+  /// medoid, and its second is to the closest of the other medoids.
+  ///
+  /// @param[in] p         A partition object describing the clustering to be evaluated.
+  /// @param[in] distance  A distance function callable on two \em indices from the partition p.
+  ///
+  /// @return Mean medoid silhouette in [0,1], or 0 for a partition with fewer than 2 clusters.
+  ///
+  template <typename D>
+  double medoid_silhouette(const partition& p, D distance) {
+    if (p.size() == 0) return 0.0;
+
+    double total = 0;
+    for (object_id i=0; i < p.size(); i++) {
+      double d1 = distance(i, p.medoid_ids[p.cluster_ids[i]]);
+      double d2 = DBL_MAX;
+      for (medoid_id m=0; m < p.medoid_ids.size(); m++) {
+        if (m == p.cluster_ids[i]) continue;
+        d2 = std::min(d2, distance(i, p.medoid_ids[m]));
+      }
+      total += medoid_silhouette(d1, d2);
+    }
+    return total / p.size();
+  }
+
+} // namespace cluster
+
+#endif // SILHOUETTE_H
@@ -0,0 +1,332 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file sparse_vector.h
+/// @brief Sparse numeric feature vectors with compact packing and merge-based distance kernels.
+///
+/// Performance signatures with many counters are often mostly zero.  A sparse_vector stores
+/// only its nonzero entries, as parallel arrays of sorted indices and values, so it packs
+/// into 12 bytes per nonzero instead of 8 bytes per dimension, and distance kernels touch 
+/// only the nonzeros of the two vectors being compared.
+///
+/// Each sparse_vector caches its squared norm.  Euclidean and cosine distances use it to
+/// reduce to a single sparse dot product, which only has to visit indices present in
+/// both vectors.
+///
+/// A std::vector<sparse_vector> works as the objects argument to kmedoids::clara(), 
+/// kmedoids::xclara(), kmedoids::center_medoids(), par_kmedoids::capek() and 
+/// par_kmedoids::xcapek().
+///
+#ifndef SPARSE_VECTOR_H
+#define SPARSE_VECTOR_H
+
+#include "muster-config.h"
+
+#ifdef MUSTER_HAVE_MPI
+#include <mpi.h>
+#include "mpi_bindings.h"
+#endif // MUSTER_HAVE_MPI
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace cluster {
+
+  ///
+  /// Sparse vector of doubles: sorted indices of nonzero entries and their values.
+  ///
+  class sparse_vector {
+  public:
+    typedef uint32_t index_type;
+
+    /// Empty (all-zero) vector.
+    sparse_vector() : norm2_(0) { }
+
+    /// Sparse copy of dimension dense values, dropping zeros.
+    sparse_vector(const double *values, size_t dimension) : norm2_(0) {
+      for (size_t i=0; i < dimension; i++) {
+        push_back(i, values[i]);
+      }
+    }
+
+    ///
+    /// Append a nonzero entry.  Indices must be added in increasing order; zero values
+    /// are ignored.
+    ///
+    void push_back(index_type index, double value) {
+      if (!idx_.empty() && index <= idx_.back()) {
+        throw std::logic_error("sparse_vector indices must be added in increasing order.");
+      }
+      if (value == 0) return;
+      idx_.push_back(index);
+      val_.push_back(value);
+      norm2_ += value * value;
+    }
+
+    /// Number of nonzero entries.
+    size_t nnz() const { return idx_.size(); }
+
+    /// Sorted indices of nonzero entries.
+    const index_type *indices() const { return idx_.empty() ? NULL : &idx_[0]; }
+
+    /// Values of nonzero entries, parallel to indices().
+    const double *values() const { return val_.empty() ? NULL : &val_[0]; }
+
+    /// Squared Euclidean norm, cached.
+    double norm2() const { return norm2_; }
+
+    /// Value at index i (zero if not present).
+    double operator[](index_type i) const {
+      std::vector<index_type>::const_iterator it = std::lower_bound(idx_.begin(), idx_.end(), i);
+      return (it != idx_.end() && *it == i) ? val_[it - idx_.begin()] : 0.0;
+    }
+
+    /// Sum of two sparse vectors, by merging their entries.
+    sparse_vector operator+(const sparse_vector& other) const {
+      sparse_vector result;
+      result.idx_.reserve(nnz() + other.nnz());
+      result.val_.reserve(nnz() + other.nnz());
+
+      size_t a = 0, b = 0;
+      while (a < nnz() || b < other.nnz()) {
+        if (b == other.nnz() || (a < nnz() && idx_[a] < other.idx_[b])) {
+          result.push_back(idx_[a], val_[a]);  a++;
+        } else if (a == nnz() || other.idx_[b] < idx_[a]) {
+          result.push_back(other.idx_[b], other.val_[b]);  b++;
+        } else {
+          result.push_back(idx_[a], val_[a] + other.val_[b]);  a++;  b++;
+        }
+      }
+      return result;
+    }
+
+    sparse_vector& operator+=(const sparse_vector& other) {
+      sparse_vector sum = *this + other;
+      swap(sum);
+      return *this;
+    }
+
+    /// Scalar division, as needed to compute means.
+    sparse_vector operator/(double divisor) const {
+      sparse_vector result = *this;
+      result /= divisor;
+      return result;
+    }
+
+    sparse_vector& operator/=(double divisor) {
+      norm2_ = 0;
+      for (size_t i=0; i < val_.size(); i++) {
+        val_[i] /= divisor;
+        norm2_ += val_[i] * val_[i];
+      }
+      return *this;
+    }
+
+    void swap(sparse_vector& other) {
+      idx_.swap(other.idx_);
+      val_.swap(other.val_);
+      std::swap(norm2_, other.norm2_);
+    }
+
+#ifdef MUSTER_HAVE_MPI
+    /// Packed as a count, then indices, then values.  The norm is recomputed on unpack.
+    int packed_size(MPI_Comm comm) const {
+      return cmpi_packed_size(1, MPI_UINT32_T, comm)
+        + cmpi_packed_size(nnz(), MPI_UINT32_T, comm)
+        + cmpi_packed_size(nnz(), MPI_DOUBLE, comm);
+    }
+
+    void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const {
+      uint32_t count = nnz();
+      CMPI_Pack(&count, 1, MPI_UINT32_T, buf, bufsize, position, comm);
+      CMPI_Pack(const_cast<index_type*>(indices()), count, MPI_UINT32_T, buf, bufsize, position, comm);
+      CMPI_Pack(const_cast<double*>(values()), count, MPI_DOUBLE, buf, bufsize, position, comm);
+    }
+
+    static sparse_vector unpack(void *buf, int bufsize, int *position, MPI_Comm comm) {
+      sparse_vector v;
+      v.unpack_from(buf, bufsize, position, comm);
+      return v;
+    }
+
+    /// Unpack into this vector, reusing its index and value arrays.
+    void unpack_from(void *buf, int bufsize, int *position, MPI_Comm comm) {
+      uint32_t count;
+      CMPI_Unpack(buf, bufsize, position, &count, 1, MPI_UINT32_T, comm);
+
+      idx_.resize(count);
+      val_.resize(count);
+      if (count) {
+        CMPI_Unpack(buf, bufsize, position, &idx_[0], count, MPI_UINT32_T, comm);
+        CMPI_Unpack(buf, bufsize, position, &val_[0], count, MPI_DOUBLE, comm);
+      }
+      norm2_ = 0;
+      for (size_t i=0; i < count; i++) {
+        norm2_ += val_[i] * val_[i];
+      }
+    }
+#endif // MUSTER_HAVE_MPI
+
+  private:
+    std::vector<index_type> idx_;   ///< Sorted indices of nonzeros.
+    std::vector<double> val_;       ///< Nonzero values.
+    double norm2_;                  ///< Cached squared norm.
+  };
+
+
+  /// Dot product of two sparse vectors, visiting only the nonzeros of each.
+  inline double sparse_dot(const sparse_vector& a, const sparse_vector& b) {
+    const sparse_vector::index_type *ai = a.indices(), *aend = ai + a.nnz();
+    const sparse_vector::index_type *bi = b.indices(), *bend = bi + b.nnz();
+    const double *av = a.values(), *bv = b.values();
+
+    double dot = 0;
+    while (ai != aend && bi != bend) {
+      if (*ai < *bi) {
+        ai++;  av++;
+      } else if (*bi < *ai) {
+        bi++;  bv++;
+      } else {
+        dot += *av++ * *bv++;
+        ai++;  bi++;
+      }
+    }
+    return dot;
+  }
+
+
+  /// Squared Euclidean distance computed by merging all entries of both vectors.  Exact, 
+  /// but visits every nonzero.
+  inline double sparse_squared_euclidean_merge(const sparse_vector& a, const sparse_vector& b) {
+    size_t i = 0, j = 0;
+    double sum = 0;
+    while (i < a.nnz() || j < b.nnz()) {
+      double d;
+      if (j == b.nnz() || (i < a.nnz() && a.indices()[i] < b.indices()[j])) {
+        d = a.values()[i++];
+      } else if (i == a.nnz() || b.indices()[j] < a.indices()[i]) {
+        d = b.values()[j++];
+      } else {
+        d = a.values()[i++] - b.values()[j++];
+      }
+      sum += d * d;
+    }
+    return sum;
+  }
+
+
+  ///
+  /// Squared Euclidean distance using the cached norms: |a|^2 + |b|^2 - 2 a.b.  When the 
+  /// result is tiny relative to the norms, cancellation makes it inaccurate, so those 
+  /// (nearly identical) pairs fall back to the exact merge.
+  ///
+  inline double sparse_squared_euclidean(const sparse_vector& a, const sparse_vector& b) {
+    const double norms = a.norm2() + b.norm2();
+    const double d2 = norms - 2 * sparse_dot(a, b);
+    if (d2 <= 1e-8 * norms) {
+      return sparse_squared_euclidean_merge(a, b);
+    }
+    return d2;
+  }
+
+
+  /// Cosine distance (1 - cosine similarity) using cached norms.
+  inline double sparse_cosine(const sparse_vector& a, const sparse_vector& b) {
+    if (a.norm2() == 0 || b.norm2() == 0) {
+      return (a.norm2() == b.norm2()) ? 0.0 : 1.0;
+    }
+    return 1.0 - sparse_dot(a, b) / std::sqrt(a.norm2() * b.norm2());
+  }
+
+
+  ///
+  /// Weighted Jaccard distance, 1 - sum(min(a_i, b_i)) / sum(max(a_i, b_i)), for 
+  /// non-negative vectors.  For 0/1 vectors this is the usual set Jaccard distance on 
+  /// the nonzero indices.
+  ///
+  inline double sparse_jaccard(const sparse_vector& a, const sparse_vector& b) {
+    size_t i = 0, j = 0;
+    double mins = 0, maxes = 0;
+    while (i < a.nnz() || j < b.nnz()) {
+      if (j == b.nnz() || (i < a.nnz() && a.indices()[i] < b.indices()[j])) {
+        maxes += a.values()[i++];
+      } else if (i == a.nnz() || b.indices()[j] < a.indices()[i]) {
+        maxes += b.values()[j++];
+      } else {
+        mins  += std::min(a.values()[i], b.values()[j]);
+        maxes += std::max(a.values()[i], b.values()[j]);
+        i++;  j++;
+      }
+    }
+    return maxes ? 1.0 - mins / maxes : 0.0;
+  }
+
+
+  /// Euclidean distance functor for sparse vectors.
+  struct sparse_euclidean_distance {
+    double operator()(const sparse_vector& a, const sparse_vector& b) const {
+      return std::sqrt(sparse_squared_euclidean(a, b));
+    }
+  };
+
+  /// Cosine distance functor for sparse vectors.
+  struct sparse_cosine_distance {
+    double operator()(const sparse_vector& a, const sparse_vector& b) const {
+      return sparse_cosine(a, b);
+    }
+  };
+
+  /// Weighted Jaccard distance functor for non-negative sparse vectors.
+  struct sparse_jaccard_distance {
+    double operator()(const sparse_vector& a, const sparse_vector& b) const {
+      return sparse_jaccard(a, b);
+    }
+  };
+
+
+  inline std::ostream& operator<<(std::ostream& out, const sparse_vector& v) {
+    out << "{";
+    for (size_t i=0; i < v.nnz(); i++) {
+      if (i) out << ", ";
+      out << v.indices()[i] << ":" << v.values()[i];
+    }
+    out << "}";
+    return out;
+  }
+
+} // namespace cluster
+
+#endif // SPARSE_VECTOR_H
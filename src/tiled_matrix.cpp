@@ -0,0 +1,288 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file tiled_matrix.cpp
+///
+#include "tiled_matrix.h"
+
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "muster-config.h"
+#ifdef MUSTER_HAVE_AIO
+#include <aio.h>
+#endif // MUSTER_HAVE_AIO
+
+using namespace std;
+
+namespace cluster {
+
+  static const char tiled_magic[8] = { 'M', 'U', 'S', 'T', 'E', 'R', 'T', 'M' };
+
+  /// Default tile size in bytes, when the caller doesn't pick a number of rows.
+  static const size_t default_tile_bytes = (size_t)64 << 20;
+
+  tiled_matrix_header::tiled_matrix_header(uint64_t n, double s) : size(n), sum(s) {
+    memcpy(magic, tiled_magic, sizeof(magic));
+  }
+
+  bool tiled_matrix_header::valid() const {
+    return !memcmp(magic, tiled_magic, sizeof(magic));
+  }
+
+
+  /// pread() until len bytes are read or an error occurs.
+  static bool read_fully(int fd, void *buf, size_t len, off_t offset) {
+    char *p = static_cast<char*>(buf);
+    while (len) {
+      ssize_t got = pread(fd, p, len, offset);
+      if (got < 0 && errno == EINTR) continue;
+      if (got <= 0) return false;
+      p += got;  len -= got;  offset += got;
+    }
+    return true;
+  }
+
+  /// write() until len bytes are written or an error occurs.
+  static bool write_fully(int fd, const void *buf, size_t len) {
+    const char *p = static_cast<const char*>(buf);
+    while (len) {
+      ssize_t put = write(fd, p, len);
+      if (put < 0 && errno == EINTR) continue;
+      if (put <= 0) return false;
+      p += put;  len -= put;
+    }
+    return true;
+  }
+
+
+  tiled_matrix_writer::tiled_matrix_writer(const string& filename, size_t n)
+    : filename_(filename), header_(n), rows_(0)
+  {
+    fd_ = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+      throw runtime_error("Couldn't open " + filename + " for writing.");
+    }
+    // header gets rewritten with the sum when we're done.
+    if (!write_fully(fd_, &header_, sizeof(header_))) {
+      ::close(fd_);
+      throw runtime_error("Error writing " + filename);
+    }
+  }
+
+
+  tiled_matrix_writer::~tiled_matrix_writer() {
+    if (fd_ >= 0) ::close(fd_);
+  }
+
+
+  void tiled_matrix_writer::add_row(const double *row) {
+    if (rows_ == header_.size) {
+      throw logic_error("Too many rows added to tiled matrix.");
+    }
+    for (size_t j=0; j < header_.size; j++) {
+      header_.sum += row[j];
+    }
+    if (!write_fully(fd_, row, header_.size * sizeof(double))) {
+      throw runtime_error("Error writing " + filename_);
+    }
+    rows_++;
+  }
+
+
+  void tiled_matrix_writer::close() {
+    if (rows_ != header_.size) {
+      throw logic_error("Tiled matrix closed before all rows were added.");
+    }
+    bool ok = (pwrite(fd_, &header_, sizeof(header_), 0) == (ssize_t)sizeof(header_));
+    ok = (::close(fd_) == 0) && ok;
+    fd_ = -1;
+    if (!ok) {
+      throw runtime_error("Error writing " + filename_);
+    }
+  }
+
+
+  tiled_dissimilarity_matrix::tiled_dissimilarity_matrix(const string& filename, size_t tile_rows) {
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      throw runtime_error("Couldn't open " + filename);
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) < 0 || !read_fully(fd_, &header_, sizeof(header_), 0) || !header_.valid()
+        || (uint64_t)st.st_size != sizeof(header_) + header_.size * header_.size * sizeof(double)) {
+      ::close(fd_);
+      throw runtime_error(filename + " is not a valid tiled matrix.");
+    }
+
+    if (!tile_rows) {
+      tile_rows = default_tile_bytes / max<size_t>(1, header_.size * sizeof(double));
+    }
+    tile_rows_ = max<size_t>(1, min<size_t>(tile_rows, header_.size));
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif // POSIX_FADV_SEQUENTIAL
+  }
+
+
+  tiled_dissimilarity_matrix::~tiled_dissimilarity_matrix() {
+    ::close(fd_);
+  }
+
+
+  void tiled_dissimilarity_matrix::read_row(size_t i, double *out) const {
+    read_rows(i, i+1, out);
+  }
+
+
+  void tiled_dissimilarity_matrix::read_rows(size_t first, size_t last, double *out) const {
+    const size_t row_bytes = size2() * sizeof(double);
+    if (!read_fully(fd_, out, (last - first) * row_bytes, sizeof(header_) + first * row_bytes)) {
+      throw runtime_error("Error reading tiled matrix.");
+    }
+  }
+
+
+  ///
+  /// One outstanding tile read.  With AIO this is a real asynchronous request; 
+  /// otherwise the read happens synchronously in finish().
+  ///
+  struct tile_reader::request {
+    double *buf;
+    size_t  len;
+    off_t   offset;
+#ifdef MUSTER_HAVE_AIO
+    struct aiocb cb;
+#endif // MUSTER_HAVE_AIO
+  };
+
+
+  tile_reader::tile_reader(const tiled_dissimilarity_matrix& mat)
+    : mat_(mat), pending_(NULL), next_tile_(0), first_(0), last_(0)
+  {
+    const size_t tile_size = mat.tile_rows() * mat.size2();
+    buffers_[0].resize(tile_size);
+    if (mat.num_tiles() > 1) {
+      buffers_[1].resize(tile_size);
+    }
+  }
+
+
+  tile_reader::~tile_reader() {
+    if (pending_) {
+      try {
+        finish();
+      } catch (...) {
+        // nothing to do; we're going away anyway.
+      }
+    }
+  }
+
+
+  void tile_reader::start(size_t tile) {
+    const size_t first = tile * mat_.tile_rows();
+    const size_t last  = min(mat_.size1(), first + mat_.tile_rows());
+    const size_t row_bytes = mat_.size2() * sizeof(double);
+
+    pending_ = new request;
+    pending_->buf    = &buffers_[tile % 2][0];
+    pending_->len    = (last - first) * row_bytes;
+    pending_->offset = sizeof(tiled_matrix_header) + first * row_bytes;
+
+#ifdef MUSTER_HAVE_AIO
+    memset(&pending_->cb, 0, sizeof(pending_->cb));
+    pending_->cb.aio_fildes = mat_.fd();
+    pending_->cb.aio_buf    = pending_->buf;
+    pending_->cb.aio_nbytes = pending_->len;
+    pending_->cb.aio_offset = pending_->offset;
+    if (aio_read(&pending_->cb) != 0) {
+      pending_->cb.aio_nbytes = 0;   // fall back to a synchronous read in finish().
+    }
+#endif // MUSTER_HAVE_AIO
+  }
+
+
+  void tile_reader::finish() {
+    request *req = pending_;
+    pending_ = NULL;
+
+    size_t done = 0;
+#ifdef MUSTER_HAVE_AIO
+    if (req->cb.aio_nbytes) {
+      const struct aiocb *list[1] = { &req->cb };
+      while (aio_error(&req->cb) == EINPROGRESS) {
+        aio_suspend(list, 1, NULL);
+      }
+      ssize_t got = aio_return(&req->cb);
+      if (got > 0) done = got;
+    }
+#endif // MUSTER_HAVE_AIO
+
+    // read whatever AIO didn't (short reads, or no AIO at all).
+    bool ok = read_fully(mat_.fd(), reinterpret_cast<char*>(req->buf) + done, 
+                         req->len - done, req->offset + done);
+    delete req;
+    if (!ok) {
+      throw runtime_error("Error reading tiled matrix.");
+    }
+  }
+
+
+  const double *tile_reader::next() {
+    if (next_tile_ >= num_tiles()) {
+      throw logic_error("tile_reader read past the last tile.");
+    }
+
+    if (!pending_) start(next_tile_);
+    finish();
+
+    const size_t tile = next_tile_++;
+    first_ = tile * mat_.tile_rows();
+    last_  = min(mat_.size1(), first_ + mat_.tile_rows());
+
+    // prefetch into the other buffer while the caller works on this one.
+    if (next_tile_ < num_tiles()) {
+      start(next_tile_);
+    }
+    return &buffers_[tile % 2][0];
+  }
+
+} // namespace cluster
@@ -0,0 +1,213 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file tiled_matrix.h
+/// @brief Dissimilarity matrices stored on disk in row tiles, for out-of-core PAM.
+///
+/// A tiled_dissimilarity_matrix keeps the full square matrix in a file on local disk, 
+/// one row of n doubles after another.  Consecutive rows are read in tiles with a 
+/// tile_reader, which prefetches the next tile asynchronously while the caller works on 
+/// the current one.  kmedoids::pam() has an overload that runs entirely from such a file,
+/// reading the matrix once per swap iteration.
+///
+/// The file starts with a small header:
+/// <table>
+/// <tr><th>Offset</th><th>Type</th><th>Contents</th></tr>
+/// <tr><td>0</td> <td>char[8]</td>   <td>magic string "MUSTERTM"</td></tr>
+/// <tr><td>8</td> <td>uint64_t</td>  <td>number of objects, <i>n</i></td></tr>
+/// <tr><td>16</td><td>double</td>    <td>sum of all entries</td></tr>
+/// <tr><td>24</td><td>double[n*n]</td><td>row-major entries</td></tr>
+/// </table>
+///
+#ifndef TILED_MATRIX_H
+#define TILED_MATRIX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cluster {
+
+  /// Header at the start of a tiled matrix file.
+  struct tiled_matrix_header {
+    char     magic[8];   ///< Always "MUSTERTM" (not NUL-terminated).
+    uint64_t size;       ///< Number of rows and columns.
+    double   sum;        ///< Sum of all entries, for PAM's convergence tolerance.
+
+    tiled_matrix_header(uint64_t size = 0, double sum = 0);
+    bool valid() const;
+  };
+
+
+  ///
+  /// Writes a tiled matrix file one row at a time.  Rows must be added in order.
+  ///
+  class tiled_matrix_writer {
+  public:
+    /// Create filename for an n by n matrix.  Throws std::runtime_error on failure.
+    tiled_matrix_writer(const std::string& filename, size_t n);
+    ~tiled_matrix_writer();
+
+    /// Append the next row, which has n entries.
+    void add_row(const double *row);
+
+    /// Finish writing the file.  Throws std::runtime_error if any row wasn't written.
+    void close();
+
+  private:
+    int fd_;
+    std::string filename_;
+    tiled_matrix_header header_;
+    size_t rows_;
+
+    tiled_matrix_writer(const tiled_matrix_writer&);
+    tiled_matrix_writer& operator=(const tiled_matrix_writer&);
+  };
+
+
+  ///
+  /// Read-only handle on a tiled matrix file.
+  ///
+  class tiled_dissimilarity_matrix {
+  public:
+    ///
+    /// Open a tiled matrix file.  
+    /// @param filename   File written by tiled_matrix_writer or build_dissimilarity_matrix().
+    /// @param tile_rows  Rows per tile.  Zero picks tiles of about 64MB.
+    ///
+    explicit tiled_dissimilarity_matrix(const std::string& filename, size_t tile_rows = 0);
+    ~tiled_dissimilarity_matrix();
+
+    size_t size1() const { return header_.size; }
+    size_t size2() const { return header_.size; }
+
+    /// Sum of all entries.
+    double sum() const { return header_.sum; }
+
+    /// Rows per tile.
+    size_t tile_rows() const { return tile_rows_; }
+
+    /// Number of tiles.
+    size_t num_tiles() const { return (size1() + tile_rows_ - 1) / tile_rows_; }
+
+    /// Synchronously read row i (size2() entries) into out.
+    void read_row(size_t i, double *out) const;
+
+    /// Synchronously read rows [first, last) into out.
+    void read_rows(size_t first, size_t last, double *out) const;
+
+    /// File descriptor, for tile_reader.
+    int fd() const { return fd_; }
+
+  private:
+    int fd_;
+    tiled_matrix_header header_;
+    size_t tile_rows_;
+
+    tiled_dissimilarity_matrix(const tiled_dissimilarity_matrix&);
+    tiled_dissimilarity_matrix& operator=(const tiled_dissimilarity_matrix&);
+  };
+
+
+  ///
+  /// Streams the tiles of a tiled_dissimilarity_matrix in order, double-buffered.  While the 
+  /// caller works on one tile, the next is read in the background with POSIX AIO (where 
+  /// available), so disk reads overlap with compute.
+  ///
+  /// <b>Example:</b>
+  /// @code
+  /// tile_reader reader(mat);
+  /// for (size_t t=0; t < reader.num_tiles(); t++) {
+  ///   const double *tile = reader.next();        // waits for tile t, prefetches t+1
+  ///   for (size_t i=reader.first_row(); i < reader.last_row(); i++) {
+  ///     const double *row = tile + (i - reader.first_row()) * mat.size2();
+  ///     // ...
+  ///   }
+  /// }
+  /// @endcode
+  ///
+  class tile_reader {
+  public:
+    explicit tile_reader(const tiled_dissimilarity_matrix& mat);
+    ~tile_reader();
+
+    size_t num_tiles() const { return mat_.num_tiles(); }
+
+    /// Wait for the next tile and return its rows.  Valid until the following call to next().
+    const double *next();
+
+    /// First row of the tile most recently returned by next().
+    size_t first_row() const { return first_; }
+
+    /// One past the last row of the tile most recently returned by next().
+    size_t last_row() const { return last_; }
+
+  private:
+    struct request;
+
+    const tiled_dissimilarity_matrix& mat_;
+    std::vector<double> buffers_[2];   ///< Current tile and tile being prefetched.
+    request *pending_;                 ///< Outstanding read, if any.
+    size_t next_tile_;                 ///< Tile that next() will return.
+    size_t first_, last_;              ///< Rows of current tile.
+
+    void start(size_t tile);           ///< Begin reading tile into its buffer.
+    void finish();                     ///< Wait for the outstanding read.
+
+    tile_reader(const tile_reader&);
+    tile_reader& operator=(const tile_reader&);
+  };
+
+
+  ///
+  /// Computes a dissimilarity matrix from a vector of objects and writes it to filename 
+  /// as a tiled matrix file.  Only one row is held in memory at a time.  Every distance
+  /// is computed twice, once for each of the two rows it appears in.
+  ///
+  template <class Objects, class D>
+  void build_dissimilarity_matrix(const Objects& objects, D dissimilarity, 
+                                  const std::string& filename) {
+    const size_t n = objects.size();
+    tiled_matrix_writer writer(filename, n);
+    std::vector<double> row(n);
+    for (size_t i=0; i < n; i++) {
+      for (size_t j=0; j < n; j++) {
+        row[j] = (i == j) ? 0.0 : dissimilarity(objects[i], objects[j]);
+      }
+      writer.add_row(n ? &row[0] : NULL);
+    }
+    writer.close();
+  }
+
+} // namespace cluster
+
+#endif // TILED_MATRIX_H
@@ -51,11 +51,25 @@ namespace cluster {
   }
 
     
+  /// Consecutive k values from min_k to max_k.
+  static vector<size_t> k_range(size_t min_k, size_t max_k) {
+    vector<size_t> ks;
+    for (size_t k = min_k; k <= max_k; k++) ks.push_back(k);
+    return ks;
+  }
+
+  static size_t max_of(const vector<size_t>& ks) {
+    return ks.empty() ? 0 : *max_element(ks.begin(), ks.end());
+  }
+
+    
   trial_generator::trial_generator(size_t _max_k, size_t _max_reps, size_t _init_size, size_t _num_objects)
     : max_k(_max_k), 
       max_reps(_max_reps), 
       init_size(_init_size), 
       num_objects(_num_objects),
+      k_values(k_range(1, _max_k)),
+      k_index(0),
       cur_trial(1, 0, get_sample_size(1)),
       iterations(0)
   { 
@@ -69,15 +83,33 @@ namespace cluster {
       max_reps(_max_reps), 
       init_size(_init_size), 
       num_objects(_num_objects),
+      k_values(k_range(_min_k, _max_k)),
+      k_index(0),
       cur_trial(_min_k, 0, get_sample_size(_min_k)),
       iterations(0)
   { 
     number_of_trials = count_all(*this);
   }
+
+
+  trial_generator::trial_generator(const vector<size_t>& _k_values, size_t _max_reps, 
+                                   size_t _init_size, size_t _num_objects)
+    : max_k(max_of(_k_values)), 
+      max_reps(_max_reps), 
+      init_size(_init_size), 
+      num_objects(_num_objects),
+      k_values(_k_values),
+      k_index(0),
+      cur_trial(k_values.empty() ? 0 : k_values[0], 0, 
+                get_sample_size(k_values.empty() ? 0 : k_values[0])),
+      iterations(0)
+  { 
+    number_of_trials = count_all(*this);
+  }
     
 
   bool trial_generator::has_next() const {
-    return cur_trial.k <= max_k;
+    return k_index < k_values.size();
   }
 
 
@@ -89,8 +121,11 @@ namespace cluster {
     cur_trial.rep++;
     if (cur_trial.rep >= max_reps || cur_trial.sample_size == num_objects) {
       cur_trial.rep = 0;
-      cur_trial.k++;
-      cur_trial.sample_size = get_sample_size(cur_trial.k);
+      k_index++;
+      if (k_index < k_values.size()) {
+        cur_trial.k = k_values[k_index];
+        cur_trial.sample_size = get_sample_size(cur_trial.k);
+      }
     }
 
     iterations++;
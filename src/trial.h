@@ -38,6 +38,7 @@
 #define TRIAL_H
 
 #include <cstdlib>
+#include <vector>
 
 namespace cluster {
 
@@ -79,6 +80,13 @@ namespace cluster {
     ///
     trial_generator(size_t min_k, size_t _max_k, 
                     size_t _max_reps, size_t _init_size, size_t _num_objects);
+
+    ///
+    /// Constructor to generate trials for an arbitrary list of k values, in the order given.
+    /// Used by adaptive searches that only visit some values of k.
+    ///
+    trial_generator(const std::vector<size_t>& k_values, 
+                    size_t _max_reps, size_t _init_size, size_t _num_objects);
     
     size_t count() const;       ///< return iterations so far.
     bool has_next() const;      ///< whether there are trials remaining.
@@ -92,6 +100,8 @@ namespace cluster {
     const size_t num_objects;   ///< number of elements in the data set; determines maximum sample size.
 
   private:
+    std::vector<size_t> k_values;  ///< values of k to generate trials for, in order
+    size_t k_index;             ///< index of cur_trial.k in k_values
     trial cur_trial;            ///< current state of the iterator.
     size_t number_of_trials;    ///< memoized total number of trials in this generator
     size_t iterations;          ///< number of iterations so far
@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file unpack.h
+/// @brief Unpacking MPI-packed objects in place, for types that support it.
+///
+/// Packable types provide <code>static T unpack(void *buf, int bufsize, int *position, MPI_Comm comm)</code>,
+/// which returns a new object that then has to be copied into its destination.  For types 
+/// that own large arrays, that copy doubles the time and peak memory of unpacking.  Types can 
+/// also provide
+///
+///     void unpack_from(void *buf, int bufsize, int *position, MPI_Comm comm);
+///
+/// which replaces the contents of an existing object.  unpack_into() uses unpack_from() when
+/// a type has it and falls back to unpack() otherwise, so gathers can construct each object 
+/// once, in its final place.
+///
+#ifndef MUSTER_UNPACK_H
+#define MUSTER_UNPACK_H
+
+#include <mpi.h>
+#include <vector>
+
+namespace cluster {
+
+  ///
+  /// has_unpack_from<T>::value is true if T has a member 
+  /// <code>void unpack_from(void *buf, int bufsize, int *position, MPI_Comm comm)</code>.
+  ///
+  template <class T>
+  class has_unpack_from {
+    typedef char yes;
+    typedef char (&no)[2];
+
+    template <class U, void (U::*)(void*, int, int*, MPI_Comm)> struct signature { };
+    template <class U> static yes test(signature<U, &U::unpack_from>*);
+    template <class U> static no  test(...);
+
+  public:
+    static const bool value = (sizeof(test<T>(0)) == sizeof(yes));
+  };
+
+
+  /// Unpacks with T::unpack_from() if InPlace, or by assigning the result of T::unpack().
+  template <class T, bool InPlace = has_unpack_from<T>::value>
+  struct unpacker {
+    static void unpack(T& dest, void *buf, int bufsize, int *position, MPI_Comm comm) {
+      dest.unpack_from(buf, bufsize, position, comm);
+    }
+  };
+
+  template <class T>
+  struct unpacker<T, false> {
+    static void unpack(T& dest, void *buf, int bufsize, int *position, MPI_Comm comm) {
+      dest = T::unpack(buf, bufsize, position, comm);
+    }
+  };
+
+
+  ///
+  /// Unpack the next object in buf into dest, in place if T supports it.
+  ///
+  template <class T>
+  void unpack_into(T& dest, void *buf, int bufsize, int *position, MPI_Comm comm) {
+    unpacker<T>::unpack(dest, buf, bufsize, position, comm);
+  }
+
+
+  ///
+  /// Unpack count objects from buf onto the back of dest.  Space is made for all of them 
+  /// first, then each is unpacked into its slot with unpack_into().
+  ///
+  template <class T>
+  void unpack_back(std::vector<T>& dest, size_t count, void *buf, int bufsize, int *position, MPI_Comm comm) {
+    size_t first = dest.size();
+    dest.resize(first + count);
+    for (size_t i=0; i < count; i++) {
+      unpack_into(dest[first + i], buf, bufsize, position, comm);
+    }
+  }
+
+} // namespace cluster
+
+#endif // MUSTER_UNPACK_H
@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file alternate_test.cpp
+/// @brief Checks alternating k-medoids on matrices and with lazy distances against PAM.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include "kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// Checks that km is a fixed point of Voronoi iteration: every object is with its closest
+/// medoid, and no object in a cluster is a better medoid than the one it has.
+static void check_fixed_point(const kmedoids& km, const dissimilarity_matrix& mat) {
+  vector<double> best(km.num_clusters());
+  for (size_t m=0; m < km.num_clusters(); m++) {
+    for (size_t i=0; i < km.size(); i++) {
+      if (km.cluster_ids[i] == m) best[m] += mat(km.medoid_ids[m], i);
+    }
+  }
+
+  for (size_t i=0; i < km.size(); i++) {
+    double mine = mat(i, km.medoid_ids[km.cluster_ids[i]]);
+    for (size_t m=0; m < km.num_clusters(); m++) {
+      if (mat(i, km.medoid_ids[m]) < mine) fail("Object isn't assigned to its closest medoid.");
+    }
+
+    double sum = 0;
+    for (size_t j=0; j < km.size(); j++) {
+      if (km.cluster_ids[j] == km.cluster_ids[i]) sum += mat(i, j);
+    }
+    if (sum < best[km.cluster_ids[i]] - 1e-9) fail("Cluster has a better medoid.");
+  }
+}
+
+
+int main(int argc, char **argv) {
+  const size_t k = 6;
+  vector<point> points;
+  make_grid_points(200, 5, 3, 15, 2, 25, points);
+
+  dissimilarity_matrix mat;
+  build_dissimilarity_matrix(points, point_distance(), mat);
+
+  kmedoids pam_km;
+  pam_km.pam(mat, k);
+
+  // Matrix and lazy versions take the same path from the same start.
+  vector<object_id> init;
+  for (size_t i=0; i < k; i++) init.push_back(i * 7);
+
+  kmedoids matrix_km, lazy_km;
+  matrix_km.alternate(mat, k, &init[0]);
+  lazy_km.alternate(points, point_distance(), k, &init[0]);
+
+  if (matrix_km.medoid_ids != lazy_km.medoid_ids || matrix_km.cluster_ids != lazy_km.cluster_ids) {
+    fail("Matrix and lazy alternate() differ.");
+  }
+  check_fixed_point(matrix_km, mat);
+
+  // Random starts should be in the same ballpark as PAM.
+  kmedoids random_km;
+  random_km.set_seed(11);
+  random_km.alternate(mat, k);
+  check_fixed_point(random_km, mat);
+  if (random_km.average_dissimilarity() < pam_km.average_dissimilarity() * 0.999 ||
+      random_km.average_dissimilarity() > pam_km.average_dissimilarity() * 1.5) {
+    ostringstream msg;
+    msg << "alternate() average dissimilarity " << random_km.average_dissimilarity() 
+        << " is far from PAM's " << pam_km.average_dissimilarity();
+    fail(msg.str());
+  }
+
+  // Warm-starting PAM from alternate() should converge to a PAM-quality answer.
+  kmedoids warm_km;
+  warm_km.pam(mat, k, &random_km.medoid_ids[0]);
+  if (warm_km.average_dissimilarity() > random_km.average_dissimilarity()) {
+    fail("PAM from alternate() medoids got worse.");
+  }
+  
+  cout << "PAM:       " << pam_km.average_dissimilarity() << endl;
+  cout << "alternate: " << random_km.average_dissimilarity() << endl;
+  cout << "warm PAM:  " << warm_km.average_dissimilarity() << endl;
+  cout << "PASSED" << endl;
+  return 0;
+}
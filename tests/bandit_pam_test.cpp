@@ -0,0 +1,112 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file bandit_pam_test.cpp
+/// @brief Checks that bandit_pam() matches PAM's quality with far fewer distance calls.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include "kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  // Small enough to compare against PAM on a full matrix.
+  const size_t k = 6;
+  vector<point> points;
+  make_grid_points(200, 13, k, 20, 2, 20, points);
+
+  dissimilarity_matrix mat;
+  build_dissimilarity_matrix(points, point_distance(), mat);
+  kmedoids pam_km;
+  pam_km.pam(mat, k);
+
+  kmedoids bandit_km;
+  bandit_km.set_seed(3);
+  bandit_km.set_bandit_batch_size(20);
+  bandit_km.bandit_pam(points, point_distance(), k);
+
+  if (bandit_km.average_dissimilarity() > pam_km.average_dissimilarity() * 1.01) {
+    ostringstream msg;
+    msg << "bandit_pam() average dissimilarity " << bandit_km.average_dissimilarity() 
+        << " is worse than PAM's " << pam_km.average_dissimilarity();
+    fail(msg.str());
+  }
+
+  // Reported cost is the true cost of the returned clustering.
+  double cost = 0;
+  for (size_t i=0; i < points.size(); i++) {
+    double mine = mat(i, bandit_km.medoid_ids[bandit_km.cluster_ids[i]]);
+    for (size_t m=0; m < k; m++) {
+      if (mat(i, bandit_km.medoid_ids[m]) < mine) fail("Object isn't with its closest medoid.");
+    }
+    cost += mine;
+  }
+  if (fabs(cost / points.size() - bandit_km.average_dissimilarity()) > 1e-9) {
+    fail("Reported average dissimilarity is wrong.");
+  }
+
+  // Larger set: should need fewer distances than a single swap iteration of PAM with
+  // lazy distances, and still beat CLARA.
+  const size_t n = 5000;
+  vector<point> big;
+  make_grid_points(n, 13, k, 20, 2, 20, big);
+
+  kmedoids big_km;
+  big_km.set_seed(3);
+  big_km.bandit_pam(big, point_distance(), k);
+
+  kmedoids clara_km;
+  clara_km.set_seed(3);
+  clara_km.clara(big, point_distance(), k);
+
+  const size_t pam_iteration = k * (n-k) * n;
+  cout << "distance calls: " << big_km.distance_calls() 
+       << " (one lazy PAM iteration needs " << pam_iteration << ")" << endl;
+  cout << "bandit_pam: " << big_km.average_dissimilarity() 
+       << ", CLARA: " << clara_km.average_dissimilarity() << endl;
+
+  if (big_km.distance_calls() == 0 || big_km.distance_calls() >= pam_iteration) {
+    fail("bandit_pam() computed too many distances.");
+  }
+  if (big_km.average_dissimilarity() > clara_km.average_dissimilarity()) {
+    fail("bandit_pam() did worse than CLARA.");
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
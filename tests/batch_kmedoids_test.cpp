@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file batch_kmedoids_test.cpp
+/// @brief Checks that batched PAM gives the same partitions as running PAM on each problem.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+
+#include <boost/random.hpp>
+
+#include "batch_kmedoids.h"
+#include "kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  size_t num_problems = 40;
+  if (argc > 1) {
+    num_problems = strtol(argv[1], NULL, 0);
+  }
+
+  boost::mt19937 rng(5);
+  boost::uniform_real<double> uniform(0, 20);
+  boost::variate_generator<boost::mt19937&, boost::uniform_real<double> > coord(rng, uniform);
+
+  // groups of 10 to 70 points; every third one is given as a matrix.
+  vector< vector<point> > groups(num_problems);
+  vector<dissimilarity_matrix> matrices(num_problems);
+  vector< pam_problem< vector<point> > > problems;
+  for (size_t p=0; p < num_problems; p++) {
+    size_t n = 10 + (p * 37) % 61;
+    for (size_t i=0; i < n; i++) groups[p].push_back(point(coord(), coord()));
+
+    size_t k = 1 + p % 6;
+    if (p % 3 == 0) {
+      build_dissimilarity_matrix(groups[p], point_distance(), matrices[p]);
+      problems.push_back(pam_problem< vector<point> >(matrices[p], k));
+    } else {
+      problems.push_back(pam_problem< vector<point> >(groups[p], k));
+    }
+  }
+
+  batch_kmedoids batch;
+  vector<cluster::partition> results;
+  for (size_t round=0; round < 2; round++) {   // second round reuses per-thread storage
+    batch.pam(problems, point_distance(), results);
+    if (results.size() != num_problems) fail("wrong number of results");
+
+    for (size_t p=0; p < num_problems; p++) {
+      dissimilarity_matrix mat;
+      build_dissimilarity_matrix(groups[p], point_distance(), mat);
+      kmedoids km;
+      km.pam(mat, problems[p].k);
+
+      if (results[p].medoid_ids != km.medoid_ids || results[p].cluster_ids != km.cluster_ids
+          || batch.average_dissimilarity(p) != km.average_dissimilarity()) {
+        ostringstream msg;
+        msg << "batched PAM differs from PAM on problem " << p << " in round " << round;
+        fail(msg.str());
+      }
+    }
+  }
+
+  // matrices only, on one thread.
+  vector< pam_problem<> > matrix_problems;
+  for (size_t p=0; p < num_problems; p += 3) {
+    matrix_problems.push_back(pam_problem<>(matrices[p], problems[p].k));
+  }
+  batch_kmedoids serial(1);
+  vector<cluster::partition> matrix_results;
+  serial.pam(matrix_problems, matrix_results);
+  for (size_t m=0; m < matrix_problems.size(); m++) {
+    if (matrix_results[m].medoid_ids != results[3 * m].medoid_ids) {
+      fail("matrix-only batch differs from mixed batch");
+    }
+  }
+
+  // invalid problems are rejected before any clustering starts.
+  matrix_problems.push_back(pam_problem<>(matrices[0], matrices[0].size1() + 1));
+  try {
+    serial.pam(matrix_problems, matrix_results);
+    fail("batch with k > n didn't throw");
+  } catch (const logic_error&) { }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
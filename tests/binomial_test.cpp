@@ -0,0 +1,129 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file binomial_test.cpp
+/// @brief Checks plain and node-aware binomial embeddings: that they form a tree whose 
+///        depth-first order is the position order, and that node-aware trees cross node 
+///        boundaries once per node.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include "binomial.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// Appends ranks in the subtree below rank to order, depth first, as gather_packed() packs them.
+static void depth_first(const binomial_embedding& binomial, int rank, vector<int>& order) {
+  order.push_back(rank);
+  vector<int> children = binomial.children(rank);
+  for (size_t c=0; c < children.size(); c++) {
+    if (binomial.parent(children[c]) != rank) {
+      fail("parent() and children() disagree.");
+    }
+    depth_first(binomial, children[c], order);
+  }
+}
+
+/// Checks the tree and returns the number of edges between ranks on different nodes.
+static int check(const binomial_embedding& binomial, const vector<int>& nodes, const string& name) {
+  const int size = binomial.size();
+  if (binomial.parent(binomial.root()) != -1) {
+    fail(name + ": root has a parent.");
+  }
+
+  vector<int> order;
+  depth_first(binomial, binomial.root(), order);
+  if ((int)order.size() != size) {
+    fail(name + ": tree doesn't reach every rank once.");
+  }
+  for (int i=0; i < size; i++) {
+    if (order[i] != binomial.reverse_relative_rank(i) || binomial.relative_rank(order[i]) != i) {
+      fail(name + ": depth-first order isn't the position order.");
+    }
+  }
+
+  int crossings = 0;
+  for (int r=0; r < size; r++) {
+    int parent = binomial.parent(r);
+    if (parent >= 0 && nodes[parent] != nodes[r]) crossings++;
+  }
+  return crossings;
+}
+
+int main(int argc, char **argv) {
+  for (int size=1; size <= 37; size++) {
+    for (int per_node=1; per_node <= 8; per_node++) {
+      // block placement and round-robin placement of ranks on nodes.
+      vector<int> block(size), cyclic(size);
+      const int num_nodes = (size + per_node - 1) / per_node;
+      for (int r=0; r < size; r++) {
+        block[r]  = (r / per_node) * per_node;
+        cyclic[r] = r % num_nodes;
+      }
+
+      for (int root=0; root < size; root += std::max(1, size / 3)) {
+        ostringstream name;
+        name << "size " << size << ", " << per_node << " per node, root " << root;
+
+        check(binomial_embedding(size, root), block, name.str() + ", plain");
+
+        int crossings = check(binomial_embedding(block, size, root), block, name.str() + ", block");
+        if (crossings != num_nodes - 1) {
+          fail(name.str() + ": node-aware tree crosses nodes too often for block placement.");
+        }
+
+        crossings = check(binomial_embedding(cyclic, size, root), cyclic, name.str() + ", cyclic");
+        if (crossings != num_nodes - 1) {
+          fail(name.str() + ": node-aware tree crosses nodes too often for cyclic placement.");
+        }
+      }
+    }
+  }
+
+  // with one rank per node, the node-aware embedding is the plain one.
+  vector<int> own(13);
+  for (int r=0; r < 13; r++) own[r] = r;
+  binomial_embedding plain(13, 0), aware(own, 13, 0);
+  for (int r=0; r < 13; r++) {
+    if (plain.parent(r) != aware.parent(r) || plain.children(r) != aware.children(r)) {
+      fail("node-aware tree with one rank per node differs from the plain tree.");
+    }
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,116 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// @file bisect_test.cpp
+/// @brief Checks that xbisect() finds k for well-separated gaussian clusters.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include <boost/random.hpp>
+
+#include "kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  const size_t num_clusters = 4;
+  size_t per_cluster = 50;
+  if (argc > 1) {
+    per_cluster = strtol(argv[1], NULL, 0);
+  }
+
+  // Gaussian clusters at the corners of a 30x20 rectangle.
+  boost::mt19937 rng(17);
+  boost::normal_distribution<double> normal(0, 1);
+  boost::variate_generator<boost::mt19937&, boost::normal_distribution<double> > noise(rng, normal);
+
+  vector<point> points;
+  for (size_t c=0; c < num_clusters; c++) {
+    for (size_t i=0; i < per_cluster; i++) {
+      points.push_back(point(30 * (c % 2) + noise(), 20 * (c / 2) + noise()));
+    }
+  }
+
+  kmedoids km;
+  km.set_seed(17);
+  km.xbisect(points, point_distance(), 3 * num_clusters, 2);
+  if (km.num_clusters() != num_clusters) {
+    ostringstream msg;
+    msg << "xbisect found " << km.num_clusters() << " clusters, expected " << num_clusters;
+    fail(msg.str());
+  }
+
+  // should be about as good as PAM with the right k.
+  dissimilarity_matrix mat;
+  build_dissimilarity_matrix(points, point_distance(), mat);
+  kmedoids pam_km;
+  pam_km.pam(mat, num_clusters);
+  if (km.average_dissimilarity() > 1.05 * pam_km.average_dissimilarity()) {
+    ostringstream msg;
+    msg << "xbisect average " << km.average_dissimilarity() 
+        << " is much worse than PAM " << pam_km.average_dissimilarity();
+    fail(msg.str());
+  }
+
+  // Running again with the same seed reuses the split workers and finds the same clustering, 
+  // with or without a distance cache.
+  cluster::partition first(km);
+  for (int cached=0; cached < 2; cached++) {
+    pair_distance_cache cache(1 << 20);
+    km.set_distance_cache(cached ? &cache : NULL);
+    km.set_seed(17);
+    km.xbisect(points, point_distance(), 3 * num_clusters, 2);
+    if (km.medoid_ids != first.medoid_ids || km.cluster_ids != first.cluster_ids) {
+      fail(cached ? "xbisect with a distance cache changed the clustering." 
+                  : "Repeated xbisect changed the clustering.");
+    }
+    if (cached && cache.size() == 0) fail("xbisect splits didn't use the distance cache.");
+  }
+  km.set_distance_cache(NULL);
+
+  // max_k caps the number of splits.
+  kmedoids capped;
+  capped.set_seed(17);
+  capped.xbisect(points, point_distance(), 3, 2);
+  if (capped.num_clusters() != 3) {
+    ostringstream msg;
+    msg << "xbisect with max_k=3 found " << capped.num_clusters() << " clusters.";
+    fail(msg.str());
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,178 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file dataset_io_test.cpp
+/// @brief Round-trips synthetic data through CSV and binary files and checks that the
+///        parallel loaders reproduce values and bounds.
+///
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include "dataset_io.h"
+#include "point_set.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+static void check_same(const dense_dataset& expected, const dense_dataset& actual, const string& what) {
+  if (expected.size() != actual.size() || expected.dimension() != actual.dimension()) {
+    ostringstream msg;
+    msg << what << ": loaded " << actual.size() << "x" << actual.dimension() 
+        << ", expected " << expected.size() << "x" << expected.dimension();
+    fail(msg.str());
+  }
+  for (size_t i=0; i < expected.size(); i++) {
+    for (size_t d=0; d < expected.dimension(); d++) {
+      if (!nearly_equal(expected.row_data(i)[d], actual.row_data(i)[d], 1e-12)) {
+        ostringstream msg;
+        msg << what << ": value mismatch at row " << i << ", column " << d;
+        fail(msg.str());
+      }
+    }
+  }
+}
+
+static void check_bounds(const dense_dataset& data, const dataset_bounds& bounds, const string& what) {
+  dataset_bounds expected(data.dimension());
+  for (size_t i=0; i < data.size(); i++) {
+    expected.add(data.row_data(i));
+  }
+  for (size_t d=0; d < data.dimension(); d++) {
+    if (!nearly_equal(expected.min[d], bounds.min[d], 1e-12) || !nearly_equal(expected.max[d], bounds.max[d], 1e-12)) {
+      fail(what + ": wrong bounds");
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t n = 20000;
+  if (argc > 1) {
+    n = strtol(argv[1], NULL, 0);
+  }
+
+  // float parser corner cases.
+  const char *cases[] = { "0", "-1.5", "+2.25e3", "1e-5", "6.02214076e23", "  3.", ".5", 
+                          "123456789012345678901234", "1e400", "4.9e-324" };
+  for (size_t i=0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+    const char *s = cases[i];
+    const char *end = s + strlen(s);
+    double value;
+    if (parse_double(s, end, &value) != end) {
+      fail(string("parse_double didn't consume ") + s);
+    }
+    double expected = strtod(s, NULL);
+    if (!(value == expected || fabs(value - expected) <= 1e-15 * fabs(expected))) {
+      fail(string("parse_double got the wrong value for ") + s);
+    }
+  }
+
+  const size_t dim = 3;
+  synthetic_generator gen(dim, 4, 11);
+  dense_dataset data(dim);
+  vector<double> coords(dim);
+  for (size_t i=0; i < n; i++) {
+    gen.generate(i, &coords[0]);
+    data.push_back(&coords[0]);
+  }
+
+  char csv_name[] = "/tmp/muster-csv-XXXXXX";
+  char bin_name[] = "/tmp/muster-bin-XXXXXX";
+  close(mkstemp(csv_name));
+  close(mkstemp(bin_name));
+
+  // CSV with a header line and a junk line that should both be skipped.
+  {
+    ofstream out(csv_name);
+    out.precision(17);
+    out << "x, y, z" << endl;
+    for (size_t i=0; i < n; i++) {
+      const double *row = data.row_data(i);
+      out << row[0] << ", " << row[1] << ",\t" << row[2] << "\r\n";
+      if (i == n / 2) out << "not, a, number" << endl;
+    }
+  }
+
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    dense_dataset loaded;
+    dataset_bounds bounds;
+    load_csv_dataset(csv_name, loaded, &bounds, threads);
+
+    ostringstream what;
+    what << "csv with " << threads << " threads";
+    check_same(data, loaded, what.str());
+    check_bounds(data, bounds, what.str());
+  }
+
+  write_binary_dataset(bin_name, data);
+  {
+    dense_dataset loaded;
+    dataset_bounds bounds;
+    load_binary_dataset(bin_name, loaded, &bounds);
+    check_same(data, loaded, "binary");
+    check_bounds(data, bounds, "binary");
+
+    // normalization with computed bounds lands everything in [0,1].
+    normalize(loaded, bounds);
+    for (size_t i=0; i < loaded.size(); i++) {
+      for (size_t d=0; d < dim; d++) {
+        double v = loaded.row_data(i)[d];
+        if (v < 0 || v > 1) fail("normalize produced values outside [0,1]");
+      }
+    }
+  }
+
+  // point_set gets the first two columns and its bounds.
+  point_set points;
+  points.load_binary_file(bin_name);
+  if (points.size() != n) fail("point_set didn't load all points");
+  dataset_bounds bounds;
+  load_binary_dataset(bin_name, data, &bounds);
+  if (points.min_x() != bounds.min[0] || points.max_y() != bounds.max[1]) {
+    fail("point_set has the wrong bounds");
+  }
+
+  unlink(csv_name);
+  unlink(bin_name);
+
+  cout << "PASSED" << endl;
+  return 0;
+}
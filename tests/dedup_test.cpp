@@ -0,0 +1,184 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file dedup_test.cpp
+/// @brief Checks that clustering deduplicated objects with weights matches clustering
+///        the full, duplicated data set.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include <boost/functional/hash.hpp>
+
+#include "kmedoids.h"
+#include "bic.h"
+#include "dedup.h"
+#include "dense_dataset.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+struct point_hash {
+  size_t operator()(const point& p) const {
+    size_t seed = 0;
+    boost::hash_combine(seed, p.x);
+    boost::hash_combine(seed, p.y);
+    return seed;
+  }
+};
+
+/// Points on an integer grid around a few centers, so most of them are duplicates.
+static void make_points(size_t n, vector<point>& points) {
+  const double centers[][2] = { {0, 0}, {20, 3}, {5, 25}, {30, 30} };
+  const size_t num_centers = sizeof(centers) / sizeof(centers[0]);
+  srand(17);
+  for (size_t i=0; i < n; i++) {
+    const double *c = centers[rand() % num_centers];
+    points.push_back(point(c[0] + rand() % 5 - 2, c[1] + rand() % 5 - 2));
+  }
+}
+
+
+int main(int argc, char **argv) {
+  const size_t n = 2000, k = 4;
+  vector<point> points;
+  make_points(n, points);
+
+  vector<point> unique;
+  dedup_map map;
+  dedup(points, unique, map, point_hash());
+
+  if (map.size() != n || unique.size() != map.num_unique() || map.num_unique() > 100) {
+    ostringstream msg;
+    msg << "Expected at most 100 unique points, got " << map.num_unique();
+    fail(msg.str());
+  }
+  double total = 0;
+  for (size_t i=0; i < n; i++) {
+    if (unique[map.mapping[i]] != points[i]) fail("Point maps to a different unique point.");
+    total += 1;
+  }
+  if (!nearly_equal(total, accumulate(map.weights.begin(), map.weights.end(), 0.0))) {
+    fail("Weights don't sum to the number of points.");
+  }
+
+  // PAM on everything vs. weighted PAM on the unique points.
+  dissimilarity_matrix full_mat, unique_mat;
+  build_dissimilarity_matrix(points, point_distance(), full_mat);
+  build_dissimilarity_matrix(unique, point_distance(), unique_mat);
+
+  kmedoids full_km, unique_km;
+  full_km.pam(full_mat, k);
+  unique_km.pam(unique_mat, map.weights, k);
+
+  if (!nearly_equal(full_km.average_dissimilarity(), unique_km.average_dissimilarity())) {
+    ostringstream msg;
+    msg << "Weighted average dissimilarity " << unique_km.average_dissimilarity() 
+        << " != full average " << full_km.average_dissimilarity();
+    fail(msg.str());
+  }
+
+  cluster::partition expanded;
+  map.expand(unique_km, expanded);
+  // Medoids may come out in a different order, so compare each object's medoid point.
+  for (size_t i=0; i < n; i++) {
+    const point& expected = points[full_km.medoid_ids[full_km.cluster_ids[i]]];
+    const point& actual   = points[expanded.medoid_ids[expanded.cluster_ids[i]]];
+    if (actual != expected) {
+      ostringstream msg;
+      msg << "Medoid of point " << i << " is " << actual << ", expected " << expected;
+      fail(msg.str());
+    }
+  }
+
+  // Weighted BIC on unique points equals BIC on everything.
+  double full_bic   = bic(full_km, matrix_distance(full_mat), 2);
+  double unique_bic = bic(unique_km, matrix_distance(unique_mat), 2, map.weights);
+  if (!nearly_equal(full_bic, unique_bic)) {
+    ostringstream msg;
+    msg << "Weighted BIC " << unique_bic << " != full BIC " << full_bic;
+    fail(msg.str());
+  }
+
+  // Weighted CLARA should match CLARA on the expanded points, where object i is repeated
+  // weights[i] times.  One heavy point near the end of a line of light points is where 
+  // weighting the samples both by how they're drawn and by weight drags the medoid to it.
+  vector<point> line, expanded_line;
+  vector<double> line_weights;
+  for (size_t i=0; i < 100; i++) {
+    line.push_back(point(i, 0));
+    line_weights.push_back(1);
+  }
+  line.push_back(point(90.5, 0));
+  line_weights.push_back(30);
+  for (size_t i=0; i < line.size(); i++) {
+    expanded_line.insert(expanded_line.end(), (size_t)line_weights[i], line[i]);
+  }
+
+  double weighted_avg = 0, expanded_avg = 0;
+  const size_t runs = 20;
+  for (size_t r=0; r < runs; r++) {
+    kmedoids weighted_km, expanded_km;
+    weighted_km.set_seed(r + 1);
+    expanded_km.set_seed(r + 1);
+    weighted_km.clara(line, line_weights, point_distance(), 1);
+    expanded_km.clara(expanded_line, point_distance(), 1);
+    weighted_avg += weighted_km.average_dissimilarity() / runs;
+    expanded_avg += expanded_km.average_dissimilarity() / runs;
+  }
+  if (!nearly_equal(weighted_avg, expanded_avg, 0.05)) {
+    ostringstream msg;
+    msg << "Weighted CLARA average " << weighted_avg 
+        << " differs from CLARA on expanded points " << expanded_avg;
+    fail(msg.str());
+  }
+
+  // Dense rows.
+  dense_dataset rows(2);
+  for (size_t i=0; i < n; i++) {
+    double coords[] = { points[i].x, points[i].y };
+    rows.push_back(coords);
+  }
+  dense_dataset unique_rows(2);
+  dedup_map row_map;
+  dedup(rows, unique_rows, row_map, dense_row_hash(), dense_row_equal());
+  if (row_map.weights != map.weights || row_map.mapping != map.mapping) {
+    fail("Dense rows deduplicated differently from points.");
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,128 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file dense_dataset_test.cpp
+/// @brief Checks dense distance kernels against naive versions and clusters a dense_dataset
+///        with CLARA.
+///
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include "kmedoids.h"
+#include "dense_dataset.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  size_t n = 2000;
+  if (argc > 1) {
+    n = strtol(argv[1], NULL, 0);
+  }
+
+  // odd dimension so that rows are padded.
+  const size_t dim = 7;
+  const size_t k   = 5;
+  synthetic_generator gen(dim, k, 7);
+  gen.set_overlap(0.02);
+
+  dense_dataset data(dim);
+  vector<size_t> labels(n);
+  vector<double> coords(dim);
+  for (size_t i=0; i < n; i++) {
+    gen.generate(i, &coords[0]);
+    labels[i] = gen.label(i);
+    data.push_back(&coords[0]);
+  }
+
+  if (data.size() != n || data.stride() % dense_lanes != 0) {
+    fail("bad dataset layout.");
+  }
+  if ((size_t)data.row_data(0) % dense_alignment != 0) {
+    fail("rows are not aligned.");
+  }
+
+  // compare kernels with naive implementations.
+  for (size_t i=0; i < 50; i++) {
+    dense_row a = data[i], b = data[n - 1 - i];
+    double e2 = 0, l1 = 0, ab = 0, aa = 0, bb = 0;
+    for (size_t d=0; d < dim; d++) {
+      e2 += (a[d] - b[d]) * (a[d] - b[d]);
+      l1 += fabs(a[d] - b[d]);
+      ab += a[d] * b[d];
+      aa += a[d] * a[d];
+      bb += b[d] * b[d];
+    }
+    if (!nearly_equal(dense_euclidean_distance()(a, b), sqrt(e2)))            fail("euclidean kernel.");
+    if (!nearly_equal(dense_manhattan_distance()(a, b), l1))                  fail("manhattan kernel.");
+    if (!nearly_equal(dense_cosine_distance()(a, b), 1 - ab / sqrt(aa * bb))) fail("cosine kernel.");
+
+    // owning copies must give the same answers as views.
+    dense_point pa(a);
+    if (dense_euclidean_distance()(pa, b) != dense_euclidean_distance()(a, b)) {
+      fail("dense_point distance differs from dense_row distance.");
+    }
+  }
+
+  // iterators should walk rows.
+  if (data.end() - data.begin() != (ptrdiff_t)n || (*(data.begin() + 3)).data() != data.row_data(3)) {
+    fail("bad iterator arithmetic.");
+  }
+
+  // well-separated clusters: CLARA should find the generated ones.
+  kmedoids km;
+  km.set_seed(1);
+  km.clara(data, dense_euclidean_distance(), k);
+
+  cluster::partition truth;
+  truth.cluster_ids = labels;
+  truth.medoid_ids.resize(k);
+  double mirkin = mirkin_distance(km, truth);
+  if (mirkin > 0.01) {
+    cerr << "Mirkin distance from truth: " << mirkin << endl;
+    fail("clara did not recover clusters.");
+  }
+
+  kmedoids xkm;
+  xkm.set_seed(1);
+  xkm.xclara(data, dense_euclidean_distance(), 2 * k, dim);
+  if (xkm.num_clusters() < 2) {
+    fail("xclara found a degenerate clustering.");
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,150 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file distance_cache_test.cpp
+/// @brief Checks that cached sample matrices match uncached ones, and that CLARA and
+///        XCLARA reuse distances through a pair_distance_cache.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include "kmedoids.h"
+#include "distance_cache.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// point_distance that counts how many times it's called.
+struct counting_distance {
+  size_t *calls;
+  counting_distance(size_t *c) : calls(c) { }
+  double operator()(const point& a, const point& b) {
+    (*calls)++;
+    return a.distance(b);
+  }
+};
+
+int main(int argc, char **argv) {
+  vector<point> points;
+  make_grid_points(500, 23, 5, 20, 3, 20, points);
+
+  // Two overlapping subsets.
+  vector<size_t> first, second;
+  for (size_t i=0; i < 60; i++) first.push_back(i * 3);
+  for (size_t i=0; i < 60; i++) second.push_back(i * 2);
+
+  size_t calls = 0;
+  pair_distance_cache cache(1 << 20);
+  dissimilarity_matrix cached, uncached;
+
+  build_dissimilarity_matrix(points, first, counting_distance(&calls), cached, cache);
+  if (cache.hits() != 0 || calls != 60 * 61 / 2) fail("First build should compute everything.");
+  if (cache.size() != 60 * 59 / 2) fail("Diagonal distances shouldn't be cached.");
+
+  // everything but the diagonal is either a hit or computed.
+  calls = 0;
+  build_dissimilarity_matrix(points, second, counting_distance(&calls), cached, cache);
+  build_dissimilarity_matrix(points, second, point_distance(), uncached);
+  if (cache.hits() == 0 || cache.hits() + cache.misses() != 2 * (60 * 59 / 2) 
+      || calls != 60 * 61 / 2 - cache.hits()) {
+    fail("Second build should reuse shared pairs.");
+  }
+  for (size_t i=0; i < second.size(); i++) {
+    for (size_t j=0; j <= i; j++) {
+      if (cached(i,j) != uncached(i,j)) fail("Cached matrix differs from uncached matrix.");
+    }
+  }
+
+  // Ids past 32 bits don't share entries with small ids.
+  if (sizeof(size_t) > 4) {
+    pair_distance_cache wide(1 << 20);
+    const size_t big = ((size_t)1 << 32) + 3;
+    wide.insert(3, 5, 1.0);
+    wide.insert(big, 5, 2.0);
+    double d;
+    if (!wide.lookup(5, big, d) || d != 2.0 || !wide.lookup(3, 5, d) || d != 1.0) {
+      fail("Large ids collided with small ones.");
+    }
+  }
+
+  // Memory budget is respected.
+  pair_distance_cache small(100 * pair_distance_cache::entry_size());
+  build_dissimilarity_matrix(points, first, point_distance(), cached, small);
+  if (small.size() != 100 || small.capacity() != 100) fail("Cache exceeded its budget.");
+  for (size_t i=0; i < first.size(); i++) {
+    for (size_t j=0; j <= i; j++) {
+      if (cached(i,j) != points[first[i]].distance(points[first[j]])) {
+        fail("Full cache gave wrong distances.");
+      }
+    }
+  }
+
+  // CLARA with the same seed gives the same answer with fewer distance calls.
+  size_t plain_calls = 0, cached_calls = 0;
+  kmedoids plain, with_cache;
+  plain.set_seed(42);
+  plain.set_max_reps(10);
+  plain.clara(points, counting_distance(&plain_calls), 5);
+
+  pair_distance_cache clara_cache(16 << 20);
+  with_cache.set_seed(42);
+  with_cache.set_max_reps(10);
+  with_cache.set_distance_cache(&clara_cache);
+  with_cache.clara(points, counting_distance(&cached_calls), 5);
+
+  if (plain.medoid_ids != with_cache.medoid_ids || plain.cluster_ids != with_cache.cluster_ids) {
+    fail("Cached CLARA found a different clustering.");
+  }
+  if (clara_cache.hits() == 0 || cached_calls != plain_calls - clara_cache.hits()) {
+    ostringstream msg;
+    msg << "Expected " << plain_calls << " - " << clara_cache.hits() 
+        << " distance calls, got " << cached_calls;
+    fail(msg.str());
+  }
+  cout << "CLARA hit rate:  " << clara_cache.hit_rate() << endl;
+
+  // XCLARA shares the cache across k.
+  pair_distance_cache xclara_cache(16 << 20);
+  kmedoids xkm;
+  xkm.set_distance_cache(&xclara_cache);
+  xkm.xclara(points, point_distance(), 8, 2);
+  if (xclara_cache.hit_rate() <= clara_cache.hit_rate()) {
+    fail("XCLARA should reuse more distances than a single CLARA run.");
+  }
+  cout << "XCLARA hit rate: " << xclara_cache.hit_rate() << endl;
+
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -93,6 +93,30 @@ int main(int argc, char **argv) {
   }
 
 
+  // node-aware embeddings, for the real nodes and for ranks dealt round-robin onto 3 nodes.
+  vector<int> nodes, cyclic(size);
+  get_node_ids(MPI_COMM_WORLD, nodes);
+  for (int r=0; r < size; r++) cyclic[r] = r % 3;
+
+  for (int root = 0; root < size; root++) {
+    all_points.clear();
+    gather(packable_vector<point>(&my_points, false), all_points, 
+           binomial_embedding(nodes, size, root), MPI_COMM_WORLD);
+    if (rank == root) {
+      verify(all_points, root);
+    }
+
+    all_points.clear();
+    allgather(packable_vector<point>(&my_points, false), all_points, 
+              binomial_embedding(cyclic, size, root), MPI_COMM_WORLD);
+    verify(all_points, root);
+  }
+
+  if (rank == 0 && verbose) {
+    cout << "Node-aware gathers PASSED" << endl;
+  }
+
+
   MPI_Finalize();
   return 0;
 }
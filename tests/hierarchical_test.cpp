@@ -0,0 +1,201 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file hierarchical_test.cpp
+/// @brief Checks NN-chain hierarchical clustering against naive agglomeration for each linkage.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <cstdlib>
+
+#include "hierarchical.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+static const char *names[] = { "single", "complete", "average", "ward" };
+
+/// Linkage distance between two clusters of points, straight from the definitions.
+static double linkage_distance(linkage method, const vector<point>& points, 
+                               const vector<size_t>& c1, const vector<size_t>& c2) {
+  if (method == ward_linkage) {
+    point m1(0,0), m2(0,0);
+    for (size_t i=0; i < c1.size(); i++) m1 += points[c1[i]];
+    for (size_t i=0; i < c2.size(); i++) m2 += points[c2[i]];
+    m1 /= c1.size();
+    m2 /= c2.size();
+    return sqrt(2.0 * c1.size() * c2.size() / (c1.size() + c2.size())) * m1.distance(m2);
+  }
+
+  double result = (method == single_linkage) ? DBL_MAX : 0;
+  for (size_t i=0; i < c1.size(); i++) {
+    for (size_t j=0; j < c2.size(); j++) {
+      double d = points[c1[i]].distance(points[c2[j]]);
+      if (method == single_linkage)        result = min(result, d);
+      else if (method == complete_linkage) result = max(result, d);
+      else                                 result += d / (c1.size() * c2.size());
+    }
+  }
+  return result;
+}
+
+/// O(n^3) agglomeration: repeatedly merge the closest pair of clusters.  Records merge 
+/// heights and the partition at every k.
+static void naive_cluster(linkage method, const vector<point>& points, 
+                          vector<double>& heights, vector<cluster::partition>& cuts) {
+  const size_t n = points.size();
+  vector< vector<size_t> > clusters(n);
+  for (size_t i=0; i < n; i++) clusters[i].push_back(i);
+
+  cuts.resize(n + 1);
+  while (true) {
+    // record partition with clusters.size() clusters, ordered by smallest id.
+    cluster::partition& p = cuts[clusters.size()];
+    p.cluster_ids.resize(n);
+    for (size_t c=0; c < clusters.size(); c++) {
+      p.medoid_ids.push_back(clusters[c][0]);
+      for (size_t i=0; i < clusters[c].size(); i++) p.cluster_ids[clusters[c][i]] = c;
+    }
+    if (clusters.size() == 1) break;
+
+    size_t best_a = 0, best_b = 1;
+    double best = DBL_MAX;
+    for (size_t a=0; a < clusters.size(); a++) {
+      for (size_t b=a+1; b < clusters.size(); b++) {
+        double d = linkage_distance(method, points, clusters[a], clusters[b]);
+        if (d < best) {
+          best = d;
+          best_a = a;
+          best_b = b;
+        }
+      }
+    }
+    heights.push_back(best);
+    clusters[best_a].insert(clusters[best_a].end(), clusters[best_b].begin(), clusters[best_b].end());
+    sort(clusters[best_a].begin(), clusters[best_a].end());
+    clusters.erase(clusters.begin() + best_b);
+  }
+}
+
+/// Clusters n objects whose distances are all fill (infinite, DBL_MAX, or NaN) and checks
+/// that every object still ends up merged exactly once into a single cluster.
+static void check_unreachable(linkage method, size_t n, double fill) {
+  dissimilarity_matrix mat(n, n);
+  for (size_t i=0; i < n; i++) {
+    for (size_t j=0; j < i; j++) mat(i,j) = fill;
+    mat(i,i) = 0;
+  }
+
+  dendrogram tree;
+  hierarchical_cluster(mat, method, tree);
+
+  ostringstream name;
+  name << names[method] << " with all distances " << fill;
+  if (tree.merges().size() != n-1) fail(name.str() + ": wrong number of merges.");
+
+  vector<char> merged(n, 0);
+  for (size_t m=0; m < n-1; m++) {
+    const cluster::merge& mg = tree.merges()[m];
+    if (mg.a >= mg.b || mg.b >= n || merged[mg.a] || merged[mg.b]) {
+      ostringstream msg;
+      msg << name.str() << ": bad merge " << mg;
+      fail(msg.str());
+    }
+    merged[mg.b] = 1;
+  }
+  if (tree.merges().back().size != n) fail(name.str() + ": last merge should contain everything.");
+}
+
+
+int main(int argc, char **argv) {
+  const size_t n = 60;
+  vector<point> points;
+  srand(29);
+  for (size_t i=0; i < n; i++) {
+    double cx = (i % 4) * 10;
+    points.push_back(point(cx + rand() / (double)RAND_MAX * 6, rand() / (double)RAND_MAX * 6));
+  }
+
+  for (int method = single_linkage; method <= ward_linkage; method++) {
+    dissimilarity_matrix mat;
+    build_dissimilarity_matrix(points, point_distance(), mat);
+
+    dendrogram tree;
+    hierarchical_cluster(mat, (linkage)method, tree);
+
+    vector<double> heights;
+    vector<cluster::partition> cuts;
+    naive_cluster((linkage)method, points, heights, cuts);
+
+    if (tree.merges().size() != n-1) fail("Wrong number of merges.");
+    for (size_t m=0; m < n-1; m++) {
+      if (fabs(tree.merges()[m].distance - heights[m]) > 1e-9 * max(1.0, heights[m])) {
+        ostringstream msg;
+        msg << names[method] << " merge " << m << " is " << tree.merges()[m] 
+            << ", expected height " << heights[m];
+        fail(msg.str());
+      }
+    }
+    if (tree.merges().back().size != n) fail("Last merge should contain everything.");
+
+    for (size_t k=1; k <= n; k++) {
+      cluster::partition p;
+      tree.cut(k, p);
+      if (p.num_clusters() != k || mirkin_distance(p, cuts[k]) != 0) {
+        ostringstream msg;
+        msg << names[method] << " cut into " << k << " clusters differs from naive clustering.";
+        fail(msg.str());
+      }
+    }
+
+    cluster::partition by_height;
+    tree.cut_height(heights[n-5], by_height);
+    if (by_height.num_clusters() != 4) fail("cut_height() gave the wrong number of clusters.");
+
+    cout << names[method] << ": top merge at " << tree.merges().back().distance << endl;
+  }
+
+  const double fills[] = { numeric_limits<double>::infinity(), DBL_MAX, numeric_limits<double>::quiet_NaN() };
+  for (int method = single_linkage; method <= ward_linkage; method++) {
+    for (size_t f=0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+      check_unreachable((linkage)method, 8, fills[f]);
+    }
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
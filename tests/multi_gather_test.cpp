@@ -44,6 +44,7 @@
 #include <boost/random.hpp>
 
 #include "multi_gather.h"
+#include "buffer_pool.h"
 #include "point.h"
 #include "random.h"
 #include "Timer.h"
@@ -156,6 +157,33 @@ int main(int argc, char **argv) {
     timer.record("verbose");
   }
 
+  // Repeating the same gathers with a shared pool should give the same results, and
+  // the pool should stop allocating after the first round.
+  buffer_pool pool;
+  size_t first_round_growths = 0;
+  for (int round=0; round < 3; round++) {
+    random_t round_random(1);
+    boost::random_number_generator<random_t> round_rng(round_random);
+
+    multi_gather<point> pooled(MPI_COMM_WORLD, 0, &pool);
+    vector<point> pooled_dest;
+    for (int root=0; root < size; root++) {
+      vector<int> cur_sources;
+      algorithm_r(size, (int)ceil(sqrt((double)size)), back_inserter(cur_sources), round_rng);
+      pooled.start(points.begin(), points.end(), cur_sources.begin(), cur_sources.end(), pooled_dest, root);
+    }
+    pooled.finish();
+
+    if (pooled_dest != dest) passed = 0;
+    if (round == 0) {
+      first_round_growths = pool.num_growths();
+    } else if (pool.num_growths() != first_round_growths) {
+      if (verbose) cerr << rank << " pool grew in round " << round << endl;
+      passed = 0;
+    }
+  }
+  timer.record("pooled_gathers");
+
   int num_passed = 0;
   MPI_Allreduce(&passed, &num_passed, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
   MPI_Finalize();
@@ -0,0 +1,190 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// @file nearest_medoids_test.cpp
+/// @brief Checks unrolled nearest-medoid searches and fixed-dimension dense distances against
+///        their generic versions.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include "kmedoids.h"
+#include "nearest_medoids.h"
+#include "dense_dataset.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// Candidate distances from a table, with candidate self standing for the object itself.
+struct table_candidates {
+  const vector<double>& distances;
+  size_t self;
+
+  table_candidates(const vector<double>& d, size_t s) : distances(d), self(s) { }
+
+  void operator()(size_t m, nearest_two& nearest) {
+    nearest.consider(m, distances[m], m == self);
+  }
+};
+
+/// Runs a search over a table of candidate distances.
+struct table_kernel {
+  table_candidates candidates;
+  nearest_two nearest;
+
+  table_kernel(const vector<double>& d, size_t self) : candidates(d, self), nearest(d.size()) { }
+
+  template <class Search>
+  void operator()(const Search& search) {
+    search.find(candidates, nearest);
+  }
+};
+
+/// Clusters a dense dataset with CLARA using whatever distance it's given.
+struct clara_kernel {
+  const dense_dataset& data;
+  size_t k;
+  kmedoids km;
+
+  clara_kernel(const dense_dataset& d, size_t _k) : data(d), k(_k) { km.set_seed(7); }
+
+  template <class D>
+  void operator()(D distance) {
+    km.clara(data, distance, k);
+  }
+};
+
+
+int main(int argc, char **argv) {
+  srand(7);
+
+  // Unrolled and looped searches should agree with each other and with a plain loop, 
+  // including ties (distances are small integers) and objects that are medoids.
+  for (size_t k=1; k <= max_unrolled_k + 4; k++) {
+    for (size_t trial=0; trial < 50; trial++) {
+      vector<double> distances(k);
+      for (size_t m=0; m < k; m++) distances[m] = rand() % 5;
+      size_t self = (trial % 2) ? rand() % k : k;
+
+      table_kernel unrolled(distances, self);
+      with_nearest_search(k, unrolled);
+
+      table_kernel looped(distances, self);
+      looped(looped_nearest_search(k));
+
+      size_t m1 = k, m2 = k;
+      double d1 = DBL_MAX, d2 = DBL_MAX;
+      for (size_t m=0; m < k; m++) {
+        if (distances[m] < d1 || m == self) {
+          d2 = d1; m2 = m1;
+          d1 = distances[m]; m1 = m;
+        } else if (distances[m] < d2) {
+          d2 = distances[m]; m2 = m;
+        }
+      }
+
+      const nearest_two* results[] = { &unrolled.nearest, &looped.nearest };
+      for (size_t r=0; r < 2; r++) {
+        if (results[r]->m1 != m1 || results[r]->m2 != m2 || 
+            results[r]->d1 != d1 || results[r]->d2 != d2) {
+          ostringstream msg;
+          msg << (r ? "looped" : "unrolled") << " search with k=" << k << " found "
+              << results[r]->m1 << "," << results[r]->m2 << ", expected " << m1 << "," << m2;
+          fail(msg.str());
+        }
+      }
+    }
+  }
+
+  // Fixed-dimension distances should match the generic ones.
+  for (size_t dim=1; dim <= 16; dim++) {
+    dense_dataset rows(dim);
+    vector<double> coords(dim);
+    for (size_t i=0; i < 2; i++) {
+      for (size_t d=0; d < dim; d++) coords[d] = rand() / (double)RAND_MAX - 0.5;
+      rows.push_back(&coords[0]);
+    }
+
+    double euclidean = dense_euclidean_distance()(rows[0], rows[1]);
+    double manhattan = dense_manhattan_distance()(rows[0], rows[1]);
+    double fixed_euclidean, fixed_manhattan;
+    switch (padded_dimension(dim)) {
+    case 4:
+      fixed_euclidean = dense_fixed_euclidean_distance<4>()(rows[0], rows[1]);
+      fixed_manhattan = dense_fixed_manhattan_distance<4>()(rows[0], rows[1]);
+      break;
+    case 8:
+      fixed_euclidean = dense_fixed_euclidean_distance<8>()(rows[0], rows[1]);
+      fixed_manhattan = dense_fixed_manhattan_distance<8>()(rows[0], rows[1]);
+      break;
+    case 12:
+      fixed_euclidean = dense_fixed_euclidean_distance<12>()(rows[0], rows[1]);
+      fixed_manhattan = dense_fixed_manhattan_distance<12>()(rows[0], rows[1]);
+      break;
+    default:
+      fixed_euclidean = dense_fixed_euclidean_distance<16>()(rows[0], rows[1]);
+      fixed_manhattan = dense_fixed_manhattan_distance<16>()(rows[0], rows[1]);
+      break;
+    }
+    if (!nearly_equal(euclidean, fixed_euclidean) || !nearly_equal(manhattan, fixed_manhattan)) {
+      ostringstream msg;
+      msg << "Fixed-dimension distances differ from generic ones for dimension " << dim;
+      fail(msg.str());
+    }
+  }
+
+  // CLARA with a distance picked by with_dense_euclidean() should match the generic distance.
+  const size_t dim = 7, k = 5;
+  synthetic_generator gen(dim, k, 7);
+  dense_dataset data(dim);
+  vector<double> coords(dim);
+  for (size_t i=0; i < 500; i++) {
+    gen.generate(i, &coords[0]);
+    data.push_back(&coords[0]);
+  }
+
+  clara_kernel fixed(data, k);
+  with_dense_euclidean(data.dimension(), fixed);
+  clara_kernel generic(data, k);
+  generic(dense_euclidean_distance());
+
+  if (fixed.km.medoid_ids != generic.km.medoid_ids || 
+      fixed.km.cluster_ids != generic.km.cluster_ids) {
+    fail("CLARA with a fixed-dimension distance found a different clustering.");
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,148 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_async_test.cpp
+/// @brief Checks that icapek() and ixcapek() find the same clusterings as capek() and 
+///        xcapek(), whether they're completed with test() or wait().
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+
+#include "par_kmedoids.h"
+#include "capek_request.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 30;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  // different numbers of points on each process, in four groups.
+  srand(41 + rank);
+  vector<point> local;
+  for (size_t i=0; i < per_process + rank; i++) {
+    double x = rand() / (double)RAND_MAX * 6 + (i % 2) * 10;
+    double y = rand() / (double)RAND_MAX * 6 + (i / 2 % 2) * 10;
+    local.push_back(point(x, y));
+  }
+
+  par_kmedoids blocking(MPI_COMM_WORLD);
+  blocking.set_seed(7);
+  vector<point> blocking_medoids;
+  blocking.capek(local, point_distance(), 4, &blocking_medoids);
+
+  // poll with test() while doing other work, including communication on the same communicator.
+  {
+    par_kmedoids async(MPI_COMM_WORLD);
+    async.set_seed(7);
+    vector<point> async_medoids;
+    capek_request<vector<point>, point_distance> req;
+    async.icapek(req, local, point_distance(), 4, &async_medoids);
+    if (!req.active()) fail(rank, "request isn't active after icapek().");
+
+    int one = 1, total = 0;
+    MPI_Allreduce(&one, &total, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (total != size) fail(rank, "application allreduce failed during icapek().");
+
+    while (!req.test()) { }
+    if (req.active()) fail(rank, "request is still active after test() returned true.");
+
+    if (!same_clustering(blocking, blocking_medoids, async, async_medoids)) {
+      fail(rank, "icapek() completed with test() differs from capek().");
+    }
+  }
+
+  // complete with wait(), reusing one request for two clusterings.
+  {
+    par_kmedoids async(MPI_COMM_WORLD);
+    async.set_seed(7);
+    vector<point> async_medoids;
+    capek_request<vector<point>, point_distance> req;
+    async.icapek(req, local, point_distance(), 4, &async_medoids);
+    req.wait();
+    if (!same_clustering(blocking, blocking_medoids, async, async_medoids)) {
+      fail(rank, "icapek() completed with wait() differs from capek().");
+    }
+
+    par_kmedoids xblocking(MPI_COMM_WORLD);
+    xblocking.set_seed(11);
+    vector<point> xblocking_medoids;
+    xblocking.xcapek(local, point_distance(), 6, 2, &xblocking_medoids);
+
+    par_kmedoids xasync(MPI_COMM_WORLD);
+    xasync.set_seed(11);
+    vector<point> xasync_medoids;
+    xasync.ixcapek(req, local, point_distance(), 6, 2, &xasync_medoids);
+    req.wait();
+
+    if (!same_clustering(xblocking, xblocking_medoids, xasync, xasync_medoids)) {
+      fail(rank, "ixcapek() differs from xcapek().");
+    }
+    // sums are reduced in a different layout, so scores may differ by rounding.
+    if (!nearly_equal(xblocking.bic_score(), xasync.bic_score())) {
+      ostringstream msg;
+      msg << "ixcapek() BIC " << xasync.bic_score() << " differs from xcapek() BIC " << xblocking.bic_score();
+      fail(rank, msg.str());
+    }
+
+    const map<size_t, double>& scores = xasync.get_k_scores();
+    const map<size_t, double>& expected = xblocking.get_k_scores();
+    if (scores.size() != expected.size()) fail(rank, "ixcapek() evaluated different k values from xcapek().");
+    for (map<size_t, double>::const_iterator s=scores.begin(), e=expected.begin(); s != scores.end(); s++, e++) {
+      if (s->first != e->first || !nearly_equal(s->second, e->second)) {
+        ostringstream msg;
+        msg << "ixcapek() score for k=" << s->first << " differs from xcapek().";
+        fail(rank, msg.str());
+      }
+    }
+  }
+
+  MPI_Finalize();
+  if (rank == 0) cout << "PASSED" << endl;
+  return 0;
+}
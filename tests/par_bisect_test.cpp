@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// @file par_bisect_test.cpp
+/// @brief Checks that par_kmedoids::xbisect() finds k for well-separated gaussian clusters.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include <boost/random.hpp>
+
+#include "par_kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 60;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  // Gaussian clusters at the corners of a 30x20 rectangle, spread over all processes.
+  const size_t num_clusters = 4;
+  boost::mt19937 rng(17 + rank);
+  boost::normal_distribution<double> normal(0, 1);
+  boost::variate_generator<boost::mt19937&, boost::normal_distribution<double> > noise(rng, normal);
+
+  vector<point> local;
+  for (size_t i=0; i < per_process; i++) {
+    size_t c = i % num_clusters;
+    local.push_back(point(30 * (c % 2) + noise(), 20 * (c / 2) + noise()));
+  }
+
+  par_kmedoids parkm(MPI_COMM_WORLD);
+  parkm.set_seed(17);
+
+  vector<point> medoids;
+  double score = parkm.xbisect(local, point_distance(), 3 * num_clusters, 2, &medoids);
+  if (medoids.size() != num_clusters || parkm.medoid_ids.size() != num_clusters) {
+    ostringstream msg;
+    msg << "xbisect found " << medoids.size() << " clusters, expected " << num_clusters;
+    fail(rank, msg.str());
+  }
+  if (score != parkm.bic_score()) {
+    fail(rank, "xbisect returned a different score than bic_score().");
+  }
+
+  // every object should be assigned to its nearest medoid.
+  for (size_t i=0; i < local.size(); i++) {
+    double d = local[i].distance(medoids[parkm.cluster_ids[i]]);
+    for (size_t m=0; m < medoids.size(); m++) {
+      if (local[i].distance(medoids[m]) < d) {
+        fail(rank, "object is not assigned to its nearest medoid.");
+      }
+    }
+  }
+
+  // max_k caps the number of splits.
+  par_kmedoids capped(MPI_COMM_WORLD);
+  capped.set_seed(17);
+  capped.xbisect(local, point_distance(), 3, 2, &medoids);
+  if (medoids.size() != 3) {
+    ostringstream msg;
+    msg << "xbisect with max_k=3 found " << medoids.size() << " clusters.";
+    fail(rank, msg.str());
+  }
+
+  if (rank == 0) {
+    cout << "PASSED" << endl;
+  }
+
+  MPI_Finalize();
+  return 0;
+}
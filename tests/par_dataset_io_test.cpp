@@ -0,0 +1,190 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_dataset_io_test.cpp
+/// @brief Loads a binary data set collectively with MPI-IO using unequal slices, and 
+///        clusters the slices with CAPEK.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+
+#include "par_kmedoids.h"
+#include "par_dataset_io.h"
+#include "point_set.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 50;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  // deliberately unequal slices: rank r gets per_process + 7r rows.
+  vector<size_t> counts(size), offsets(size + 1, 0);
+  for (int r=0; r < size; r++) {
+    counts[r] = per_process + 7 * r;
+    offsets[r+1] = offsets[r] + counts[r];
+  }
+  const size_t n = offsets[size];
+
+  const size_t dim = 5;
+  const size_t k   = 3;
+  synthetic_generator gen(dim, k, 13);
+  gen.set_overlap(0.02);
+
+  dense_dataset all(dim, n);
+  dataset_bounds expected_bounds(dim);
+  for (size_t i=0; i < n; i++) {
+    gen.generate(i, all.row_data(i));
+    expected_bounds.add(all.row_data(i));
+  }
+
+  // rank 0 writes the file and tells everyone its name.
+  char filename[64] = "/tmp/muster-par-XXXXXX";
+  if (rank == 0) {
+    close(mkstemp(filename));
+    write_binary_dataset(filename, all);
+  }
+  MPI_Bcast(filename, sizeof(filename), MPI_CHAR, 0, MPI_COMM_WORLD);
+
+  // unequal slices in rank order
+  dense_dataset local;
+  dataset_bounds bounds;
+  load_binary_dataset(filename, local, MPI_COMM_WORLD, counts[rank], &bounds);
+  if (local.size() != counts[rank] || local.dimension() != dim) {
+    fail(rank, "loaded slice has the wrong shape.");
+  }
+  for (size_t i=0; i < local.size(); i++) {
+    if (dense_euclidean_distance()(local[i], all[offsets[rank] + i]) != 0) {
+      fail(rank, "loaded slice has the wrong values.");
+    }
+  }
+  for (size_t d=0; d < dim; d++) {
+    if (bounds.min[d] != expected_bounds.min[d] || bounds.max[d] != expected_bounds.max[d]) {
+      fail(rank, "global bounds are wrong.");
+    }
+  }
+
+  // balanced slices cover everything exactly once.
+  dense_dataset balanced;
+  load_binary_dataset(filename, balanced, MPI_COMM_WORLD);
+  size_t first, last, total = 0;
+  balanced_slice(n, rank, size, &first, &last);
+  MPI_Allreduce(&last, &total, 1, MPI_SIZE_T, MPI_MAX, MPI_COMM_WORLD);
+  if (balanced.size() != last - first || total != n) {
+    fail(rank, "balanced slices don't cover the data set.");
+  }
+  if (balanced.size() && dense_euclidean_distance()(balanced[0], all[first]) != 0) {
+    fail(rank, "balanced slice starts at the wrong row.");
+  }
+
+  // arbitrary, overlapping slices; the last rank reads nothing.
+  dense_dataset slice;
+  size_t slice_count = (rank == size - 1) ? 0 : 10;
+  read_dataset_slice(filename, 3 * rank, slice_count, slice, MPI_COMM_WORLD);
+  if (slice.size() != slice_count || (slice_count && dense_euclidean_distance()(slice[9], all[3 * rank + 9]) != 0)) {
+    fail(rank, "read_dataset_slice read the wrong rows.");
+  }
+
+  // reading past the end fails everywhere, not just where it's wrong.
+  bool threw = false;
+  try {
+    read_dataset_slice(filename, (rank == 0) ? n : 0, 1, slice, MPI_COMM_WORLD);
+  } catch (const std::runtime_error& e) {
+    threw = true;
+  }
+  if (!threw) fail(rank, "reading past the end didn't throw.");
+
+  point_set points;
+  points.load_binary_file(filename, MPI_COMM_WORLD, counts[rank]);
+  if (points.size() != counts[rank] || points.min_x() != expected_bounds.min[0]) {
+    fail(rank, "point_set didn't load its slice.");
+  }
+
+  // capek on unequal slices: medoids must be assigned to themselves.
+  par_kmedoids parkm(MPI_COMM_WORLD);
+  parkm.set_seed(3);
+  parkm.capek(local, dense_euclidean_distance(), k);
+  if (parkm.cluster_ids.size() != local.size() || parkm.medoid_ids.size() != k) {
+    fail(rank, "capek produced wrong number of medoids or cluster ids.");
+  }
+  for (size_t m=0; m < parkm.medoid_ids.size(); m++) {
+    object_id id = parkm.medoid_ids[m];
+    if (id >= n) {
+      fail(rank, "medoid id out of range.");
+    }
+    if (id >= offsets[rank] && id < offsets[rank + 1] && parkm.cluster_ids[id - offsets[rank]] != m) {
+      fail(rank, "local medoid isn't in its own cluster.");
+    }
+  }
+
+  // gather handles unequal counts, and well-separated clusters are recovered exactly.
+  cluster::partition whole;
+  parkm.gather(whole, 0);
+  if (rank == 0) {
+    if (whole.size() != n) {
+      fail(rank, "gathered partition has the wrong size.");
+    }
+    cluster::partition truth;
+    truth.cluster_ids.resize(n);
+    truth.medoid_ids.resize(k);
+    for (size_t i=0; i < n; i++) {
+      truth.cluster_ids[i] = gen.label(i);
+    }
+    if (mirkin_distance(whole, truth) != 0) {
+      ostringstream msg;
+      msg << "capek didn't recover the clusters: mirkin distance " << mirkin_distance(whole, truth);
+      fail(rank, msg.str());
+    }
+    unlink(filename);
+    cout << "PASSED" << endl;
+  }
+
+  MPI_Finalize();
+  return 0;
+}
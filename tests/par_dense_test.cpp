@@ -0,0 +1,115 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_dense_test.cpp
+/// @brief Clusters a distributed dense_dataset with CAPEK and XCAPEK, and checks bulk packing.
+///
+#include <mpi.h>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "par_kmedoids.h"
+#include "dense_dataset.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 64;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  const size_t dim = 6;
+  const size_t k   = 4;
+  synthetic_generator gen(dim, k, 11);
+  gen.set_overlap(0.02);
+
+  uint64_t first = rank * per_process;
+  dense_dataset local(dim, per_process);
+  for (size_t i=0; i < per_process; i++) {
+    gen.generate(first + i, local.row_data(i));
+  }
+
+  // bulk pack/unpack round trip of a range of rows.
+  int bufsize = local.packed_size(3, 10, MPI_COMM_WORLD);
+  vector<char> buf(bufsize);
+  int pos = 0;
+  local.pack(3, 10, &buf[0], bufsize, &pos, MPI_COMM_WORLD);
+
+  dense_dataset copy;
+  pos = 0;
+  copy.unpack(&buf[0], bufsize, &pos, MPI_COMM_WORLD);
+  if (copy.size() != 7 || copy.dimension() != dim) {
+    fail(rank, "bulk unpack has wrong shape.");
+  }
+  for (size_t i=0; i < copy.size(); i++) {
+    if (dense_euclidean_distance()(copy[i], local[i + 3]) != 0) {
+      fail(rank, "bulk unpack has wrong values.");
+    }
+  }
+
+  par_kmedoids parkm(MPI_COMM_WORLD);
+  parkm.set_seed(5);
+
+  vector<dense_point> medoids;
+  parkm.capek(local, dense_euclidean_distance(), k, &medoids);
+  if (medoids.size() != k || parkm.cluster_ids.size() != per_process) {
+    fail(rank, "capek produced wrong number of medoids or cluster ids.");
+  }
+  for (size_t i=0; i < medoids.size(); i++) {
+    if (medoids[i].dimension() != dim) {
+      fail(rank, "medoid has wrong dimension.");
+    }
+  }
+
+  parkm.xcapek(local, dense_euclidean_distance(), 2 * k, dim, &medoids);
+  if (medoids.size() != parkm.medoid_ids.size()) {
+    fail(rank, "xcapek medoids do not match medoid ids.");
+  }
+
+  if (rank == 0) {
+    cout << "PASSED" << endl;
+  }
+
+  MPI_Finalize();
+  return 0;
+}
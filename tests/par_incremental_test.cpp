@@ -0,0 +1,137 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_incremental_test.cpp
+/// @brief Checks that recapek() keeps the previous medoids while the data barely changes, and
+///        runs new trials once it drifts.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cfloat>
+
+#include "par_kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// Four groups of points, each jittered around a corner of a square of the given side.
+static void make_points(vector<point>& local, size_t count, double side, double jitter) {
+  local.clear();
+  for (size_t i=0; i < count; i++) {
+    double x = rand() / (double)RAND_MAX * jitter + (i % 2) * side;
+    double y = rand() / (double)RAND_MAX * jitter + (i / 2 % 2) * side;
+    local.push_back(point(x, y));
+  }
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 30;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  srand(41 + rank);
+  vector<point> local;
+  make_points(local, per_process, 10, 6);
+
+  par_kmedoids parkm(MPI_COMM_WORLD);
+  parkm.set_seed(7);
+  vector<point> medoids;
+  parkm.capek(local, point_distance(), 4, &medoids);
+  const vector<object_id> first_ids = parkm.medoid_ids;
+
+  // a fresh sample of the same distribution shouldn't need new trials.
+  make_points(local, per_process, 10, 6);
+  if (parkm.recapek(local, point_distance(), medoids, 0.5, &medoids)) {
+    fail(rank, "recapek() ran new trials for data that barely changed.");
+  }
+  if (parkm.medoid_ids != first_ids) {
+    fail(rank, "recapek() changed medoids without running new trials.");
+  }
+  if (parkm.cluster_ids.size() != local.size()) {
+    fail(rank, "recapek() didn't assign all local objects.");
+  }
+  for (size_t o=0; o < local.size(); o++) {
+    double d = point_distance()(local[o], medoids[parkm.cluster_ids[o]]);
+    for (size_t m=0; m < medoids.size(); m++) {
+      if (point_distance()(local[o], medoids[m]) < d) {
+        fail(rank, "recapek() didn't assign an object to its nearest medoid.");
+      }
+    }
+  }
+
+  // move the groups far apart, so the old medoids are a poor fit.
+  make_points(local, per_process, 100, 6);
+  double stale = 0;
+  for (size_t o=0; o < local.size(); o++) {
+    double d = DBL_MAX;
+    for (size_t m=0; m < medoids.size(); m++) {
+      d = min(d, point_distance()(local[o], medoids[m]));
+    }
+    stale += d;
+  }
+  double stale_total;
+  MPI_Allreduce(&stale, &stale_total, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+  if (!parkm.recapek(local, point_distance(), medoids, 0.5, &medoids)) {
+    fail(rank, "recapek() kept the old medoids after the data drifted.");
+  }
+  if (medoids.size() != 4 || parkm.medoid_ids.size() != 4) {
+    fail(rank, "recapek() changed k.");
+  }
+  double fresh = parkm.average_dissimilarity() * size;
+  if (fresh >= stale_total) {
+    ostringstream msg;
+    msg << "new trials didn't improve on the old medoids: " << fresh << " vs. " << stale_total;
+    fail(rank, msg.str());
+  }
+
+  // the new clustering is the reference now, so the same data needs no new trials.
+  if (parkm.recapek(local, point_distance(), medoids, 0.5, &medoids)) {
+    fail(rank, "recapek() ran new trials right after re-clustering.");
+  }
+
+  MPI_Finalize();
+  if (rank == 0) cout << "PASSED" << endl;
+  return 0;
+}
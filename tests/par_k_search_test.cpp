@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// @file par_k_search_test.cpp
+/// @brief Checks that adaptive k searches in XCAPEK agree with exhaustive search.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include "par_kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// Runs xcapek with the silhouette criterion and returns the number of clusters found.
+static size_t search_k(const vector<point>& local, k_search_strategy strategy, size_t patience,
+                       size_t max_k, size_t *visited) {
+  par_kmedoids parkm(MPI_COMM_WORLD);
+  parkm.set_seed(17);
+  parkm.set_k_criterion(silhouette_criterion);
+  parkm.set_k_search(strategy);
+  parkm.set_k_patience(patience);
+
+  vector<point> medoids;
+  parkm.xcapek(local, point_distance(), max_k, 2, &medoids);
+  *visited = parkm.get_k_scores().size();
+  return medoids.size();
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 40;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  // Four uniformly filled squares.
+  srand(41 + rank);
+  vector<point> local;
+  for (size_t i=0; i < per_process; i++) {
+    size_t id = rank * per_process + i;
+    double x = rand() / (double)RAND_MAX * 6 + (id % 2) * 10;
+    double y = rand() / (double)RAND_MAX * 6 + (id / 2 % 2) * 10;
+    local.push_back(point(x, y));
+  }
+
+  const size_t max_k = 16;
+  size_t visited;
+  size_t k = search_k(local, exhaustive_k_search, 0, max_k, &visited);
+  if (k != 4 || visited != max_k) {
+    ostringstream msg;
+    msg << "exhaustive search found k=" << k << " visiting " << visited << " values of k.";
+    fail(rank, msg.str());
+  }
+
+  const char *names[] = { "patient exhaustive", "coarse-to-fine", "golden-section" };
+  k_search_strategy strategies[] = { exhaustive_k_search, coarse_to_fine_k_search, golden_section_k_search };
+  for (size_t s=0; s < 3; s++) {
+    size_t found = search_k(local, strategies[s], 2, max_k, &visited);
+    if (found != k || visited >= max_k) {
+      ostringstream msg;
+      msg << names[s] << " search found k=" << found << " visiting " << visited 
+          << " values of k, expected k=" << k << " with fewer than " << max_k << ".";
+      fail(rank, msg.str());
+    }
+  }
+
+  // with no objects anywhere, every strategy finds nothing and visits no k.
+  vector<point> empty;
+  for (size_t s=0; s < 3; s++) {
+    size_t found = search_k(empty, strategies[s], 0, max_k, &visited);
+    if (found != 0 || visited != 0) {
+      fail(rank, string(names[s]) + " search found clusters in an empty data set.");
+    }
+  }
+
+  if (rank == 0) {
+    cout << "PASSED" << endl;
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,116 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file par_silhouette_test.cpp
+/// @brief Picks k with the medoid silhouette in XCAPEK.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+
+#include "par_kmedoids.h"
+#include "silhouette.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 40;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  // Four uniformly filled squares.
+  srand(41 + rank);
+  vector<point> local;
+  for (size_t i=0; i < per_process; i++) {
+    size_t id = rank * per_process + i;
+    double x = rand() / (double)RAND_MAX * 6 + (id % 2) * 10;
+    double y = rand() / (double)RAND_MAX * 6 + (id / 2 % 2) * 10;
+    local.push_back(point(x, y));
+  }
+
+  par_kmedoids parkm(MPI_COMM_WORLD);
+  parkm.set_seed(17);
+  parkm.set_k_criterion(silhouette_criterion);
+
+  vector<point> medoids;
+  double score = parkm.xcapek(local, point_distance(), 8, 2, &medoids);
+  if (medoids.size() != 4) {
+    ostringstream msg;
+    msg << "xcapek with silhouette found " << medoids.size() << " clusters, expected 4.";
+    fail(rank, msg.str());
+  }
+
+  // Score should be the mean silhouette over all objects for the medoids found.
+  double local_sum = 0;
+  for (size_t i=0; i < local.size(); i++) {
+    double d1 = DBL_MAX, d2 = DBL_MAX;
+    for (size_t m=0; m < medoids.size(); m++) {
+      double d = local[i].distance(medoids[m]);
+      if (d < d1) {
+        d2 = d1;
+        d1 = d;
+      } else if (d < d2) {
+        d2 = d;
+      }
+    }
+    local_sum += medoid_silhouette(d1, d2);
+  }
+  double sum;
+  MPI_Allreduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  double expected = sum / (per_process * size);
+
+  if (fabs(score - expected) > 1e-9 || score != parkm.bic_score()) {
+    ostringstream msg;
+    msg << "xcapek silhouette was " << score << ", expected " << expected;
+    fail(rank, msg.str());
+  }
+
+  if (rank == 0) {
+    cout << "PASSED" << endl;
+  }
+
+  MPI_Finalize();
+  return 0;
+}
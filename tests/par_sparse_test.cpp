@@ -0,0 +1,119 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_sparse_test.cpp
+/// @brief Packs sparse vectors and clusters them with CAPEK and XCAPEK.
+///
+#include <mpi.h>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "par_kmedoids.h"
+#include "sparse_vector.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 60;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  // cluster c has support [c*stride, c*stride + dim) in a 10^6-dimensional space.
+  const size_t dim = 6, k = 3, stride = 300000;
+  synthetic_generator gen(dim, k, 41);
+  gen.set_overlap(0.05);
+
+  vector<sparse_vector> local(per_process);
+  vector<double> coords(dim);
+  for (size_t i=0; i < per_process; i++) {
+    size_t id = rank * per_process + i;
+    gen.generate(id, &coords[0]);
+    for (size_t d=0; d < dim; d++) {
+      local[i].push_back(gen.label(id) * stride + d, coords[d] + 1.0);
+    }
+  }
+
+  // packed size only depends on nonzeros.
+  int bufsize = local[0].packed_size(MPI_COMM_WORLD);
+  if ((size_t)bufsize > 4 + dim * 12 + 16) {
+    fail(rank, "sparse vectors don't pack compactly.");
+  }
+  vector<char> buf(bufsize);
+  int pos = 0;
+  local[0].pack(&buf[0], bufsize, &pos, MPI_COMM_WORLD);
+  pos = 0;
+  sparse_vector copy = sparse_vector::unpack(&buf[0], bufsize, &pos, MPI_COMM_WORLD);
+  if (sparse_euclidean_distance()(copy, local[0]) != 0 || copy.norm2() != local[0].norm2()) {
+    fail(rank, "unpacked sparse vector differs.");
+  }
+
+  par_kmedoids parkm(MPI_COMM_WORLD);
+  parkm.set_seed(9);
+
+  vector<sparse_vector> medoids;
+  parkm.capek(local, sparse_euclidean_distance(), k, &medoids);
+  if (medoids.size() != k || parkm.cluster_ids.size() != per_process) {
+    fail(rank, "capek produced wrong number of medoids or cluster ids.");
+  }
+
+  // objects with the same label should share a cluster.
+  for (size_t i=0; i < per_process; i++) {
+    size_t id = rank * per_process + i;
+    size_t m = parkm.cluster_ids[i];
+    if (gen.label(id) * stride != medoids[m].indices()[0]) {
+      fail(rank, "capek put an object in a cluster with a different support.");
+    }
+  }
+
+  parkm.xcapek(local, sparse_jaccard_distance(), 2 * k, dim, &medoids);
+  if (medoids.size() != parkm.medoid_ids.size()) {
+    fail(rank, "xcapek medoids do not match medoid ids.");
+  }
+
+  if (rank == 0) {
+    cout << "PASSED" << endl;
+  }
+
+  MPI_Finalize();
+  return 0;
+}
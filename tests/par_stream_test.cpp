@@ -0,0 +1,133 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_stream_test.cpp
+/// @brief Checks that par_stream_kmedoids finds the groups in its window, forgets expired
+///        objects, and keeps its summaries bounded.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include "par_stream_kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// Point jittered around corner i of a square with the given side and offset.
+static point make_point(size_t i, double side, double offset) {
+  double x = rand() / (double)RAND_MAX + (i % 2) * side + offset;
+  double y = rand() / (double)RAND_MAX + (i / 2 % 2) * side + offset;
+  return point(x, y);
+}
+
+/// Check that each corner of the square has a medoid within 2 of it.
+static void check_corners(int rank, const vector<point>& medoids, double side, double offset,
+                          const string& when) {
+  if (medoids.size() != 4) {
+    fail(rank, "expected 4 medoids " + when);
+  }
+  for (size_t c=0; c < 4; c++) {
+    point corner((c % 2) * side + offset + 0.5, (c / 2 % 2) * side + offset + 0.5);
+    bool found = false;
+    for (size_t m=0; m < medoids.size(); m++) {
+      if (corner.distance(medoids[m]) < 2) found = true;
+    }
+    if (!found) {
+      ostringstream msg;
+      msg << "no medoid near " << corner << " " << when;
+      fail(rank, msg.str());
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_step = 50;
+  if (argc > 1) {
+    per_step = strtol(argv[1], NULL, 0);
+  }
+
+  srand(23 + rank);
+  const size_t summary_size = 8, window_panes = 3;
+  par_stream_kmedoids<point, point_distance> stream(MPI_COMM_WORLD, point_distance(), 4, 
+                                                    summary_size, 0, window_panes);
+
+  // one pane per step, with the groups around one square for a while ...
+  for (size_t step=0; step < 5; step++) {
+    for (size_t i=0; i < per_step; i++) {
+      stream.add(make_point(i, 10, 0));
+    }
+    if (stream.local_summary_size() > window_panes * 2 * summary_size) {
+      fail(rank, "summary grew past its bound.");
+    }
+    stream.update();
+    stream.next_pane();
+  }
+  check_corners(rank, stream.medoids(), 10, 0, "in the first square");
+
+  if (stream.local_count() != window_panes * per_step) {
+    fail(rank, "window doesn't hold the last window_panes panes.");
+  }
+  if (stream.window_weight() != (double)(window_panes * per_step * size)) {
+    fail(rank, "summary weights don't add up to the window.");
+  }
+
+  // ... then around a square far away.  Once the old panes expire, the medoids move.
+  for (size_t step=0; step < window_panes; step++) {
+    for (size_t i=0; i < per_step; i++) {
+      stream.add(make_point(i, 10, 100));
+    }
+    stream.update();
+    stream.next_pane();
+  }
+  check_corners(rank, stream.medoids(), 10, 100, "after the old objects expired");
+
+  point p = make_point(3, 10, 100);
+  if (stream.nearest(p) >= stream.medoids().size() 
+      || p.distance(stream.medoids()[stream.nearest(p)]) > 3) {
+    fail(rank, "nearest() didn't find the nearby medoid.");
+  }
+
+  MPI_Finalize();
+  if (rank == 0) cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,160 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_subset_test.cpp
+/// @brief Checks that subset_capek() finds good medoids and gives every process the same 
+///        partition, including processes that hold no objects and so never participate.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+
+#include "par_kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 12;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  // only even ranks have objects: four groups jittered around the corners of a square.
+  srand(17 + rank);
+  vector<point> local;
+  if (rank % 2 == 0) {
+    for (size_t i=0; i < per_process; i++) {
+      double x = rand() / (double)RAND_MAX + (i % 2) * 10;
+      double y = rand() / (double)RAND_MAX + (i / 2 % 2) * 10;
+      local.push_back(point(x, y));
+    }
+  }
+
+  const size_t k = 4;
+  par_kmedoids subset(MPI_COMM_WORLD);
+  subset.set_seed(11);
+  subset.set_init_size(8);
+  vector<point> medoids;
+  subset.subset_capek(local, point_distance(), k, &medoids);
+
+  if (medoids.size() != k || subset.medoid_ids.size() != k) {
+    fail(rank, "subset_capek() didn't find k medoids.");
+  }
+  if (subset.cluster_ids.size() != local.size()) {
+    fail(rank, "subset_capek() didn't assign all local objects.");
+  }
+
+  // every process has the same medoids as rank 0.
+  vector<object_id> root_ids = subset.medoid_ids;
+  MPI_Bcast(&root_ids[0], k, MPI_SIZE_T, 0, MPI_COMM_WORLD);
+  if (root_ids != subset.medoid_ids) {
+    fail(rank, "processes have different medoids.");
+  }
+
+  // each group gets its own medoid.
+  for (size_t c=0; c < 4; c++) {
+    point corner((c % 2) * 10 + 0.5, (c / 2 % 2) * 10 + 0.5);
+    bool found = false;
+    for (size_t m=0; m < medoids.size(); m++) {
+      if (corner.distance(medoids[m]) < 2) found = true;
+    }
+    if (!found) {
+      ostringstream msg;
+      msg << "no medoid near " << corner;
+      fail(rank, msg.str());
+    }
+  }
+
+  for (size_t o=0; o < local.size(); o++) {
+    double d = point_distance()(local[o], medoids[subset.cluster_ids[o]]);
+    for (size_t m=0; m < medoids.size(); m++) {
+      if (point_distance()(local[o], medoids[m]) < d) {
+        fail(rank, "subset_capek() didn't assign an object to its nearest medoid.");
+      }
+    }
+  }
+
+  // total dissimilarity matches the assignment.
+  double local_sum = 0, sum;
+  for (size_t o=0; o < local.size(); o++) {
+    local_sum += point_distance()(local[o], medoids[subset.cluster_ids[o]]);
+  }
+  MPI_Allreduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  if (fabs(subset.average_dissimilarity() * size - sum) > 1e-9 * sum) {
+    fail(rank, "average_dissimilarity() doesn't match the assignment.");
+  }
+
+  // trials are judged by all objects, so the result is about as good as capek()'s.
+  par_kmedoids full(MPI_COMM_WORLD);
+  full.set_seed(11);
+  full.set_init_size(8);
+  vector<point> full_medoids;
+  full.capek(local, point_distance(), k, &full_medoids);
+  if (subset.average_dissimilarity() > 1.05 * full.average_dissimilarity()) {
+    ostringstream msg;
+    msg << "subset_capek() average " << subset.average_dissimilarity() 
+        << " is much worse than capek() average " << full.average_dissimilarity();
+    fail(rank, msg.str());
+  }
+
+  // reseeding draws the same samples, so this call reuses the cached participant communicator.
+  vector<object_id> first_ids = subset.medoid_ids;
+  subset.set_seed(11);
+  subset.subset_capek(local, point_distance(), k, &medoids);
+  if (subset.medoid_ids != first_ids) {
+    fail(rank, "subset_capek() with the same seed found different medoids.");
+  }
+
+  // the random state stays in step across processes, so calls can follow each other.
+  subset.subset_capek(local, point_distance(), k, &medoids);
+  root_ids = subset.medoid_ids;
+  MPI_Bcast(&root_ids[0], k, MPI_SIZE_T, 0, MPI_COMM_WORLD);
+  if (root_ids != subset.medoid_ids) {
+    fail(rank, "processes have different medoids on the second call.");
+  }
+
+  MPI_Finalize();
+  if (rank == 0) cout << "PASSED" << endl;
+  return 0;
+}
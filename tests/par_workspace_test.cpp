@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file par_workspace_test.cpp
+/// @brief Checks that CAPEK and XCAPEK give the same results with a shared workspace, and
+///        that the workspace stops growing once it has warmed up.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+#include "par_kmedoids.h"
+#include "capek_workspace.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  size_t per_process = 30;
+  if (argc > 1) {
+    per_process = strtol(argv[1], NULL, 0);
+  }
+
+  capek_workspace ws;
+  size_t warm_growths = 0;
+  size_t warm_capacity[3] = { 0, 0, 0 };
+
+  // one clustering per "timestep", as a simulation would do.
+  for (int step=0; step < 4; step++) {
+    srand(41 + rank + 1000 * step);
+    vector<point> local;
+    for (size_t i=0; i < per_process; i++) {
+      size_t id = rank * per_process + i;
+      double x = rand() / (double)RAND_MAX * 6 + (id % 2) * 10;
+      double y = rand() / (double)RAND_MAX * 6 + (id / 2 % 2) * 10;
+      local.push_back(point(x, y));
+    }
+
+    par_kmedoids fresh(MPI_COMM_WORLD);
+    fresh.set_seed(7);
+    vector<point> fresh_medoids;
+    fresh.capek(local, point_distance(), 4, &fresh_medoids);
+
+    par_kmedoids reused(MPI_COMM_WORLD);
+    reused.set_workspace(&ws);
+    reused.set_seed(7);
+    vector<point> reused_medoids;
+    reused.capek(local, point_distance(), 4, &reused_medoids);
+
+    if (!same_clustering(fresh, fresh_medoids, reused, reused_medoids)) {
+      fail(rank, "capek with a shared workspace differs from capek with a new one.");
+    }
+
+    // xcapek shares the workspace too.
+    fresh.xcapek(local, point_distance(), 6, 2, &fresh_medoids);
+    reused.xcapek(local, point_distance(), 6, 2, &reused_medoids);
+    if (!same_clustering(fresh, fresh_medoids, reused, reused_medoids)) {
+      fail(rank, "xcapek with a shared workspace differs from xcapek with a new one.");
+    }
+
+    // with the same seed, every step samples the same objects, so the packing buffers 
+    // and the gathers' scratch should stop growing after the first step.
+    buffer_pool::gather_scratch& scratch = ws.buffers.scratch();
+    size_t capacity[3] = { 
+      scratch.children.capacity(), scratch.sizes.capacity(), scratch.offsets.capacity() 
+    };
+    if (step == 0) {
+      warm_growths = ws.buffers.num_growths();
+      copy(capacity, capacity + 3, warm_capacity);
+    } else if (ws.buffers.num_growths() != warm_growths) {
+      ostringstream msg;
+      msg << "workspace buffers grew in step " << step;
+      fail(rank, msg.str());
+    } else if (!equal(capacity, capacity + 3, warm_capacity)) {
+      ostringstream msg;
+      msg << "gather scratch grew in step " << step;
+      fail(rank, msg.str());
+    }
+  }
+
+  // the node-aware embeddings for each round's trials are built once per size.
+  const binomial_embedding *embedding = &ws.node_embedding(MPI_COMM_WORLD, size);
+  if (ws.node_embedding(MPI_COMM_WORLD, 1).size() != 1 
+      || &ws.node_embedding(MPI_COMM_WORLD, size) != embedding || embedding->size() != size) {
+    fail(rank, "node_embedding() rebuilt a cached embedding.");
+  }
+
+  MPI_Finalize();
+  if (rank == 0) cout << "PASSED" << endl;
+  return 0;
+}
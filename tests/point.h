@@ -98,11 +98,11 @@ namespace cluster {
       return *this;
     }
 
-    bool operator==(const point& other) { 
+    bool operator==(const point& other) const { 
       return x == other.x && y == other.y;
     }
 
-    bool operator!=(const point& other) { 
+    bool operator!=(const point& other) const { 
       return !(*this == other);
     }
 
@@ -37,12 +37,14 @@
 
 #include <limits>
 #include <algorithm>
+#include <stdexcept>
 
 #include <boost/algorithm/string.hpp>
 
 #ifdef MUSTER_HAVE_MPI
 #include "mpi_utils.h"
 #include "mpi_bindings.h"
+#include "par_dataset_io.h"
 #endif // MUSTER_HAVE_MPI
 
 using namespace boost;
@@ -52,10 +54,10 @@ using namespace std;
 namespace cluster {
 
   point_set::point_set()
-    : min_x_(numeric_limits<double>::min()),
-      max_x_(numeric_limits<double>::max()),
-      min_y_(numeric_limits<double>::min()),
-      max_y_(numeric_limits<double>::max())
+    : min_x_( numeric_limits<double>::infinity()),
+      max_x_(-numeric_limits<double>::infinity()),
+      min_y_( numeric_limits<double>::infinity()),
+      max_y_(-numeric_limits<double>::infinity())
   { }
 
   point_set::~point_set() { }
@@ -65,7 +67,7 @@ namespace cluster {
     max_x_ = max(p.x, max_x_);
     min_y_ = min(p.y, min_y_);
     max_y_ = max(p.y, max_y_);
-
+    points_.push_back(p);
   }
 
   void point_set::normalize() {
@@ -88,7 +90,7 @@ namespace cluster {
     }
 
     for (size_t i=1; i < values.size(); i += 2) {
-      points_.push_back(point(values[i-1], values[i]));
+      add_point(values[i-1], values[i]);
     }
   }
 
@@ -109,7 +111,7 @@ namespace cluster {
     Y = strtod(parts[1].c_str(), &err);
     if (*err) return;
 
-    points_.push_back(point(X,Y));
+    add_point(X, Y);
   }
 
 
@@ -122,6 +124,41 @@ namespace cluster {
   }
 
 
+  void point_set::add_dataset(const dense_dataset& data, const dataset_bounds& bounds) {
+    if (!data.size()) return;
+    if (data.dimension() < 2) {
+      throw runtime_error("point_set needs data with at least two dimensions.");
+    }
+
+    points_.reserve(points_.size() + data.size());
+    for (size_t i=0; i < data.size(); i++) {
+      const double *row = data.row_data(i);
+      points_.push_back(point(row[0], row[1]));
+    }
+
+    min_x_ = min(bounds.min[0], min_x_);
+    max_x_ = max(bounds.max[0], max_x_);
+    min_y_ = min(bounds.min[1], min_y_);
+    max_y_ = max(bounds.max[1], max_y_);
+  }
+
+
+  void point_set::load_csv_file(const string& filename, int num_threads) {
+    dense_dataset data;
+    dataset_bounds bounds;
+    load_csv_dataset(filename, data, &bounds, num_threads);
+    add_dataset(data, bounds);
+  }
+
+
+  void point_set::load_binary_file(const string& filename) {
+    dense_dataset data;
+    dataset_bounds bounds;
+    load_binary_dataset(filename, data, &bounds);
+    add_dataset(data, bounds);
+  }
+
+
   void point_set::write_csv_file(ostream& out, partition *clustering) {
     out.setf(std::ios::fixed);
     for (size_t i = 0; i < points_.size(); i++) {
@@ -134,6 +171,14 @@ namespace cluster {
   }
 
 #ifdef MUSTER_HAVE_MPI
+  void point_set::load_binary_file(const string& filename, MPI_Comm comm, size_t local_count) {
+    dense_dataset data;
+    dataset_bounds bounds;
+    load_binary_dataset(filename, data, comm, local_count, &bounds);
+    add_dataset(data, bounds);
+  }
+
+
   void scatter(point_set& points, int root, MPI_Comm comm) {
     int rank, size;
     CMPI_Comm_rank(comm, &rank);
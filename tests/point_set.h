@@ -44,6 +44,7 @@
 #include <string>
 #include <iostream>
 #include "point.h"
+#include "dataset_io.h"
 
 namespace cluster {
 
@@ -79,6 +80,29 @@ namespace cluster {
     ///
     void load_csv_file(std::istream& input);
 
+    ///
+    /// Loads a csv file by name using the parallel loader in dataset_io.h.  Bounds
+    /// for normalize() are computed while parsing.  Columns past the first two are 
+    /// ignored.
+    ///
+    void load_csv_file(const std::string& filename, int num_threads = 0);
+
+    ///
+    /// Loads a binary data set file (see dataset_io.h) of dimension 2 or more by 
+    /// mapping it into memory.
+    ///
+    void load_binary_file(const std::string& filename);
+
+#ifdef MUSTER_HAVE_MPI
+    ///
+    /// Collectively loads this process's slice of a binary data set with MPI-IO (see 
+    /// par_dataset_io.h).  By default rows are split evenly; otherwise this process reads 
+    /// local_count rows following those of lower ranks.  Bounds are global.
+    ///
+    void load_binary_file(const std::string& filename, MPI_Comm comm, 
+                          size_t local_count = (size_t)-1);
+#endif // MUSTER_HAVE_MPI
+
 
     ///
     /// Write a csv file out, optionally including information about
@@ -103,6 +127,9 @@ namespace cluster {
   private:
     std::vector<point> points_;
 
+    /// Append the first two columns of data, with their bounds.
+    void add_dataset(const dense_dataset& data, const dataset_bounds& bounds);
+
     double min_x_, max_x_;
     double min_y_, max_y_;
 
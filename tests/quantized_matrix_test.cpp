@@ -0,0 +1,161 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file quantized_matrix_test.cpp
+/// @brief Checks quantization error bounds of compressed dissimilarity matrices, and 
+///        that PAM and XPAM find the same clusterings on them as on exact matrices.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include "kmedoids.h"
+#include "quantized_matrix.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+template <class Matrix>
+static void check_error(const dissimilarity_matrix& exact, const Matrix& quantized, const string& what) {
+  if (quantized.size1() != exact.size1() || quantized.size2() != exact.size2()) {
+    fail(what + ": wrong size");
+  }
+  // allow a little slack for floating point error in decoding.
+  double bound = quantized.max_error() * (1 + 1e-9) + 1e-12;
+  for (size_t i=0; i < exact.size1(); i++) {
+    for (size_t j=0; j < exact.size2(); j++) {
+      if (fabs(quantized(i,j) - exact(i,j)) > bound) {
+        ostringstream msg;
+        msg << what << ": entry (" << i << "," << j << ") is " << quantized(i,j) 
+            << ", expected " << exact(i,j) << " +/- " << bound;
+        fail(msg.str());
+      }
+    }
+    if (quantized(i,i) != 0) {
+      fail(what + ": diagonal isn't exactly zero");
+    }
+  }
+}
+
+template <class Matrix>
+static void check_pam(const dissimilarity_matrix& exact, const Matrix& quantized, 
+                      const dense_dataset& data, size_t k, const string& what) {
+  kmedoids exact_km;
+  exact_km.pam(exact, k);
+
+  kmedoids km;
+  km.pam(quantized, k);
+  if (mirkin_distance(km, exact_km) != 0) {
+    fail(what + ": PAM found a different clustering than with exact distances");
+  }
+
+  double exact_cost = exact_km.average_dissimilarity() * exact_km.size();
+  double rechecked  = km.recheck_cost(lazy_distance(data, dense_euclidean_distance()));
+  if (fabs(rechecked - exact_cost) > 1e-9 * exact_cost) {
+    fail(what + ": rechecked cost doesn't match the exact cost");
+  }
+  if (km.recheck_cost(make_matrix_distance(exact), true) > rechecked * (1 + 1e-12)) {
+    fail(what + ": exact reassignment increased the cost");
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t n = 300;
+  if (argc > 1) {
+    n = strtol(argv[1], NULL, 0);
+  }
+
+  const size_t dim = 4;
+  const size_t k   = 5;
+  synthetic_generator gen(dim, k, 17);
+  gen.set_overlap(0.03);
+
+  dense_dataset data(dim, n);
+  for (size_t i=0; i < n; i++) {
+    gen.generate(i, data.row_data(i));
+  }
+
+  dissimilarity_matrix exact;
+  build_dissimilarity_matrix(data, dense_euclidean_distance(), exact);
+
+  quantized_matrix global16;
+  build_dissimilarity_matrix(data, dense_euclidean_distance(), global16);
+  check_error(exact, global16, "global 16-bit");
+
+  quantized_matrix blocked16(50);   // rounds up to 64 rows per block
+  build_dissimilarity_matrix(data, dense_euclidean_distance(), blocked16);
+  check_error(exact, blocked16, "blocked 16-bit");
+  if (blocked16.block_rows() != 64) {
+    fail("block size wasn't rounded up to a power of two");
+  }
+
+  quantized8_matrix global8;
+  quantize(exact, global8);
+  check_error(exact, global8, "global 8-bit");
+
+  // a subset matrix should match the corresponding piece of the full one.
+  vector<size_t> subset;
+  for (size_t i=0; i < n; i += 3) subset.push_back(i);
+  quantized_matrix sub16(16);
+  build_dissimilarity_matrix(data, subset, dense_euclidean_distance(), sub16);
+  for (size_t i=0; i < subset.size(); i++) {
+    for (size_t j=0; j < subset.size(); j++) {
+      if (fabs(sub16(i,j) - exact(subset[i], subset[j])) > sub16.max_error() * (1 + 1e-9) + 1e-12) {
+        fail("subset matrix has the wrong entries");
+      }
+    }
+  }
+
+  // 16-bit storage should be about 4x smaller than packed doubles.
+  double exact_bytes = n * (n + 1) / 2 * sizeof(double);
+  if (global16.bytes() > exact_bytes / 4 + 64) {
+    fail("16-bit matrix isn't 4x smaller");
+  }
+
+  check_pam(exact, global16, data, k, "global 16-bit");
+  check_pam(exact, blocked16, data, k, "blocked 16-bit");
+
+  kmedoids xkm;
+  xkm.xpam(global16, 2 * k, dim);
+  if (xkm.num_clusters() != k) {
+    ostringstream msg;
+    msg << "xpam on a quantized matrix found " << xkm.num_clusters() << " clusters, expected " << k;
+    fail(msg.str());
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
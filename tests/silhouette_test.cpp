@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file silhouette_test.cpp
+/// @brief Checks the medoid silhouette and its use for picking k in xpam() and xclara().
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include "kmedoids.h"
+#include "silhouette.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// Four uniformly filled squares: not gaussian, but well separated.
+static void make_squares(size_t n, vector<point>& points) {
+  srand(41);
+  for (size_t i=0; i < n; i++) {
+    double x = rand() / (double)RAND_MAX * 6 + (i % 2) * 10;
+    double y = rand() / (double)RAND_MAX * 6 + (i / 2 % 2) * 10;
+    points.push_back(point(x, y));
+  }
+}
+
+
+int main(int argc, char **argv) {
+  vector<point> points;
+  make_squares(160, points);
+
+  dissimilarity_matrix mat;
+  build_dissimilarity_matrix(points, point_distance(), mat);
+
+  // Check the silhouette of a PAM clustering against the definition.
+  kmedoids km;
+  km.pam(mat, 4);
+  double expected = 0;
+  for (size_t i=0; i < points.size(); i++) {
+    double d1 = mat(i, km.medoid_ids[km.cluster_ids[i]]);
+    double d2 = 1e300;
+    for (size_t m=0; m < km.num_clusters(); m++) {
+      if (m != km.cluster_ids[i]) d2 = min(d2, mat(i, km.medoid_ids[m]));
+    }
+    expected += 1 - d1 / d2;
+  }
+  expected /= points.size();
+
+  double actual = medoid_silhouette(km, matrix_distance(mat));
+  if (fabs(actual - expected) > 1e-12) {
+    ostringstream msg;
+    msg << "Silhouette was " << actual << ", expected " << expected;
+    fail(msg.str());
+  }
+
+  kmedoids one;
+  one.pam(mat, 1);
+  if (medoid_silhouette(one, matrix_distance(mat)) != 0) fail("Silhouette of one cluster should be 0.");
+
+  // Silhouette should find the four squares.
+  kmedoids bic_km, sil_km, sil_clara;
+  bic_km.xpam(mat, 8, 2);
+
+  sil_km.set_k_criterion(silhouette_criterion);
+  double best = sil_km.xpam(mat, 8, 2);
+  if (sil_km.num_clusters() != 4) {
+    ostringstream msg;
+    msg << "xpam() with silhouette found " << sil_km.num_clusters() << " clusters, expected 4.";
+    fail(msg.str());
+  }
+  if (fabs(best - medoid_silhouette(sil_km, matrix_distance(mat))) > 1e-12) {
+    fail("xpam() returned the wrong silhouette.");
+  }
+
+  sil_clara.set_k_criterion(silhouette_criterion);
+  sil_clara.set_seed(7);
+  sil_clara.xclara(points, point_distance(), 8, 2);
+  if (sil_clara.num_clusters() != 4) {
+    ostringstream msg;
+    msg << "xclara() with silhouette found " << sil_clara.num_clusters() << " clusters, expected 4.";
+    fail(msg.str());
+  }
+
+  cout << "BIC chose k = " << bic_km.num_clusters() 
+       << ", silhouette chose k = " << sil_km.num_clusters() << endl;
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,151 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file sparse_vector_test.cpp
+/// @brief Checks sparse distance kernels against dense ones, and clusters sparse vectors
+///        with CLARA and XCLARA.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include "kmedoids.h"
+#include "sparse_vector.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+/// Sparse objects whose support depends on their cluster: cluster c uses indices 
+/// [c*stride, c*stride + dim), with values from the synthetic generator.
+static void make_objects(size_t n, size_t k, vector<sparse_vector>& objects, 
+                         cluster::partition& truth) {
+  const size_t dim = 8, stride = 50;
+  synthetic_generator gen(dim, k, 31);
+  gen.set_overlap(0.05);
+
+  objects.resize(n);
+  truth.cluster_ids.resize(n);
+  truth.medoid_ids.resize(k);
+  vector<double> coords(dim);
+  for (size_t i=0; i < n; i++) {
+    size_t c = gen.label(i);
+    gen.generate(i, &coords[0]);
+    sparse_vector v;
+    for (size_t d=0; d < dim; d++) {
+      v.push_back(c * stride + d, coords[d] + 1.0);
+    }
+    objects[i].swap(v);
+    truth.cluster_ids[i] = c;
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t n = 1000;
+  if (argc > 1) {
+    n = strtol(argv[1], NULL, 0);
+  }
+
+  // kernels against dense equivalents, with overlapping and disjoint supports.
+  const size_t dim = 37;
+  vector<double> a(dim, 0.0), b(dim, 0.0);
+  for (size_t i=0; i < dim; i += 3) a[i] = 1.0 + i;
+  for (size_t i=0; i < dim; i += 2) b[i] = 2.0 - 0.1 * i;
+  sparse_vector sa(&a[0], dim), sb(&b[0], dim);
+
+  double d2 = 0, dot = 0, aa = 0, bb = 0, mins = 0, maxes = 0;
+  for (size_t i=0; i < dim; i++) {
+    d2  += (a[i] - b[i]) * (a[i] - b[i]);
+    dot += a[i] * b[i];
+    aa  += a[i] * a[i];
+    bb  += b[i] * b[i];
+    mins  += min(fabs(a[i]), fabs(b[i]));
+    maxes += max(fabs(a[i]), fabs(b[i]));
+  }
+  if (!nearly_equal(sparse_euclidean_distance()(sa, sb), sqrt(d2))) fail("wrong Euclidean distance");
+  if (!nearly_equal(sparse_squared_euclidean_merge(sa, sb), d2))   fail("wrong merged Euclidean distance");
+  if (!nearly_equal(sparse_cosine_distance()(sa, sb), 1 - dot / sqrt(aa * bb))) fail("wrong cosine distance");
+  if (sa.nnz() != 13 || sa[3] != 4.0 || sa[4] != 0.0)  fail("wrong sparse representation");
+
+  // identical vectors must be exactly zero apart despite the norm-based fast path.
+  sparse_vector sc = sa + sparse_vector();
+  if (sparse_euclidean_distance()(sa, sc) != 0) fail("identical vectors aren't at distance 0");
+
+  // jaccard on 0/1 vectors is set jaccard.
+  sparse_vector s1, s2;
+  s1.push_back(1, 1);  s1.push_back(2, 1);  s1.push_back(5, 1);
+  s2.push_back(2, 1);  s2.push_back(5, 1);  s2.push_back(9, 1);  s2.push_back(11, 1);
+  if (!nearly_equal(sparse_jaccard_distance()(s1, s2), 1 - 2.0 / 5.0)) fail("wrong Jaccard distance");
+
+  // means for center_medoids.
+  sparse_vector mean = (sa + sb) / 2;
+  for (size_t i=0; i < dim; i++) {
+    if (!nearly_equal(mean[i], (a[i] + b[i]) / 2)) fail("wrong sparse mean");
+  }
+  if (!nearly_equal(mean.norm2(), sparse_dot(mean, mean))) fail("cached norm is stale");
+
+  bool threw = false;
+  try {
+    sa.push_back(0, 1.0);
+  } catch (const std::logic_error&) {
+    threw = true;
+  }
+  if (!threw) fail("out-of-order push_back didn't throw");
+
+  // clustering
+  const size_t k = 4;
+  vector<sparse_vector> objects;
+  cluster::partition truth;
+  make_objects(n, k, objects, truth);
+
+  kmedoids km;
+  km.set_seed(7);
+  km.clara(objects, sparse_euclidean_distance(), k);
+  if (mirkin_distance(km, truth) != 0) fail("clara didn't recover sparse clusters");
+
+  km.center_medoids(objects, sparse_euclidean_distance());
+  
+  kmedoids xkm;
+  xkm.set_seed(7);
+  xkm.xclara(objects, sparse_cosine_distance(), 2 * k, 8);
+  if (xkm.num_clusters() < k) {
+    ostringstream msg;
+    msg << "xclara found only " << xkm.num_clusters() << " clusters";
+    fail(msg.str());
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,259 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file synthetic_generator.h
+/// @brief Deterministic, random-access generator for large synthetic clustering data sets.
+///
+#ifndef SYNTHETIC_GENERATOR_H
+#define SYNTHETIC_GENERATOR_H
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "point.h"
+
+namespace cluster {
+
+  ///
+  /// Generates gaussian clusters in an arbitrary number of dimensions, without any shared
+  /// generator state.  Every coordinate and label is a pure function of the seed and the
+  /// <i>global</i> index of the object, so any rank (or any thread within a rank) can
+  /// produce any slice of the data set independently, in any order, and get exactly the
+  /// same values it would have gotten by generating the whole set serially.  Nothing needs
+  /// to be stored, so this scales to data sets with billions of objects.
+  ///
+  /// Cluster centers are drawn uniformly from the unit hypercube.  Each object picks its
+  /// cluster at random with probability proportional to the cluster's weight, and its 
+  /// coordinates are normally distributed around that cluster's center.
+  ///
+  /// <b>Example usage:</b>
+  /// @code
+  /// synthetic_generator gen(8, 20, seed);   // 8 dimensions, 20 clusters
+  /// gen.set_overlap(0.25);
+  /// gen.set_imbalance(10);                  // largest cluster 10x bigger than the smallest
+  ///
+  /// uint64_t first, last;
+  /// synthetic_generator::slice(1000000000, rank, size, &first, &last);
+  /// std::vector<double> coords((last - first) * gen.dimension());
+  /// gen.generate(first, last, &coords[0]);
+  /// @endcode
+  ///
+  class synthetic_generator {
+  public:
+    ///
+    /// Construct a generator for data with the supplied dimensionality and number of clusters.
+    /// Generators constructed with the same arguments produce identical data everywhere.
+    ///
+    synthetic_generator(size_t dimension, size_t num_clusters, uint64_t seed = 0)
+      : dimension_(dimension), num_clusters_(num_clusters), seed_(seed), 
+        overlap_(0.1), imbalance_(1.0)
+    {
+      if (!dimension_ || !num_clusters_) {
+        throw std::logic_error("synthetic_generator needs at least one dimension and one cluster.");
+      }
+
+      centers_.resize(num_clusters_ * dimension_);
+      for (size_t c=0; c < num_clusters_; c++) {
+        for (size_t d=0; d < dimension_; d++) {
+          centers_[c * dimension_ + d] = uniform(center_stream, c, d);
+        }
+      }
+      update_weights();
+      update_stddev();
+    }
+
+    ///
+    /// Set overlap between clusters.  This is the standard deviation of each cluster
+    /// as a fraction of the expected spacing between centers in the unit hypercube, 
+    /// <code>num_clusters^(-1/dimension)</code>.  Values well below 0.5 give separated clusters;
+    /// values near or above 1 give heavily overlapping ones.  Default is 0.1.
+    ///
+    void set_overlap(double overlap) {
+      overlap_ = overlap;
+      update_stddev();
+    }
+
+    ///
+    /// Set imbalance between cluster sizes.  This is the ratio between the expected sizes
+    /// of the largest and smallest clusters.  Sizes decay geometrically from the first 
+    /// cluster to the last.  Default is 1, i.e. all clusters have the same expected size.
+    ///
+    void set_imbalance(double imbalance) {
+      if (imbalance < 1.0) {
+        throw std::logic_error("Imbalance must be at least 1.");
+      }
+      imbalance_ = imbalance;
+      update_weights();
+    }
+
+    size_t   dimension()    const { return dimension_; }
+    size_t   num_clusters() const { return num_clusters_; }
+    uint64_t seed()         const { return seed_; }
+    double   overlap()      const { return overlap_; }
+    double   imbalance()    const { return imbalance_; }
+    double   stddev()       const { return stddev_; }
+
+    /// Coordinates of the center of cluster c.
+    const double *center(size_t c) const { return &centers_[c * dimension_]; }
+
+    /// Fraction of all objects expected to fall in cluster c.
+    double weight(size_t c) const { 
+      return cumulative_[c] - (c ? cumulative_[c-1] : 0.0);
+    }
+
+    ///
+    /// Ground-truth cluster for the object with global index i.
+    ///
+    size_t label(uint64_t i) const {
+      double u = uniform(label_stream, i, 0);
+      size_t c = std::upper_bound(cumulative_.begin(), cumulative_.end(), u) - cumulative_.begin();
+      return std::min(c, num_clusters_ - 1);
+    }
+
+    ///
+    /// Write the dimension() coordinates of the object with global index i to coords.
+    ///
+    void generate(uint64_t i, double *coords) const {
+      const double *c = center(label(i));
+      for (size_t d=0; d < dimension_; d += 2) {
+        // Box-Muller gives us two independent normals per pair of uniforms.
+        double u1 = 1.0 - uniform(point_stream, i, d);   // in (0,1], safe for log()
+        double u2 = uniform(point_stream, i, d + 1);
+        double r  = stddev_ * std::sqrt(-2.0 * std::log(u1));
+        coords[d] = c[d] + r * std::cos(2 * M_PI * u2);
+        if (d + 1 < dimension_) {
+          coords[d+1] = c[d+1] + r * std::sin(2 * M_PI * u2);
+        }
+      }
+    }
+
+    ///
+    /// Write coordinates for objects [first, last) to coords, one row of dimension() 
+    /// doubles per object.  If labels is non-NULL, ground-truth labels are written there too.
+    ///
+    void generate(uint64_t first, uint64_t last, double *coords, size_t *labels = NULL) const {
+      for (uint64_t i=first; i < last; i++) {
+        generate(i, coords);
+        coords += dimension_;
+        if (labels) *labels++ = label(i);
+      }
+    }
+
+    ///
+    /// Convenience for 2-dimensional generators: get object i as a point.
+    ///
+    point get_point(uint64_t i) const {
+      if (dimension_ != 2) {
+        throw std::logic_error("get_point() requires a 2-dimensional generator.");
+      }
+      double coords[2];
+      generate(i, coords);
+      return point(coords[0], coords[1]);
+    }
+
+    ///
+    /// Append points for objects [first, last) to the points vector.  2-D generators only.
+    ///
+    void generate_points(uint64_t first, uint64_t last, std::vector<point>& points) const {
+      points.reserve(points.size() + (last - first));
+      for (uint64_t i=first; i < last; i++) {
+        points.push_back(get_point(i));
+      }
+    }
+
+    ///
+    /// Computes the contiguous block [first, last) of n objects owned by part <code>part</code>
+    /// of <code>num_parts</code>.  Blocks differ in size by at most one object.  Use this to 
+    /// divide objects among ranks, and again to divide a rank's block among threads.
+    ///
+    static void slice(uint64_t n, size_t part, size_t num_parts, uint64_t *first, uint64_t *last) {
+      uint64_t base = n / num_parts;
+      uint64_t rem  = n % num_parts;
+      *first = part * base + std::min<uint64_t>(part, rem);
+      *last  = *first + base + (part < rem ? 1 : 0);
+    }
+
+  private:
+    /// Independent streams of random numbers, so that labels, coordinates and
+    /// centers never share inputs to the hash.
+    enum stream { center_stream = 1, label_stream = 2, point_stream = 3 };
+
+    size_t   dimension_;
+    size_t   num_clusters_;
+    uint64_t seed_;
+    double   overlap_;
+    double   imbalance_;
+    double   stddev_;
+
+    std::vector<double> centers_;      ///< num_clusters x dimension cluster centers.
+    std::vector<double> cumulative_;   ///< cumulative normalized cluster weights.
+
+    /// SplitMix64 finalizer; a cheap, high quality 64-bit mixing function.
+    static uint64_t mix(uint64_t z) {
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    /// Counter-based uniform random number in [0,1) for (stream, index, slot).
+    double uniform(stream s, uint64_t index, uint64_t slot) const {
+      uint64_t h = mix(seed_ + 0x9e3779b97f4a7c15ULL * (uint64_t)s);
+      h = mix(h ^ index);
+      h = mix(h ^ (slot + 0x632be59bd9b4e019ULL));
+      return (h >> 11) * (1.0 / 9007199254740992.0);   // 53 random bits
+    }
+
+    void update_weights() {
+      // weight of cluster c is imbalance^(-c / (k-1)), normalized to sum to 1.
+      cumulative_.resize(num_clusters_);
+      double total = 0.0;
+      for (size_t c=0; c < num_clusters_; c++) {
+        double exponent = (num_clusters_ > 1) ? (double)c / (num_clusters_ - 1) : 0.0;
+        total += std::pow(imbalance_, -exponent);
+        cumulative_[c] = total;
+      }
+      for (size_t c=0; c < num_clusters_; c++) {
+        cumulative_[c] /= total;
+      }
+    }
+
+    void update_stddev() {
+      stddev_ = overlap_ * std::pow((double)num_clusters_, -1.0 / dimension_);
+    }
+  };
+
+} // namespace cluster
+
+#endif // SYNTHETIC_GENERATOR_H
@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file synthetic_generator_test.cpp
+/// @brief Checks that synthetic_generator slices are independent, deterministic, and 
+///        have the requested cluster structure.
+///
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  uint64_t n = 100000;
+  if (argc > 1) {
+    n = strtoull(argv[1], NULL, 0);
+  }
+
+  const size_t dim = 5;
+  const size_t k   = 7;
+  synthetic_generator gen(dim, k, 42);
+  gen.set_overlap(0.05);
+  gen.set_imbalance(8);
+
+  // generate everything serially, in one shot.
+  vector<double> serial(n * dim);
+  vector<size_t> serial_labels(n);
+  gen.generate(0, n, &serial[0], &serial_labels[0]);
+
+  // generate slices in reverse order, as independent "ranks" would, with a fresh generator.
+  synthetic_generator other(dim, k, 42);
+  other.set_overlap(0.05);
+  other.set_imbalance(8);
+
+  const size_t parts = 13;
+  vector<double> sliced(n * dim);
+  vector<size_t> sliced_labels(n);
+  for (size_t p = parts; p > 0; p--) {
+    uint64_t first, last;
+    synthetic_generator::slice(n, p-1, parts, &first, &last);
+    other.generate(first, last, &sliced[first * dim], &sliced_labels[first]);
+  }
+
+  if (serial != sliced || serial_labels != sliced_labels) {
+    fail("sliced generation does not match serial generation.");
+  }
+
+  // check that cluster sizes follow the requested weights.
+  vector<size_t> counts(k, 0);
+  for (uint64_t i=0; i < n; i++) counts[serial_labels[i]]++;
+  for (size_t c=0; c < k; c++) {
+    double expected = gen.weight(c) * n;
+    if (fabs(counts[c] - expected) > 5 * sqrt(expected) + 1) {
+      fail("cluster sizes do not match weights.");
+    }
+  }
+  if (counts[0] <= counts[k-1]) {
+    fail("imbalance was not applied.");
+  }
+
+  // check that objects are near their centers: mean squared distance should be d * stddev^2.
+  double sum2 = 0;
+  for (uint64_t i=0; i < n; i++) {
+    const double *c = gen.center(serial_labels[i]);
+    for (size_t d=0; d < dim; d++) {
+      double diff = serial[i * dim + d] - c[d];
+      sum2 += diff * diff;
+    }
+  }
+  double expected2 = dim * gen.stddev() * gen.stddev();
+  if (fabs(sum2 / n - expected2) > 0.05 * expected2) {
+    fail("cluster spread does not match overlap.");
+  }
+
+  // a different seed should give different data.
+  synthetic_generator reseeded(dim, k, 43);
+  double coords[dim];
+  reseeded.generate(0, coords);
+  if (equal(coords, coords + dim, &serial[0])) {
+    fail("seed has no effect.");
+  }
+
+  cout << "PASSED" << endl;
+  return 0;
+}
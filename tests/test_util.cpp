@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file test_util.cpp
+/// @brief Implementation of the shared test helpers.
+///
+#include "test_util.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+#ifdef MUSTER_HAVE_MPI
+#include <mpi.h>
+#endif // MUSTER_HAVE_MPI
+
+using namespace std;
+
+namespace cluster {
+
+  void fail(const string& msg) {
+    cerr << "Error: " << msg << endl;
+    cout << "FAILED" << endl;
+    exit(1);
+  }
+
+
+#ifdef MUSTER_HAVE_MPI
+  void fail(int rank, const string& msg) {
+    cerr << "Error on rank " << rank << ": " << msg << endl;
+    cout << "FAILED" << endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+
+  bool same_clustering(const par_kmedoids& a, const vector<point>& a_medoids, 
+                       const par_kmedoids& b, const vector<point>& b_medoids) {
+    return a.medoid_ids == b.medoid_ids && a.cluster_ids == b.cluster_ids && a_medoids == b_medoids;
+  }
+#endif // MUSTER_HAVE_MPI
+
+
+  bool nearly_equal(double a, double b, double tolerance) {
+    return fabs(a - b) <= tolerance * max(1.0, fabs(a));
+  }
+
+
+  void make_grid_points(size_t n, unsigned seed, size_t cols, double col_step, 
+                        size_t rows, double row_step, vector<point>& points) {
+    srand(seed);
+    for (size_t i=0; i < n; i++) {
+      double cx = (i % cols) * col_step, cy = (i % rows) * row_step;
+      points.push_back(point(cx + rand() % 100 / 10.0, cy + rand() % 100 / 10.0));
+    }
+  }
+
+} // namespace cluster
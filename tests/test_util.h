@@ -0,0 +1,86 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file test_util.h
+/// @brief Helpers shared by the tests: failure reporting, tolerant comparison, and
+///        synthetic point data.
+///
+#ifndef MUSTER_TEST_UTIL_H
+#define MUSTER_TEST_UTIL_H
+
+#include "muster-config.h"
+
+#include <string>
+#include <vector>
+#include "point.h"
+
+#ifdef MUSTER_HAVE_MPI
+#include "par_kmedoids.h"
+#endif // MUSTER_HAVE_MPI
+
+namespace cluster {
+
+  ///
+  /// Prints msg and FAILED, then exits with status 1.
+  ///
+  void fail(const std::string& msg);
+
+#ifdef MUSTER_HAVE_MPI
+  ///
+  /// Prints msg with the failing rank and FAILED, then aborts MPI_COMM_WORLD.
+  ///
+  void fail(int rank, const std::string& msg);
+
+  ///
+  /// True if a and b found the same medoids and assigned every object to the same cluster.
+  ///
+  bool same_clustering(const par_kmedoids& a, const std::vector<point>& a_medoids, 
+                       const par_kmedoids& b, const std::vector<point>& b_medoids);
+#endif // MUSTER_HAVE_MPI
+
+  ///
+  /// True if a and b agree to within tolerance, relative to a when |a| > 1.
+  ///
+  bool nearly_equal(double a, double b, double tolerance = 1e-9);
+
+  ///
+  /// Appends n points jittered by up to 10 in each dimension around a grid of 
+  /// cols x rows centers, col_step and row_step apart.  Point i goes to column
+  /// i % cols and row i % rows.  Seeds rand() with seed first, so the points are 
+  /// the same on every call.
+  ///
+  void make_grid_points(size_t n, unsigned seed, size_t cols, double col_step, 
+                        size_t rows, double row_step, std::vector<point>& points);
+
+} // namespace cluster
+
+#endif // MUSTER_TEST_UTIL_H
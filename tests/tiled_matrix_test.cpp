@@ -0,0 +1,133 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file tiled_matrix_test.cpp
+/// @brief Streams a tiled on-disk dissimilarity matrix and checks that out-of-core PAM
+///        finds the same clustering as in-memory PAM.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "kmedoids.h"
+#include "tiled_matrix.h"
+#include "synthetic_generator.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+int main(int argc, char **argv) {
+  size_t n = 400;
+  if (argc > 1) {
+    n = strtol(argv[1], NULL, 0);
+  }
+
+  const size_t dim = 3;
+  const size_t k   = 6;
+  synthetic_generator gen(dim, k, 23);
+  gen.set_overlap(0.05);
+
+  dense_dataset data(dim, n);
+  for (size_t i=0; i < n; i++) {
+    gen.generate(i, data.row_data(i));
+  }
+
+  dissimilarity_matrix exact;
+  build_dissimilarity_matrix(data, dense_euclidean_distance(), exact);
+
+  char filename[] = "/tmp/muster-tiled-XXXXXX";
+  close(mkstemp(filename));
+  build_dissimilarity_matrix(data, dense_euclidean_distance(), string(filename));
+
+  // small tiles, with a partial one at the end.
+  tiled_dissimilarity_matrix tiled(filename, 37);
+  if (tiled.size1() != n || tiled.num_tiles() != (n + 36) / 37) {
+    fail("tiled matrix has the wrong shape.");
+  }
+
+  double sum = 0;
+  size_t rows_seen = 0;
+  tile_reader reader(tiled);
+  for (size_t t=0; t < reader.num_tiles(); t++) {
+    const double *row = reader.next();
+    if (reader.first_row() != rows_seen) {
+      fail("tiles aren't contiguous.");
+    }
+    for (size_t i=reader.first_row(); i < reader.last_row(); i++, row += n) {
+      for (size_t j=0; j < n; j++) {
+        if (row[j] != exact(i,j)) {
+          ostringstream msg;
+          msg << "tile entry (" << i << "," << j << ") is " << row[j] << ", expected " << exact(i,j);
+          fail(msg.str());
+        }
+        sum += row[j];
+      }
+      rows_seen++;
+    }
+  }
+  if (rows_seen != n) fail("tiles don't cover the matrix.");
+  if (fabs(sum - tiled.sum()) > 1e-9 * sum) fail("header has the wrong sum.");
+
+  // out-of-core PAM should agree with in-memory PAM.
+  kmedoids in_memory;
+  in_memory.pam(exact, k);
+
+  kmedoids out_of_core;
+  out_of_core.pam(tiled, k);
+  if (out_of_core.medoid_ids != in_memory.medoid_ids || mirkin_distance(out_of_core, in_memory) != 0) {
+    fail("out-of-core PAM found a different clustering.");
+  }
+  if (fabs(out_of_core.average_dissimilarity() - in_memory.average_dissimilarity()) 
+      > 1e-9 * in_memory.average_dissimilarity()) {
+    fail("out-of-core PAM reports a different cost.");
+  }
+
+  // starting from given medoids skips BUILD but should converge to the same place here.
+  vector<object_id> initial;
+  for (size_t m=0; m < k; m++) initial.push_back(m);
+  kmedoids warm;
+  warm.pam(tiled, k, &initial[0]);
+  kmedoids warm_in_memory;
+  warm_in_memory.pam(exact, k, &initial[0]);
+  if (fabs(warm.average_dissimilarity() - warm_in_memory.average_dissimilarity()) 
+      > 1e-9 * warm_in_memory.average_dissimilarity()) {
+    fail("out-of-core PAM from initial medoids disagrees with in-memory PAM.");
+  }
+
+  unlink(filename);
+  cout << "PASSED" << endl;
+  return 0;
+}
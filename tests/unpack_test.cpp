@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file unpack_test.cpp
+/// @brief Checks that gathers unpack objects in place instead of copying them.
+///
+#include <mpi.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include "unpack.h"
+#include "gather.h"
+#include "multi_gather.h"
+#include "id_pair.h"
+#include "packable_vector.h"
+#include "sparse_vector.h"
+#include "dense_dataset.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+///
+/// Packable payload that counts how many times a non-empty instance is copied.
+///
+struct counted {
+  static size_t copies;
+  vector<int> values;
+
+  counted() { }
+  counted(int rank) : values(rank + 1, rank) { }
+  counted(const counted& other) : values(other.values) { 
+    if (!values.empty()) copies++;
+  }
+  counted& operator=(const counted& other) {
+    values = other.values;
+    if (!values.empty()) copies++;
+    return *this;
+  }
+
+  int packed_size(MPI_Comm comm) const {
+    return cmpi_packed_size(1, MPI_SIZE_T, comm) + cmpi_packed_size(values.size(), MPI_INT, comm);
+  }
+
+  void pack(void *buf, int bufsize, int *position, MPI_Comm comm) const {
+    size_t count = values.size();
+    CMPI_Pack(&count, 1, MPI_SIZE_T, buf, bufsize, position, comm);
+    CMPI_Pack(const_cast<int*>(&values[0]), count, MPI_INT, buf, bufsize, position, comm);
+  }
+
+  static counted unpack(void *buf, int bufsize, int *position, MPI_Comm comm) {
+    counted c;
+    c.unpack_from(buf, bufsize, position, comm);
+    return c;
+  }
+
+  void unpack_from(void *buf, int bufsize, int *position, MPI_Comm comm) {
+    size_t count;
+    CMPI_Unpack(buf, bufsize, position, &count, 1, MPI_SIZE_T, comm);
+    values.resize(count);
+    CMPI_Unpack(buf, bufsize, position, &values[0], count, MPI_INT, comm);
+  }
+
+  bool is_from(int rank) const {
+    return values == vector<int>(rank + 1, rank);
+  }
+};
+
+size_t counted::copies = 0;
+
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // detection of in-place unpacking
+  if (!has_unpack_from<sparse_vector>::value)                  fail(rank, "sparse_vector not detected");
+  if (!has_unpack_from<dense_point>::value)                    fail(rank, "dense_point not detected");
+  if (!has_unpack_from< id_pair<sparse_vector> >::value)       fail(rank, "id_pair not detected");
+  if (!has_unpack_from< packable_vector<dense_point> >::value) fail(rank, "packable_vector not detected");
+  if (has_unpack_from<point>::value)                           fail(rank, "point has no unpack_from");
+
+  // round trip through unpack_into, reusing a destination that already holds data.
+  sparse_vector sv;
+  sv.push_back(2, 1.5);
+  sv.push_back(7, -2.0);
+  id_pair<sparse_vector> pair(sv, 42);
+
+  vector<char> buf(pair.packed_size(MPI_COMM_SELF));
+  int pos = 0;
+  pair.pack(&buf[0], buf.size(), &pos, MPI_COMM_SELF);
+
+  sparse_vector stale;
+  for (int i=0; i < 10; i++) stale.push_back(i, i);
+  id_pair<sparse_vector> out(stale, 3);
+  pos = 0;
+  unpack_into(out, &buf[0], buf.size(), &pos, MPI_COMM_SELF);
+  if (out.id != 42 || out.element.nnz() != 2 || out.element.indices()[1] != 7 
+      || out.element.norm2() != sv.norm2()) {
+    fail(rank, "id_pair<sparse_vector> did not round trip");
+  }
+
+  // binomial gather
+  vector<counted> gathered;
+  gather(counted(rank), gathered, MPI_COMM_WORLD, 0);
+  if (rank == 0) {
+    if (gathered.size() != (size_t)size) fail(rank, "wrong gather size");
+    for (int r=0; r < size; r++) {
+      if (!gathered[r].is_from(r)) fail(rank, "wrong gathered object");
+    }
+  }
+
+  // gather into packable_vectors that are copies of one another, and so share storage.
+  vector<point> mine(rank + 1, point(rank, rank));
+  vector< packable_vector<point> > vectors;
+  vectors.assign(size, packable_vector<point>());
+  gather(make_packable_vector(&mine, false), vectors, MPI_COMM_WORLD, 0);
+  if (rank == 0) {
+    for (int r=0; r < size; r++) {
+      if (vectors[r]._packables->size() != (size_t)r + 1 || (*vectors[r]._packables)[0] != point(r, r)) {
+        fail(rank, "packable_vectors sharing storage were unpacked into each other");
+      }
+    }
+  }
+
+  // multi_gather to every root, two objects from each rank
+  vector<counted> local(2, counted(rank));
+  vector<int> sources;
+  for (int r=0; r < size; r++) sources.push_back(r);
+
+  counted::copies = 0;
+  vector<counted> multi;
+  multi_gather<counted> mg(MPI_COMM_WORLD);
+  for (int root=0; root < size; root++) {
+    mg.start(local.begin(), local.end(), sources.begin(), sources.end(), multi, root);
+  }
+  mg.finish();
+
+  if (multi.size() != 2 * (size_t)size) fail(rank, "wrong multi_gather size");
+  for (size_t i=0; i < multi.size(); i++) {
+    if (!multi[i].is_from(i / 2)) fail(rank, "wrong multi_gathered object");
+  }
+  if (counted::copies) {
+    ostringstream msg;
+    msg << "multi_gather copied " << counted::copies << " objects while unpacking";
+    fail(rank, msg.str());
+  }
+
+  MPI_Finalize();
+  if (rank == 0) cout << "PASSED" << endl;
+  return 0;
+}
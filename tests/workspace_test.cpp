@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory  
+// LLNL-CODE-433662
+// All rights reserved.  
+//
+// This file is part of Muster. For details, see http://github.com/tgamblin/muster. 
+// Please also read the LICENSE file for further information.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+///
+/// @file workspace_test.cpp
+/// @brief Checks that kmedoids gives the same results when it reuses a workspace, and 
+///        that the workspace stops growing.
+///
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include <boost/random.hpp>
+
+#include "kmedoids.h"
+#include "point.h"
+#include "test_util.h"
+
+using namespace cluster;
+using namespace std;
+
+static bool same(const cluster::partition& a, const cluster::partition& b) {
+  return a.medoid_ids == b.medoid_ids && a.cluster_ids == b.cluster_ids;
+}
+
+
+int main(int argc, char **argv) {
+  size_t num_points = 300;
+  if (argc > 1) {
+    num_points = strtol(argv[1], NULL, 0);
+  }
+
+  // noisy points around 5 centers, reshuffled each "timestep".
+  boost::mt19937 rng(11);
+  boost::normal_distribution<double> normal(0, 1);
+  boost::variate_generator<boost::mt19937&, boost::normal_distribution<double> > noise(rng, normal);
+
+  kmedoids_workspace ws;
+  kmedoids reused;
+  reused.set_workspace(&ws);
+
+  const double *matrix_data = NULL;
+  size_t sample_capacity = 0;
+
+  for (size_t step=0; step < 4; step++) {
+    vector<point> points;
+    for (size_t i=0; i < num_points; i++) {
+      points.push_back(point(25 * (i % 5) + noise(), 10 * (i % 2) + noise()));
+    }
+
+    // CLARA with a reused workspace matches a fresh kmedoids with the same seed.
+    kmedoids fresh;
+    fresh.set_seed(step);
+    fresh.clara(points, point_distance(), 5);
+
+    reused.set_seed(step);
+    reused.clara(points, point_distance(), 5);
+    if (!same(reused, fresh)) fail("clara with a reused workspace differs from a fresh clara");
+
+    // sample matrix and sample vector are allocated once.
+    if (step == 0) {
+      matrix_data = &ws.distance.data()[0];
+      sample_capacity = ws.sample.capacity();
+    } else if (&ws.distance.data()[0] != matrix_data || ws.sample.capacity() != sample_capacity) {
+      ostringstream msg;
+      msg << "workspace was reallocated in step " << step;
+      fail(msg.str());
+    }
+
+    // xpam reuses one kmedoids for every k.
+    vector<point> few(points.begin(), points.begin() + 60);
+    dissimilarity_matrix mat;
+    build_dissimilarity_matrix(few, point_distance(), mat);
+
+    kmedoids fresh_x;
+    fresh_x.xpam(mat, 8, 2);
+    reused.xpam(mat, 8, 2);
+    if (!same(reused, fresh_x)) fail("xpam with a reused workspace differs from a fresh xpam");
+  }
+
+  if (ws.subcall.get() == NULL) fail("xpam didn't keep its subcall in the workspace");
+
+  cout << "PASSED" << endl;
+  return 0;
+}